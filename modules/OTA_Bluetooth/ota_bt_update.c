@@ -1,6 +1,10 @@
 #include <string.h>
 #include <inttypes.h>
-#include <stdlib.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/select.h>
+#include "sdkconfig.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/event_groups.h"
@@ -11,318 +15,270 @@
 #include "esp_gap_bt_api.h"
 #include "esp_spp_api.h"
 #include "esp_bt_device.h"
-#include "esp_ota_ops.h"
-#include "esp_partition.h"
+#include "ota_proto.h"
 #include "ota_bt_update.h"
 
 #define TAG "ota_bt"
 #define SPP_SERVER_NAME "ESP32_OTA_SPP"
 
-// Protocolo
-#define PROTO_START_OTA 0x01
-#define PROTO_DATA_CHUNK 0x02
-#define PROTO_END_OTA 0x03
-#define PROTO_ACK 0xAA
-#define PROTO_NAK 0xFF
-
 // Estados SPP
 #define SPP_CONN_STATE_DISCONNECTED 0
 #define SPP_CONN_STATE_CONNECTING 1
 #define SPP_CONN_STATE_CONNECTED 2
 
-// Estados OTA
-#define OTA_STATE_IDLE 0
-#define OTA_STATE_STARTED 1
-#define OTA_STATE_RECEIVING 2
-#define OTA_STATE_ENDING 3
-
-// Buffer para recepción SPP (debe ser mayor que MTU SPP)
-#define RX_BUFFER_SIZE 4096
-#define MAX_CHUNK_PAYLOAD 1021
-
 // Event group bits
-#define EVT_RX_DATA   (1 << 0)
-#define EVT_STOP_TASK (1 << 1)
-
-typedef struct {
-    uint8_t buffer[RX_BUFFER_SIZE];
-    size_t head;     // Próximo byte a escribir
-    size_t tail;     // Próximo byte a leer
-    size_t count;    // Bytes disponibles
-} rx_buffer_t;
+#define EVT_RX_DATA    (1 << 0)
+#define EVT_STOP_TASK  (1 << 1)
+#define EVT_DISCONNECT (1 << 2)
+
+#ifdef CONFIG_OTA_BT_L2CAP_ERTM
+#define SPP_L2CAP_ERTM true
+#else
+#define SPP_L2CAP_ERTM false
+#endif
+
+// Modo turbo (CONFIG_OTA_BT_SPP_VFS)
+#ifdef CONFIG_OTA_BT_SPP_TX_BUFFER_SIZE
+#define SPP_TX_BUFFER_SIZE CONFIG_OTA_BT_SPP_TX_BUFFER_SIZE
+#else
+#define SPP_TX_BUFFER_SIZE ESP_SPP_MAX_TX_BUFFER_SIZE
+#endif
+#ifdef CONFIG_OTA_BT_SPP_READ_SIZE
+#define SPP_READ_SIZE CONFIG_OTA_BT_SPP_READ_SIZE
+#else
+#define SPP_READ_SIZE OTA_PROTO_MAX_PUSH
+#endif
+#define SPP_TX_BATCH 64                // Respuestas de una pasada en un solo write()
+#define SPP_VFS_POLL_TICKS 1           // Sin select(): read() de SPP VFS no bloquea, sin datos esperar un tick
+#define SPP_VFS_SELECT_MS 100          // Con select(): cada cuánto mirar s_link_q si no llegan datos
+#define SPP_LINK_QUEUE_LEN 4           // Modo VFS: aperturas y cierres pendientes para la task
 
 typedef struct {
     uint32_t spp_handle;
+    int spp_fd;              // Descriptor de la conexión que atiende la task en modo VFS
     uint8_t spp_state;
-    uint8_t ota_state;
-    esp_ota_handle_t ota_handle;
-    const esp_partition_t *update_partition;
-    size_t bytes_received;
-    size_t expected_size;
-    uint32_t start_time;
-    uint32_t chunk_count;
-    rx_buffer_t rx_buf;
+    bool proto;              // El protocolo OTA es de esta conexión (no de otro transporte)
 } ota_bt_state_t;
 
 static ota_bt_state_t ota_state = {
     .spp_handle = 0,
+    .spp_fd = -1,
     .spp_state = SPP_CONN_STATE_DISCONNECTED,
-    .ota_state = OTA_STATE_IDLE,
-    .bytes_received = 0,
-    .expected_size = 0,
-    .chunk_count = 0,
-    .rx_buf = {}
+    .proto = false,
 };
 
 // Task y eventos
 static TaskHandle_t s_ota_task_handle = NULL;
 static EventGroupHandle_t s_ota_events = NULL;
 
+#ifdef CONFIG_OTA_BT_SPP_VFS
+
+// Modo VFS: el callback pasa aperturas y cierres a la task por s_link_q, en
+// orden y con su handle, para que un cierre no se pierda ni se aplique a otra conexión
+typedef enum {
+    SPP_LINK_OPEN,
+    SPP_LINK_CLOSE,
+    SPP_LINK_STOP,           // ota_bt_stop
+} spp_link_type_t;
+
+typedef struct {
+    uint8_t type;            // spp_link_type_t
+    uint32_t handle;
+    int fd;                  // Solo SPP_LINK_OPEN
+} spp_link_evt_t;
+
+static QueueHandle_t s_link_q = NULL;
+
+static uint8_t s_rx[SPP_READ_SIZE];
+static uint8_t s_tx[SPP_TX_BATCH];
+static size_t s_tx_len;
+static bool s_select = true;             // select() disponible en el VFS de SPP (si no, sondeo por tick)
+
 /**
- * @brief Agregar bytes al buffer circular de recepción
+ * @brief Dormir hasta que el descriptor SPP tenga datos (o sitio para escribir)
+ *
+ * Vuelve también a los SPP_VFS_SELECT_MS para que el llamante mire la cola
+ * de conexiones. Si el VFS de SPP no implementa select() (ENOSYS) se avisa
+ * una vez y las esperas siguientes son de SPP_VFS_POLL_TICKS.
+ * @return false si no se esperó: el llamante espera por su cuenta
  */
-static void rx_buffer_append(rx_buffer_t *buf, const uint8_t *data, size_t len)
+static bool spp_vfs_select(int fd, bool write)
 {
-    for (size_t i = 0; i < len; i++) {
-        buf->buffer[buf->head] = data[i];
-        buf->head = (buf->head + 1) % RX_BUFFER_SIZE;
-        if (buf->count < RX_BUFFER_SIZE) {
-            buf->count++;
-        } else {
-            // Buffer lleno, descartar datos antiguos (emergencia)
-            buf->tail = (buf->tail + 1) % RX_BUFFER_SIZE;
-            ESP_LOGW(TAG, "RX buffer overflow!");
+    if (!s_select) {
+        return false;
+    }
+
+    fd_set fds;
+    FD_ZERO(&fds);
+    FD_SET(fd, &fds);
+    struct timeval tv = { .tv_sec = 0, .tv_usec = SPP_VFS_SELECT_MS * 1000 };
+    if (select(fd + 1, write ? NULL : &fds, write ? &fds : NULL, NULL, &tv) >= 0) {
+        return true;
+    }
+    if (errno == ENOSYS) {
+        ESP_LOGW(TAG, "select() no disponible en SPP VFS: se sondea cada %d tick(s)", SPP_VFS_POLL_TICKS);
+        s_select = false;
+    }
+    return false;
+}
+
+static esp_err_t spp_write_all(const uint8_t *data, size_t len)
+{
+    while (len > 0) {
+        ssize_t n = write(ota_state.spp_fd, data, len);
+        if (n < 0) {
+            ESP_LOGW(TAG, "write SPP falló: errno %d", errno);
+            return ESP_FAIL;
         }
+        if (n == 0) {
+            // Buffer TX lleno
+            if (!spp_vfs_select(ota_state.spp_fd, true)) {
+                vTaskDelay(SPP_VFS_POLL_TICKS);
+            }
+            continue;
+        }
+        data += n;
+        len -= n;
     }
+    return ESP_OK;
+}
+
+static esp_err_t spp_flush(void *ctx)
+{
+    if (s_tx_len == 0) {
+        return ESP_OK;
+    }
+
+    esp_err_t err = spp_write_all(s_tx, s_tx_len);
+    s_tx_len = 0;
+    return err;
 }
 
 /**
- * @brief Leer bytes del buffer circular
+ * @brief Acumular la respuesta; el protocolo llama a spp_flush al terminar
+ * la pasada o antes de esperar
  */
-static size_t rx_buffer_read(rx_buffer_t *buf, uint8_t *out, size_t len)
+static esp_err_t spp_send(void *ctx, const uint8_t *data, size_t len)
 {
-    size_t to_read = (len < buf->count) ? len : buf->count;
-    
-    for (size_t i = 0; i < to_read; i++) {
-        out[i] = buf->buffer[buf->tail];
-        buf->tail = (buf->tail + 1) % RX_BUFFER_SIZE;
-        buf->count--;
+    if (s_tx_len + len > sizeof(s_tx)) {
+        esp_err_t err = spp_flush(ctx);
+        if (err != ESP_OK) {
+            return err;
+        }
+        if (len > sizeof(s_tx)) {
+            return spp_write_all(data, len);   // STATUS, SECTOR_HASH
+        }
     }
-    
-    return to_read;
+
+    memcpy(&s_tx[s_tx_len], data, len);
+    s_tx_len += len;
+    return ESP_OK;
 }
 
+static const ota_proto_transport_t s_spp_transport = {
+    .name = "SPP",
+    .send = spp_send,
+    .flush = spp_flush,
+};
+
 /**
- * @brief Peek (leer sin consumir) del buffer
+ * @brief Mirar si ya se cerró la conexión `handle` (o se pidió parar)
+ *
+ * Consume el cierre de `handle` y descarta cierres de conexiones anteriores;
+ * una apertura o una parada se dejan en la cola para ota_bt_task.
+ * @param wait Ticks de espera si la cola está vacía
+ * @return true si la conexión terminó
  */
-static size_t rx_buffer_peek(rx_buffer_t *buf, uint8_t *out, size_t len)
+static bool spp_vfs_link_done(uint32_t handle, TickType_t wait)
 {
-    size_t to_read = (len < buf->count) ? len : buf->count;
-    size_t pos = buf->tail;
-    
-    for (size_t i = 0; i < to_read; i++) {
-        out[i] = buf->buffer[pos];
-        pos = (pos + 1) % RX_BUFFER_SIZE;
+    spp_link_evt_t evt;
+    while (xQueuePeek(s_link_q, &evt, wait) == pdTRUE) {
+        if (evt.type != SPP_LINK_CLOSE) {
+            return true;
+        }
+        xQueueReceive(s_link_q, &evt, 0);
+        if (evt.handle == handle) {
+            return true;
+        }
     }
-    
-    return to_read;
+    return false;
 }
 
 /**
- * @brief Procesar paquetes del buffer
+ * @brief Atender una conexión en modo VFS: read() → ota_proto_receive hasta que cierre
  */
-static void process_rx_buffer(uint32_t handle)
+static void spp_vfs_serve(const spp_link_evt_t *link)
 {
-    uint8_t response;
-    rx_buffer_t *buf = &ota_state.rx_buf;
-    
-    while (buf->count > 0) {
-        // Peek al primer byte (comando)
-        uint8_t cmd;
-        if (rx_buffer_peek(buf, &cmd, 1) < 1) break;
-        
-        // ========== START_OTA ==========
-        if (cmd == PROTO_START_OTA) {
-            if (buf->count < 5) {
-                break;  // Esperar más datos
-            }
-            
-            uint8_t header[5];
-            rx_buffer_read(buf, header, 5);
-            
-            if (ota_state.ota_state != OTA_STATE_IDLE) {
-                ESP_LOGW(TAG, "START_OTA rechazado (estado: %d)", ota_state.ota_state);
-                response = PROTO_NAK;
-                esp_spp_write(handle, 1, &response);
-                continue;
-            }
-            
-            size_t size = (header[1] << 24) | (header[2] << 16) | (header[3] << 8) | header[4];
-            ESP_LOGI(TAG, "START_OTA: %zu bytes", size);
-            
-            ota_state.update_partition = esp_ota_get_next_update_partition(NULL);
-            if (ota_state.update_partition == NULL) {
-                ESP_LOGE(TAG, "Partición OTA no disponible");
-                response = PROTO_NAK;
-                esp_spp_write(handle, 1, &response);
-                continue;
-            }
-            
-            esp_err_t err = esp_ota_begin(ota_state.update_partition, OTA_SIZE_UNKNOWN, &ota_state.ota_handle);
-            if (err != ESP_OK) {
-                ESP_LOGE(TAG, "esp_ota_begin falló: %s", esp_err_to_name(err));
-                response = PROTO_NAK;
-                esp_spp_write(handle, 1, &response);
-                continue;
-            }
-            
-            ota_state.ota_state = OTA_STATE_RECEIVING;
-            ota_state.bytes_received = 0;
-            ota_state.expected_size = size;
-            ota_state.chunk_count = 0;
-            ota_state.start_time = xTaskGetTickCount();
-            
-            response = PROTO_ACK;
-            esp_spp_write(handle, 1, &response);
-            ESP_LOGI(TAG, "OTA iniciada. Esperando %zu bytes", size);
+    if (ota_proto_connect(&s_spp_transport) != ESP_OK) {
+        // Otro transporte tiene el protocolo: sin leer, RFCOMM frena al PC
+        while (!spp_vfs_link_done(link->handle, portMAX_DELAY)) {
         }
-        // ========== DATA_CHUNK ==========
-        else if (cmd == PROTO_DATA_CHUNK) {
-            if (buf->count < 3) {
-                break;  // Esperar más datos
-            }
-            
-            uint8_t header[3];
-            rx_buffer_peek(buf, header, 3);
-            
-            uint16_t chunk_len = (header[1] << 8) | header[2];
-            
-            if (chunk_len > MAX_CHUNK_PAYLOAD) {
-                ESP_LOGE(TAG, "Longitud inválida: %u", chunk_len);
-                rx_buffer_read(buf, header, 3);  // Descartar
-                response = PROTO_NAK;
-                esp_spp_write(handle, 1, &response);
-                continue;
-            }
-            
-            if (buf->count < (3 + chunk_len)) {
-                break;  // Esperar más datos
-            }
-            
-            if (ota_state.ota_state != OTA_STATE_RECEIVING) {
-                ESP_LOGW(TAG, "DATA_CHUNK rechazado (estado: %d)", ota_state.ota_state);
-                rx_buffer_read(buf, header, 3 + chunk_len);  // Descartar
-                response = PROTO_NAK;
-                esp_spp_write(handle, 1, &response);
-                continue;
-            }
-            
-            rx_buffer_read(buf, header, 3);
-            
-            uint8_t *chunk_data = (uint8_t *)malloc(chunk_len);
-            if (chunk_data == NULL) {
-                ESP_LOGE(TAG, "No hay memoria para chunk");
-                response = PROTO_NAK;
-                esp_spp_write(handle, 1, &response);
-                continue;
-            }
-            
-            size_t read = rx_buffer_read(buf, chunk_data, chunk_len);
-            if (read != chunk_len) {
-                ESP_LOGE(TAG, "Lectura incompleta: %zu/%u", read, chunk_len);
-                free(chunk_data);
-                response = PROTO_NAK;
-                esp_spp_write(handle, 1, &response);
-                continue;
-            }
-            
-            esp_err_t err = esp_ota_write(ota_state.ota_handle, chunk_data, chunk_len);
-            free(chunk_data);
-            
-            if (err != ESP_OK) {
-                ESP_LOGE(TAG, "esp_ota_write falló: %s", esp_err_to_name(err));
-                esp_ota_abort(ota_state.ota_handle);
-                ota_state.ota_state = OTA_STATE_IDLE;
-                response = PROTO_NAK;
-                esp_spp_write(handle, 1, &response);
-                continue;
-            }
-            
-            ota_state.bytes_received += chunk_len;
-            ota_state.chunk_count++;
-            response = PROTO_ACK;
-            esp_spp_write(handle, 1, &response);
+        return;
+    }
+
+    ota_state.spp_fd = link->fd;
+    ota_state.proto = true;
+    s_tx_len = 0;
+    for (;;) {
+        ssize_t n = read(link->fd, s_rx, sizeof(s_rx));
+        if (n > 0) {
+            ota_proto_receive(s_rx, n);
+            continue;
         }
-        // ========== END_OTA ==========
-        else if (cmd == PROTO_END_OTA) {
-            if (buf->count < 1) {
-                break;
-            }
-            
-            uint8_t end_byte;
-            rx_buffer_read(buf, &end_byte, 1);
-            
-            if (ota_state.ota_state != OTA_STATE_RECEIVING) {
-                ESP_LOGW(TAG, "END_OTA rechazado (estado: %d)", ota_state.ota_state);
-                response = PROTO_NAK;
-                esp_spp_write(handle, 1, &response);
-                continue;
-            }
-            
-            ESP_LOGI(TAG, "END_OTA recibido");
-            ota_state.ota_state = OTA_STATE_ENDING;
-            
-            if (ota_state.bytes_received != ota_state.expected_size) {
-                ESP_LOGW(TAG, "Tamaño mismatch: %zu recibidos vs %zu esperados",
-                    ota_state.bytes_received, ota_state.expected_size);
-            }
-            
-            uint32_t elapsed_ms = (xTaskGetTickCount() - ota_state.start_time) * portTICK_PERIOD_MS;
-            float elapsed_s = elapsed_ms / 1000.0;
-            float speed_mbps = (ota_state.bytes_received / (float)(elapsed_ms ? elapsed_ms : 1)) * 1000.0f / (1024.0f * 1024.0f);
-            
-            ESP_LOGI(TAG, "OTA finalizada:");
-            ESP_LOGI(TAG, "   - Bytes: %zu", ota_state.bytes_received);
-            ESP_LOGI(TAG, "   - Chunks: %lu", ota_state.chunk_count);
-            ESP_LOGI(TAG, "   - Tiempo: %.2f s", elapsed_s);
-            ESP_LOGI(TAG, "   - Velocidad: %.2f MB/s", speed_mbps);
-            
-            esp_err_t err = esp_ota_end(ota_state.ota_handle);
-            if (err != ESP_OK) {
-                ESP_LOGE(TAG, "esp_ota_end falló: %s", esp_err_to_name(err));
-                ota_state.ota_state = OTA_STATE_IDLE;
-                response = PROTO_NAK;
-                esp_spp_write(handle, 1, &response);
-                continue;
-            }
-            
-            err = esp_ota_set_boot_partition(ota_state.update_partition);
-            if (err != ESP_OK) {
-                ESP_LOGE(TAG, "esp_ota_set_boot_partition falló: %s", esp_err_to_name(err));
-                ota_state.ota_state = OTA_STATE_IDLE;
-                response = PROTO_NAK;
-                esp_spp_write(handle, 1, &response);
-                continue;
-            }
-            
-            response = PROTO_ACK;
-            esp_spp_write(handle, 1, &response);
-            ESP_LOGI(TAG, "OTA confirmada. Reiniciando en 2s...");
-            ota_state.ota_state = OTA_STATE_IDLE;
-            
-            vTaskDelay(pdMS_TO_TICKS(2000));
-            esp_restart();
+        if (n < 0) {
+            break;   // Conexión cerrada
         }
-        else {
-            uint8_t bad_byte;
-            rx_buffer_read(buf, &bad_byte, 1);
-            ESP_LOGW(TAG, "Byte desconocido descartado: 0x%02X", bad_byte);
+        bool waited = spp_vfs_select(link->fd, false);
+        if (spp_vfs_link_done(link->handle, waited ? 0 : SPP_VFS_POLL_TICKS)) {
+            break;
         }
     }
+
+    ota_proto_disconnect(&s_spp_transport);
+    ota_state.proto = false;
+    ota_state.spp_fd = -1;
 }
 
 /**
- * @brief Task que procesa el buffer RX y gestiona OTA
+ * @brief Task OTA en modo VFS: lee la conexión y procesa en la misma task
+ */
+static void ota_bt_task(void *arg)
+{
+    ESP_LOGI(TAG, "OTA BT task iniciada (SPP VFS)");
+    spp_link_evt_t evt;
+    for (;;) {
+        xQueueReceive(s_link_q, &evt, portMAX_DELAY);
+        if (evt.type == SPP_LINK_STOP) {
+            ESP_LOGI(TAG, "OTA BT task detenida");
+            break;
+        }
+        if (evt.type == SPP_LINK_OPEN) {
+            spp_vfs_serve(&evt);
+        }
+        // SPP_LINK_CLOSE suelto: de una conexión que ya terminó por read()
+    }
+
+    s_ota_task_handle = NULL;
+    vTaskDelete(NULL);
+}
+
+#else
+
+static esp_err_t spp_send(void *ctx, const uint8_t *data, size_t len)
+{
+    return esp_spp_write(ota_state.spp_handle, len, (uint8_t *)data);
+}
+
+static const ota_proto_transport_t s_spp_transport = {
+    .name = "SPP",
+    .send = spp_send,
+};
+
+/**
+ * @brief Task que procesa el buffer RX del protocolo OTA
+ *
+ * El callback SPP corre en la task de Bluedroid y solo hace ota_proto_push;
+ * el procesado (que puede esperar a la flash) se hace aquí.
  */
 static void ota_bt_task(void *arg)
 {
@@ -330,21 +286,26 @@ static void ota_bt_task(void *arg)
     for (;;) {
         EventBits_t bits = xEventGroupWaitBits(
             s_ota_events,
-            EVT_RX_DATA | EVT_STOP_TASK,
+            EVT_RX_DATA | EVT_STOP_TASK | EVT_DISCONNECT,
             pdTRUE,      // clear on exit
             pdFALSE,     // wait for any bit
             portMAX_DELAY
         );
 
+        if (bits & (EVT_STOP_TASK | EVT_DISCONNECT)) {
+            // El cierre se hace aquí y no en el callback SPP para no
+            // adelantarse a la task escritora. Si ya conectó otro cliente,
+            // ota_proto_close marcó dónde acaba el anterior y este sigue conectado
+            ota_proto_disconnect(&s_spp_transport);
+        }
+
         if (bits & EVT_STOP_TASK) {
             ESP_LOGI(TAG, "OTA BT task detenida");
             break;
         }
 
         if (bits & EVT_RX_DATA) {
-            if (ota_state.spp_handle != 0) {
-                process_rx_buffer(ota_state.spp_handle);
-            }
+            ota_proto_process();
         }
     }
 
@@ -352,6 +313,8 @@ static void ota_bt_task(void *arg)
     vTaskDelete(NULL);
 }
 
+#endif // CONFIG_OTA_BT_SPP_VFS
+
 /**
  * @brief GAP callback
  */
@@ -400,12 +363,21 @@ static void esp_spp_cb(esp_spp_cb_event_t event, esp_spp_cb_param_t *param)
     case ESP_SPP_CLOSE_EVT:
         ESP_LOGI(TAG, "[SPP] Desconectado");
         ota_state.spp_state = SPP_CONN_STATE_DISCONNECTED;
-        if (ota_state.ota_state != OTA_STATE_IDLE) {
-            ESP_LOGW(TAG, "Abortando OTA: conexión cerrada");
-            esp_ota_abort(ota_state.ota_handle);
-            ota_state.ota_state = OTA_STATE_IDLE;
+#ifdef CONFIG_OTA_BT_SPP_VFS
+        if (s_link_q) {
+            spp_link_evt_t evt = { .type = SPP_LINK_CLOSE, .handle = param->close.handle };
+            if (xQueueSend(s_link_q, &evt, 0) != pdTRUE) {
+                ESP_LOGW(TAG, "[SPP] Cola de conexiones llena: el cierre se verá por read()");
+            }
         }
-        memset(&ota_state.rx_buf, 0, sizeof(rx_buffer_t));
+#else
+        // La task desconecta después: lo que llegue antes es ya de la conexión siguiente
+        ota_state.proto = false;
+        ota_proto_close(&s_spp_transport);
+        if (s_ota_events) {
+            xEventGroupSetBits(s_ota_events, EVT_DISCONNECT);
+        }
+#endif
         break;
 
     case ESP_SPP_START_EVT:
@@ -417,18 +389,26 @@ static void esp_spp_cb(esp_spp_cb_event_t event, esp_spp_cb_param_t *param)
         ESP_LOGI(TAG, "[SPP] Cliente conectado");
         ota_state.spp_handle = param->srv_open.handle;
         ota_state.spp_state = SPP_CONN_STATE_CONNECTED;
-        ota_state.ota_state = OTA_STATE_IDLE;
-        memset(&ota_state.rx_buf, 0, sizeof(rx_buffer_t));
+#ifdef CONFIG_OTA_BT_SPP_VFS
+        // La task conecta el protocolo y lee el descriptor cuando termine con la conexión anterior
+        if (s_link_q) {
+            spp_link_evt_t evt = { .type = SPP_LINK_OPEN, .handle = param->srv_open.handle,
+                                   .fd = param->srv_open.fd };
+            if (xQueueSend(s_link_q, &evt, 0) != pdTRUE) {
+                ESP_LOGE(TAG, "[SPP] Cola de conexiones llena: cliente sin protocolo OTA");
+            }
+        }
+#else
+        // Sin esperar a la task: si aún no procesó el cierre anterior,
+        // ota_proto_close separó lo de esa conexión y este cliente sigue conectado
+        ota_state.proto = (ota_proto_connect(&s_spp_transport) == ESP_OK);
+#endif
         break;
 
     case ESP_SPP_DATA_IND_EVT: {
-        uint8_t *data = param->data_ind.data;
-        uint16_t len = param->data_ind.len;
-        if (len == 0) break;
-
-        rx_buffer_append(&ota_state.rx_buf, data, len);
-        ESP_LOGD(TAG, "SPP RX: %u bytes (buffer: %zu/%d)", len, ota_state.rx_buf.count, RX_BUFFER_SIZE);
+        if (!ota_state.proto) break;   // Otro transporte tiene el protocolo
 
+        ota_proto_push(param->data_ind.data, param->data_ind.len);
         if (s_ota_events) {
             xEventGroupSetBits(s_ota_events, EVT_RX_DATA);
         }
@@ -453,6 +433,19 @@ esp_err_t ota_bt_init(const char *device_name)
             return ESP_FAIL;
         }
     }
+#ifdef CONFIG_OTA_BT_SPP_VFS
+    if (!s_link_q) {
+        s_link_q = xQueueCreate(SPP_LINK_QUEUE_LEN, sizeof(spp_link_evt_t));
+        if (!s_link_q) {
+            ESP_LOGE(TAG, "No se pudo crear la cola de conexiones");
+            return ESP_FAIL;
+        }
+    }
+#endif
+
+    if (ota_proto_init() != ESP_OK) {
+        return ESP_FAIL;
+    }
 
     if (!s_ota_task_handle) {
         BaseType_t res = xTaskCreate(
@@ -485,12 +478,20 @@ esp_err_t ota_bt_init(const char *device_name)
     ESP_ERROR_CHECK(esp_spp_register_callback(esp_spp_cb));
 
     esp_spp_cfg_t spp_cfg = {
+#ifdef CONFIG_OTA_BT_SPP_VFS
+        .mode = ESP_SPP_MODE_VFS,
+        .tx_buffer_size = SPP_TX_BUFFER_SIZE,
+#else
         .mode = ESP_SPP_MODE_CB,
-        .enable_l2cap_ertm = false,
-        .tx_buffer_size = 0
+        .tx_buffer_size = 0,
+#endif
+        .enable_l2cap_ertm = SPP_L2CAP_ERTM,
     };
 
     ESP_ERROR_CHECK(esp_spp_enhanced_init(&spp_cfg));
+#ifdef CONFIG_OTA_BT_SPP_VFS
+    ESP_ERROR_CHECK(esp_spp_vfs_register());
+#endif
 
     esp_bt_io_cap_t iocap = ESP_BT_IO_CAP_NONE;
     esp_bt_gap_set_security_param(ESP_BT_SP_IOCAP_MODE, &iocap, sizeof(uint8_t));
@@ -505,28 +506,31 @@ esp_err_t ota_bt_init(const char *device_name)
     esp_bt_gap_set_device_name(device_name ? device_name : SPP_SERVER_NAME);
     esp_bt_gap_set_scan_mode(ESP_BT_CONNECTABLE, ESP_BT_GENERAL_DISCOVERABLE);
 
-    ESP_LOGI(TAG, "Bluetooth OTA inicializado - PIN: 1234");
-    ESP_LOGI(TAG, "RX Buffer: %d bytes (max %d por chunk)", RX_BUFFER_SIZE, MAX_CHUNK_PAYLOAD);
+    ESP_LOGI(TAG, "Bluetooth OTA inicializado (SPP %s, ERTM %s) - PIN: 1234",
+             spp_cfg.mode == ESP_SPP_MODE_VFS ? "VFS" : "callback", SPP_L2CAP_ERTM ? "sí" : "no");
 
     return ESP_OK;
 }
 
 esp_err_t ota_bt_stop(void)
 {
-    // Señalamos a la task que termine
+    // Señalamos a la task que termine (suspende o aborta la OTA en curso)
     if (s_ota_events && s_ota_task_handle) {
+#ifdef CONFIG_OTA_BT_SPP_VFS
+        spp_link_evt_t evt = { .type = SPP_LINK_STOP };
+        xQueueSend(s_link_q, &evt, portMAX_DELAY);
+#else
         xEventGroupSetBits(s_ota_events, EVT_STOP_TASK);
-        // Esperar un poco a que muera la task (opcional)
-        vTaskDelay(pdMS_TO_TICKS(100));
-    }
-
-    // Abortamos OTA en curso si la hay
-    if (ota_state.ota_state != OTA_STATE_IDLE) {
-        esp_ota_abort(ota_state.ota_handle);
-        ota_state.ota_state = OTA_STATE_IDLE;
+#endif
+        while (s_ota_task_handle) {
+            vTaskDelay(pdMS_TO_TICKS(10));
+        }
     }
 
     // Apagar BT
+#ifdef CONFIG_OTA_BT_SPP_VFS
+    esp_spp_vfs_unregister();
+#endif
     esp_spp_deinit();
     esp_bluedroid_disable();
     esp_bluedroid_deinit();
@@ -547,15 +551,31 @@ esp_err_t ota_bt_deinit(void)
         vEventGroupDelete(s_ota_events);
         s_ota_events = NULL;
     }
+#ifdef CONFIG_OTA_BT_SPP_VFS
+    if (s_link_q) {
+        vQueueDelete(s_link_q);
+        s_link_q = NULL;
+    }
+#endif
+
+    // La task escritora es compartida: sigue viva si otro transporte la usa
+    if (ota_proto_deinit() != ESP_OK) {
+        ESP_LOGW(TAG, "Protocolo OTA en uso por otro transporte, escritor no liberado");
+    }
 
     ESP_LOGI(TAG, "Bluetooth OTA desinicializado");
 
     return ESP_OK;
 }
 
+esp_err_t ota_bt_get_writer_stats(ota_bt_writer_stats_t *out)
+{
+    return ota_proto_get_writer_stats(out);
+}
+
 esp_err_t ota_bt_finish_update(void)
 {
-    if (ota_state.ota_state == OTA_STATE_IDLE) {
+    if (!ota_proto_session_active()) {
         return ESP_ERR_INVALID_STATE;
     }
 
@@ -1,12 +1,19 @@
 #pragma once
 
+#include <stdint.h>
 #include "esp_err.h"
 #include "esp_spp_api.h"
+#include "ota_proto.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/**
+ * @brief Estadísticas del escritor de flash (ver ota_proto_writer_stats_t)
+ */
+typedef ota_proto_writer_stats_t ota_bt_writer_stats_t;
+
 /**
  * @brief Initialize Bluetooth OTA module with SPP profile
  * @param device_name Bluetooth device name for discovery
@@ -26,6 +33,13 @@ esp_err_t ota_bt_deinit(void);
  */
 esp_err_t ota_bt_finish_update(void);
 
+/**
+ * @brief Get flash writer statistics (stall time > 0 means flash is the bottleneck)
+ * @param out Destination structure
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG if out is NULL
+ */
+esp_err_t ota_bt_get_writer_stats(ota_bt_writer_stats_t *out);
+
 /**
  * @brief Stop Bluetooth OTA service (turn off BT stack, keep app running)
  * @return ESP_OK on success
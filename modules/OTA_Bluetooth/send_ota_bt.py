@@ -1,22 +1,57 @@
 #!/usr/bin/env python3
 
 """
-ESP32 Bluetooth OTA Update Tool v4.0 - COMPATIBLE CON BUFFER RX
+ESP32 Bluetooth OTA Update Tool v5.0 - VENTANA DESLIZANTE
 
-Cambios en v4.0:
-- Compatibilidad con RX buffer del ESP32
-- Sincronización mejorada
-- Validación de ACK antes de siguiente paquete
+Cambios en v5.0:
+- Modo ventana: varios chunks en vuelo con ACK acumulativo
+- Modo benchmark para comparar tamaños de ventana
+- Compresión deflate opcional (--compress), inflada en el ESP32
+- Actualización delta opcional (--delta BASE.bin), aplicada en el ESP32
+- Reanudación tras desconexión (RESUME_OTA) y reconexión automática
+- CRC32 por chunk (OTA_FLAG_CRC) y SHA-256 de la imagen verificado en el ESP32
+- Control de flujo por créditos (OTA_FLAG_CREDIT): nunca se envía más de lo que cabe en el buffer RX del ESP32
+- Chunk negociado en START/RESUME (--chunk): el ESP32 anuncia su chunk máximo y su buffer RX
+- Dedupe por sectores (--dedupe): los sectores de 4 KB iguales a la app en ejecución los copia el ESP32
+- Telemetría al final (STATUS): histogramas de latencia del ESP32 y cuello de botella (enlace, CPU o flash)
+- Modo flota (--fleet): la misma imagen a varios puertos en paralelo, con reintentos y resumen JSON
+- Se mantiene el modo stop-and-wait (--window 0)
+- Mismo protocolo por UART (--baud) y TCP (socket://IP:PUERTO)
 
-Protocolo:
+Protocolo (stop-and-wait):
 - [0x01] + [size_4_bytes] = START_OTA (5 bytes)
 - [0x02] + [len_2_bytes] + [data] = DATA_CHUNK (3 + len bytes)
 - [0x03] = END_OTA (1 byte)
 - 0xAA = ACK
 - 0xFF = NAK
 
+Protocolo (ventana):
+- [0x04] + [len_2_bytes] + [TLV...] = START_OTA_EXT -> 0xAA + [len] + [TLV...]
+- [0x05] + [seq_2_bytes] + [len_2_bytes] + [data] (+ [crc32_4_bytes]) = DATA_SEQ
+- [0x06] = ABORT_OTA
+- [0x07] + [len_2_bytes] + [TLV...] = RESUME_OTA -> 0xAA + [len] + [TLV ventana, offset]
+- TLV chunk (0x07, 2 bytes) pedido en START/RESUME; la respuesta trae el aceptado y el buffer RX (0x08, 4 bytes)
+- [0x08] + [first_2_bytes] + [count_1_byte] = SECTOR_HASH -> 0xAA + [first_2_bytes] + [count_1_byte] + [hash_16_bytes] x count
+- [0x09] + [seq_2_bytes] + [sector_2_bytes] + [count_1_byte] (+ [crc32_4_bytes]) = COPY_SEQ (con OTA_FLAG_DEDUPE)
+- [0xC1] = STATUS -> 0xAA + [len_2_bytes] + [TLV...] (telemetría de la sesión actual o la última)
+- 0xAB + [next_seq_2_bytes] (+ [credit_4_bytes]) = SACK (todo lo anterior a next_seq escrito)
+- 0xAC + [next_seq_2_bytes] + [código] (+ [credit_4_bytes]) = SNAK (retransmitir desde next_seq)
+- credit: bytes enviados desde el ACK de START/RESUME que el ESP32 puede aceptar (TLV_CREDIT inicial)
+- 0xFF + [código] = NAK
+
 Uso:
-python3 send_ota_v4.py COM9 build/app.bin
+python3 send_ota_bt.py COM9 build/app.bin
+python3 send_ota_bt.py COM9 build/app.bin --window 8
+python3 send_ota_bt.py COM9 build/app.bin --bench 1,2,4,8
+python3 send_ota_bt.py COM9 build/app.bin --bench 4,8 --bench-chunks 1021,2048,4096
+python3 send_ota_bt.py COM9 build/app.bin --window 8 --compress
+python3 send_ota_bt.py COM9 build/app.bin --window 8 --delta Versions/0.1/OTA.bin --compress
+python3 send_ota_bt.py COM9 build/app.bin --window 8 --dedupe
+python3 send_ota_bt.py COM9 build/app.bin --status
+python3 send_ota_bt.py /dev/rfcomm0,/dev/rfcomm1,/dev/rfcomm2 build/app.bin --window 8 --fleet --summary flota.json
+python3 send_ota_bt.py @puertos.txt build/app.bin --window 8 --fleet --jobs 4 --fleet-logs logs/
+python3 send_ota_bt.py /dev/ttyUSB0 build/app.bin --window 8 --baud 921600
+python3 send_ota_bt.py socket://192.168.1.50:3333 build/app.bin --window 15
 """
 
 import serial
@@ -24,14 +59,87 @@ import sys
 import time
 import os
 import struct
+import argparse
+import zlib
+import hashlib
+import threading
+import queue
+import io
+import json
+import re
+
+# Generador de parches compartido con pack_ota.py (modules/OTA_Stream)
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "OTA_Stream"))
+from pack_ota import make_delta
 
 # Protocolo
 PROTO_START_OTA = 0x01
 PROTO_DATA_CHUNK = 0x02
 PROTO_END_OTA = 0x03
+PROTO_START_OTA_EXT = 0x04
+PROTO_DATA_SEQ = 0x05
+PROTO_ABORT_OTA = 0x06
+PROTO_RESUME_OTA = 0x07
+PROTO_SECTOR_HASH = 0x08
+PROTO_COPY_SEQ = 0x09
+PROTO_STATUS = 0xC1
 PROTO_ACK = 0xAA
+PROTO_SACK = 0xAB
+PROTO_SNAK = 0xAC
 PROTO_NAK = 0xFF
 
+# TLVs de START_OTA_EXT
+TLV_IMAGE_SIZE = 0x01
+TLV_WINDOW = 0x02
+TLV_FLAGS = 0x03
+TLV_IMAGE_HASH = 0x04
+TLV_OFFSET = 0x05
+TLV_CREDIT = 0x06
+TLV_CHUNK = 0x07
+TLV_RX_BUFFER = 0x08
+
+# Flags de START_OTA_EXT
+OTA_FLAG_DEFLATE = 0x01
+OTA_FLAG_DELTA = 0x02
+OTA_FLAG_CRC = 0x04
+OTA_FLAG_CREDIT = 0x08
+OTA_FLAG_DEDUPE = 0x10
+OTA_FLAGS_TRANSFORM = OTA_FLAG_DEFLATE | OTA_FLAG_DELTA
+OTA_INFLATE_WINDOW_BITS = 12  # Igual que ota_inflate.h / pack_ota.py
+
+MAX_CHUNK_PAYLOAD = 1021      # DATA_CHUNK y firmwares sin TLV_CHUNK
+DEFAULT_CHUNK = 4096          # Chunk pedido en START/RESUME (el ESP32 lo recorta)
+MAX_RETRIES = 10
+SECTOR_SIZE = 4096
+SECTOR_HASH_LEN = 16          # Primeros bytes del SHA-256 de cada sector
+SECTOR_HASH_MAX_COUNT = 32    # Hashes por respuesta de SECTOR_HASH
+COPY_MAX_SECTORS = 16         # Sectores por COPY_SEQ
+
+# TLV de la respuesta a STATUS
+STATUS_TLV_SESSION = 0x01
+STATUS_TLV_COUNTERS = 0x02
+STATUS_TLV_MEMORY = 0x03
+STATUS_TLV_HIST = 0x04
+STATUS_HISTS = ("Entre chunks", "Procesado de chunk", "Espera por flash", "Escritura por sector", "Retardo del ACK")
+
+# Códigos de SNAK recuperables retransmitiendo (secuencia, CRC)
+PROTO_ERR_SEQ = 0x05
+PROTO_ERR_PARAM = 0x09
+PROTO_ERR_CRC = 0x0C
+RECONNECT_DELAY = 2.0
+
+# Imagen rechazada por su cabecera con el primer chunk: reintentar no sirve
+PROTO_ERR_IMAGE_REJECT = {
+    0x0E: "no es una imagen de app ESP-IDF",
+    0x0F: "compilada para otro chip",
+    0x10: "de otro proyecto",
+    0x11: "secure_version menor que la del ESP32",
+}
+
+
+class ImageRejected(Exception):
+    """El ESP32 rechazó la imagen al validar su cabecera"""
+
 def send_firmware_ota(port, firmware_path, baud_rate=115200, chunk_size=1021):
     """
     Envía firmware OTA por SPP v4.0 con sincronización mejorada
@@ -52,27 +160,19 @@ def send_firmware_ota(port, firmware_path, baud_rate=115200, chunk_size=1021):
         print(f"⚠️  Chunk size ajustado a {chunk_size}")
     
     try:
-        print(f"🔌 Conectando a {port}...")
-        ser = serial.Serial(
-            port=port,
-            baudrate=baud_rate,
-            timeout=3.0,
-            write_timeout=3.0
-        )
-        time.sleep(0.5)
-        ser.reset_input_buffer()
-        ser.reset_output_buffer()
-        print(f"✅ Conectado\n")
+        ser = open_port(port, baud_rate)
         
         # ========== FASE 1: START_OTA ==========
         print("📤 FASE 1: Iniciando OTA...")
         start_cmd = struct.pack('>BI', PROTO_START_OTA, firmware_size)
         print(f"   Enviando: {start_cmd.hex()}")
         
+        t0 = time.time()
         ser.write(start_cmd)
         time.sleep(0.3)
         
         response = ser.read(1)
+        print(f"   Tiempo hasta primer ACK: {(time.time() - t0) * 1000:.0f} ms")
         if len(response) == 0 or response[0] != PROTO_ACK:
             print("❌ START_OTA no aceptado")
             ser.close()
@@ -86,6 +186,7 @@ def send_firmware_ota(port, firmware_path, baud_rate=115200, chunk_size=1021):
         with open(firmware_path, 'rb') as f:
             chunk_num = 0
             bytes_sent = 0
+            naks = 0
             start_time = time.time()
             
             while bytes_sent < firmware_size:
@@ -116,8 +217,15 @@ def send_firmware_ota(port, firmware_path, baud_rate=115200, chunk_size=1021):
                     
                     if response[0] == PROTO_ACK:
                         bytes_sent += chunk_len
+                        naks = 0
                     else:
                         print(f"   ❌ NAK en chunk {chunk_num}")
+                        naks += 1
+                        if naks > MAX_RETRIES:
+                            # Sesión abortada en el ESP32 (p. ej. imagen rechazada por su cabecera)
+                            print("❌ Demasiados NAK seguidos, ver el log del ESP32")
+                            ser.close()
+                            return False
                         # Retroceder
                         f.seek(bytes_sent)
                         continue
@@ -169,21 +277,1003 @@ def send_firmware_ota(port, firmware_path, baud_rate=115200, chunk_size=1021):
         traceback.print_exc()
         return False
 
+def encode_tlv(tlv_type, value):
+    return struct.pack('>BB', tlv_type, len(value)) + value
+
+
+def parse_tlv(data):
+    fields = {}
+    pos = 0
+    while pos + 2 <= len(data):
+        tlv_type, tlv_len = data[pos], data[pos + 1]
+        fields[tlv_type] = data[pos + 2:pos + 2 + tlv_len]
+        pos += 2 + tlv_len
+    return fields
+
+
+def read_exact(ser, n):
+    data = ser.read(n)
+    return data if len(data) == n else None
+
+
+def compress_image(data):
+    comp = zlib.compressobj(9, zlib.DEFLATED, -OTA_INFLATE_WINDOW_BITS, 9)
+    return comp.compress(data) + comp.flush()
+
+
+def start_tlv(firmware_size, window, flags=0, digest=None, chunk=DEFAULT_CHUNK):
+    tlv = encode_tlv(TLV_IMAGE_SIZE, struct.pack('>I', firmware_size))
+    tlv += encode_tlv(TLV_WINDOW, bytes([window]))
+    if flags:
+        tlv += encode_tlv(TLV_FLAGS, bytes([flags]))
+    if chunk:
+        tlv += encode_tlv(TLV_CHUNK, struct.pack('>H', chunk))
+    if digest:
+        tlv += encode_tlv(TLV_IMAGE_HASH, digest)
+    return tlv
+
+
+def parse_credit(fields):
+    """
+    Crédito inicial (TLV_CREDIT) de la respuesta a START/RESUME, o None si
+    el ESP32 no usa créditos
+    """
+    if TLV_CREDIT not in fields:
+        return None
+    return struct.unpack('>I', fields[TLV_CREDIT])[0]
+
+
+def parse_chunk(fields):
+    """
+    Chunk aceptado (TLV_CHUNK) de la respuesta a START/RESUME. Los firmwares
+    sin negociación no lo envían y siguen en MAX_CHUNK_PAYLOAD.
+    """
+    if TLV_CHUNK not in fields:
+        return MAX_CHUNK_PAYLOAD
+    chunk = struct.unpack('>H', fields[TLV_CHUNK])[0]
+    if TLV_RX_BUFFER in fields:
+        rx_buffer = struct.unpack('>I', fields[TLV_RX_BUFFER])[0]
+        print(f"   ℹ️  ESP32: chunk {chunk} bytes, buffer RX {rx_buffer} bytes")
+    return chunk
+
+
+def resume_ota(ser, firmware_size, window, digest, flags=0, chunk=DEFAULT_CHUNK):
+    """
+    Envía RESUME_OTA. Devuelve (ventana, offset, crédito, chunk) si el ESP32
+    tiene una sesión guardada para esta imagen, o None si hay que empezar de cero.
+    """
+    tlv = start_tlv(firmware_size, window, flags, digest, chunk)
+    ser.write(struct.pack('>BH', PROTO_RESUME_OTA, len(tlv)) + tlv)
+
+    response = ser.read(1)
+    if len(response) == 0:
+        print("   ⚠️  RESUME_OTA sin respuesta")
+        return None
+    if response[0] == PROTO_NAK:
+        code = ser.read(1)
+        print(f"   ℹ️  Sin sesión que reanudar (código 0x{code.hex() or '??'})")
+        return None
+    if response[0] != PROTO_ACK:
+        print(f"   ⚠️  Respuesta inesperada: 0x{response[0]:02X}")
+        ser.reset_input_buffer()
+        return None
+
+    length = read_exact(ser, 1)
+    body = read_exact(ser, length[0]) if length else None
+    if body is None:
+        return None
+
+    fields = parse_tlv(body)
+    if TLV_OFFSET not in fields:
+        return None
+    return (fields.get(TLV_WINDOW, bytes([1]))[0], struct.unpack('>I', fields[TLV_OFFSET])[0],
+            parse_credit(fields), parse_chunk(fields))
+
+
+def start_ota_ext(ser, firmware_size, window, flags=0, digest=None, chunk=DEFAULT_CHUNK):
+    """
+    Envía START_OTA_EXT y devuelve (ventana aceptada, crédito inicial, chunk
+    aceptado) o None
+    """
+    tlv = start_tlv(firmware_size, window, flags, digest, chunk)
+    start_cmd = struct.pack('>BH', PROTO_START_OTA_EXT, len(tlv)) + tlv
+    print(f"   Enviando: {start_cmd.hex()}")
+    t0 = time.time()
+    ser.write(start_cmd)
+
+    response = ser.read(1)
+    print(f"   Tiempo hasta primer ACK: {(time.time() - t0) * 1000:.0f} ms")
+    if len(response) == 0:
+        print("❌ START_OTA_EXT sin respuesta")
+        return None
+    if response[0] == PROTO_NAK:
+        code = ser.read(1)
+        print(f"❌ START_OTA_EXT rechazado (código 0x{code.hex() or '??'})")
+        if code and code[0] == PROTO_ERR_PARAM and flags & OTA_FLAG_CREDIT:
+            print("   ℹ️  Firmwares sin OTA_FLAG_CREDIT rechazan el flag: usar --no-credit")
+        return None
+    if response[0] != PROTO_ACK:
+        print(f"❌ Respuesta inesperada: 0x{response[0]:02X}")
+        return None
+
+    length = read_exact(ser, 1)
+    body = read_exact(ser, length[0]) if length else None
+    if body is None:
+        print("❌ Respuesta START_OTA_EXT incompleta")
+        return None
+
+    fields = parse_tlv(body)
+    return fields.get(TLV_WINDOW, bytes([1]))[0], parse_credit(fields), parse_chunk(fields)
+
+
+def query_sector_hashes(ser, sectors):
+    """
+    Pide con SECTOR_HASH los hashes de los primeros `sectors` sectores del
+    slot en ejecución. Devuelve la lista (puede ser más corta si la partición
+    termina antes) o None si el ESP32 no soporta el comando.
+    """
+    hashes = []
+    while len(hashes) < sectors:
+        first = len(hashes)
+        count = min(SECTOR_HASH_MAX_COUNT, sectors - first)
+        ser.write(struct.pack('>BHB', PROTO_SECTOR_HASH, first, count))
+
+        response = ser.read(1)
+        if len(response) == 0 or response[0] != PROTO_ACK:
+            if len(response) and response[0] == PROTO_NAK:
+                ser.read(1)
+            ser.reset_input_buffer()
+            return None
+        header = read_exact(ser, 3)
+        if header is None or struct.unpack('>H', header[:2])[0] != first:
+            return None
+        if header[2] == 0:
+            break  # Fin de la partición
+        body = read_exact(ser, header[2] * SECTOR_HASH_LEN)
+        if body is None:
+            return None
+        hashes += [body[i:i + SECTOR_HASH_LEN] for i in range(0, len(body), SECTOR_HASH_LEN)]
+    return hashes
+
+
+def dedupe_plan(firmware, hashes, offset=0):
+    """
+    Divide firmware[offset:] en segmentos: bytes (se envían con DATA_SEQ) o
+    (sector, n) para copiar n sectores del slot en ejecución con COPY_SEQ.
+    Un sector completo se copia si su hash coincide con el del mismo sector
+    del slot en ejecución o, si no, con el de cualquier otro.
+    Devuelve (segmentos, bytes copiados).
+    """
+    index = {}
+    for i, digest in enumerate(hashes):
+        index.setdefault(digest, i)
+
+    segments = []
+    copied = 0
+    data_from = offset
+    pos = min(len(firmware), offset + (-offset) % SECTOR_SIZE)  # Tras reanudar, alinear a sector
+    while pos + SECTOR_SIZE <= len(firmware):
+        sector = pos // SECTOR_SIZE
+        digest = hashlib.sha256(firmware[pos:pos + SECTOR_SIZE]).digest()[:SECTOR_HASH_LEN]
+        src = sector if sector < len(hashes) and hashes[sector] == digest else index.get(digest)
+        if src is None:
+            pos += SECTOR_SIZE
+            continue
+
+        if data_from < pos:
+            segments.append(firmware[data_from:pos])
+        last = segments[-1] if segments else None
+        if isinstance(last, tuple) and last[0] + last[1] == src and last[1] < COPY_MAX_SECTORS:
+            segments[-1] = (last[0], last[1] + 1)
+        else:
+            segments.append((src, 1))
+        copied += SECTOR_SIZE
+        pos += SECTOR_SIZE
+        data_from = pos
+
+    if data_from < len(firmware):
+        segments.append(firmware[data_from:])
+    return segments, copied
+
+
+def query_status(ser, credit=None):
+    """
+    Pide la telemetría del ESP32 (STATUS). Devuelve un dict con 'session',
+    'counters', 'memory' y 'hists' (nombre -> (n, máx_us, suma_us, buckets))
+    o None si el firmware no conoce el comando.
+    """
+    ser.write(bytes([PROTO_STATUS]))
+    response = read_end_response(ser, credit)
+    if len(response) == 0 or response[0] != PROTO_ACK:
+        return None
+    length = read_exact(ser, 2)
+    body = read_exact(ser, struct.unpack('>H', length)[0]) if length else None
+    if body is None:
+        return None
+
+    status = {'hists': {}}
+    pos = 0
+    while pos + 2 <= len(body):
+        tlv_type, value = body[pos], body[pos + 2:pos + 2 + body[pos + 1]]
+        pos += 2 + body[pos + 1]
+        if tlv_type == STATUS_TLV_SESSION and len(value) == 17:
+            status['session'] = (value[0],) + struct.unpack('>IIII', value[1:])
+        elif tlv_type == STATUS_TLV_COUNTERS and len(value) == 24:
+            status['counters'] = struct.unpack('>6I', value)
+        elif tlv_type == STATUS_TLV_MEMORY and len(value) == 16:
+            status['memory'] = struct.unpack('>4I', value)
+        elif tlv_type == STATUS_TLV_HIST and len(value) >= 17 and value[0] < len(STATUS_HISTS):
+            count, max_us, sum_us = struct.unpack('>IIQ', value[1:17])
+            buckets = struct.unpack(f'>{(len(value) - 17) // 4}I', value[17:])
+            status['hists'][STATUS_HISTS[value[0]]] = (count, max_us, sum_us, buckets)
+    return status
+
+
+def hist_percentile(buckets, count, max_us, q):
+    """
+    Percentil aproximado (µs) de un histograma log2: límite superior del
+    bucket donde se alcanza q
+    """
+    seen = 0
+    for i, n in enumerate(buckets):
+        seen += n
+        if seen >= q * count:
+            return min(2 ** (i + 1), max_us)
+    return max_us
+
+
+def bottleneck(status):
+    """
+    Reparto del tiempo de la task OTA del ESP32 entre esperar al enlace,
+    procesar (CPU) y esperar a la flash. Devuelve (límite, {nombre: fracción}).
+    """
+    elapsed_us = max(status['session'][4] * 1000, 1)
+    cpu = status['hists'].get(STATUS_HISTS[1], (0, 0, 0))[2] / elapsed_us
+    flash = status['hists'].get(STATUS_HISTS[2], (0, 0, 0))[2] / elapsed_us
+    shares = {'CPU': min(cpu, 1.0), 'flash': min(flash, 1.0)}
+    shares['enlace'] = max(0.0, 1.0 - shares['CPU'] - shares['flash'])
+    return max(shares, key=shares.get), shares
+
+
+def print_status(status, rtts=None):
+    """
+    Imprime la telemetría de STATUS y, si se pasan, las medidas de ida y
+    vuelta del ACK tomadas en el PC (segundos)
+    """
+    print("📊 Telemetría del ESP32 (STATUS):")
+    print(f"   {'Histograma (ms)':<24} {'n':>7} {'media':>8} {'p50':>8} {'p90':>8} {'máx':>8}")
+    for name in STATUS_HISTS:
+        if name not in status['hists']:
+            continue
+        count, max_us, sum_us, buckets = status['hists'][name]
+        if count == 0:
+            print(f"   {name:<24} {0:>7}")
+            continue
+        p50 = hist_percentile(buckets, count, max_us, 0.5)
+        p90 = hist_percentile(buckets, count, max_us, 0.9)
+        print(f"   {name:<24} {count:>7} {sum_us / count / 1000:>8.2f} {p50 / 1000:>8.2f} "
+              f"{p90 / 1000:>8.2f} {max_us / 1000:>8.2f}")
+    if rtts:
+        samples = sorted(rtts)
+        n = len(samples)
+        print(f"   {'ACK ida y vuelta (PC)':<24} {n:>7} {sum(samples) / n * 1000:>8.2f} "
+              f"{samples[n // 2] * 1000:>8.2f} {samples[min(n - 1, n * 9 // 10)] * 1000:>8.2f} "
+              f"{samples[-1] * 1000:>8.2f}")
+
+    if 'counters' in status:
+        naks, crc_errors, gaps, dups, overflows, stalls = status['counters']
+        print(f"   NAK/SNAK {naks}, CRC {crc_errors}, huecos {gaps}, duplicados {dups}, "
+              f"desbordes {overflows} bytes, esperas por flash >1 ms {stalls}")
+    if 'memory' in status:
+        ring_max, ring_size, heap_min, heap_boot = status['memory']
+        session_heap = f"{heap_min / 1024:.1f} KB" if heap_min else "-"
+        print(f"   Buffer RX máx {ring_max}/{ring_size} bytes, heap mínimo {session_heap} "
+              f"(desde el arranque {heap_boot / 1024:.1f} KB)")
+    if 'session' in status and status['hists'].get(STATUS_HISTS[1], (0,))[0]:
+        limit, shares = bottleneck(status)
+        print(f"   Task OTA: enlace {shares['enlace'] * 100:.0f}%, CPU {shares['CPU'] * 100:.0f}%, "
+              f"flash {shares['flash'] * 100:.0f}% -> cuello de botella: {limit}")
+    print()
+
+
+def transfer_windowed(ser, firmware, chunk_size, window, crc=False, credit=None, segments=None, rtts=None,
+                      progress=None):
+    """
+    Envía el firmware con DATA_SEQ manteniendo hasta `window` chunks sin confirmar.
+    Go-back-N: ante SNAK o timeout se retransmite desde el primer chunk pendiente.
+    Con crc=True cada chunk lleva su CRC32 (sesión iniciada con OTA_FLAG_CRC).
+    Con credit (crédito inicial de OTA_FLAG_CREDIT) además nunca se envían más
+    bytes de los que el ESP32 ha anunciado que caben en su buffer RX.
+    Con segments (de dedupe_plan) los sectores (sector, n) van como COPY_SEQ
+    en la misma secuencia que los chunks. Si se pasa la lista rtts se le
+    añade, por cada SACK que avanza, el tiempo desde el envío del último
+    chunk confirmado. progress(bytes) se llama con los bytes confirmados
+    cada vez que avanza la ventana.
+    Devuelve (ok, chunks_enviados, retransmisiones, segundos); lanza
+    ImageRejected si el ESP32 rechaza la cabecera de la imagen.
+    """
+    chunks = []
+    for segment in (segments if segments is not None else [firmware]):
+        if isinstance(segment, tuple):
+            chunks.append(segment)
+        else:
+            chunks += [segment[i:i + chunk_size] for i in range(0, len(segment), chunk_size)]
+    ends = []       # bytes de imagen hasta el final de cada chunk (progreso)
+    for chunk in chunks:
+        ends.append((ends[-1] if ends else 0) +
+                    (chunk[1] * SECTOR_SIZE if isinstance(chunk, tuple) else len(chunk)))
+    total = len(chunks)
+    sent_at = [0.0] * total
+    base = 0        # primer chunk sin confirmar (absoluto)
+    next_seq = 0    # próximo chunk a enviar (absoluto)
+    sent = 0
+    retransmits = 0
+    retries = 0
+    start_time = time.time()
+    last_report = 0
+    stream = 0      # bytes enviados desde el ACK de START/RESUME
+    limit = credit  # None: sin control de flujo por créditos
+    credit_len = 4 if credit is not None else 0
+
+    def absolute(seq16):
+        return base + ((seq16 - base) & 0xFFFF)
+
+    def update_limit(raw):
+        # El ESP32 cuenta en 32 bits; el límite solo avanza
+        nonlocal limit
+        diff = (struct.unpack('>I', raw)[0] - limit) & 0xFFFFFFFF
+        if diff < 0x80000000:
+            limit += diff
+
+    while base < total:
+        while next_seq < total and next_seq - base < window:
+            chunk = chunks[next_seq]
+            if isinstance(chunk, tuple):
+                body = struct.pack('>HHB', next_seq & 0xFFFF, chunk[0], chunk[1])
+                frame = bytes([PROTO_COPY_SEQ]) + body
+                if crc:
+                    frame += struct.pack('>I', zlib.crc32(body))
+            else:
+                frame = struct.pack('>BHH', PROTO_DATA_SEQ, next_seq & 0xFFFF, len(chunk)) + chunk
+                if crc:
+                    frame += struct.pack('>I', zlib.crc32(chunk))
+            if limit is not None and stream + len(frame) > limit:
+                break  # Sin crédito: esperar al próximo SACK
+            ser.write(frame)
+            sent_at[next_seq] = time.time()
+            stream += len(frame)
+            next_seq += 1
+            sent += 1
+
+        response = ser.read(1)
+        if len(response) == 0:
+            retries += 1
+            if retries > MAX_RETRIES:
+                print(f"   ❌ Demasiados timeouts en chunk {base}")
+                return False, sent, retransmits, time.time() - start_time
+            print(f"   ⚠️  Timeout, retransmitiendo desde chunk {base}")
+            retransmits += next_seq - base
+            next_seq = base
+            continue
+
+        if response[0] == PROTO_SACK:
+            seq = read_exact(ser, 2 + credit_len)
+            if seq is None:
+                continue
+            if credit_len:
+                update_limit(seq[2:])
+            acked = absolute(struct.unpack('>H', seq[:2])[0])
+            if acked > base:
+                base = min(acked, next_seq)
+                retries = 0
+                if rtts is not None:
+                    rtts.append(time.time() - sent_at[base - 1])
+                if progress is not None:
+                    progress(ends[base - 1])
+        elif response[0] == PROTO_SNAK:
+            body = read_exact(ser, 3 + credit_len)
+            if body is None:
+                continue
+            if credit_len:
+                update_limit(body[3:])
+            expected = absolute(struct.unpack('>H', body[:2])[0])
+            if body[2] in PROTO_ERR_IMAGE_REJECT:
+                raise ImageRejected(f"{PROTO_ERR_IMAGE_REJECT[body[2]]} (código 0x{body[2]:02X})")
+            print(f"   ⚠️  SNAK (código 0x{body[2]:02X}), retransmitiendo desde chunk {expected}")
+            if body[2] not in (PROTO_ERR_SEQ, PROTO_ERR_CRC):  # No recuperable
+                return False, sent, retransmits, time.time() - start_time
+            retransmits += next_seq - expected
+            base = expected
+            next_seq = expected
+        elif response[0] == PROTO_NAK:
+            code = ser.read(1)
+            print(f"   ❌ NAK (código 0x{code.hex() or '??'})")
+            return False, sent, retransmits, time.time() - start_time
+
+        # Progreso
+        if base - last_report >= 50:
+            last_report = base
+            elapsed = time.time() - start_time
+            done = ends[base - 1]
+            if elapsed > 0:
+                speed = done / elapsed / (1024 * 1024)
+                pct = (done / ends[-1]) * 100
+                print(f"   [{base:4d}] {done / 1024:8.1f} KB ({pct:5.1f}%) - {speed:.2f} MB/s")
+
+    return True, sent, retransmits, time.time() - start_time
+
+
+def read_end_response(ser, credit):
+    """
+    Lee la respuesta a END_OTA saltando los SACK que el ESP32 aún tuviera
+    pendientes (con créditos también anuncia crédito al vaciar su buffer)
+    """
+    while True:
+        response = ser.read(1)
+        if len(response) == 0 or response[0] != PROTO_SACK:
+            return response
+        if read_exact(ser, 2 + (4 if credit is not None else 0)) is None:
+            return b''
+
+
+def open_port(port, baud_rate):
+    """
+    Abre el enlace: puerto serie (SPP o UART) o URL de pyserial
+    (socket://IP:PUERTO para el transporte TCP del ESP32)
+    """
+    print(f"🔌 Conectando a {port}...")
+    ser = serial.serial_for_url(
+        port,
+        baudrate=baud_rate,
+        timeout=3.0,
+        write_timeout=3.0
+    )
+    time.sleep(0.5)
+    ser.reset_input_buffer()
+    ser.reset_output_buffer()
+    print(f"✅ Conectado\n")
+    return ser
+
+
+def build_payload(firmware, compress=False, delta_base=None):
+    """
+    Lo que se envía para `firmware`: la imagen, un parche contra delta_base
+    y/o deflate. Devuelve (payload, flags) o None si falta delta_base.
+    """
+    flags = 0
+    payload = firmware
+    if delta_base:
+        if not os.path.isfile(delta_base):
+            print(f"❌ Archivo no existe: {delta_base}")
+            return None
+        with open(delta_base, 'rb') as f:
+            base = f.read()
+        payload, _ = make_delta(base, firmware)
+        flags |= OTA_FLAG_DELTA
+        print(f"🩹 Parche contra {delta_base}: {len(payload)} bytes ({len(payload) / len(firmware) * 100:.1f}%)")
+    if compress:
+        payload = compress_image(payload)
+        flags |= OTA_FLAG_DEFLATE
+        print(f"🗜️  Comprimido: {len(payload)} bytes ({len(payload) / len(firmware) * 100:.1f}%)")
+    return payload, flags
+
+
+def send_firmware_ota_windowed(port, firmware_path, window, baud_rate=115200, chunk_size=DEFAULT_CHUNK,
+                               compress=False, delta_base=None, resume=True, reconnect=3, crc=True,
+                               credit=True, dedupe=False, status=True, prepared=None, progress=None):
+    """
+    Envía firmware OTA por SPP con ventana deslizante (DATA_SEQ + SACK)
+
+    Con delta_base se envía un parche contra esa imagen, que debe ser
+    exactamente la que está ejecutando el ESP32 (NAK 0x0A si no lo es).
+
+    La imagen final se anuncia siempre con su SHA-256, que el ESP32 comprueba
+    antes de aceptarla. Las imágenes sin transformar además son reanudables:
+    se pregunta primero con RESUME_OTA y, si el enlace cae, se reconecta hasta
+    `reconnect` veces continuando desde el offset que indique el ESP32.
+
+    chunk_size es el máximo que se pide; se usa el que acepte el ESP32.
+
+    Con dedupe se piden antes los hashes de los sectores del slot en ejecución
+    y solo se envían los sectores distintos; el ESP32 copia el resto de su
+    propia flash. Si el ESP32 no soporta SECTOR_HASH se envía todo.
+
+    Con status se pide la telemetría (STATUS) antes del END_OTA, cuando ya
+    está todo confirmado, y se imprime.
+
+    prepared = (firmware, payload, flags) evita leer y transformar la imagen
+    en cada llamada (modo flota). progress(hechos, total) recibe los bytes
+    de payload confirmados.
+    """
+    if dedupe and (compress or delta_base):
+        print("❌ --dedupe no se combina con --compress ni --delta")
+        return False
+
+    if prepared is None:
+        if not os.path.isfile(firmware_path):
+            print(f"❌ Archivo no existe: {firmware_path}")
+            return False
+
+        with open(firmware_path, 'rb') as f:
+            firmware = f.read()
+
+        print(f"📦 Archivo: {firmware_path}")
+        print(f"📏 Tamaño: {len(firmware)} bytes ({len(firmware) / 1024:.2f} KB)")
+
+        built = build_payload(firmware, compress, delta_base)
+        if built is None:
+            return False
+        payload, flags = built
+    else:
+        firmware, payload, flags = prepared
+
+    if crc:
+        flags |= OTA_FLAG_CRC
+    if credit:
+        flags |= OTA_FLAG_CREDIT
+    resumable = not (flags & OTA_FLAGS_TRANSFORM)
+    digest = hashlib.sha256(firmware).digest()
+    attempts = 1 + (reconnect if resumable else 0)
+
+    for attempt in range(attempts):
+        if attempt > 0:
+            print(f"🔁 Reconectando ({attempt}/{reconnect}) en {RECONNECT_DELAY:.0f}s...")
+            time.sleep(RECONNECT_DELAY)
+
+        ser = None
+        try:
+            ser = open_port(port, baud_rate)
+
+            hashes = None
+            flags &= ~OTA_FLAG_DEDUPE
+            if dedupe:
+                print("📤 FASE 0: Pidiendo hashes de sectores de la app en ejecución (SECTOR_HASH)...")
+                hashes = query_sector_hashes(ser, (len(firmware) + SECTOR_SIZE - 1) // SECTOR_SIZE)
+                if hashes is None:
+                    print("   ⚠️  El ESP32 no soporta SECTOR_HASH: se envía la imagen completa")
+                else:
+                    flags |= OTA_FLAG_DEDUPE
+
+            offset = 0
+            accepted = None
+            if resumable and (resume or attempt > 0):
+                print("📤 FASE 1: Consultando sesión guardada (RESUME_OTA)...")
+                resumed = resume_ota(ser, len(firmware), window, digest,
+                                     flags & (OTA_FLAG_CRC | OTA_FLAG_CREDIT | OTA_FLAG_DEDUPE), chunk_size)
+                if resumed:
+                    accepted, offset, initial_credit, chunk = resumed
+                    print(f"✅ Reanudando en {offset} bytes ({offset / len(firmware) * 100:.1f}%)")
+
+            if accepted is None:
+                print(f"📤 FASE 1: Iniciando OTA (ventana solicitada {window})...")
+                started = start_ota_ext(ser, len(firmware), window, flags, digest, chunk_size)
+                if started is None:
+                    ser.close()
+                    return False
+                accepted, initial_credit, chunk = started
+            if initial_credit is not None:
+                print(f"✅ ESP32 listo (ventana aceptada {accepted}, crédito {initial_credit} bytes)\n")
+            else:
+                print(f"✅ ESP32 listo (ventana aceptada {accepted})\n")
+
+            remaining = payload[offset:]
+            segments = None
+            if hashes is not None:
+                segments, copied = dedupe_plan(payload, hashes, offset)
+                to_send = len(remaining) - copied
+                print(f"♻️  Dedupe: {copied // SECTOR_SIZE} sectores iguales a la app en ejecución, "
+                      f"se envían {to_send} bytes ({to_send / max(len(remaining), 1) * 100:.1f}%)")
+            print(f"📤 FASE 2: Enviando {len(remaining)} bytes en chunks de {chunk}...")
+            rtts = []
+            report = None
+            if progress is not None:
+                progress(offset, len(payload))
+                report = lambda done: progress(offset + done, len(payload))
+            ok, sent, retransmits, elapsed = transfer_windowed(ser, remaining, chunk, accepted, crc,
+                                                               initial_credit, segments, rtts, report)
+            if not ok:
+                ser.close()
+                continue
+            # Velocidad efectiva: bytes de imagen por segundo
+            speed = (len(firmware) - offset) / elapsed / (1024 * 1024) if elapsed > 0 else 0
+            print(f"   ✅ Transferencia: {sent} chunks ({retransmits} retransmitidos) en {elapsed:.2f}s ({speed:.2f} MB/s)\n")
+
+            if status:
+                telemetry = query_status(ser, initial_credit)
+                if telemetry is None:
+                    print("   ⚠️  El ESP32 no responde a STATUS (firmware sin telemetría)\n")
+                else:
+                    print_status(telemetry, rtts)
+
+            print("📤 FASE 3: Finalizando OTA...")
+            ser.write(bytes([PROTO_END_OTA]))
+            time.sleep(0.5)
+
+            response = read_end_response(ser, initial_credit)
+            if len(response) == 0 or response[0] != PROTO_ACK:
+                # En modo ventana el NAK lleva código (0x0D: SHA-256 incorrecto)
+                code = ser.read(1) if len(response) and response[0] == PROTO_NAK else b''
+                print(f"❌ END_OTA no confirmado (código 0x{code.hex() or '??'})")
+                ser.close()
+                return False
+
+            print("✅ OTA completada - ESP32 reiniciando...\n")
+            ser.close()
+            return True
+
+        except ImageRejected as e:
+            print(f"❌ Imagen rechazada por el ESP32: {e}")
+            ser.close()
+            return False
+        except serial.SerialException as e:
+            print(f"❌ Error serial: {e}")
+            if ser is not None and ser.is_open:
+                ser.close()
+
+    return False
+
+
+class FleetUnit:
+    """
+    Estado de un dispositivo en modo flota
+    """
+    def __init__(self, port):
+        self.port = port
+        self.state = "en cola"      # en cola, enviando, reintento, ok, fallo
+        self.attempts = 0
+        self.done = 0               # Bytes de payload confirmados (incluye lo reanudado)
+        self.base = None            # Posición al empezar el intento actual (reanudación)
+        self.total = 0
+        self.started = None
+        self.elapsed = 0.0
+        self.error = None
+        self.log = io.StringIO()
+
+    def update(self, done, total):
+        if self.base is None:
+            self.base = done
+        self.done = done
+        self.total = total
+
+    def speed(self):
+        """KB/s del intento actual (o del último)"""
+        elapsed = time.time() - self.started if self.state == "enviando" else self.elapsed
+        return (self.done - (self.base or 0)) / elapsed / 1024 if elapsed > 0 else 0.0
+
+
+class FleetOutput:
+    """
+    stdout en modo flota: lo que imprime cada hilo de dispositivo va a su
+    log (y la última línea con error queda en unit.error); el resto sale
+    por la consola
+    """
+    def __init__(self, console):
+        self.console = console
+        self.units = {}
+
+    def attach(self, unit):
+        self.units[threading.get_ident()] = unit
+
+    def detach(self):
+        self.units.pop(threading.get_ident(), None)
+
+    def write(self, text):
+        unit = self.units.get(threading.get_ident())
+        if unit is None:
+            return self.console.write(text)
+        unit.log.write(text)
+        for line in text.splitlines():
+            if "❌" in line:
+                unit.error = line.replace("❌", "").strip()
+        return len(text)
+
+    def flush(self):
+        self.console.flush()
+
+
+def read_fleet_ports(spec):
+    """
+    Puertos del modo flota: lista separada por comas o @fichero (uno por
+    línea, # para comentarios)
+    """
+    if spec.startswith("@"):
+        with open(spec[1:]) as f:
+            lines = [line.split("#")[0].strip() for line in f]
+        return [line for line in lines if line]
+    return [port for port in spec.split(",") if port]
+
+
+def send_fleet(ports, firmware_path, window, jobs=None, retries=2, summary=None, log_dir=None,
+               compress=False, delta_base=None, **kwargs):
+    """
+    Envía la misma imagen a varios dispositivos a la vez, un hilo por
+    puerto (como mucho `jobs` simultáneos). La imagen se lee y se
+    transforma una sola vez. Un dispositivo que falla vuelve a la cola
+    hasta `retries` veces (si su sesión es reanudable continúa donde se
+    quedó). Imprime el progreso agregado y, al final, una tabla por
+    dispositivo; con summary escribe el resultado en JSON ('-' = stdout).
+    """
+    if not os.path.isfile(firmware_path):
+        print(f"❌ Archivo no existe: {firmware_path}")
+        return False
+
+    with open(firmware_path, 'rb') as f:
+        firmware = f.read()
+    built = build_payload(firmware, compress, delta_base)
+    if built is None:
+        return False
+    prepared = (firmware, built[0], built[1])
+
+    units = [FleetUnit(port) for port in ports]
+    jobs = max(1, min(jobs or len(units), len(units)))
+    pending = queue.Queue()
+    for unit in units:
+        pending.put(unit)
+
+    print(f"📦 Archivo: {firmware_path} ({len(firmware)} bytes, payload {len(prepared[1])} bytes)")
+    print(f"🚚 Flota: {len(units)} dispositivos, {jobs} en paralelo, hasta {retries} reintentos\n")
+
+    out = FleetOutput(sys.stdout)
+
+    def worker():
+        while True:
+            try:
+                unit = pending.get_nowait()
+            except queue.Empty:
+                return
+            if unit.attempts > 0:
+                time.sleep(RECONNECT_DELAY)
+            unit.attempts += 1
+            unit.state = "enviando"
+            unit.done = 0
+            unit.base = None
+            unit.error = None
+            unit.started = time.time()
+            unit.log.write(f"--- Intento {unit.attempts} ---\n")
+            out.attach(unit)
+            try:
+                ok = send_firmware_ota_windowed(unit.port, firmware_path, window, prepared=prepared,
+                                                progress=unit.update, compress=compress,
+                                                delta_base=delta_base, **kwargs)
+            except Exception as e:  # Un dispositivo no debe tumbar la flota
+                print(f"❌ {type(e).__name__}: {e}")
+                ok = False
+            out.detach()
+            unit.elapsed = time.time() - unit.started
+            if ok:
+                unit.state = "ok"
+                out.console.write(f"\r✅ {unit.port}: {unit.elapsed:.1f} s, {unit.speed():.1f} KB/s\n")
+            elif unit.attempts <= retries:
+                unit.state = "reintento"
+                out.console.write(f"\r⚠️  {unit.port}: {unit.error or 'fallo'} (reintento {unit.attempts}/{retries})\n")
+                pending.put(unit)
+            else:
+                unit.state = "fallo"
+                out.console.write(f"\r❌ {unit.port}: {unit.error or 'fallo'}\n")
+
+    start_time = time.time()
+    sys.stdout = out
+    try:
+        threads = [threading.Thread(target=worker, daemon=True) for _ in range(jobs)]
+        for thread in threads:
+            thread.start()
+        interactive = out.console.isatty()
+        last_line = 0
+        while any(thread.is_alive() for thread in threads):
+            time.sleep(0.5)
+            now = time.time()
+            if not interactive and now - last_line < 5:
+                continue
+            last_line = now
+            payload_len = len(prepared[1])
+            done = sum(payload_len if u.state == "ok" else u.done for u in units)
+            active = [u for u in units if u.state == "enviando"]
+            ok_count = sum(u.state == "ok" for u in units)
+            failed = sum(u.state == "fallo" for u in units)
+            line = (f"📶 {done / (payload_len * len(units)) * 100:5.1f}% | {ok_count} OK, {failed} fallidos, "
+                    f"{len(active)} enviando | {sum(u.speed() for u in active):8.1f} KB/s")
+            out.console.write(("\r" + line) if interactive else (line + "\n"))
+            out.console.flush()
+        for thread in threads:
+            thread.join()
+    finally:
+        sys.stdout = out.console
+
+    elapsed = time.time() - start_time
+    if log_dir:
+        os.makedirs(log_dir, exist_ok=True)
+    for unit in units:
+        unit.log_path = None
+        if log_dir:
+            unit.log_path = os.path.join(log_dir, re.sub(r'[^A-Za-z0-9_.-]', '_', unit.port) + ".log")
+            with open(unit.log_path, "w") as f:
+                f.write(unit.log.getvalue())
+
+    ok_units = [u for u in units if u.state == "ok"]
+    print(f"\n\n{'Puerto':<24} {'Estado':>7} {'Intentos':>9} {'Tiempo (s)':>11} {'KB/s':>9}  Error")
+    for unit in units:
+        print(f"{unit.port:<24} {unit.state:>7} {unit.attempts:>9} {unit.elapsed:>11.1f} {unit.speed():>9.1f}  "
+              f"{'' if unit.state == 'ok' else unit.error or ''}")
+    print(f"\n🚚 {len(ok_units)}/{len(units)} actualizados en {elapsed:.1f} s "
+          f"({len(firmware) * len(ok_units) / max(elapsed, 1e-6) / 1024:.1f} KB/s de imagen en total)")
+
+    if summary:
+        result = {
+            "firmware": os.path.abspath(firmware_path),
+            "size": len(firmware),
+            "payload": len(prepared[1]),
+            "sha256": hashlib.sha256(firmware).hexdigest(),
+            "seconds": round(elapsed, 3),
+            "ok": len(ok_units),
+            "failed": len(units) - len(ok_units),
+            "devices": [{
+                "port": unit.port,
+                "ok": unit.state == "ok",
+                "attempts": unit.attempts,
+                "seconds": round(unit.elapsed, 3),
+                "kbps": round(unit.speed(), 1),
+                "error": None if unit.state == "ok" else unit.error,
+                "log": unit.log_path,
+            } for unit in units],
+        }
+        if summary == "-":
+            print(json.dumps(result, indent=2, ensure_ascii=False))
+        else:
+            with open(summary, "w") as f:
+                json.dump(result, f, indent=2, ensure_ascii=False)
+            print(f"📝 Resumen: {summary}")
+
+    return len(ok_units) == len(units)
+
+
+def bench_windows(port, firmware_path, windows, baud_rate=115200, chunks=(MAX_CHUNK_PAYLOAD,)):
+    """
+    Transfiere la imagen con cada combinación de chunk pedido y ventana y
+    aborta al final (sin reiniciar el ESP32). Imprime una tabla comparativa
+    de throughput con la ventana y el chunk que aceptó el ESP32.
+    """
+    if not os.path.isfile(firmware_path):
+        print(f"❌ Archivo no existe: {firmware_path}")
+        return False
+
+    with open(firmware_path, 'rb') as f:
+        firmware = f.read()
+
+    results = []
+    try:
+        ser = open_port(port, baud_rate)
+        for chunk_size in chunks:
+            for window in windows:
+                print(f"📊 Chunk {chunk_size}, ventana {window}...")
+                started = start_ota_ext(ser, len(firmware), window, chunk=chunk_size)
+                if started is None:
+                    break
+                accepted, _, chunk = started
+                ok, sent, retransmits, elapsed = transfer_windowed(ser, firmware, chunk, accepted)
+                telemetry = query_status(ser) if ok else None
+                limit = bottleneck(telemetry)[0] if telemetry else "?"
+
+                ser.write(bytes([PROTO_ABORT_OTA]))
+                time.sleep(0.2)
+                ser.reset_input_buffer()
+
+                if not ok:
+                    print(f"   ❌ Transferencia fallida con chunk {chunk_size} y ventana {window}")
+                    continue
+                results.append((chunk_size, chunk, window, accepted, elapsed,
+                                len(firmware) / elapsed / 1024, retransmits, limit))
+        ser.close()
+    except ImageRejected as e:
+        print(f"❌ Imagen rechazada por el ESP32: {e}")
+    except serial.SerialException as e:
+        print(f"❌ Error serial: {e}")
+
+    print()
+    print(f"{'Chunk':>6} {'Aceptado':>9} {'Ventana':>8} {'Aceptada':>9} {'Tiempo (s)':>11} {'KB/s':>9} {'Retrans.':>9} "
+          f"{'Límite':>7}")
+    for chunk_size, chunk, window, accepted, elapsed, kbps, retransmits, limit in results:
+        print(f"{chunk_size:>6} {chunk:>9} {window:>8} {accepted:>9} {elapsed:>11.2f} {kbps:>9.1f} {retransmits:>9} "
+              f"{limit:>7}")
+
+    return len(results) == len(windows) * len(chunks)
+
+
+def show_status(port, baud_rate=115200):
+    """
+    Solo consulta STATUS: telemetría de la sesión en curso o de la última
+    (p. ej. tras un --bench o una transferencia fallida)
+    """
+    try:
+        ser = open_port(port, baud_rate)
+        telemetry = query_status(ser)
+        ser.close()
+    except serial.SerialException as e:
+        print(f"❌ Error serial: {e}")
+        return False
+
+    if telemetry is None:
+        print("❌ El ESP32 no responde a STATUS")
+        return False
+    state, received, image, expected, elapsed_ms = telemetry['session']
+    print(f"📋 Sesión: estado {state}, {received} bytes recibidos, imagen {image}/{expected} bytes, {elapsed_ms / 1000:.2f} s")
+    print_status(telemetry)
+    return True
+
+
 def main():
     print("=" * 70)
-    print("  ESP32 Bluetooth OTA v4.0 (Buffer RX sincronizado)")
+    print("  ESP32 Bluetooth OTA v5.0 (Ventana deslizante)")
     print("=" * 70)
-    
-    if len(sys.argv) < 3:
-        print("\n❌ Uso: python3 send_ota_v4.py <puerto> <firmware.bin>")
-        print("\nEjemplos:")
-        print("  python3 send_ota_v4.py COM9 build/app.bin")
-        sys.exit(1)
-    
-    port = sys.argv[1]
-    firmware_path = sys.argv[2]
-    
-    success = send_firmware_ota(port, firmware_path)
+
+    parser = argparse.ArgumentParser(description="Envía firmware OTA al ESP32 por SPP, UART o TCP")
+    parser.add_argument("port", help="Puerto serie SPP/UART (ej. COM9, /dev/rfcomm0, /dev/ttyUSB0) "
+                                     "o socket://IP:PUERTO para TCP. Con --fleet: lista separada por comas o @fichero")
+    parser.add_argument("firmware", help="Imagen .bin a enviar")
+    parser.add_argument("--window", type=int, default=0,
+                        help="Chunks en vuelo (0 = stop-and-wait clásico; con créditos hasta 255)")
+    parser.add_argument("--bench", type=str, default=None,
+                        help="Lista de ventanas a comparar, ej. 1,2,4,8 (aborta sin reiniciar)")
+    parser.add_argument("--bench-chunks", type=str, default=str(MAX_CHUNK_PAYLOAD),
+                        help="Chunks a comparar con --bench, ej. 1021,2048,4096")
+    parser.add_argument("--chunk", type=int, default=DEFAULT_CHUNK,
+                        help="Chunk máximo que se pide al ESP32 en modo ventana (acepta hasta su límite)")
+    parser.add_argument("--compress", action="store_true",
+                        help="Enviar la imagen comprimida con deflate (requiere modo ventana)")
+    parser.add_argument("--delta", type=str, default=None, metavar="BASE.bin",
+                        help="Enviar un parche contra la imagen que ejecuta el ESP32 (requiere modo ventana)")
+    parser.add_argument("--dedupe", action="store_true",
+                        help="Enviar solo los sectores de 4 KB distintos de la app en ejecución (requiere modo ventana)")
+    parser.add_argument("--status", action="store_true",
+                        help="Solo mostrar la telemetría de la sesión actual o la última (STATUS)")
+    parser.add_argument("--no-status", action="store_true",
+                        help="No pedir la telemetría al final (firmwares sin STATUS: evita esperar el timeout)")
+    parser.add_argument("--no-resume", action="store_true",
+                        help="No intentar reanudar una sesión guardada en el ESP32 (empieza de cero)")
+    parser.add_argument("--no-crc", action="store_true",
+                        help="No añadir CRC32 a cada chunk (firmwares sin OTA_FLAG_CRC)")
+    parser.add_argument("--no-credit", action="store_true",
+                        help="Sin control de flujo por créditos (firmwares sin OTA_FLAG_CREDIT)")
+    parser.add_argument("--baud", type=int, default=115200,
+                        help="Velocidad del puerto serie (solo UART; SPP y TCP la ignoran)")
+    parser.add_argument("--fleet", action="store_true",
+                        help="Modo flota: la imagen a todos los puertos en paralelo (modo ventana)")
+    parser.add_argument("--jobs", type=int, default=None,
+                        help="Dispositivos simultáneos en modo flota (por defecto todos)")
+    parser.add_argument("--fleet-retries", type=int, default=2,
+                        help="Reintentos por dispositivo fallido en modo flota")
+    parser.add_argument("--fleet-logs", type=str, default=None, metavar="DIR",
+                        help="Guardar el log de cada dispositivo en DIR (modo flota)")
+    parser.add_argument("--summary", type=str, default=None, metavar="FICHERO",
+                        help="Resumen JSON del modo flota ('-' para stdout)")
+    parser.add_argument("--reconnect", type=int, default=3,
+                        help="Reconexiones automáticas si se cae el enlace (modo ventana, imagen sin transformar)")
+    args = parser.parse_args()
+
+    port = args.port
+    firmware_path = args.firmware
+
+    if args.fleet:
+        success = send_fleet(read_fleet_ports(port), firmware_path, max(args.window, 1), jobs=args.jobs,
+                             retries=args.fleet_retries, summary=args.summary, log_dir=args.fleet_logs,
+                             compress=args.compress, delta_base=args.delta,
+                             baud_rate=args.baud, chunk_size=args.chunk, resume=not args.no_resume,
+                             reconnect=args.reconnect, crc=not args.no_crc, credit=not args.no_credit,
+                             dedupe=args.dedupe, status=not args.no_status)
+    elif args.status:
+        success = show_status(port, baud_rate=args.baud)
+    elif args.bench:
+        windows = [int(w) for w in args.bench.split(",") if w]
+        chunks = [int(c) for c in args.bench_chunks.split(",") if c]
+        success = bench_windows(port, firmware_path, windows, baud_rate=args.baud, chunks=chunks)
+    elif args.window > 0 or args.compress or args.delta or args.dedupe:
+        success = send_firmware_ota_windowed(port, firmware_path, max(args.window, 1),
+                                             baud_rate=args.baud, chunk_size=args.chunk,
+                                             compress=args.compress, delta_base=args.delta,
+                                             resume=not args.no_resume, reconnect=args.reconnect,
+                                             crc=not args.no_crc, credit=not args.no_credit,
+                                             dedupe=args.dedupe, status=not args.no_status)
+    else:
+        success = send_firmware_ota(port, firmware_path, baud_rate=args.baud)
     
     print("=" * 70)
     if success:
@@ -0,0 +1,359 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include "esp_http_client.h"
+
+// esp_http_client sobre sockets POSIX: HTTP/1.1 en claro, cuerpos con
+// Content-Length o hasta el cierre, conexiones persistentes y redirecciones.
+// keep_alive_enable (TCP keep-alive en ESP-IDF) no tiene efecto.
+
+#define URL_LEN 512
+#define HOST_LEN 128
+#define MAX_HEADERS 8
+#define HEADER_KEY_LEN 32
+#define HEADER_VALUE_LEN 160
+#define HEAD_BUF_SIZE 4096
+
+int host_http_connections = 0;
+
+struct esp_http_client {
+    esp_http_client_config_t cfg;
+    char url[URL_LEN];
+    char host[HOST_LEN];
+    char port[8];
+    const char *path;               // Dentro de url
+    esp_http_client_method_t method;
+    char keys[MAX_HEADERS][HEADER_KEY_LEN];
+    char values[MAX_HEADERS][HEADER_VALUE_LEN];
+    int fd;                         // -1: sin conexión
+    int status;
+    int64_t content_length;         // -1: hasta el cierre
+    int64_t body_read;
+    bool server_close;              // Connection: close en la respuesta
+    char location[URL_LEN];
+    char head[HEAD_BUF_SIZE];       // Cabeceras y primeros bytes del cuerpo
+    size_t head_len;
+    size_t head_pos;                // Cuerpo pendiente en head[head_pos..head_len)
+};
+
+static void client_event(esp_http_client_handle_t c, esp_http_client_event_id_t id, char *key, char *value)
+{
+    if (!c->cfg.event_handler) return;
+
+    esp_http_client_event_t evt = {
+        .event_id = id,
+        .client = c,
+        .user_data = c->cfg.user_data,
+        .header_key = key,
+        .header_value = value,
+    };
+    c->cfg.event_handler(&evt);
+}
+
+static void client_disconnect(esp_http_client_handle_t c)
+{
+    if (c->fd >= 0) {
+        close(c->fd);
+        c->fd = -1;
+        client_event(c, HTTP_EVENT_DISCONNECTED, NULL, NULL);
+    }
+}
+
+esp_http_client_handle_t esp_http_client_init(const esp_http_client_config_t *config)
+{
+    esp_http_client_handle_t c = calloc(1, sizeof(*c));
+    if (!c) return NULL;
+
+    c->cfg = *config;
+    c->method = config->method;
+    c->fd = -1;
+    if (esp_http_client_set_url(c, config->url) != ESP_OK) {
+        free(c);
+        return NULL;
+    }
+    return c;
+}
+
+esp_err_t esp_http_client_cleanup(esp_http_client_handle_t client)
+{
+    if (!client) return ESP_ERR_INVALID_ARG;
+    client_disconnect(client);
+    free(client);
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_set_url(esp_http_client_handle_t client, const char *url)
+{
+    char host[HOST_LEN] = "";
+    char port[8] = "80";
+
+    if (strncmp(url, "http://", 7) != 0 || strlen(url) >= URL_LEN) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    const char *p = url + 7;
+    size_t host_len = strcspn(p, ":/");
+    if (host_len == 0 || host_len >= sizeof(host)) return ESP_ERR_INVALID_ARG;
+    memcpy(host, p, host_len);
+    p += host_len;
+    if (*p == ':') {
+        size_t port_len = strcspn(++p, "/");
+        if (port_len == 0 || port_len >= sizeof(port)) return ESP_ERR_INVALID_ARG;
+        memcpy(port, p, port_len);
+        port[port_len] = '\0';
+        p += port_len;
+    }
+
+    // Como en ESP-IDF: cambiar de servidor cierra la conexión
+    if (strcmp(host, client->host) != 0 || strcmp(port, client->port) != 0) {
+        client_disconnect(client);
+        strcpy(client->host, host);
+        strcpy(client->port, port);
+    }
+
+    size_t path_off = p - url;
+    strcpy(client->url, url);
+    client->path = client->url[path_off] ? &client->url[path_off] : "/";
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_set_method(esp_http_client_handle_t client, esp_http_client_method_t method)
+{
+    client->method = method;
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_set_header(esp_http_client_handle_t client, const char *key, const char *value)
+{
+    int slot = -1;
+    for (int i = 0; i < MAX_HEADERS; i++) {
+        if (strcasecmp(client->keys[i], key) == 0) {
+            slot = i;
+            break;
+        }
+        if (slot < 0 && client->keys[i][0] == '\0') slot = i;
+    }
+    if (slot < 0 || strlen(key) >= HEADER_KEY_LEN || strlen(value) >= HEADER_VALUE_LEN) {
+        return ESP_ERR_NO_MEM;
+    }
+    strcpy(client->keys[slot], key);
+    strcpy(client->values[slot], value);
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_delete_header(esp_http_client_handle_t client, const char *key)
+{
+    for (int i = 0; i < MAX_HEADERS; i++) {
+        if (client->keys[i][0] && strcasecmp(client->keys[i], key) == 0) {
+            client->keys[i][0] = '\0';
+        }
+    }
+    return ESP_OK;
+}
+
+static esp_err_t client_connect(esp_http_client_handle_t c)
+{
+    struct addrinfo hints = { .ai_family = AF_UNSPEC, .ai_socktype = SOCK_STREAM };
+    struct addrinfo *res;
+    if (getaddrinfo(c->host, c->port, &hints, &res) != 0) {
+        return ESP_FAIL;
+    }
+
+    c->fd = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+    if (c->fd >= 0 && connect(c->fd, res->ai_addr, res->ai_addrlen) != 0) {
+        close(c->fd);
+        c->fd = -1;
+    }
+    freeaddrinfo(res);
+    if (c->fd < 0) {
+        return ESP_FAIL;
+    }
+
+    struct timeval tv = { .tv_sec = c->cfg.timeout_ms / 1000, .tv_usec = (c->cfg.timeout_ms % 1000) * 1000 };
+    setsockopt(c->fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    host_http_connections++;
+    client_event(c, HTTP_EVENT_ON_CONNECTED, NULL, NULL);
+    return ESP_OK;
+}
+
+static esp_err_t client_send_request(esp_http_client_handle_t c)
+{
+    static const char *const methods[] = { "GET", "POST", "HEAD" };
+    char req[2048];
+    int n = snprintf(req, sizeof(req), "%s %s HTTP/1.1\r\nHost: %s:%s\r\nUser-Agent: ESP32 HTTP Client/1.0\r\n",
+                     methods[c->method], c->path, c->host, c->port);
+    for (int i = 0; i < MAX_HEADERS; i++) {
+        if (c->keys[i][0]) {
+            n += snprintf(req + n, sizeof(req) - n, "%s: %s\r\n", c->keys[i], c->values[i]);
+        }
+    }
+    n += snprintf(req + n, sizeof(req) - n, "\r\n");
+
+    for (int sent = 0; sent < n; ) {
+        ssize_t w = send(c->fd, req + sent, n - sent, MSG_NOSIGNAL);
+        if (w <= 0) return ESP_FAIL;
+        sent += w;
+    }
+    client_event(c, HTTP_EVENT_HEADERS_SENT, NULL, NULL);
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_open(esp_http_client_handle_t client, int write_len)
+{
+    (void)write_len;
+
+    // Una respuesta sin leer entera deja la conexión inservible
+    if (client->fd >= 0 && !esp_http_client_is_complete_data_received(client)) {
+        client_disconnect(client);
+    }
+
+    // Como en ESP-IDF, sin comprobar si el servidor cerró la conexión
+    // keep-alive: en ese caso falla fetch_headers
+    if (client->fd < 0 && client_connect(client) != ESP_OK) {
+        return ESP_FAIL;
+    }
+    client->status = 0;
+    client->content_length = -1;
+    client->body_read = 0;
+    client->head_len = client->head_pos = 0;
+
+    return client_send_request(client);
+}
+
+int64_t esp_http_client_fetch_headers(esp_http_client_handle_t client)
+{
+    char *end = NULL;
+    while (!end) {
+        if (client->head_len == sizeof(client->head) - 1) return ESP_FAIL;
+
+        ssize_t r = recv(client->fd, client->head + client->head_len, sizeof(client->head) - 1 - client->head_len, 0);
+        if (r <= 0) return ESP_FAIL;
+
+        client->head_len += r;
+        client->head[client->head_len] = '\0';
+        end = strstr(client->head, "\r\n\r\n");
+    }
+    *end = '\0';
+    client->head_pos = end + 4 - client->head;
+
+    int status;
+    if (sscanf(client->head, "HTTP/1.%*d %d", &status) != 1) return ESP_FAIL;
+    client->status = status;
+    client->server_close = false;
+    client->location[0] = '\0';
+
+    char *save;
+    strtok_r(client->head, "\r\n", &save);      // Línea de estado
+    for (char *line = strtok_r(NULL, "\r\n", &save); line; line = strtok_r(NULL, "\r\n", &save)) {
+        char *colon = strchr(line, ':');
+        if (!colon) continue;
+        *colon = '\0';
+        char *value = colon + 1;
+        while (*value == ' ') value++;
+
+        if (strcasecmp(line, "Content-Length") == 0) {
+            client->content_length = strtoll(value, NULL, 10);
+        } else if (strcasecmp(line, "Connection") == 0 && strcasecmp(value, "close") == 0) {
+            client->server_close = true;
+        } else if (strcasecmp(line, "Location") == 0) {
+            snprintf(client->location, sizeof(client->location), "%s", value);
+        }
+        client_event(client, HTTP_EVENT_ON_HEADER, line, value);
+    }
+
+    if (client->method == HTTP_METHOD_HEAD || status == 204 || status == 304) {
+        client->content_length = 0;
+    }
+    return client->content_length < 0 ? 0 : client->content_length;
+}
+
+int esp_http_client_get_status_code(esp_http_client_handle_t client)
+{
+    return client->status;
+}
+
+int64_t esp_http_client_get_content_length(esp_http_client_handle_t client)
+{
+    return client->content_length;
+}
+
+int esp_http_client_read(esp_http_client_handle_t client, char *buffer, int len)
+{
+    if (client->content_length >= 0) {
+        int64_t left = client->content_length - client->body_read;
+        if (len > left) len = (int)left;
+    }
+    if (len <= 0) return 0;
+
+    int n;
+    if (client->head_pos < client->head_len) {
+        n = client->head_len - client->head_pos;
+        if (n > len) n = len;
+        memcpy(buffer, client->head + client->head_pos, n);
+        client->head_pos += n;
+    } else {
+        if (client->fd < 0) return 0;
+        ssize_t r = recv(client->fd, buffer, len, 0);
+        if (r < 0) {
+            return (errno == EAGAIN || errno == EWOULDBLOCK) ? -ESP_ERR_TIMEOUT : -1;
+        }
+        if (r == 0) {
+            client_disconnect(client);
+            if (client->content_length < 0) client->content_length = client->body_read;
+            return 0;
+        }
+        n = (int)r;
+    }
+
+    client->body_read += n;
+    client_event(client, HTTP_EVENT_ON_DATA, NULL, NULL);
+    if (esp_http_client_is_complete_data_received(client)) {
+        client_event(client, HTTP_EVENT_ON_FINISH, NULL, NULL);
+        if (client->server_close) {
+            client_disconnect(client);
+        }
+    }
+    return n;
+}
+
+esp_err_t esp_http_client_flush_response(esp_http_client_handle_t client, int *len)
+{
+    char buf[512];
+    int total = 0;
+    int n;
+    while ((n = esp_http_client_read(client, buf, sizeof(buf))) > 0) {
+        total += n;
+    }
+    if (len) *len = total;
+    return n < 0 ? ESP_FAIL : ESP_OK;
+}
+
+bool esp_http_client_is_complete_data_received(esp_http_client_handle_t client)
+{
+    return client->content_length >= 0 && client->body_read == client->content_length;
+}
+
+esp_err_t esp_http_client_set_redirection(esp_http_client_handle_t client)
+{
+    char url[URL_LEN + HOST_LEN + 16];      // set_url rechaza las de más de URL_LEN
+    if (client->location[0] == '\0') return ESP_ERR_INVALID_ARG;
+
+    if (client->location[0] == '/') {
+        snprintf(url, sizeof(url), "http://%s:%s%s", client->host, client->port, client->location);
+    } else {
+        snprintf(url, sizeof(url), "%s", client->location);
+    }
+    client_event(client, HTTP_EVENT_REDIRECT, NULL, NULL);
+    return esp_http_client_set_url(client, url);
+}
+
+esp_err_t esp_http_client_close(esp_http_client_handle_t client)
+{
+    client_disconnect(client);
+    return ESP_OK;
+}
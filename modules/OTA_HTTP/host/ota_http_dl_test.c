@@ -0,0 +1,288 @@
+/*
+ * Prueba en el host de la descarga reanudable (ota_http_dl.c).
+ *
+ * Compila ota_http_dl.c tal cual contra los stubs de OTA_Protocol/host
+ * (particiones en RAM con semántica NOR, NVS en memoria) y un
+ * esp_http_client sobre sockets, y descarga una imagen real de
+ * range_server.py, que corta las conexiones a propósito. Cada escenario
+ * arranca su servidor; entre llamadas a ota_http_download solo sobrevive el
+ * NVS, como tras un reinicio. Los escenarios con manifest piden antes
+ * /latest.json por la misma sesión (ota_http_session), como
+ * ota_check_for_update, y cuentan las conexiones TCP.
+ *
+ * Uso: ota_http_dl_test [-v] [imagen.bin]   (desde modules/OTA_HTTP/host)
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <signal.h>
+#include <unistd.h>
+#include <inttypes.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_ota_ops.h"
+#include "esp_http_client.h"
+#include "mbedtls/sha256.h"
+#include "host_port.h"
+#include "ota_http_session.h"
+#include "ota_http_dl.h"
+
+#define TEST_SERVER "range_server.py"
+#define TEST_DEFAULT_IMAGE "../../../Versions/0.1/OTA.bin"
+#define TEST_MAX_CALLS 3
+#define TEST_SECTOR 4096
+
+typedef struct {
+    const char *name;
+    const char *server_args;        // Opciones de range_server.py
+    const char *path;
+    int max_attempts;
+    int calls;                      // Llamadas a ota_http_download ("reinicios" entre ellas)
+    bool change_image;              // Tras la primera llamada el servidor sirve otra imagen
+    bool bad_sha;                   // SHA-256 esperado incorrecto
+    bool manifest;                  // GET /latest.json por la misma sesión antes de la imagen
+    int tcp;                        // Conexiones TCP esperadas (0: no comprobar)
+    esp_err_t expect;               // Resultado de la última llamada
+} scenario_t;
+
+static const scenario_t s_scenarios[] = {
+    { "sin cortes",               "",                                          "/OTA.bin",          1,  1, false, false, false, 1, ESP_OK },
+    { "manifest + imagen",        "",                                          "/OTA.bin",          1,  1, false, false, true,  1, ESP_OK },
+    { "manifest + redireccion",   "",                                          "/redirect/OTA.bin", 1,  1, false, false, true,  1, ESP_OK },
+    { "cortes cada 128 KB",       "--drop-after 131072",                       "/OTA.bin",          10, 1, false, false, true,  8, ESP_OK },
+    { "reinicio a mitad",         "--drop-after 300000 --drops 1",             "/OTA.bin",          1,  2, false, false, false, 2, ESP_OK },
+    { "imagen cambiada",          "--drop-after 300000 --drops 1",             "/OTA.bin",          1,  2, true,  false, false, 2, ESP_OK },
+    { "redireccion + cortes",     "--drop-after 200000",                       "/redirect/OTA.bin", 10, 1, false, false, false, 0, ESP_OK },
+    { "sin Range, 2 cortes",      "--no-range --drop-after 200000 --drops 2",  "/OTA.bin",          5,  1, false, false, false, 3, ESP_OK },
+    { "reintentos agotados",      "--drop-after 100000",                       "/OTA.bin",          3,  1, false, false, false, 3, ESP_FAIL },
+    { "SHA-256 incorrecto",       "",                                          "/OTA.bin",          1,  1, false, true,  false, 1, ESP_ERR_INVALID_CRC },
+};
+
+static const char *s_image_path;
+static const char *s_alt_path;      // Imagen con el último sector cambiado
+static bool s_verbose;
+
+typedef struct {
+    FILE *pipe;
+    int pid;
+    int port;
+} server_t;
+
+static bool server_start(server_t *srv, const char *image, const char *args, int port)
+{
+    char cmd[512];
+    snprintf(cmd, sizeof(cmd), "exec python3 %s %s --port %d %s %s", TEST_SERVER, image, port, args,
+             s_verbose ? "-v" : "");
+    srv->pipe = popen(cmd, "r");
+    if (!srv->pipe) return false;
+
+    if (fscanf(srv->pipe, "PORT %d PID %d", &srv->port, &srv->pid) != 2) {
+        pclose(srv->pipe);
+        return false;
+    }
+    return true;
+}
+
+static void server_stop(server_t *srv)
+{
+    kill(srv->pid, SIGTERM);
+    pclose(srv->pipe);
+}
+
+static uint8_t *load_file(const char *path, size_t *size)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f) return NULL;
+
+    fseek(f, 0, SEEK_END);
+    long len = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    uint8_t *data = (len > 0 && len <= HOST_PARTITION_SIZE) ? malloc(len) : NULL;
+    if (data && fread(data, 1, len, f) != (size_t)len) {
+        free(data);
+        data = NULL;
+    }
+    fclose(f);
+
+    *size = len;
+    return data;
+}
+
+static void manifest_on_header(void *ctx, const char *key, const char *value)
+{
+    if (key && strcasecmp(key, "ETag") == 0) snprintf(ctx, 64, "%s", value);
+}
+
+static void sha256(const uint8_t *data, size_t len, uint8_t out[32])
+{
+    mbedtls_sha256_context ctx;
+    mbedtls_sha256_init(&ctx);
+    mbedtls_sha256_starts(&ctx, 0);
+    mbedtls_sha256_update(&ctx, data, len);
+    mbedtls_sha256_finish(&ctx, out);
+    mbedtls_sha256_free(&ctx);
+}
+
+/**
+ * @brief GET del manifest por la sesión, condicional la segunda vez (304)
+ */
+static bool manifest_get(ota_http_session_t *session, int port)
+{
+    char url[128];
+    char body[256];
+    char etag[64] = "";
+    snprintf(url, sizeof(url), "http://127.0.0.1:%d/latest.json", port);
+
+    for (int i = 0; i < 2; i++) {
+        int status;
+        int64_t len;
+        if (etag[0]) ota_http_session_set_header(session, "If-None-Match", etag);
+        if (ota_http_session_open(session, url, manifest_on_header, etag, &status, &len) != ESP_OK) {
+            ota_http_session_end(session);
+            return false;
+        }
+        int n = ota_http_session_read(session, body, sizeof(body) - 1);
+        ota_http_session_end(session);
+        if (status != (i == 0 ? 200 : 304) || (i == 0 && n <= 0)) return false;
+    }
+    return true;
+}
+
+static bool run(const scenario_t *sc, const uint8_t *image, const uint8_t *alt, size_t size)
+{
+    const esp_partition_t *part = esp_ota_get_next_update_partition(NULL);
+    host_reset();
+    // Sin 0xFF: una escritura sin borrado previo deja datos erróneos
+    memset(host_partition_data(part), 0x00, HOST_PARTITION_SIZE);
+
+    server_t srv;
+    if (!server_start(&srv, s_image_path, sc->server_args, 0)) {
+        printf("%-24s no se pudo arrancar %s   FALLO\n", sc->name, TEST_SERVER);
+        return false;
+    }
+
+    const uint8_t *served = image;
+    uint8_t digest[32];
+    sha256(image, size, digest);
+    if (sc->bad_sha) digest[0] ^= 1;
+
+    char url[128];
+    snprintf(url, sizeof(url), "http://127.0.0.1:%d%s", srv.port, sc->path);
+
+    ota_http_dl_config_t cfg = OTA_HTTP_DL_CONFIG_DEFAULT();
+    cfg.url = url;
+    cfg.expected_sha256 = digest;
+    cfg.max_attempts = sc->max_attempts;
+    cfg.timeout_ms = 5000;
+
+    // Una sesión por "arranque", como ota_check_for_update
+    ota_http_session_config_t session_cfg = OTA_HTTP_SESSION_CONFIG_DEFAULT();
+    session_cfg.timeout_ms = cfg.timeout_ms;
+    int tcp0 = host_http_connections;
+
+    ota_http_dl_stats_t stats;
+    uint32_t received = 0;
+    uint32_t resumed_from = 0;
+    int connections = 0;
+    esp_err_t err = ESP_FAIL;
+    int64_t t0 = esp_timer_get_time();
+
+    for (int call = 0; call < sc->calls; call++) {
+        if (call == 1 && sc->change_image) {
+            // Misma URL, otro contenido (y otro ETag): If-Range debe fallar
+            int port = srv.port;
+            server_stop(&srv);
+            if (!server_start(&srv, s_alt_path, "", port)) {
+                printf("%-24s no se pudo rearrancar %s   FALLO\n", sc->name, TEST_SERVER);
+                return false;
+            }
+            served = alt;
+            sha256(alt, size, digest);
+        }
+        ota_http_session_t *session = ota_http_session_create(&session_cfg);
+        cfg.session = session;
+        if (sc->manifest && !manifest_get(session, srv.port)) {
+            err = ESP_ERR_INVALID_STATE;
+        } else {
+            err = ota_http_download(&cfg, &stats);
+        }
+        ota_http_session_destroy(session);
+        received += stats.downloaded;
+        connections += stats.attempts;
+        if (call > 0 && !resumed_from) resumed_from = stats.resumed_from;
+    }
+    double ms = (esp_timer_get_time() - t0) / 1000.0;
+    int tcp = host_http_connections - tcp0;
+    server_stop(&srv);
+
+    uint32_t pending = 0;
+    bool has_pending = ota_http_dl_pending(&pending, NULL) == ESP_OK;
+    bool ok = err == sc->expect && (sc->tcp == 0 || tcp == sc->tcp);
+    if (err == ESP_OK) {
+        ok = ok && host_boot_partition() == part && memcmp(host_partition_data(part), served, size) == 0 &&
+             !has_pending;
+    } else {
+        ok = ok && host_boot_partition() == NULL;
+        // Un corte deja el progreso para la siguiente llamada; un error de imagen no
+        ok = ok && (err == ESP_FAIL ? has_pending && pending % TEST_SECTOR == 0 : !has_pending);
+    }
+
+    printf("%-24s %-20s %4d %4d %9.2f %10" PRIu32 " %7.0f   %s\n", sc->name, esp_err_to_name(err), connections,
+           tcp, (double)received / size, resumed_from, ms, ok ? "OK" : "FALLO");
+    return ok;
+}
+
+int main(int argc, char **argv)
+{
+    int opt;
+    host_log_level = ESP_LOG_NONE;
+
+    while ((opt = getopt(argc, argv, "v")) != -1) {
+        if (opt == 'v') {
+            s_verbose = true;
+            host_log_level = ESP_LOG_INFO;
+        } else {
+            fprintf(stderr, "Uso: %s [-v] [imagen.bin]\n", argv[0]);
+            return 2;
+        }
+    }
+    s_image_path = optind < argc ? argv[optind] : TEST_DEFAULT_IMAGE;
+
+    size_t size;
+    uint8_t *image = load_file(s_image_path, &size);
+    if (!image) {
+        fprintf(stderr, "No se pudo leer %s (máximo %d bytes)\n", s_image_path, HOST_PARTITION_SIZE);
+        return 2;
+    }
+
+    // Segunda versión de la imagen: misma cabecera, último sector distinto
+    uint8_t *alt = malloc(size);
+    memcpy(alt, image, size);
+    for (size_t i = size > TEST_SECTOR ? size - TEST_SECTOR : 0; i < size; i++) alt[i] ^= 0x5A;
+
+    char alt_path[] = "/tmp/ota_http_dl_XXXXXX";
+    int fd = mkstemp(alt_path);
+    if (fd < 0 || write(fd, alt, size) != (ssize_t)size) {
+        fprintf(stderr, "No se pudo crear la imagen alternativa\n");
+        return 2;
+    }
+    close(fd);
+    s_alt_path = alt_path;
+
+    printf("Imagen: %s, %zu bytes\n\n", s_image_path, size);
+    printf("%-24s %-20s %4s %4s %9s %10s %7s\n", "Escenario", "Resultado", "Int.", "TCP", "Rx/imagen", "Reanuda en",
+           "ms");
+
+    bool all_ok = true;
+    for (size_t i = 0; i < sizeof(s_scenarios) / sizeof(s_scenarios[0]); i++) {
+        all_ok &= run(&s_scenarios[i], image, alt, size);
+    }
+
+    unlink(alt_path);
+    free(alt);
+    free(image);
+    printf("\n%s\n", all_ok ? "Todos los escenarios OK" : "Hay escenarios con FALLO");
+    return all_ok ? 0 : 1;
+}
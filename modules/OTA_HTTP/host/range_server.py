@@ -0,0 +1,115 @@
+#!/usr/bin/env python3
+"""
+Servidor HTTP de pruebas para ota_http_dl: sirve una imagen con ETag,
+Range e If-Range, y corta conexiones a propósito. Las rutas *.json
+devuelven un manifest pequeño (con If-None-Match y 304).
+
+    python3 range_server.py ../../../Versions/0.1/OTA.bin --drop-after 200000
+
+Al arrancar imprime "PORT <puerto> PID <pid>" en stdout.
+"""
+
+import argparse
+import hashlib
+import os
+import re
+import socket
+import sys
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+
+RANGE_RE = re.compile(r"bytes=(\d+)-$")
+
+
+def make_handler(args, image):
+    etag = '"%s"' % hashlib.sha256(image).hexdigest()[:16]
+    manifest = b'{"version":"%s","size":%d}' % (etag.strip('"').encode(), len(image))
+    manifest_etag = '"m-%s"' % etag.strip('"')
+    state = {"responses": 0}
+
+    class Handler(BaseHTTPRequestHandler):
+        protocol_version = "HTTP/1.1"
+
+        def log_message(self, fmt, *a):
+            if args.verbose:
+                sys.stderr.write("[server] " + (fmt % a) + "\n")
+
+        def do_GET(self):
+            # /redirect/<ruta>: 302 a /<ruta>, como las releases de GitHub
+            if self.path.startswith("/redirect/"):
+                self.send_response(302)
+                self.send_header("Location", self.path[len("/redirect"):])
+                self.send_header("Content-Length", "0")
+                self.end_headers()
+                return
+
+            if self.path.endswith(".json"):
+                not_modified = self.headers.get("If-None-Match") == manifest_etag
+                self.send_response(304 if not_modified else 200)
+                self.send_header("ETag", manifest_etag)
+                self.send_header("Content-Length", "0" if not_modified else str(len(manifest)))
+                self.end_headers()
+                if not not_modified:
+                    self.wfile.write(manifest)
+                return
+
+            start = 0
+            rng = self.headers.get("Range")
+            if_range = self.headers.get("If-Range")
+            if rng and not args.no_range and (if_range is None or if_range == etag):
+                m = RANGE_RE.match(rng)
+                if not m or int(m.group(1)) >= len(image):
+                    self.send_response(416)
+                    self.send_header("Content-Range", "bytes */%d" % len(image))
+                    self.send_header("Content-Length", "0")
+                    self.end_headers()
+                    return
+                start = int(m.group(1))
+
+            body = image[start:]
+            self.send_response(206 if start else 200)
+            self.send_header("ETag", etag)
+            self.send_header("Accept-Ranges", "none" if args.no_range else "bytes")
+            if start:
+                self.send_header("Content-Range", "bytes %d-%d/%d" % (start, len(image) - 1, len(image)))
+            self.send_header("Content-Length", str(len(body)))
+            self.end_headers()
+
+            state["responses"] += 1
+            cut = args.drop_after and (args.drops < 0 or state["responses"] <= args.drops)
+            if cut and args.drop_after < len(body):
+                # Corte brusco a mitad de cuerpo: RST en lugar de FIN
+                self.wfile.write(body[:args.drop_after])
+                self.wfile.flush()
+                self.connection.setsockopt(socket.SOL_SOCKET, socket.SO_LINGER, b"\x01\x00\x00\x00\x00\x00\x00\x00")
+                self.close_connection = True
+                self.log_message("corte tras %d bytes", args.drop_after)
+                return
+            self.wfile.write(body)
+
+    return Handler
+
+
+def main():
+    ap = argparse.ArgumentParser(description="Servidor HTTP con Range y cortes para probar ota_http_dl")
+    ap.add_argument("image", help="Imagen servida en cualquier ruta")
+    ap.add_argument("--port", type=int, default=0, help="Puerto (0: uno libre)")
+    ap.add_argument("--drop-after", type=int, default=0, help="Cortar cada respuesta tras N bytes de cuerpo")
+    ap.add_argument("--drops", type=int, default=-1, help="Respuestas que se cortan (-1: todas)")
+    ap.add_argument("--no-range", action="store_true", help="Ignorar Range: siempre 200 con la imagen entera")
+    ap.add_argument("-v", "--verbose", action="store_true")
+    args = ap.parse_args()
+
+    with open(args.image, "rb") as f:
+        image = f.read()
+
+    server = ThreadingHTTPServer(("127.0.0.1", args.port), make_handler(args, image))
+    server.daemon_threads = True
+    print("PORT %d PID %d" % (server.server_address[1], os.getpid()), flush=True)
+    try:
+        server.serve_forever()
+    except KeyboardInterrupt:
+        pass
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,390 @@
+#include <string.h>
+#include <strings.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_partition.h"
+#include "esp_ota_ops.h"
+#include "esp_rom_crc.h"
+#include "nvs.h"
+#include "ota_stream.h"
+#include "ota_image_check.h"
+#include "ota_http_session.h"
+#include "ota_http_dl.h"
+
+#define TAG "ota_http_dl"
+
+#define DL_NVS_NAMESPACE "ota_info"
+#define DL_NVS_KEY "dl_resume"
+#define DL_SECTOR_SIZE 4096
+#define DL_SAVE_INTERVAL (64 * 1024)        // Bytes de imagen entre guardados en NVS
+#define DL_MAX_RETRY_DELAY_MS 30000
+
+// Registro persistente de una descarga a medias
+typedef struct {
+    uint32_t url_crc;           // CRC32 de la URL pedida
+    uint32_t part_addr;         // Partición destino
+    uint32_t size;              // Tamaño de la imagen (Content-Length de la respuesta 200)
+    uint32_t offset;            // Bytes escritos en flash (alineado a sector)
+    char etag[OTA_HTTP_ETAG_LEN];
+} dl_resume_record_t;
+
+// Cabeceras de la respuesta en curso (HTTP_EVENT_ON_HEADER)
+typedef struct {
+    char etag[OTA_HTTP_ETAG_LEN];
+    bool has_range;
+    uint32_t range_start;       // Content-Range: bytes <start>-<end>/<total>
+    uint32_t range_total;
+} dl_headers_t;
+
+typedef struct {
+    const ota_http_dl_config_t *cfg;
+    ota_http_session_t *session;
+    const esp_partition_t *part;
+    dl_resume_record_t rec;
+    bool resumable;             // Hay tamaño y ETag: el registro vale para reanudar
+    uint32_t saved;             // Último offset guardado en NVS
+    uint8_t *sector;            // Sector en construcción, se escribe entero
+    size_t fill;
+    ota_image_check_t check;
+    dl_headers_t hdr;
+    ota_http_dl_stats_t stats;
+} dl_state_t;
+
+static void record_store(dl_state_t *st)
+{
+    nvs_handle_t nvs;
+    if (nvs_open(DL_NVS_NAMESPACE, NVS_READWRITE, &nvs) != ESP_OK) {
+        ESP_LOGW(TAG, "No se pudo abrir NVS para reanudación");
+        return;
+    }
+    if (nvs_set_blob(nvs, DL_NVS_KEY, &st->rec, sizeof(st->rec)) == ESP_OK) {
+        nvs_commit(nvs);
+        st->saved = st->rec.offset;
+    }
+    nvs_close(nvs);
+}
+
+static esp_err_t record_load(dl_resume_record_t *rec)
+{
+    nvs_handle_t nvs;
+    esp_err_t err = nvs_open(DL_NVS_NAMESPACE, NVS_READONLY, &nvs);
+    if (err != ESP_OK) return err;
+
+    size_t len = sizeof(*rec);
+    err = nvs_get_blob(nvs, DL_NVS_KEY, rec, &len);
+    nvs_close(nvs);
+
+    if (err == ESP_OK && len != sizeof(*rec)) {
+        err = ESP_ERR_INVALID_SIZE;
+    }
+    return err;
+}
+
+void ota_http_dl_forget(void)
+{
+    nvs_handle_t nvs;
+    if (nvs_open(DL_NVS_NAMESPACE, NVS_READWRITE, &nvs) != ESP_OK) return;
+
+    if (nvs_erase_key(nvs, DL_NVS_KEY) == ESP_OK) {
+        nvs_commit(nvs);
+    }
+    nvs_close(nvs);
+}
+
+esp_err_t ota_http_dl_pending(uint32_t *offset, uint32_t *size)
+{
+    dl_resume_record_t rec;
+    if (record_load(&rec) != ESP_OK || rec.offset == 0) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    if (offset) *offset = rec.offset;
+    if (size) *size = rec.size;
+    return ESP_OK;
+}
+
+static void dl_on_header(void *ctx, const char *key, const char *value)
+{
+    dl_headers_t *hdr = (dl_headers_t *)ctx;
+
+    if (!key) {
+        memset(hdr, 0, sizeof(*hdr));       // Otra respuesta tras una redirección
+    } else if (strcasecmp(key, "ETag") == 0) {
+        // Uno que no cabe no sirve de validador: se deja vacío
+        if (strlen(value) < sizeof(hdr->etag)) {
+            strcpy(hdr->etag, value);
+        }
+    } else if (strcasecmp(key, "Content-Range") == 0) {
+        unsigned long start, end, total;
+        hdr->has_range = sscanf(value, "bytes %lu-%lu/%lu", &start, &end, &total) == 3;
+        hdr->range_start = start;
+        hdr->range_total = total;
+    }
+}
+
+/**
+ * @brief Escribir el sector en construcción en st->rec.offset
+ *
+ * El primer sector pasa antes por ota_image_check. El offset se guarda en
+ * NVS cada DL_SAVE_INTERVAL bytes.
+ */
+static esp_err_t dl_flush_sector(dl_state_t *st)
+{
+    if (st->rec.offset == 0) {
+        ota_image_verdict_t verdict = ota_image_check_feed(&st->check, st->sector, st->fill);
+        if (OTA_IMAGE_REJECTED(verdict)) {
+            ESP_LOGE(TAG, "Imagen rechazada: %s", ota_image_verdict_str(verdict));
+            return ESP_ERR_OTA_VALIDATE_FAILED;
+        }
+    }
+
+    esp_err_t err = esp_partition_erase_range(st->part, st->rec.offset, DL_SECTOR_SIZE);
+    if (err == ESP_OK) {
+        err = esp_partition_write(st->part, st->rec.offset, st->sector, st->fill);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Error escribiendo en flash en %" PRIu32 ": %s", st->rec.offset, esp_err_to_name(err));
+        return err;
+    }
+
+    st->rec.offset += st->fill;
+    st->fill = 0;
+
+    if (st->resumable && st->rec.offset - st->saved >= DL_SAVE_INTERVAL) {
+        record_store(st);
+    }
+    return ESP_OK;
+}
+
+/**
+ * @brief Una conexión: desde st->rec.offset hasta el final o hasta el corte
+ */
+static esp_err_t dl_attempt(dl_state_t *st)
+{
+    const ota_http_dl_config_t *cfg = st->cfg;
+    bool resuming = st->rec.offset > 0;
+
+    if (resuming) {
+        char range[32];
+        snprintf(range, sizeof(range), "bytes=%" PRIu32 "-", st->rec.offset);
+        ota_http_session_set_header(st->session, "Range", range);
+        ota_http_session_set_header(st->session, "If-Range", st->rec.etag);
+    }
+
+    // Cada intento vuelve a la URL original: la de la redirección puede caducar
+    memset(&st->hdr, 0, sizeof(st->hdr));
+    int status;
+    int64_t content_length;
+    if (ota_http_session_open(st->session, cfg->url, dl_on_header, &st->hdr, &status, &content_length) != ESP_OK) {
+        return ESP_FAIL;
+    }
+
+    if (status == 206 && resuming) {
+        if (!st->hdr.has_range || st->hdr.range_start != st->rec.offset ||
+            st->hdr.range_total != st->rec.size) {
+            ESP_LOGW(TAG, "Content-Range inesperado: se descarga de nuevo desde 0");
+            st->rec.offset = 0;
+            return ESP_FAIL;
+        }
+        ESP_LOGI(TAG, "Reanudando en %" PRIu32 "/%" PRIu32 " bytes", st->rec.offset, st->rec.size);
+    } else if (status == 200) {
+        if (resuming) {
+            ESP_LOGW(TAG, "El servidor envía la imagen entera (ETag distinto o sin Range): desde 0");
+        }
+        if (content_length > st->part->size ||
+            (cfg->image_size && content_length > 0 && content_length != cfg->image_size)) {
+            ESP_LOGE(TAG, "Tamaño inesperado: %" PRId64 " bytes", content_length);
+            return ESP_ERR_INVALID_SIZE;
+        }
+
+        memset(&st->rec, 0, sizeof(st->rec));
+        st->rec.url_crc = esp_rom_crc32_le(0, (const uint8_t *)cfg->url, strlen(cfg->url));
+        st->rec.part_addr = st->part->address;
+        st->rec.size = content_length > 0 ? (uint32_t)content_length : 0;
+        strcpy(st->rec.etag, st->hdr.etag);
+        st->resumable = st->rec.size > 0 && st->rec.etag[0] != '\0';
+        st->saved = 0;
+        ota_image_check_init(&st->check);
+
+        if (st->resumable) {
+            record_store(st);
+        } else {
+            ota_http_dl_forget();
+            ESP_LOGW(TAG, "Respuesta sin Content-Length o sin ETag: descarga no reanudable");
+        }
+    } else if (status == 416) {
+        ESP_LOGW(TAG, "Rango no satisfacible: se descarga de nuevo desde 0");
+        st->rec.offset = 0;
+        return ESP_FAIL;
+    } else {
+        ESP_LOGE(TAG, "Respuesta HTTP inválida (%d)", status);
+        return status >= 500 ? ESP_FAIL : ESP_ERR_NOT_FOUND;
+    }
+
+    st->stats.image_size = st->rec.size;
+    st->fill = 0;
+
+    int read_len = 0;
+    while (st->rec.size == 0 || st->rec.offset + st->fill < st->rec.size) {
+        read_len = ota_http_session_read(st->session, (char *)st->sector + st->fill, DL_SECTOR_SIZE - st->fill);
+        if (read_len <= 0) {
+            break;
+        }
+        st->fill += read_len;
+        st->stats.downloaded += read_len;
+
+        if (st->fill == DL_SECTOR_SIZE) {
+            esp_err_t err = dl_flush_sector(st);
+            if (err != ESP_OK) return err;
+        }
+    }
+
+    bool complete = st->rec.size ? st->rec.offset + st->fill == st->rec.size
+                                 : read_len == 0 && ota_http_session_complete(st->session);
+    if (!complete) {
+        // El sector a medias se pierde: se vuelve a pedir desde su inicio
+        st->fill = 0;
+        if (st->resumable && st->rec.offset != st->saved) {
+            record_store(st);
+        }
+        ESP_LOGW(TAG, "Conexión cortada en %" PRIu32 "/%" PRIu32 " bytes", st->rec.offset, st->rec.size);
+        return ESP_FAIL;
+    }
+
+    return st->fill ? dl_flush_sector(st) : ESP_OK;
+}
+
+/**
+ * @brief Errores de red o del servidor, que merece la pena reintentar
+ */
+static bool dl_retryable(esp_err_t err)
+{
+    return err == ESP_FAIL || err == ESP_ERR_TIMEOUT;
+}
+
+static esp_err_t dl_finish(dl_state_t *st)
+{
+    size_t len = st->rec.offset;
+
+    if (len == 0 || (st->cfg->image_size && len != st->cfg->image_size)) {
+        ESP_LOGE(TAG, "Tamaño inesperado: %zu bytes", len);
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    // Tras una reanudación parte de la imagen se escribió en otro arranque:
+    // el SHA-256 se calcula leyendo la partición
+    if (st->cfg->expected_sha256) {
+        uint8_t digest[OTA_STREAM_SHA256_LEN];
+        esp_err_t err = ota_partition_sha256(st->part, len, digest);
+        if (err != ESP_OK) return err;
+        if (memcmp(digest, st->cfg->expected_sha256, sizeof(digest)) != 0) {
+            ESP_LOGE(TAG, "SHA-256 de la imagen no coincide");
+            return ESP_ERR_INVALID_CRC;
+        }
+    }
+
+    // Sin esp_ota_begin/end: la validación completa la hace esp_ota_set_boot_partition
+    return esp_ota_set_boot_partition(st->part);
+}
+
+esp_err_t ota_http_download(const ota_http_dl_config_t *cfg, ota_http_dl_stats_t *stats)
+{
+    if (!cfg || !cfg->url) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    dl_state_t *st = calloc(1, sizeof(*st));
+    if (!st) return ESP_ERR_NO_MEM;
+    st->cfg = cfg;
+
+    st->part = esp_ota_get_next_update_partition(NULL);
+    if (!st->part) {
+        ESP_LOGE(TAG, "Partición OTA no disponible");
+        free(st);
+        return ESP_FAIL;
+    }
+
+    // Solo vale el registro de esta misma URL y partición
+    uint32_t url_crc = esp_rom_crc32_le(0, (const uint8_t *)cfg->url, strlen(cfg->url));
+    if (record_load(&st->rec) == ESP_OK && st->rec.url_crc == url_crc &&
+        st->rec.part_addr == st->part->address && st->rec.etag[0] != '\0' &&
+        st->rec.offset % DL_SECTOR_SIZE == 0 && st->rec.offset < st->rec.size &&
+        st->rec.size <= st->part->size) {
+        st->resumable = true;
+        st->saved = st->rec.offset;
+        st->stats.resumed_from = st->rec.offset;
+        if (st->rec.offset) {
+            ESP_LOGI(TAG, "Descarga a medias: %" PRIu32 "/%" PRIu32 " bytes (ETag %s)",
+                     st->rec.offset, st->rec.size, st->rec.etag);
+        }
+    } else {
+        memset(&st->rec, 0, sizeof(st->rec));
+    }
+
+    // Sin sesión de quien llama, una propia para los intentos de esta descarga
+    ota_http_session_t *own = NULL;
+    st->session = cfg->session;
+    if (!st->session) {
+        ota_http_session_config_t session_cfg = {
+            .timeout_ms = cfg->timeout_ms,
+            .crt_bundle_attach = cfg->crt_bundle_attach,
+        };
+        st->session = own = ota_http_session_create(&session_cfg);
+    }
+
+    st->sector = malloc(DL_SECTOR_SIZE);
+    if (!st->session || !st->sector) {
+        ota_http_session_destroy(own);
+        free(st->sector);
+        free(st);
+        return ESP_ERR_NO_MEM;
+    }
+
+    ESP_LOGI(TAG, "Descargando %s en %s", cfg->url, st->part->label);
+
+    int64_t t0 = esp_timer_get_time();
+    uint32_t delay_ms = cfg->retry_delay_ms;
+    esp_err_t err;
+
+    for (;;) {
+        st->stats.attempts++;
+        err = dl_attempt(st);
+        ota_http_session_end(st->session);    // La conexión sigue abierta si la respuesta se leyó entera
+
+        if (err == ESP_OK || !dl_retryable(err) || st->stats.attempts >= cfg->max_attempts) {
+            break;
+        }
+        ESP_LOGW(TAG, "Intento %d fallido; reintento en %" PRIu32 " ms", st->stats.attempts, delay_ms);
+        vTaskDelay(pdMS_TO_TICKS(delay_ms));
+        delay_ms = delay_ms * 2 > DL_MAX_RETRY_DELAY_MS ? DL_MAX_RETRY_DELAY_MS : delay_ms * 2;
+    }
+
+    if (err == ESP_OK) {
+        err = dl_finish(st);
+    }
+
+    if (err == ESP_OK) {
+        ota_http_dl_forget();
+        ESP_LOGI(TAG, "Imagen descargada: %" PRIu32 " bytes, %" PRIu32 " recibidos en %d conexiones (%" PRId64 " ms)",
+                 st->rec.offset, st->stats.downloaded, st->stats.attempts, (esp_timer_get_time() - t0) / 1000);
+    } else if (dl_retryable(err)) {
+        // El progreso queda en NVS para la siguiente llamada
+        ESP_LOGE(TAG, "Descarga interrumpida en %" PRIu32 "/%" PRIu32 " bytes tras %d intentos",
+                 st->rec.offset, st->rec.size, st->stats.attempts);
+    } else {
+        ota_http_dl_forget();
+        ESP_LOGE(TAG, "Error en la descarga: %s", esp_err_to_name(err));
+    }
+
+    if (stats) {
+        *stats = st->stats;
+    }
+
+    ota_http_session_destroy(own);
+    free(st->sector);
+    free(st);
+    return err;
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "ota_http_session.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Descarga reanudable de una imagen completa por HTTP(S).
+ *
+ * La imagen se escribe sector a sector en la siguiente partición OTA y el
+ * offset escrito se guarda en NVS junto con la URL, el tamaño y el ETag del
+ * servidor. Si la conexión se corta, el reintento (o la siguiente llamada
+ * tras un reinicio) pide solo lo que falta con "Range: bytes=N-" e
+ * "If-Range: <ETag>": si la imagen cambió en el servidor, este responde 200
+ * con la imagen entera y la descarga empieza de cero.
+ */
+
+// ETag más largo que se guarda (con comillas); uno más largo no es reanudable
+#define OTA_HTTP_ETAG_LEN 64
+
+/**
+ * @brief Configuración de una descarga
+ */
+typedef struct {
+    const char *url;                    // URL de la imagen (la de la primera petición, antes de redirecciones)
+    const uint8_t *expected_sha256;     // SHA-256 de la imagen (NULL: solo la validación de esp_ota_set_boot_partition)
+    size_t image_size;                  // Tamaño esperado (0: no comprobar)
+    ota_http_session_t *session;        // Sesión compartida (p. ej. con el manifest); NULL: una propia
+    int timeout_ms;                     // Timeout de esp_http_client por operación (sesión propia)
+    int max_attempts;                   // Intentos por llamada: el primero más los reintentos
+    uint32_t retry_delay_ms;            // Espera antes del primer reintento; se dobla en cada uno
+    esp_err_t (*crt_bundle_attach)(void *conf);   // esp_crt_bundle_attach para HTTPS (sesión propia)
+} ota_http_dl_config_t;
+
+#define OTA_HTTP_DL_CONFIG_DEFAULT() {  \
+    .url = NULL,                        \
+    .expected_sha256 = NULL,            \
+    .image_size = 0,                    \
+    .session = NULL,                    \
+    .timeout_ms = 15000,                \
+    .max_attempts = 5,                  \
+    .retry_delay_ms = 1000,             \
+    .crt_bundle_attach = NULL,          \
+}
+
+/**
+ * @brief Resultado de una llamada, para logs y pruebas
+ */
+typedef struct {
+    uint32_t resumed_from;      // Offset recuperado de NVS al empezar (0: descarga nueva)
+    uint32_t downloaded;        // Bytes de cuerpo recibidos en esta llamada (todos los intentos)
+    uint32_t image_size;        // Tamaño de la imagen según el servidor (0 si no se llegó a saber)
+    int attempts;               // Intentos (peticiones de la imagen)
+} ota_http_dl_stats_t;
+
+/**
+ * @brief Descargar la imagen en la siguiente partición OTA y marcarla para arrancar
+ *
+ * Reintenta los cortes de red hasta cfg->max_attempts; si se agotan, el
+ * progreso queda en NVS para la siguiente llamada con la misma URL.
+ *
+ * @param stats Opcional (NULL)
+ * @return ESP_OK con la partición de arranque cambiada,
+ *         ESP_ERR_OTA_VALIDATE_FAILED si la imagen no sirve para este dispositivo,
+ *         ESP_ERR_INVALID_CRC si el SHA-256 no coincide,
+ *         ESP_ERR_INVALID_SIZE si el tamaño no es el esperado o no cabe,
+ *         ESP_ERR_NOT_FOUND si el servidor responde 4xx,
+ *         ESP_FAIL si se agotan los reintentos
+ */
+esp_err_t ota_http_download(const ota_http_dl_config_t *cfg, ota_http_dl_stats_t *stats);
+
+/**
+ * @brief Descarga a medias guardada en NVS
+ * @param offset Bytes ya escritos en flash
+ * @param size Tamaño de la imagen
+ * @return ESP_OK si hay una, ESP_ERR_NOT_FOUND si no
+ */
+esp_err_t ota_http_dl_pending(uint32_t *offset, uint32_t *size);
+
+/**
+ * @brief Olvidar la descarga a medias (la siguiente empieza de cero)
+ */
+void ota_http_dl_forget(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,212 @@
+#include <string.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include "sdkconfig.h"
+#include "esp_log.h"
+#include "esp_http_client.h"
+#include "ota_http_session.h"
+
+#define TAG "ota_http_session"
+
+#define SESSION_MAX_HEADERS 4           // Cabeceras de una sola petición (Range, If-Range...)
+#define SESSION_HEADER_KEY_LEN 32
+#define SESSION_HEADER_VALUE_LEN 80
+#define SESSION_MAX_REDIRECTS 3
+
+struct ota_http_session {
+    ota_http_session_config_t cfg;
+    esp_http_client_handle_t client;
+    bool connected;                     // Entre HTTP_EVENT_ON_CONNECTED y HTTP_EVENT_DISCONNECTED
+    ota_http_header_cb_t on_header;
+    void *ctx;
+    char keys[SESSION_MAX_HEADERS][SESSION_HEADER_KEY_LEN];
+    char values[SESSION_MAX_HEADERS][SESSION_HEADER_VALUE_LEN];
+    uint32_t connections;
+    uint32_t requests;
+};
+
+static esp_err_t session_event_handler(esp_http_client_event_t *evt)
+{
+    ota_http_session_t *s = (ota_http_session_t *)evt->user_data;
+
+    switch (evt->event_id) {
+    case HTTP_EVENT_ON_CONNECTED:
+        s->connected = true;
+        s->connections++;
+        break;
+    case HTTP_EVENT_DISCONNECTED:
+        s->connected = false;
+        break;
+    case HTTP_EVENT_ON_HEADER:
+        if (s->on_header) {
+            s->on_header(s->ctx, evt->header_key, evt->header_value);
+        }
+        break;
+    default:
+        break;
+    }
+    return ESP_OK;
+}
+
+ota_http_session_t *ota_http_session_create(const ota_http_session_config_t *cfg)
+{
+    ota_http_session_t *s = calloc(1, sizeof(*s));
+    if (!s) return NULL;
+
+    ota_http_session_config_t def = OTA_HTTP_SESSION_CONFIG_DEFAULT();
+    s->cfg = cfg ? *cfg : def;
+    return s;
+}
+
+void ota_http_session_destroy(ota_http_session_t *s)
+{
+    if (!s) return;
+
+    if (s->client) {
+        ESP_LOGI(TAG, "Sesión cerrada: %" PRIu32 " peticiones en %" PRIu32 " conexiones",
+                 s->requests, s->connections);
+        esp_http_client_cleanup(s->client);
+    }
+    free(s);
+}
+
+esp_err_t ota_http_session_set_header(ota_http_session_t *s, const char *key, const char *value)
+{
+    if (strlen(key) >= SESSION_HEADER_KEY_LEN || strlen(value) >= SESSION_HEADER_VALUE_LEN) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // Se guardan aquí: el cliente puede no existir hasta ota_http_session_open
+    for (int i = 0; i < SESSION_MAX_HEADERS; i++) {
+        if (s->keys[i][0] == '\0' || strcmp(s->keys[i], key) == 0) {
+            strcpy(s->keys[i], key);
+            strcpy(s->values[i], value);
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_NO_MEM;
+}
+
+/**
+ * @brief Crear el cliente con la primera URL o apuntar el existente a url
+ *
+ * esp_http_client_set_url cierra la conexión si cambia el host o el puerto.
+ */
+static esp_err_t session_set_url(ota_http_session_t *s, const char *url)
+{
+    if (s->client) {
+        return esp_http_client_set_url(s->client, url);
+    }
+
+    esp_http_client_config_t client_cfg = {
+        .url = url,
+        .crt_bundle_attach = s->cfg.crt_bundle_attach,
+        .timeout_ms = s->cfg.timeout_ms,
+        .event_handler = session_event_handler,
+        .user_data = s,
+        .keep_alive_enable = true,      // TCP keep-alive: detecta la conexión muerta entre peticiones
+#ifdef CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS
+        .save_client_session = true,    // Reconexión al mismo host con la sesión TLS guardada
+#endif
+    };
+
+    s->client = esp_http_client_init(&client_cfg);
+    return s->client ? ESP_OK : ESP_ERR_NO_MEM;
+}
+
+esp_err_t ota_http_session_open(ota_http_session_t *s, const char *url,
+                                ota_http_header_cb_t on_header, void *ctx,
+                                int *status, int64_t *content_length)
+{
+    esp_err_t err = session_set_url(s, url);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "URL no válida: %s", url);
+        return err;
+    }
+
+    for (int i = 0; i < SESSION_MAX_HEADERS; i++) {
+        if (s->keys[i][0]) {
+            esp_http_client_set_header(s->client, s->keys[i], s->values[i]);
+        }
+    }
+
+    s->on_header = on_header;
+    s->ctx = ctx;
+    bool retried = false;
+
+    for (int redirects = 0; ; ) {
+        bool reused = s->connected;
+        s->requests++;
+
+        err = esp_http_client_open(s->client, 0);
+        if (err == ESP_OK) {
+            *content_length = esp_http_client_fetch_headers(s->client);
+            if (*content_length < 0) err = ESP_FAIL;
+        }
+
+        if (err != ESP_OK) {
+            esp_http_client_close(s->client);
+            s->connected = false;
+            if (reused && !retried) {
+                // El servidor cerró la conexión mientras no se usaba
+                ESP_LOGD(TAG, "Conexión reutilizada cerrada por el servidor: reconectando");
+                retried = true;
+                if (on_header) on_header(ctx, NULL, NULL);
+                continue;
+            }
+            ESP_LOGW(TAG, "Error en la petición HTTP: %s", esp_err_to_name(err));
+            return err;
+        }
+
+        *status = esp_http_client_get_status_code(s->client);
+        bool redirect = *status == 301 || *status == 302 || *status == 303 ||
+                        *status == 307 || *status == 308;
+        if (!redirect || redirects++ == SESSION_MAX_REDIRECTS) {
+            return ESP_OK;
+        }
+
+        // Releases de GitHub: redirección a una URL firmada de otro host
+        esp_http_client_flush_response(s->client, NULL);
+        esp_http_client_set_redirection(s->client);
+        if (on_header) on_header(ctx, NULL, NULL);
+    }
+}
+
+int ota_http_session_read(ota_http_session_t *s, char *buf, int len)
+{
+    return esp_http_client_read(s->client, buf, len);
+}
+
+bool ota_http_session_complete(ota_http_session_t *s)
+{
+    return esp_http_client_is_complete_data_received(s->client);
+}
+
+void ota_http_session_end(ota_http_session_t *s)
+{
+    if (!s->client) {
+        memset(s->keys, 0, sizeof(s->keys));
+        return;
+    }
+
+    // Con cuerpo pendiente la conexión no sirve para la siguiente petición
+    if (!esp_http_client_is_complete_data_received(s->client)) {
+        esp_http_client_close(s->client);
+        s->connected = false;
+    }
+
+    for (int i = 0; i < SESSION_MAX_HEADERS; i++) {
+        if (s->keys[i][0]) {
+            esp_http_client_delete_header(s->client, s->keys[i]);
+            s->keys[i][0] = '\0';
+        }
+    }
+    s->on_header = NULL;
+    s->ctx = NULL;
+}
+
+void ota_http_session_counts(const ota_http_session_t *s, uint32_t *connections, uint32_t *requests)
+{
+    if (connections) *connections = s->connections;
+    if (requests) *requests = s->requests;
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Sesión HTTP(S) persistente para la OTA.
+ *
+ * Un solo esp_http_client para todas las peticiones de una comprobación
+ * (manifest, imagen y reintentos): mientras el servidor no cierre, la
+ * conexión TLS abierta se reutiliza (HTTP/1.1 keep-alive) y solo se conecta
+ * de nuevo al cambiar de host, p. ej. tras una redirección. Con
+ * CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS la reconexión al mismo host reanuda
+ * la sesión TLS guardada en lugar de hacer el handshake completo.
+ */
+
+typedef struct ota_http_session ota_http_session_t;
+
+/**
+ * @brief Cabecera de la respuesta en curso
+ *
+ * key == NULL: empieza otra respuesta (tras una redirección) y las
+ * cabeceras recibidas hasta ahora ya no valen.
+ */
+typedef void (*ota_http_header_cb_t)(void *ctx, const char *key, const char *value);
+
+/**
+ * @brief Configuración de la sesión
+ */
+typedef struct {
+    int timeout_ms;                                 // Timeout de esp_http_client por operación
+    esp_err_t (*crt_bundle_attach)(void *conf);     // esp_crt_bundle_attach para HTTPS
+} ota_http_session_config_t;
+
+#define OTA_HTTP_SESSION_CONFIG_DEFAULT() {  \
+    .timeout_ms = 15000,                     \
+    .crt_bundle_attach = NULL,               \
+}
+
+/**
+ * @brief Crear una sesión (el cliente se crea con la primera petición)
+ * @param cfg Configuración; NULL para OTA_HTTP_SESSION_CONFIG_DEFAULT()
+ * @return NULL sin memoria
+ */
+ota_http_session_t *ota_http_session_create(const ota_http_session_config_t *cfg);
+
+/**
+ * @brief Cerrar la conexión y liberar la sesión
+ */
+void ota_http_session_destroy(ota_http_session_t *s);
+
+/**
+ * @brief Cabecera de petición solo para la siguiente ota_http_session_open
+ */
+esp_err_t ota_http_session_set_header(ota_http_session_t *s, const char *key, const char *value);
+
+/**
+ * @brief GET de url por la conexión abierta (o una nueva), siguiendo redirecciones
+ *
+ * Si la conexión reutilizada resulta estar cerrada por el servidor se
+ * reintenta una vez con una nueva.
+ *
+ * @param on_header Cabeceras de la respuesta (NULL: no interesan)
+ * @param status Código HTTP de la respuesta final
+ * @param content_length Content-Length (0 si no viene)
+ * @return ESP_OK con las cabeceras leídas; ESP_FAIL si no hay respuesta
+ */
+esp_err_t ota_http_session_open(ota_http_session_t *s, const char *url,
+                                ota_http_header_cb_t on_header, void *ctx,
+                                int *status, int64_t *content_length);
+
+/**
+ * @brief Leer del cuerpo de la respuesta (como esp_http_client_read)
+ * @return Bytes leídos, 0 al final o si se cerró la conexión, < 0 en error
+ */
+int ota_http_session_read(ota_http_session_t *s, char *buf, int len);
+
+/**
+ * @brief Se ha recibido el cuerpo entero
+ */
+bool ota_http_session_complete(ota_http_session_t *s);
+
+/**
+ * @brief Terminar la petición
+ *
+ * Con el cuerpo leído entero la conexión queda abierta para la siguiente;
+ * si no (corte, error o respuesta que no interesa) se cierra.
+ */
+void ota_http_session_end(ota_http_session_t *s);
+
+/**
+ * @brief Conexiones abiertas por la sesión y peticiones hechas (para logs)
+ */
+void ota_http_session_counts(const ota_http_session_t *s, uint32_t *connections, uint32_t *requests);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,240 @@
+#include <string.h>
+#include <inttypes.h>
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_ota_ops.h"
+#include "esp_app_desc.h"
+#include "esp_timer.h"
+#include "esp_system.h"
+#include "esp_wifi.h"
+#include "nvs.h"
+#include "ota_health.h"
+
+#define TAG "ota_health"
+
+#define HEALTH_NVS_NAMESPACE "ota_health"
+#define HEALTH_NVS_KEY "last"
+#define WIFI_POLL_MS 100
+
+static ota_health_result_t s_result;    // Prueba en curso
+static int64_t s_start_us;
+static esp_timer_handle_t s_deadline;
+
+static void result_store(const ota_health_result_t *res)
+{
+    nvs_handle_t nvs;
+    if (nvs_open(HEALTH_NVS_NAMESPACE, NVS_READWRITE, &nvs) != ESP_OK) {
+        ESP_LOGW(TAG, "No se pudo abrir NVS para el resultado");
+        return;
+    }
+
+    if (nvs_set_blob(nvs, HEALTH_NVS_KEY, res, sizeof(*res)) == ESP_OK) {
+        nvs_commit(nvs);
+    }
+    nvs_close(nvs);
+}
+
+esp_err_t ota_health_get_last(ota_health_result_t *out)
+{
+    if (!out) return ESP_ERR_INVALID_ARG;
+
+    nvs_handle_t nvs;
+    esp_err_t err = nvs_open(HEALTH_NVS_NAMESPACE, NVS_READONLY, &nvs);
+    if (err != ESP_OK) return err;
+
+    size_t len = sizeof(*out);
+    err = nvs_get_blob(nvs, HEALTH_NVS_KEY, out, &len);
+    nvs_close(nvs);
+
+    if (err == ESP_OK && len != sizeof(*out)) {
+        err = ESP_ERR_INVALID_SIZE;
+    }
+    return err;
+}
+
+const char *ota_health_status_str(ota_health_status_t status)
+{
+    switch (status) {
+    case OTA_HEALTH_NONE: return "sin pruebas";
+    case OTA_HEALTH_PENDING: return "en curso";
+    case OTA_HEALTH_PASSED: return "válida";
+    case OTA_HEALTH_FAILED: return "prueba fallida";
+    case OTA_HEALTH_TIMEOUT: return "plazo agotado";
+    case OTA_HEALTH_CRASHED: return "reinicio durante la prueba";
+    }
+    return "?";
+}
+
+/**
+ * @brief Cerrar la prueba en curso y guardarla
+ */
+static void result_finish(ota_health_status_t status, const char *check, esp_err_t err)
+{
+    s_result.status = status;
+    strncpy(s_result.failed_check, check ? check : "", sizeof(s_result.failed_check) - 1);
+    s_result.error = err;
+    s_result.elapsed_ms = (esp_timer_get_time() - s_start_us) / 1000;
+    s_result.free_heap = esp_get_free_heap_size();
+    result_store(&s_result);
+}
+
+/**
+ * @brief Marcar la imagen inválida y reiniciar en la anterior
+ *
+ * Solo vuelve si no hay otra imagen válida a la que volver.
+ */
+static esp_err_t rollback(void)
+{
+    esp_err_t err = esp_ota_mark_app_invalid_rollback_and_reboot();
+    ESP_LOGE(TAG, "No se pudo volver a la imagen anterior: %s", esp_err_to_name(err));
+    return err;
+}
+
+/**
+ * @brief Plazo agotado (task de esp_timer): una prueba colgada no debe dejar
+ * la imagen sin decidir
+ */
+static void deadline_cb(void *arg)
+{
+    ESP_LOGE(TAG, "Plazo agotado sin terminar las pruebas: volviendo a la imagen anterior");
+    result_finish(OTA_HEALTH_TIMEOUT, "plazo", ESP_ERR_TIMEOUT);
+    rollback();
+}
+
+/**
+ * @brief Informar del resultado de la última imagen probada
+ *
+ * Si esa imagen no es la que corre y no había pasado, el bootloader (o
+ * rollback()) volvió a la anterior: se anota en el registro.
+ */
+static void report_last(const esp_partition_t *running)
+{
+    ota_health_result_t last;
+    if (ota_health_get_last(&last) != ESP_OK) return;
+
+    if (last.status != OTA_HEALTH_PASSED && !last.rolled_back &&
+        strncmp(last.partition, running->label, sizeof(last.partition)) != 0) {
+        if (last.status == OTA_HEALTH_PENDING) {
+            last.status = OTA_HEALTH_CRASHED;
+        }
+        last.rolled_back = true;
+        result_store(&last);
+    }
+
+    if (last.status == OTA_HEALTH_PASSED) {
+        ESP_LOGI(TAG, "Última imagen probada: %.32s (%.16s) válida en %" PRIu32 " ms, heap libre %" PRIu32,
+                 last.version, last.partition, last.elapsed_ms, last.free_heap);
+    } else {
+        ESP_LOGW(TAG, "Última imagen probada: %.32s (%.16s) %s%s%.16s (%s) tras %" PRIu32 " ms%s",
+                 last.version, last.partition, ota_health_status_str(last.status),
+                 last.failed_check[0] ? ": " : "", last.failed_check, esp_err_to_name(last.error),
+                 last.elapsed_ms, last.rolled_back ? ", se volvió a la anterior" : "");
+    }
+}
+
+esp_err_t ota_health_run(const ota_health_config_t *cfg)
+{
+    if (!cfg || (cfg->num_checks && !cfg->checks)) return ESP_ERR_INVALID_ARG;
+
+    const esp_partition_t *running = esp_ota_get_running_partition();
+    report_last(running);
+
+    esp_ota_img_states_t state;
+    if (esp_ota_get_state_partition(running, &state) != ESP_OK || state != ESP_OTA_IMG_PENDING_VERIFY) {
+#ifndef CONFIG_BOOTLOADER_APP_ROLLBACK_ENABLE
+        ESP_LOGW(TAG, "Rollback del bootloader desactivado: las imágenes nuevas no se prueban");
+#endif
+        return ESP_OK;  // Ya validada o de fábrica
+    }
+
+    const esp_app_desc_t *desc = esp_app_get_description();
+    memset(&s_result, 0, sizeof(s_result));
+    s_result.status = OTA_HEALTH_PENDING;
+    strncpy(s_result.version, desc->version, sizeof(s_result.version) - 1);
+    strncpy(s_result.partition, running->label, sizeof(s_result.partition) - 1);
+    s_start_us = esp_timer_get_time();
+    result_store(&s_result);
+
+    ESP_LOGI(TAG, "Primer arranque de %s en %s: %u pruebas, plazo %" PRIu32 " ms",
+             s_result.version, s_result.partition, (unsigned)cfg->num_checks, cfg->deadline_ms);
+
+    const esp_timer_create_args_t timer_args = {
+        .callback = deadline_cb,
+        .name = "ota_health",
+    };
+    if (esp_timer_create(&timer_args, &s_deadline) != ESP_OK ||
+        esp_timer_start_once(s_deadline, (uint64_t)cfg->deadline_ms * 1000) != ESP_OK) {
+        ESP_LOGE(TAG, "No se pudo armar el plazo");
+        result_finish(OTA_HEALTH_FAILED, "plazo", ESP_FAIL);
+        return rollback();
+    }
+
+    const char *failed = NULL;
+    esp_err_t err = ESP_OK;
+    for (size_t i = 0; i < cfg->num_checks && !failed; i++) {
+        const ota_health_check_t *chk = &cfg->checks[i];
+        int64_t elapsed_ms = (esp_timer_get_time() - s_start_us) / 1000;
+        uint32_t remaining = elapsed_ms < cfg->deadline_ms ? cfg->deadline_ms - elapsed_ms : 0;
+
+        int64_t t0 = esp_timer_get_time();
+        err = chk->fn(chk->ctx, remaining);
+        if (err == ESP_OK) {
+            ESP_LOGI(TAG, "Prueba %s: OK (%" PRId64 " ms)", chk->name, (esp_timer_get_time() - t0) / 1000);
+        } else {
+            ESP_LOGE(TAG, "Prueba %s: %s", chk->name, esp_err_to_name(err));
+            failed = chk->name;
+        }
+    }
+
+    if (!failed && cfg->min_free_heap) {
+        uint32_t heap = esp_get_free_heap_size();
+        if (heap < cfg->min_free_heap) {
+            ESP_LOGE(TAG, "Heap libre %" PRIu32 " < %" PRIu32, heap, cfg->min_free_heap);
+            failed = "heap";
+            err = ESP_ERR_NO_MEM;
+        }
+    }
+
+    // Si el timer ya no estaba armado el plazo decidió antes (y está reiniciando)
+    if (esp_timer_stop(s_deadline) != ESP_OK) {
+        return ESP_ERR_TIMEOUT;
+    }
+    esp_timer_delete(s_deadline);
+    s_deadline = NULL;
+
+    if (failed) {
+        ESP_LOGE(TAG, "Imagen %s no válida: volviendo a la anterior", s_result.version);
+        result_finish(OTA_HEALTH_FAILED, failed, err);
+        return rollback();
+    }
+
+    err = esp_ota_mark_app_valid_cancel_rollback();
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "esp_ota_mark_app_valid_cancel_rollback falló: %s", esp_err_to_name(err));
+        result_finish(OTA_HEALTH_FAILED, "validar", err);
+        return err;
+    }
+
+    result_finish(OTA_HEALTH_PASSED, NULL, ESP_OK);
+    ESP_LOGI(TAG, "Imagen %s validada en %" PRIu32 " ms (heap libre %" PRIu32 ")",
+             s_result.version, s_result.elapsed_ms, s_result.free_heap);
+    return ESP_OK;
+}
+
+esp_err_t ota_health_check_wifi(void *ctx, uint32_t timeout_ms)
+{
+    wifi_ap_record_t ap;
+    TickType_t start = xTaskGetTickCount();
+
+    while (esp_wifi_sta_get_ap_info(&ap) != ESP_OK) {
+        if (xTaskGetTickCount() - start >= pdMS_TO_TICKS(timeout_ms)) {
+            return ESP_ERR_TIMEOUT;
+        }
+        vTaskDelay(pdMS_TO_TICKS(WIFI_POLL_MS));
+    }
+
+    ESP_LOGI(TAG, "Wi-Fi asociado a %.32s (RSSI %d)", (const char *)ap.ssid, ap.rssi);
+    return ESP_OK;
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Prueba de salud en el primer arranque de una imagen nueva.
+ *
+ * Con el rollback del bootloader activado (CONFIG_BOOTLOADER_APP_ROLLBACK_ENABLE)
+ * una imagen recién instalada arranca en ESP_OTA_IMG_PENDING_VERIFY. Si no se
+ * valida antes del siguiente reinicio el bootloader vuelve a la anterior.
+ * ota_health_run() pasa las pruebas configuradas antes de un plazo y:
+ *   - todas bien: esp_ota_mark_app_valid_cancel_rollback()
+ *   - alguna falla o se agota el plazo: esp_ota_mark_app_invalid_rollback_and_reboot()
+ * El resultado se guarda en NVS y se informa en el siguiente arranque.
+ */
+
+// Plazo para todas las pruebas, desde la llamada a ota_health_run()
+#ifndef OTA_HEALTH_DEADLINE_MS
+#define OTA_HEALTH_DEADLINE_MS 60000
+#endif
+
+// Heap libre mínimo tras las pruebas (con Wi-Fi y sensores ya arrancados)
+#ifndef OTA_HEALTH_MIN_FREE_HEAP
+#define OTA_HEALTH_MIN_FREE_HEAP (40 * 1024)
+#endif
+
+/**
+ * @brief Una prueba: devuelve ESP_OK si pasa
+ * @param ctx Contexto de la prueba (ota_health_check_t.ctx)
+ * @param timeout_ms Tiempo que queda hasta el plazo
+ */
+typedef esp_err_t (*ota_health_check_fn_t)(void *ctx, uint32_t timeout_ms);
+
+typedef struct {
+    const char *name;               // Para los logs y el registro en NVS (se guardan 15 caracteres)
+    ota_health_check_fn_t fn;
+    void *ctx;
+} ota_health_check_t;
+
+/**
+ * @brief Configuración de la prueba de salud
+ */
+typedef struct {
+    const ota_health_check_t *checks;   // Se ejecutan en orden; la primera que falla decide
+    size_t num_checks;
+    uint32_t deadline_ms;               // Plazo total; al agotarse se vuelve a la imagen anterior
+    uint32_t min_free_heap;             // 0: no comprobar el heap
+} ota_health_config_t;
+
+#define OTA_HEALTH_CONFIG_DEFAULT() {               \
+    .checks = NULL,                                 \
+    .num_checks = 0,                                \
+    .deadline_ms = OTA_HEALTH_DEADLINE_MS,          \
+    .min_free_heap = OTA_HEALTH_MIN_FREE_HEAP,      \
+}
+
+typedef enum {
+    OTA_HEALTH_NONE = 0,            // Nunca se ha probado una imagen
+    OTA_HEALTH_PENDING,             // Prueba en curso (si se lee al arrancar: se reinició durante la prueba)
+    OTA_HEALTH_PASSED,              // Imagen validada
+    OTA_HEALTH_FAILED,              // Una prueba falló: vuelta a la imagen anterior
+    OTA_HEALTH_TIMEOUT,             // Plazo agotado: vuelta a la imagen anterior
+    OTA_HEALTH_CRASHED,             // Reinicio durante la prueba: el bootloader volvió a la imagen anterior
+} ota_health_status_t;
+
+/**
+ * @brief Resultado de la última imagen probada (se guarda en NVS)
+ */
+typedef struct {
+    uint8_t status;                 // ota_health_status_t
+    bool rolled_back;               // Confirmado al arrancar de nuevo la imagen anterior
+    char version[32];               // esp_app_desc_t.version de la imagen probada
+    char partition[16];             // Partición de la imagen probada
+    char failed_check[16];          // Prueba que falló ("heap", "plazo" o ota_health_check_t.name)
+    int32_t error;                  // esp_err_t de la prueba que falló
+    uint32_t elapsed_ms;            // Duración de la prueba
+    uint32_t free_heap;             // Heap libre al terminar
+} ota_health_result_t;
+
+/**
+ * @brief Prueba de salud en el arranque (llamar al inicio, tras nvs_flash_init)
+ *
+ * Si la imagen en ejecución no está pendiente de verificar solo informa del
+ * resultado anterior. Si está pendiente y alguna prueba falla no vuelve:
+ * reinicia en la imagen anterior.
+ * @param cfg Pruebas, plazo y heap mínimo
+ * @return ESP_OK si la imagen es válida, error si no se pudo volver a la anterior
+ */
+esp_err_t ota_health_run(const ota_health_config_t *cfg);
+
+/**
+ * @brief Resultado de la última imagen probada
+ * @param out Destination structure
+ * @return ESP_OK on success, ESP_ERR_NVS_NOT_FOUND si nunca se probó una imagen
+ */
+esp_err_t ota_health_get_last(ota_health_result_t *out);
+
+/**
+ * @brief Texto del estado para los logs
+ */
+const char *ota_health_status_str(ota_health_status_t status);
+
+/**
+ * @brief Prueba: la estación Wi-Fi se asocia a un AP (ctx sin usar)
+ *
+ * La app debe haber llamado a esp_wifi_start()/esp_wifi_connect().
+ */
+esp_err_t ota_health_check_wifi(void *ctx, uint32_t timeout_ms);
+
+#ifdef __cplusplus
+}
+#endif
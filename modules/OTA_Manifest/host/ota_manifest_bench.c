@@ -0,0 +1,373 @@
+/*
+ * Benchmark en el host de la lectura del manifest: ota_manifest (a trozos,
+ * memoria fija) frente a cJSON (manifest entero en un buffer y árbol).
+ *
+ * Compila ota_json.c, ota_manifest.c, ota_version.c y ota_release.c tal
+ * cual. Con -DOTA_BENCH_CJSON y el cJSON.c de ESP-IDF
+ * ($IDF_PATH/components/json/cJSON) mide también cJSON con un malloc que
+ * cuenta reservas y el pico de heap; sin él, solo ota_manifest.
+ *
+ * Antes de medir comprueba cada manifest: la versión elegida es la
+ * esperada y el resultado no cambia al trocear la entrada en cualquier
+ * punto (de byte en byte). También pasa una tabla de documentos no válidos.
+ *
+ * Uso: ota_manifest_bench [-n repeticiones]   (desde modules/OTA_Manifest/host)
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <unistd.h>
+#include <time.h>
+#include "ota_json.h"
+#include "ota_manifest.h"
+#ifdef OTA_BENCH_CJSON
+#include "cJSON.h"
+#endif
+
+#define BENCH_CHUNK 256             // Como MANIFEST_CHUNK en ota_update.c
+#define BENCH_CHANNEL "beta"
+#define BENCH_MODEL "esp32"
+#define BENCH_MAX_SIZE (64 * 1024)
+
+typedef struct {
+    const char *name;
+    char *json;
+    size_t len;
+    const char *expect_version;     // Versión elegida para beta@esp32
+    const char *expect_url;
+} manifest_case_t;
+
+static double now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+/* ---------- Manifests de prueba ---------- */
+
+static void append(char *buf, size_t *len, const char *fmt, ...) __attribute__((format(printf, 3, 4)));
+
+static void append(char *buf, size_t *len, const char *fmt, ...)
+{
+    va_list ap;
+    va_start(ap, fmt);
+    *len += vsnprintf(buf + *len, BENCH_MAX_SIZE - *len, fmt, ap);
+    va_end(ap);
+}
+
+// Notas de versión de n bytes, con escapes y caracteres no ASCII
+static void notes(char *buf, size_t *len, size_t n)
+{
+    static const char *phrases[] = {
+        "Corrige la reconexi\\u00f3n Wi-Fi tras un corte. ",
+        "Lectura del BME68x cada 5 s en lugar de 1 s. ",
+        "Nuevo canal \\\"beta\\\" para pruebas de campo.\\n",
+        "Descarga reanudable con Range e If-Range. ",
+        "Sensor CCS811: calibración de línea base \\u2192 NVS. ",
+    };
+    append(buf, len, "\"");
+    for (size_t start = *len, i = 0; *len - start < n; i++) {
+        append(buf, len, "%s", phrases[i % 5]);
+    }
+    append(buf, len, "\"");
+}
+
+static void release(char *buf, size_t *len, const char *version, const char *file, bool full, size_t notes_len)
+{
+    append(buf, len,
+           "{\"version\": \"%s\", \"url\": \"https://raw.githubusercontent.com/David-lopruiz/SBCG06-OTA/main/"
+           "Versions/%s/%s\"",
+           version, version, file);
+    if (full) {
+        append(buf, len,
+               ", \"size\": 996752, \"compression\": \"deflate\", "
+               "\"sha256\": \"9f86d081884c7d659a2feaa0c55ad015a3bf4f1b2b0b822cd15d6c15b0f00a08\", "
+               "\"min_version\": \"0.1\", \"rollout\": 25.5, "
+               "\"delta\": {\"from\": \"0.2\", \"url\": \"https://raw.githubusercontent.com/David-lopruiz/"
+               "SBCG06-OTA/main/Versions/%s/delta-0.2.bin\", \"compression\": \"deflate\"}",
+               version);
+    }
+    if (notes_len) {
+        append(buf, len, ", \"notes\": ");
+        notes(buf, len, notes_len);
+        append(buf, len, ", \"changes\": [\"a\", {\"version\": \"x\"}, [1, 2.5e3, -0.5, true, null]]");
+    }
+    append(buf, len, "}");
+}
+
+static manifest_case_t make_case(const char *name, int kind)
+{
+    char *buf = malloc(BENCH_MAX_SIZE);
+    size_t len = 0;
+    manifest_case_t c = { name, buf, 0, NULL, NULL };
+
+    switch (kind) {
+    case 0:
+        // Versions/latest.json tal cual
+        append(buf, &len,
+               "{\n  \"version\": \"0.1\",\n  \"url\": \"https://raw.githubusercontent.com/David-lopruiz/"
+               "SBCG06-OTA/main/Versions/0.2/i2c_oled.bin\",\n  \"notes\": \"Versi\\u00f3n inicial\"\n}\n");
+        c.expect_version = "0.1";
+        c.expect_url = "https://raw.githubusercontent.com/David-lopruiz/SBCG06-OTA/main/Versions/0.2/i2c_oled.bin";
+        break;
+    case 1:
+        // Una versión con todos los campos (pack_ota.py, delta, despliegue)
+        release(buf, &len, "0.3", "OTA.bin", true, 200);
+        c.expect_version = "0.3";
+        c.expect_url = "https://raw.githubusercontent.com/David-lopruiz/SBCG06-OTA/main/Versions/0.3/OTA.bin";
+        break;
+    default: {
+        // Canales y modelos: kind modelos por canal, notas más largas con más modelos
+        int models = kind;
+        static const char *channels[] = { "stable", "beta", "nightly" };
+        static const char *targets[] = { "esp32s3", "esp32c3", "esp32c6", "esp32h2", "esp32", "esp32s2" };
+        size_t notes_len = kind > 3 ? 1500 : 400;
+        append(buf, &len, "{\"version\": \"0.3\", \"url\": \"https://raw.githubusercontent.com/David-lopruiz/"
+                          "SBCG06-OTA/main/Versions/0.3/OTA.bin\", \"notes\": ");
+        notes(buf, &len, notes_len);
+        append(buf, &len, ", \"channels\": {");
+        bool first = true;
+        for (int ch = 0; ch < 3; ch++) {
+            for (int m = 0; m < models && m < 6; m++) {
+                char key[48], version[32];
+                snprintf(key, sizeof(key), "%s@%s", channels[ch], targets[m]);
+                if (ch == 0) {
+                    snprintf(version, sizeof(version), "0.3.%d", m);
+                } else {
+                    snprintf(version, sizeof(version), "0.4.0-%s.%d", channels[ch], m);
+                }
+                append(buf, &len, "%s\"%s\": ", first ? "" : ", ", key);
+                release(buf, &len, version, "OTA.bin", true, notes_len);
+                first = false;
+            }
+            append(buf, &len, ", \"%s\": ", channels[ch]);
+            release(buf, &len, ch == 0 ? "0.3" : ch == 1 ? "0.4.0-beta.1" : "0.4.0-nightly.1", "OTA.bin", true,
+                    notes_len);
+        }
+        append(buf, &len, "}}");
+        // beta@esp32 existe si hay 5 o más modelos; si no, la entrada "beta"
+        c.expect_version = models >= 5 ? "0.4.0-beta.4" : "0.4.0-beta.1";
+        c.expect_url = models >= 5 ? "https://raw.githubusercontent.com/David-lopruiz/SBCG06-OTA/main/Versions/"
+                                     "0.4.0-beta.4/OTA.bin"
+                                   : "https://raw.githubusercontent.com/David-lopruiz/SBCG06-OTA/main/Versions/"
+                                     "0.4.0-beta.1/OTA.bin";
+        break;
+    }
+    }
+
+    c.len = len;
+    return c;
+}
+
+/* ---------- ota_manifest ---------- */
+
+static const ota_manifest_release_t *stream_parse(ota_manifest_parser_t *p, const char *json, size_t len,
+                                                  size_t chunk)
+{
+    ota_manifest_parser_init(p, BENCH_CHANNEL, BENCH_MODEL);
+    for (size_t off = 0; off < len; off += chunk) {
+        size_t n = len - off < chunk ? len - off : chunk;
+        if (ota_manifest_parser_feed(p, json + off, n) != ESP_OK) return NULL;
+    }
+    if (ota_manifest_parser_finish(p) != ESP_OK) return NULL;
+    return ota_manifest_select(p);
+}
+
+static bool check_case(const manifest_case_t *c)
+{
+    ota_manifest_parser_t ref, p;
+    const ota_manifest_release_t *r = stream_parse(&ref, c->json, c->len, c->len);
+    if (!r || strcmp(r->version, c->expect_version) != 0 || strcmp(r->url, c->expect_url) != 0) {
+        printf("%-28s versión elegida %s, esperada %s   FALLO\n", c->name, r ? r->version : "(ninguna)",
+               c->expect_version);
+        return false;
+    }
+
+    // Mismo resultado con cualquier troceo
+    static const size_t chunks[] = { 1, 2, 3, 7, 64, 255, 256, 1000 };
+    for (size_t i = 0; i < sizeof(chunks) / sizeof(chunks[0]); i++) {
+        const ota_manifest_release_t *q = stream_parse(&p, c->json, c->len, chunks[i]);
+        if (!q || memcmp(q, r, sizeof(*r)) != 0) {
+            printf("%-28s troceo de %zu bytes da otro resultado   FALLO\n", c->name, chunks[i]);
+            return false;
+        }
+    }
+    return true;
+}
+
+/* ---------- JSON no válido ---------- */
+
+static const char *s_invalid[] = {
+    "", "{", "{\"a\"}", "{\"a\":}", "{\"a\":1,}", "[1,]", "{\"a\":01}", "{\"a\":1.}", "{\"a\":-}",
+    "{\"a\":tru}", "{\"a\":\"\\x\"}", "{\"a\":\"\\u12G4\"}", "{\"a\":\"\n\"}", "{} {}", "{]", "[}",
+    "{\"a\" 1}", "{\"a\":1 \"b\":2}", "\"solo texto\"", "[{\"version\":\"0.1\",\"url\":\"x\"}]",
+};
+
+#define NUM_INVALID (sizeof(s_invalid) / sizeof(s_invalid[0]))
+
+static bool check_invalid(void)
+{
+    bool ok = true;
+    ota_manifest_parser_t p;
+    for (size_t i = 0; i < NUM_INVALID; i++) {
+        if (stream_parse(&p, s_invalid[i], strlen(s_invalid[i]), 1) != NULL || p.err == ESP_OK) {
+            printf("Aceptado y no es un manifest válido: '%s'   FALLO\n", s_invalid[i]);
+            ok = false;
+        }
+    }
+
+    // Escapes: "\u00e9" y un par surrogate a UTF-8
+    ota_json_t j;
+    ota_json_init(&j);
+    const char *doc = "[\"\\u00e9\\ud83d\\ude00\\/\\n\"]";
+    size_t len = strlen(doc);
+    ota_json_token_t tok;
+    while ((tok = ota_json_next(&j, &doc, &len)) != OTA_JSON_STRING && tok != OTA_JSON_NEED_MORE) {}
+    if (tok != OTA_JSON_STRING || strcmp(j.value, "\xc3\xa9\xf0\x9f\x98\x80/\n") != 0) {
+        printf("Escapes mal resueltos   FALLO\n");
+        ok = false;
+    }
+
+    // Anidamiento por encima de OTA_JSON_MAX_DEPTH
+    char deep[2 * OTA_JSON_MAX_DEPTH + 8];
+    size_t n = 0;
+    for (int i = 0; i <= OTA_JSON_MAX_DEPTH; i++) deep[n++] = '[';
+    if (stream_parse(&p, deep, n, 1) != NULL || p.err == ESP_OK) {
+        printf("Anidamiento de %d niveles aceptado   FALLO\n", OTA_JSON_MAX_DEPTH + 1);
+        ok = false;
+    }
+    return ok;
+}
+
+/* ---------- cJSON ---------- */
+
+#ifdef OTA_BENCH_CJSON
+static size_t s_heap;
+static size_t s_heap_peak;
+static size_t s_allocs;
+
+static void *count_malloc(size_t size)
+{
+    size_t *block = malloc(size + sizeof(size_t));
+    if (!block) return NULL;
+    *block = size;
+    s_heap += size;
+    if (s_heap > s_heap_peak) s_heap_peak = s_heap;
+    s_allocs++;
+    return block + 1;
+}
+
+static void count_free(void *ptr)
+{
+    if (!ptr) return;
+    size_t *block = (size_t *)ptr - 1;
+    s_heap -= *block;
+    free(block);
+}
+
+// Lo mismo que hacía ota_update.c: buffer con el manifest entero, árbol y campos
+static bool cjson_parse(const char *json, size_t len, char *buf)
+{
+    memcpy(buf, json, len);
+    buf[len] = '\0';
+
+    cJSON *root = cJSON_Parse(buf);
+    if (!root) return false;
+
+    const cJSON *rel = root;
+    const cJSON *channels = cJSON_GetObjectItem(root, "channels");
+    if (cJSON_IsObject(channels)) {
+        const cJSON *entry = cJSON_GetObjectItem(channels, BENCH_CHANNEL "@" BENCH_MODEL);
+        if (!cJSON_IsObject(entry)) entry = cJSON_GetObjectItem(channels, BENCH_CHANNEL);
+        if (cJSON_IsObject(entry)) rel = entry;
+    }
+    const cJSON *ver = cJSON_GetObjectItem(rel, "version");
+    const cJSON *url = cJSON_GetObjectItem(rel, "url");
+    bool ok = cJSON_IsString(ver) && cJSON_IsString(url);
+    cJSON_Delete(root);
+    return ok;
+}
+#endif
+
+/* ---------- Benchmark ---------- */
+
+static void bench(const manifest_case_t *c, int reps)
+{
+    ota_manifest_parser_t p;
+    double t0 = now_us();
+    for (int i = 0; i < reps; i++) {
+        if (!stream_parse(&p, c->json, c->len, BENCH_CHUNK)) abort();
+    }
+    double stream_us = (now_us() - t0) / reps;
+
+    printf("%-28s %7zu %10.1f %8.1f %10zu %6d", c->name, c->len, stream_us, c->len / stream_us,
+           sizeof(ota_manifest_parser_t) + BENCH_CHUNK, 0);
+
+#ifdef OTA_BENCH_CJSON
+    char *buf = malloc(c->len + 1);
+    s_heap_peak = s_allocs = 0;
+    if (!cjson_parse(c->json, c->len, buf)) abort();
+    size_t peak = s_heap_peak, allocs = s_allocs;
+
+    t0 = now_us();
+    for (int i = 0; i < reps; i++) cjson_parse(c->json, c->len, buf);
+    double cjson_us = (now_us() - t0) / reps;
+    free(buf);
+
+    printf(" | %10.1f %8.1f %10zu %6zu", cjson_us, c->len / cjson_us, peak + c->len + 1, allocs);
+#endif
+    printf("\n");
+}
+
+int main(int argc, char **argv)
+{
+    int reps = 2000;
+    int opt;
+    while ((opt = getopt(argc, argv, "n:")) != -1) {
+        if (opt == 'n') {
+            reps = atoi(argv[optind - 1]);
+        } else {
+            fprintf(stderr, "Uso: %s [-n repeticiones]\n", argv[0]);
+            return 2;
+        }
+    }
+
+#ifdef OTA_BENCH_CJSON
+    cJSON_Hooks hooks = { count_malloc, count_free };
+    cJSON_InitHooks(&hooks);
+#endif
+
+    manifest_case_t cases[] = {
+        make_case("latest.json actual", 0),
+        make_case("versión completa", 1),
+        make_case("3 canales x 2 modelos", 2),
+        make_case("3 canales x 6 modelos", 6),
+    };
+    size_t num = sizeof(cases) / sizeof(cases[0]);
+
+    bool ok = check_invalid();
+    for (size_t i = 0; i < num; i++) ok &= check_case(&cases[i]);
+    if (!ok) return 1;
+    printf("Comprobaciones OK (troceos de 1 a 1000 bytes, %zu documentos no válidos)\n\n", NUM_INVALID);
+
+    printf("%-36s %-37s", "", "ota_manifest (trozos de 256 B)");
+#ifdef OTA_BENCH_CJSON
+    printf(" | cJSON (buffer + árbol)");
+#endif
+    printf("\n%-28s %7s %10s %8s %10s %6s", "Manifest", "Bytes", "us", "MB/s", "Memoria", "Malloc");
+#ifdef OTA_BENCH_CJSON
+    printf(" | %10s %8s %10s %6s", "us", "MB/s", "Memoria", "Malloc");
+#endif
+    printf("\n");
+
+    for (size_t i = 0; i < num; i++) {
+        bench(&cases[i], reps);
+        free(cases[i].json);
+    }
+
+    printf("\nMemoria: ota_manifest_parser_t + trozo de lectura (fija); cJSON: buffer del manifest + pico de heap "
+           "del árbol.\n");
+    return 0;
+}
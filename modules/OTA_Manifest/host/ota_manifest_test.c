@@ -0,0 +1,279 @@
+/*
+ * Pruebas en el host de la comparación de versiones (ota_version.c) y del
+ * despliegue gradual (ota_release.c).
+ *
+ * Compila los dos ficheros tal cual contra el esp_err.h de
+ * OTA_Protocol/host/stubs. Termina con código 0 si todas las pruebas pasan.
+ *
+ * Uso: ota_manifest_test [-v]   (desde modules/OTA_Manifest/host)
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <math.h>
+#include "ota_version.h"
+#include "ota_release.h"
+
+#define TEST_DEVICES 100000
+#define TEST_TOLERANCE 0.01         // Desviación admitida en la fracción de dispositivos
+
+static bool s_verbose;
+static int s_failed;
+static int s_total;
+
+static void check(bool ok, const char *fmt, const char *a, const char *b)
+{
+    s_total++;
+    if (!ok) s_failed++;
+    if (!ok || s_verbose) {
+        printf("  %-5s ", ok ? "OK" : "FALLO");
+        printf(fmt, a, b);
+        printf("\n");
+    }
+}
+
+static int sign(int x)
+{
+    return (x > 0) - (x < 0);
+}
+
+/* ---------- Versiones ---------- */
+
+static const char *s_valid[] = {
+    "0.1", "0.2", "1", "v1.2.3", "V2.0", "1.0.0-alpha", "1.0.0-alpha.1", "1.0.0-0.3.7",
+    "1.0.0-x.7.z.92", "1.0.0-x-y-z.--", "1.0.0+20130313144700", "1.0.0-beta+exp.sha.5114f85",
+    "1.0.0+001", "4294967295.0.0",
+};
+
+static const char *s_invalid[] = {
+    "", "x", "1.", "1..2", ".1", "01.2", "1.02", "1.2.3.4", "1.0.0-", "1.0.0-01", "1.0.0-a..b",
+    "1.0.0+", "1.0.0+a..b", "1.0.0-a_b", "4294967296", "1.0 ", " 1.0", "1.0.0-beta.1234567890123456789",
+};
+
+typedef struct {
+    const char *a;
+    const char *b;
+    int expect;                     // Signo de la comparación
+} compare_case_t;
+
+static const compare_case_t s_compare[] = {
+    { "0.1",            "0.1.0",            0 },
+    { "0.1",            "0.2",             -1 },
+    { "0.10",           "0.9",              1 },     // strcmp diría lo contrario
+    { "1.0.0",          "v1.0.0",           0 },
+    { "1.0.0+build.1",  "1.0.0+build.2",    0 },
+    { "2.0.0",          "10.0.0",          -1 },
+    { "1.0.0-beta.2",   "1.0.0-beta.11",   -1 },     // Numéricos por valor
+    { "1.0.0-beta.11",  "1.0.0-beta.2b",   -1 },     // Numérico antes que alfanumérico
+    { "1.0.0-rc.1",     "1.0.0",           -1 },
+    { "1.0.0-rc.1",     "0.9.9",            1 },
+    { "1.0.0-Alpha",    "1.0.0-alpha",     -1 },     // ASCII: mayúsculas antes
+};
+
+// Ejemplo de precedencia de semver 2.0, de menor a mayor
+static const char *s_chain[] = {
+    "1.0.0-alpha", "1.0.0-alpha.1", "1.0.0-alpha.beta", "1.0.0-beta", "1.0.0-beta.2",
+    "1.0.0-beta.11", "1.0.0-rc.1", "1.0.0", "1.0.1", "1.1.0", "2.0.0",
+};
+
+#define COUNT(a) (sizeof(a) / sizeof((a)[0]))
+
+static void test_versions(void)
+{
+    printf("Versiones\n");
+    int before = s_failed;
+    ota_version_t v;
+
+    for (size_t i = 0; i < COUNT(s_valid); i++) {
+        check(ota_version_parse(s_valid[i], &v) == ESP_OK, "válida    \"%s\"%s", s_valid[i], "");
+    }
+    for (size_t i = 0; i < COUNT(s_invalid); i++) {
+        check(ota_version_parse(s_invalid[i], &v) != ESP_OK, "no válida \"%s\"%s", s_invalid[i], "");
+    }
+
+    for (size_t i = 0; i < COUNT(s_compare); i++) {
+        const compare_case_t *c = &s_compare[i];
+        int ab = 99, ba = 99;
+        bool ok = ota_version_compare_str(c->a, c->b, &ab) == ESP_OK &&
+                  ota_version_compare_str(c->b, c->a, &ba) == ESP_OK &&
+                  sign(ab) == c->expect && sign(ba) == -c->expect;
+        char text[64];
+        snprintf(text, sizeof(text), "%-16s %s", c->a, c->expect < 0 ? "<" : c->expect > 0 ? ">" : "=");
+        check(ok, "%s %s", text, c->b);
+    }
+
+    // Todos los pares de la cadena: orden total, antisimétrico y transitivo
+    bool ok = true;
+    for (size_t i = 0; i < COUNT(s_chain); i++) {
+        for (size_t j = 0; j < COUNT(s_chain); j++) {
+            int r;
+            if (ota_version_compare_str(s_chain[i], s_chain[j], &r) != ESP_OK ||
+                sign(r) != (i < j ? -1 : i > j ? 1 : 0)) {
+                ok = false;
+                printf("  FALLO %s ? %s = %d\n", s_chain[i], s_chain[j], r);
+            }
+        }
+    }
+    check(ok, "cadena de precedencia de semver (%s ... %s)", s_chain[0], s_chain[COUNT(s_chain) - 1]);
+
+    printf("  %d fallos\n\n", s_failed - before);
+}
+
+/* ---------- Despliegue gradual ---------- */
+
+// MACs consecutivas del mismo fabricante, como un lote de placas
+static void device_id(int i, char out[13])
+{
+    snprintf(out, 13, "24d7eb%06x", 0x10000 + i);
+}
+
+static double rollout_fraction(const char *version, uint16_t rollout)
+{
+    int in = 0;
+    char id[13];
+    for (int i = 0; i < TEST_DEVICES; i++) {
+        device_id(i, id);
+        in += ota_rollout_includes(id, version, rollout);
+    }
+    return (double)in / TEST_DEVICES;
+}
+
+static void test_rollout(void)
+{
+    printf("Despliegue gradual (%d dispositivos)\n", TEST_DEVICES);
+    printf("  %-10s %10s %10s\n", "rollout", "esperado", "medido");
+    int before = s_failed;
+    char id[13];
+    char text[64];
+
+    static const uint16_t percents[] = { 0, 1, 50, 1000, 2500, 5000, 9000, OTA_ROLLOUT_FULL };
+    for (size_t i = 0; i < COUNT(percents); i++) {
+        double expect = percents[i] / (double)OTA_ROLLOUT_FULL;
+        double got = rollout_fraction("0.2", percents[i]);
+        printf("  %8.2f %% %9.2f%% %9.2f%%\n", percents[i] / 100.0, 100 * expect, 100 * got);
+        bool exact = percents[i] == 0 || percents[i] == OTA_ROLLOUT_FULL;
+        snprintf(text, sizeof(text), "%.2f %%", percents[i] / 100.0);
+        check(exact ? got == expect : fabs(got - expect) < TEST_TOLERANCE, "fracción al %s%s", text, "");
+    }
+
+    // Uniformidad: chi-cuadrado de las cubetas agrupadas en 100 clases
+    static int classes[100];
+    memset(classes, 0, sizeof(classes));
+    for (int i = 0; i < TEST_DEVICES; i++) {
+        device_id(i, id);
+        classes[ota_rollout_bucket(id, "0.2") / 100]++;
+    }
+    double chi2 = 0;
+    double expected = TEST_DEVICES / 100.0;
+    for (int i = 0; i < 100; i++) {
+        chi2 += (classes[i] - expected) * (classes[i] - expected) / expected;
+    }
+    // 99 grados de libertad: p = 0.001 en 148.2
+    snprintf(text, sizeof(text), "%.1f", chi2);
+    printf("  chi-cuadrado (99 g.l.): %s\n", text);
+    check(chi2 < 148.2, "cubetas uniformes (chi2 = %s)%s", text, "");
+
+    // Subir el porcentaje solo añade dispositivos
+    bool monotonic = true;
+    for (int i = 0; i < TEST_DEVICES && monotonic; i++) {
+        device_id(i, id);
+        bool prev = false;
+        for (uint16_t r = 0; r <= OTA_ROLLOUT_FULL; r += 500) {
+            bool in = ota_rollout_includes(id, "0.2", r);
+            if (prev && !in) monotonic = false;
+            prev = in;
+        }
+    }
+    check(monotonic, "un dispositivo incluido sigue incluido al subir el porcentaje%s%s", "", "");
+
+    // Cada versión elige su propio 10 %: el solape esperado es el 1 %
+    int both = 0;
+    for (int i = 0; i < TEST_DEVICES; i++) {
+        device_id(i, id);
+        both += ota_rollout_includes(id, "0.2", 1000) && ota_rollout_includes(id, "0.3", 1000);
+    }
+    double overlap = (double)both / TEST_DEVICES;
+    snprintf(text, sizeof(text), "%.2f %%", 100 * overlap);
+    printf("  solape de los 10 %% de 0.2 y 0.3: %s\n", text);
+    check(fabs(overlap - 0.01) < 0.005, "solape entre versiones (%s)%s", text, "");
+
+    // Estable: misma entrada, misma cubeta
+    check(ota_rollout_bucket("24d7eb010000", "0.2") == ota_rollout_bucket("24d7eb010000", "0.2"),
+          "cubeta estable%s%s", "", "");
+
+    printf("  %d fallos\n\n", s_failed - before);
+}
+
+/* ---------- Decisión ---------- */
+
+typedef struct {
+    const char *local;
+    ota_release_t rel;
+    ota_release_decision_t expect;
+} decide_case_t;
+
+static void test_decide(void)
+{
+    printf("Decisión\n");
+    int before = s_failed;
+
+    // Un dispositivo dentro del 10 % de 0.3 y otro fuera
+    char in_id[13] = "", out_id[13] = "";
+    char id[13];
+    for (int i = 0; i < TEST_DEVICES && (!in_id[0] || !out_id[0]); i++) {
+        device_id(i, id);
+        strcpy(ota_rollout_includes(id, "0.3", 1000) ? in_id : out_id, id);
+    }
+
+    const decide_case_t cases[] = {
+        { "0.2",   { "0.3",   NULL,  OTA_ROLLOUT_FULL, false }, OTA_RELEASE_UPDATE },
+        { "0.2",   { "0.2.0", NULL,  OTA_ROLLOUT_FULL, false }, OTA_RELEASE_UP_TO_DATE },
+        { "0.3",   { "0.2",   NULL,  OTA_ROLLOUT_FULL, false }, OTA_RELEASE_OLDER },
+        { "0.3",   { "0.2",   NULL,  OTA_ROLLOUT_FULL, true  }, OTA_RELEASE_UPDATE },
+        { "0.1",   { "0.3",   "0.2", OTA_ROLLOUT_FULL, false }, OTA_RELEASE_BELOW_MIN },
+        { "0.2",   { "0.3",   "0.2", OTA_ROLLOUT_FULL, false }, OTA_RELEASE_UPDATE },
+        { "0.0.0", { "0.1",   NULL,  OTA_ROLLOUT_FULL, false }, OTA_RELEASE_UPDATE },
+        { "???",   { "0.1",   NULL,  OTA_ROLLOUT_FULL, false }, OTA_RELEASE_UPDATE },
+        { "0.2",   { "0.3",   NULL,  0,                false }, OTA_RELEASE_NOT_IN_ROLLOUT },
+        { "0.2",   { "beta",  NULL,  OTA_ROLLOUT_FULL, false }, OTA_RELEASE_INVALID },
+        { "0.2",   { "0.3",   "x",   OTA_ROLLOUT_FULL, false }, OTA_RELEASE_INVALID },
+        { "0.3.0-beta.1", { "0.3", NULL, OTA_ROLLOUT_FULL, false }, OTA_RELEASE_UPDATE },
+    };
+
+    char text[96];
+    for (size_t i = 0; i < COUNT(cases); i++) {
+        const decide_case_t *c = &cases[i];
+        ota_release_decision_t d = ota_release_decide(&c->rel, c->local, in_id);
+        snprintf(text, sizeof(text), "%s -> %s%s%s", c->local, c->rel.version,
+                 c->rel.min_version ? " min " : "", c->rel.min_version ? c->rel.min_version : "");
+        check(d == c->expect, "%-28s %s", text, ota_release_decision_name(d));
+    }
+
+    ota_release_t staged = { "0.3", NULL, 1000, false };
+    check(ota_release_decide(&staged, "0.2", in_id) == OTA_RELEASE_UPDATE, "rollout 10 %%: %s dentro%s", in_id, "");
+    check(ota_release_decide(&staged, "0.2", out_id) == OTA_RELEASE_NOT_IN_ROLLOUT,
+          "rollout 10 %%: %s fuera%s", out_id, "");
+
+    printf("  %d fallos\n\n", s_failed - before);
+}
+
+int main(int argc, char **argv)
+{
+    int opt;
+    while ((opt = getopt(argc, argv, "v")) != -1) {
+        if (opt == 'v') {
+            s_verbose = true;
+        } else {
+            fprintf(stderr, "Uso: %s [-v]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    test_versions();
+    test_rollout();
+    test_decide();
+
+    printf("%d pruebas, %d fallos\n", s_total, s_failed);
+    return s_failed ? 1 : 0;
+}
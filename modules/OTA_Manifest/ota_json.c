@@ -0,0 +1,424 @@
+#include <string.h>
+#include "ota_json.h"
+
+// Qué puede venir a continuación (fuera de un token)
+enum {
+    EXPECT_VALUE = 0,               // Inicio, tras ':' o tras ',' en un array
+    EXPECT_VALUE_OR_ARRAY_END,      // Tras '['
+    EXPECT_KEY_OR_OBJECT_END,       // Tras '{'
+    EXPECT_KEY,                     // Tras ',' en un objeto
+    EXPECT_COLON,
+    EXPECT_COMMA_OR_END,
+    EXPECT_EOF,                     // Documento completo: solo espacios
+    EXPECT_ERROR,
+};
+
+// Token a medias
+enum {
+    LEX_NONE = 0,
+    LEX_KEY,
+    LEX_STRING,
+    LEX_NUMBER,
+    LEX_LITERAL,
+};
+
+// Estados de un número (sub con LEX_NUMBER)
+enum {
+    NUM_MINUS = 0,
+    NUM_ZERO,
+    NUM_INT,
+    NUM_DOT,
+    NUM_FRAC,
+    NUM_E,
+    NUM_E_SIGN,
+    NUM_EXP,
+};
+
+// Cadenas (sub con LEX_KEY / LEX_STRING): normal, tras '\' y 4 dígitos de \uXXXX
+#define STR_NORMAL 0
+#define STR_ESCAPE 1
+#define STR_HEX 2
+
+#define REPLACEMENT_CHAR 0xFFFD
+
+void ota_json_init(ota_json_t *j)
+{
+    memset(j, 0, sizeof(*j));
+}
+
+static void put(ota_json_t *j, char c)
+{
+    if (j->value_len < OTA_JSON_VALUE_LEN - 1) {
+        j->value[j->value_len++] = c;
+    } else {
+        j->truncated = true;
+    }
+}
+
+static void put_utf8(ota_json_t *j, uint32_t cp)
+{
+    char out[4];
+    size_t n;
+    if (cp < 0x80) {
+        out[0] = cp;
+        n = 1;
+    } else if (cp < 0x800) {
+        out[0] = 0xC0 | (cp >> 6);
+        out[1] = 0x80 | (cp & 0x3F);
+        n = 2;
+    } else if (cp < 0x10000) {
+        out[0] = 0xE0 | (cp >> 12);
+        out[1] = 0x80 | ((cp >> 6) & 0x3F);
+        out[2] = 0x80 | (cp & 0x3F);
+        n = 3;
+    } else {
+        out[0] = 0xF0 | (cp >> 18);
+        out[1] = 0x80 | ((cp >> 12) & 0x3F);
+        out[2] = 0x80 | ((cp >> 6) & 0x3F);
+        out[3] = 0x80 | (cp & 0x3F);
+        n = 4;
+    }
+
+    // Un carácter que no cabe entero no se escribe a medias
+    if (j->value_len + n > OTA_JSON_VALUE_LEN - 1) {
+        j->truncated = true;
+        return;
+    }
+    memcpy(j->value + j->value_len, out, n);
+    j->value_len += n;
+}
+
+// Surrogate alto sin el bajo detrás
+static void flush_surrogate(ota_json_t *j)
+{
+    if (j->high_surrogate) {
+        put_utf8(j, REPLACEMENT_CHAR);
+        j->high_surrogate = 0;
+    }
+}
+
+static void unicode_escape(ota_json_t *j, uint32_t cp)
+{
+    if (cp >= 0xD800 && cp <= 0xDBFF) {
+        flush_surrogate(j);
+        j->high_surrogate = cp;
+    } else if (cp >= 0xDC00 && cp <= 0xDFFF) {
+        if (j->high_surrogate) {
+            put_utf8(j, 0x10000 + ((j->high_surrogate - 0xD800) << 10) + (cp - 0xDC00));
+            j->high_surrogate = 0;
+        } else {
+            put_utf8(j, REPLACEMENT_CHAR);
+        }
+    } else {
+        flush_surrogate(j);
+        put_utf8(j, cp);
+    }
+}
+
+static ota_json_token_t fail(ota_json_t *j)
+{
+    j->expect = EXPECT_ERROR;
+    j->lex = LEX_NONE;
+    return OTA_JSON_ERROR;
+}
+
+static void start_text(ota_json_t *j, uint8_t lex, uint8_t sub)
+{
+    j->lex = lex;
+    j->sub = sub;
+    j->value_len = 0;
+    j->truncated = false;
+    j->high_surrogate = 0;
+}
+
+static void end_text(ota_json_t *j)
+{
+    j->value[j->value_len] = '\0';
+    j->lex = LEX_NONE;
+}
+
+static void value_done(ota_json_t *j)
+{
+    j->expect = j->depth ? EXPECT_COMMA_OR_END : EXPECT_EOF;
+}
+
+static bool in_object(const ota_json_t *j)
+{
+    return j->depth && (j->containers >> (j->depth - 1)) & 1;
+}
+
+static ota_json_token_t push(ota_json_t *j, bool object)
+{
+    if (j->depth == OTA_JSON_MAX_DEPTH) return fail(j);
+
+    if (object) {
+        j->containers |= 1u << j->depth;
+    } else {
+        j->containers &= ~(1u << j->depth);
+    }
+    j->depth++;
+    j->expect = object ? EXPECT_KEY_OR_OBJECT_END : EXPECT_VALUE_OR_ARRAY_END;
+    return object ? OTA_JSON_OBJECT_BEGIN : OTA_JSON_ARRAY_BEGIN;
+}
+
+static ota_json_token_t pop(ota_json_t *j, bool object)
+{
+    if (!j->depth || in_object(j) != object) return fail(j);
+
+    j->depth--;
+    value_done(j);
+    return object ? OTA_JSON_OBJECT_END : OTA_JSON_ARRAY_END;
+}
+
+/**
+ * @brief Primer carácter de un valor
+ * @return Token completo, OTA_JSON_NEED_MORE si empieza uno de texto, o error
+ */
+static ota_json_token_t begin_value(ota_json_t *j, char c)
+{
+    switch (c) {
+    case '{':
+        return push(j, true);
+    case '[':
+        return push(j, false);
+    case '"':
+        start_text(j, LEX_STRING, STR_NORMAL);
+        return OTA_JSON_NEED_MORE;
+    case 't':
+        j->literal = "true";
+        break;
+    case 'f':
+        j->literal = "false";
+        break;
+    case 'n':
+        j->literal = "null";
+        break;
+    default:
+        if (c == '-' || (c >= '0' && c <= '9')) {
+            start_text(j, LEX_NUMBER, c == '-' ? NUM_MINUS : c == '0' ? NUM_ZERO : NUM_INT);
+            put(j, c);
+            return OTA_JSON_NEED_MORE;
+        }
+        return fail(j);
+    }
+
+    j->lex = LEX_LITERAL;
+    j->sub = 1;
+    return OTA_JSON_NEED_MORE;
+}
+
+static bool number_complete(uint8_t state)
+{
+    return state == NUM_ZERO || state == NUM_INT || state == NUM_FRAC || state == NUM_EXP;
+}
+
+/**
+ * @brief Un carácter de un número
+ * @return true si forma parte del número; false si lo termina (no se consume)
+ */
+static bool number_char(ota_json_t *j, char c)
+{
+    bool digit = c >= '0' && c <= '9';
+    uint8_t next;
+
+    switch (j->sub) {
+    case NUM_MINUS:
+        if (!digit) return false;
+        next = c == '0' ? NUM_ZERO : NUM_INT;
+        break;
+    case NUM_ZERO:
+    case NUM_INT:
+        if (digit && j->sub == NUM_INT) next = NUM_INT;
+        else if (c == '.') next = NUM_DOT;
+        else if (c == 'e' || c == 'E') next = NUM_E;
+        else return false;
+        break;
+    case NUM_DOT:
+    case NUM_FRAC:
+        if (digit) next = NUM_FRAC;
+        else if ((c == 'e' || c == 'E') && j->sub == NUM_FRAC) next = NUM_E;
+        else return false;
+        break;
+    case NUM_E:
+        if (c == '+' || c == '-') next = NUM_E_SIGN;
+        else if (digit) next = NUM_EXP;
+        else return false;
+        break;
+    default:
+        if (!digit) return false;
+        next = NUM_EXP;
+        break;
+    }
+
+    j->sub = next;
+    put(j, c);
+    return true;
+}
+
+/**
+ * @brief Un carácter de una cadena o clave
+ * @return Token al cerrar la cadena, OTA_JSON_NEED_MORE o error
+ */
+static ota_json_token_t string_char(ota_json_t *j, char c)
+{
+    uint8_t u = (uint8_t)c;
+
+    if (j->sub == STR_NORMAL) {
+        if (c == '"') {
+            flush_surrogate(j);
+            bool key = j->lex == LEX_KEY;
+            end_text(j);
+            if (key) {
+                j->expect = EXPECT_COLON;
+                return OTA_JSON_KEY;
+            }
+            value_done(j);
+            return OTA_JSON_STRING;
+        }
+        if (c == '\\') {
+            j->sub = STR_ESCAPE;
+            return OTA_JSON_NEED_MORE;
+        }
+        if (u < 0x20) return fail(j);
+        flush_surrogate(j);
+        put(j, c);
+        return OTA_JSON_NEED_MORE;
+    }
+
+    if (j->sub == STR_ESCAPE) {
+        static const char escapes[] = "\"\"\\\\//b\bf\fn\nr\rt\t";
+        if (c == 'u') {
+            j->sub = STR_HEX;
+            j->unicode = 0;
+            return OTA_JSON_NEED_MORE;
+        }
+        const char *e = NULL;
+        for (size_t i = 0; i < sizeof(escapes) - 1; i += 2) {
+            if (escapes[i] == c) e = &escapes[i + 1];
+        }
+        if (!e) return fail(j);
+        flush_surrogate(j);
+        put(j, *e);
+        j->sub = STR_NORMAL;
+        return OTA_JSON_NEED_MORE;
+    }
+
+    // \uXXXX
+    uint32_t digit;
+    if (c >= '0' && c <= '9') digit = c - '0';
+    else if (c >= 'a' && c <= 'f') digit = c - 'a' + 10;
+    else if (c >= 'A' && c <= 'F') digit = c - 'A' + 10;
+    else return fail(j);
+
+    j->unicode = (j->unicode << 4) | digit;
+    if (++j->sub == STR_HEX + 4) {
+        unicode_escape(j, j->unicode);
+        j->sub = STR_NORMAL;
+    }
+    return OTA_JSON_NEED_MORE;
+}
+
+ota_json_token_t ota_json_next(ota_json_t *j, const char **data, size_t *len)
+{
+    if (j->expect == EXPECT_ERROR) return OTA_JSON_ERROR;
+
+    const char *p = *data;
+    const char *end = p + *len;
+    ota_json_token_t tok = OTA_JSON_NEED_MORE;
+
+    while (p < end && tok == OTA_JSON_NEED_MORE) {
+        char c = *p;
+
+        switch (j->lex) {
+        case LEX_KEY:
+        case LEX_STRING:
+            tok = string_char(j, c);
+            p++;
+            continue;
+
+        case LEX_NUMBER:
+            if (number_char(j, c)) {
+                p++;
+                continue;
+            }
+            // El carácter que termina el número no se consume
+            if (!number_complete(j->sub)) {
+                tok = fail(j);
+                break;
+            }
+            end_text(j);
+            value_done(j);
+            tok = OTA_JSON_NUMBER;
+            continue;
+
+        case LEX_LITERAL:
+            if (c != j->literal[j->sub]) {
+                tok = fail(j);
+                break;
+            }
+            p++;
+            if (j->literal[++j->sub] == '\0') {
+                j->lex = LEX_NONE;
+                value_done(j);
+                tok = j->literal[0] == 't' ? OTA_JSON_TRUE : j->literal[0] == 'f' ? OTA_JSON_FALSE : OTA_JSON_NULL;
+            }
+            continue;
+
+        default:
+            break;
+        }
+        if (tok == OTA_JSON_ERROR) break;
+
+        p++;
+        if (c == ' ' || c == '\t' || c == '\n' || c == '\r') continue;
+
+        switch (j->expect) {
+        case EXPECT_VALUE:
+            tok = begin_value(j, c);
+            break;
+        case EXPECT_VALUE_OR_ARRAY_END:
+            tok = c == ']' ? pop(j, false) : begin_value(j, c);
+            break;
+        case EXPECT_KEY_OR_OBJECT_END:
+        case EXPECT_KEY:
+            if (c == '"') {
+                start_text(j, LEX_KEY, STR_NORMAL);
+            } else if (c == '}' && j->expect == EXPECT_KEY_OR_OBJECT_END) {
+                tok = pop(j, true);
+            } else {
+                tok = fail(j);
+            }
+            break;
+        case EXPECT_COLON:
+            if (c == ':') j->expect = EXPECT_VALUE;
+            else tok = fail(j);
+            break;
+        case EXPECT_COMMA_OR_END:
+            if (c == ',') j->expect = in_object(j) ? EXPECT_KEY : EXPECT_VALUE;
+            else if (c == '}' || c == ']') tok = pop(j, c == '}');
+            else tok = fail(j);
+            break;
+        default:
+            tok = fail(j);
+            break;
+        }
+    }
+
+    j->offset += p - *data;
+    *len -= p - *data;
+    *data = p;
+    return tok;
+}
+
+ota_json_token_t ota_json_end(ota_json_t *j)
+{
+    if (j->lex == LEX_NUMBER && j->depth == 0 && number_complete(j->sub)) {
+        end_text(j);
+        value_done(j);
+        return OTA_JSON_NUMBER;
+    }
+    if (j->expect != EXPECT_EOF || j->lex != LEX_NONE) {
+        return fail(j);
+    }
+    return OTA_JSON_DONE;
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Tokenizador JSON incremental ("pull") con memoria fija.
+ *
+ * Recibe el documento a trozos, tal como llega de esp_http_client_read, y
+ * devuelve un token cada vez: no construye árbol ni reserva memoria. Los
+ * tokens pueden quedar partidos entre dos trozos; el estado se guarda en
+ * ota_json_t. El texto de claves, cadenas y números se guarda hasta
+ * OTA_JSON_VALUE_LEN - 1 bytes (con los escapes ya resueltos, en UTF-8);
+ * uno más largo se recorta y marca truncated.
+ */
+
+// Texto más largo de una clave o valor (con el '\0')
+#ifndef OTA_JSON_VALUE_LEN
+#define OTA_JSON_VALUE_LEN 256
+#endif
+
+// Anidamiento máximo de objetos y arrays
+#define OTA_JSON_MAX_DEPTH 32
+
+typedef enum {
+    OTA_JSON_NEED_MORE = 0,     // Trozo consumido: pasar el siguiente
+    OTA_JSON_OBJECT_BEGIN,
+    OTA_JSON_OBJECT_END,
+    OTA_JSON_ARRAY_BEGIN,
+    OTA_JSON_ARRAY_END,
+    OTA_JSON_KEY,               // Clave de un objeto en value
+    OTA_JSON_STRING,            // Cadena en value
+    OTA_JSON_NUMBER,            // Número en value, tal como viene
+    OTA_JSON_TRUE,
+    OTA_JSON_FALSE,
+    OTA_JSON_NULL,
+    OTA_JSON_DONE,              // Solo ota_json_end: documento completo
+    OTA_JSON_ERROR,             // Documento no válido; el tokenizador queda en error
+} ota_json_token_t;
+
+typedef struct {
+    char value[OTA_JSON_VALUE_LEN];
+    size_t value_len;
+    bool truncated;             // value recortado a OTA_JSON_VALUE_LEN - 1 bytes
+    uint8_t depth;              // Anidamiento tras el último token (0: fuera del documento)
+    size_t offset;              // Bytes consumidos (posición del error en OTA_JSON_ERROR)
+
+    // Estado interno
+    uint8_t expect;
+    uint8_t lex;
+    uint8_t sub;
+    uint32_t unicode;
+    uint16_t high_surrogate;
+    const char *literal;
+    uint32_t containers;        // Bit n: el nivel n + 1 es un objeto
+} ota_json_t;
+
+/**
+ * @brief Empezar un documento
+ */
+void ota_json_init(ota_json_t *j);
+
+/**
+ * @brief Siguiente token del trozo
+ *
+ * Avanza *data y *len sobre lo consumido. Con OTA_JSON_NEED_MORE el trozo
+ * se ha consumido entero; cualquier otro token puede dejar bytes por leer
+ * en *data.
+ */
+ota_json_token_t ota_json_next(ota_json_t *j, const char **data, size_t *len);
+
+/**
+ * @brief Fin de la entrada
+ * @return OTA_JSON_NUMBER si el documento era un número (quedaba pendiente),
+ *         OTA_JSON_DONE si está completo, OTA_JSON_ERROR si no
+ */
+ota_json_token_t ota_json_end(ota_json_t *j);
+
+#ifdef __cplusplus
+}
+#endif
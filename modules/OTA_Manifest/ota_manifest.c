@@ -0,0 +1,217 @@
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "ota_version.h"
+#include "ota_release.h"
+#include "ota_manifest.h"
+
+#define STABLE_CHANNEL "stable"
+
+// Qué es cada nivel abierto (context[depth]): tipo en los bits altos y entrada en los bajos
+#define CTX_SKIP 0x00                   // Objeto o array que no interesa
+#define CTX_RELEASE 0x10                // Campos de una versión
+#define CTX_DELTA 0x20                  // Objeto "delta" de una versión
+#define CTX_CHANNELS 0x30               // Objeto "channels"
+#define CTX_TYPE(c) ((c) & 0xF0)
+#define CTX_SLOT(c) ((c) & 0x0F)
+
+void ota_manifest_parser_init(ota_manifest_parser_t *p, const char *channel, const char *model)
+{
+    memset(p, 0, sizeof(*p));
+    ota_json_init(&p->json);
+
+    for (int i = 0; i < OTA_MANIFEST_SLOTS; i++) {
+        p->slots[i].rollout = OTA_ROLLOUT_FULL;
+    }
+
+    snprintf(p->slot_keys[OTA_MANIFEST_STABLE_MODEL], OTA_MANIFEST_KEY_LEN, STABLE_CHANNEL "@%s", model);
+    // En el canal estable las entradas del canal son las de stable
+    if (strcmp(channel, STABLE_CHANNEL) != 0) {
+        snprintf(p->slot_keys[OTA_MANIFEST_CHANNEL_MODEL], OTA_MANIFEST_KEY_LEN, "%s@%s", channel, model);
+        snprintf(p->slot_keys[OTA_MANIFEST_CHANNEL], OTA_MANIFEST_KEY_LEN, "%s", channel);
+    }
+}
+
+static int slot_for_key(const ota_manifest_parser_t *p, const char *key)
+{
+    for (int i = OTA_MANIFEST_STABLE_MODEL; i < OTA_MANIFEST_SLOTS; i++) {
+        if (key[0] && strcmp(p->slot_keys[i], key) == 0) return i;
+    }
+    return -1;
+}
+
+/**
+ * @brief Contexto de un objeto que se abre, según su padre y su clave
+ */
+static uint8_t object_context(ota_manifest_parser_t *p, uint8_t parent, int depth)
+{
+    int slot;
+
+    if (depth == 1) {
+        p->slots[OTA_MANIFEST_ROOT].found = true;
+        return CTX_RELEASE | OTA_MANIFEST_ROOT;
+    }
+    if (CTX_TYPE(parent) == CTX_RELEASE) {
+        if (strcmp(p->key, "delta") == 0) return CTX_DELTA | CTX_SLOT(parent);
+        if (strcmp(p->key, "channels") == 0 && CTX_SLOT(parent) == OTA_MANIFEST_ROOT && depth == 2) {
+            return CTX_CHANNELS;
+        }
+    } else if (CTX_TYPE(parent) == CTX_CHANNELS && (slot = slot_for_key(p, p->key)) >= 0) {
+        // Una entrada repetida: vale la última
+        memset(&p->slots[slot], 0, sizeof(p->slots[slot]));
+        p->slots[slot].rollout = OTA_ROLLOUT_FULL;
+        p->slots[slot].found = true;
+        return CTX_RELEASE | slot;
+    }
+    return CTX_SKIP;
+}
+
+/**
+ * @brief Cadena en un campo de tamaño fijo; no cabe: versión no válida
+ */
+static void set_string(ota_manifest_release_t *rel, const ota_json_t *j, char *out, size_t size)
+{
+    if (j->truncated || j->value_len >= size) {
+        rel->invalid = true;
+        return;
+    }
+    memcpy(out, j->value, j->value_len + 1);
+}
+
+static bool is_string(ota_manifest_release_t *rel, ota_json_token_t tok)
+{
+    if (tok != OTA_JSON_STRING) rel->invalid = true;
+    return tok == OTA_JSON_STRING;
+}
+
+static void release_field(ota_manifest_parser_t *p, ota_manifest_release_t *rel, ota_json_token_t tok)
+{
+    const ota_json_t *j = &p->json;
+    const char *key = p->key;
+
+    if (strcmp(key, "version") == 0) {
+        if (is_string(rel, tok)) set_string(rel, j, rel->version, sizeof(rel->version));
+    } else if (strcmp(key, "url") == 0) {
+        if (is_string(rel, tok)) set_string(rel, j, rel->url, sizeof(rel->url));
+    } else if (strcmp(key, "min_version") == 0) {
+        if (is_string(rel, tok)) set_string(rel, j, rel->min_version, sizeof(rel->min_version));
+    } else if (strcmp(key, "sha256") == 0) {
+        if (is_string(rel, tok)) set_string(rel, j, rel->sha256, sizeof(rel->sha256));
+    } else if (strcmp(key, "compression") == 0) {
+        rel->deflate = tok == OTA_JSON_STRING && strcmp(j->value, "deflate") == 0;
+    } else if (strcmp(key, "size") == 0 && tok == OTA_JSON_NUMBER) {
+        double size = strtod(j->value, NULL);
+        rel->size = size > 0 && size <= UINT32_MAX ? (uint32_t)size : 0;
+    } else if (strcmp(key, "rollout") == 0 && tok == OTA_JSON_NUMBER) {
+        double pct = strtod(j->value, NULL);
+        rel->rollout = pct <= 0 ? 0 : pct >= 100 ? OTA_ROLLOUT_FULL : (uint16_t)(pct * 100 + 0.5);
+    } else if (strcmp(key, "downgrade") == 0) {
+        rel->downgrade = tok == OTA_JSON_TRUE;
+    }
+}
+
+static void delta_field(ota_manifest_parser_t *p, ota_manifest_release_t *rel, ota_json_token_t tok)
+{
+    const ota_json_t *j = &p->json;
+
+    // Un parche que no se puede leer se ignora: queda la imagen completa
+    if (tok != OTA_JSON_STRING || j->truncated) return;
+
+    if (strcmp(p->key, "from") == 0 && j->value_len < sizeof(rel->delta_from)) {
+        strcpy(rel->delta_from, j->value);
+    } else if (strcmp(p->key, "url") == 0 && j->value_len < sizeof(rel->delta_url)) {
+        strcpy(rel->delta_url, j->value);
+    } else if (strcmp(p->key, "compression") == 0) {
+        rel->delta_deflate = strcmp(j->value, "deflate") == 0;
+    }
+}
+
+static void on_token(ota_manifest_parser_t *p, ota_json_token_t tok)
+{
+    int depth = p->json.depth;
+    uint8_t ctx;
+
+    switch (tok) {
+    case OTA_JSON_OBJECT_BEGIN:
+        // Dentro de lo que se salta se salta todo
+        ctx = p->context[depth - 1];
+        p->context[depth] = depth > 1 && CTX_TYPE(ctx) == CTX_SKIP ? CTX_SKIP : object_context(p, ctx, depth);
+        return;
+    case OTA_JSON_ARRAY_BEGIN:
+        p->context[depth] = CTX_SKIP;
+        return;
+    case OTA_JSON_OBJECT_END:
+    case OTA_JSON_ARRAY_END:
+        return;
+    case OTA_JSON_KEY:
+        if (p->json.truncated || p->json.value_len >= sizeof(p->key)) {
+            p->key[0] = '\0';
+        } else {
+            memcpy(p->key, p->json.value, p->json.value_len + 1);
+        }
+        return;
+    default:
+        break;
+    }
+
+    // Valor escalar: cuenta la clave del objeto que lo contiene
+    ctx = p->context[depth];
+    if (CTX_TYPE(ctx) == CTX_RELEASE) {
+        release_field(p, &p->slots[CTX_SLOT(ctx)], tok);
+    } else if (CTX_TYPE(ctx) == CTX_DELTA) {
+        delta_field(p, &p->slots[CTX_SLOT(ctx)], tok);
+    }
+}
+
+esp_err_t ota_manifest_parser_feed(ota_manifest_parser_t *p, const char *data, size_t len)
+{
+    if (p->err != ESP_OK) return p->err;
+
+    p->received += len;
+    while (len) {
+        ota_json_token_t tok = ota_json_next(&p->json, &data, &len);
+        if (tok == OTA_JSON_NEED_MORE) break;
+        if (tok == OTA_JSON_ERROR) {
+            p->err = ESP_ERR_INVALID_RESPONSE;
+            break;
+        }
+        on_token(p, tok);
+    }
+    return p->err;
+}
+
+esp_err_t ota_manifest_parser_finish(ota_manifest_parser_t *p)
+{
+    if (p->err != ESP_OK) return p->err;
+
+    // Un documento que no es un objeto no llega a marcar la entrada de primer nivel
+    if (ota_json_end(&p->json) != OTA_JSON_DONE || !p->slots[OTA_MANIFEST_ROOT].found) {
+        p->err = ESP_ERR_INVALID_RESPONSE;
+    }
+    return p->err;
+}
+
+const ota_manifest_release_t *ota_manifest_select(const ota_manifest_parser_t *p)
+{
+    if (p->err != ESP_OK) return NULL;
+
+    const ota_manifest_release_t *stable = &p->slots[OTA_MANIFEST_STABLE_MODEL];
+    if (!stable->found) stable = &p->slots[OTA_MANIFEST_ROOT];
+
+    const ota_manifest_release_t *channel = &p->slots[OTA_MANIFEST_CHANNEL_MODEL];
+    if (!channel->found) channel = &p->slots[OTA_MANIFEST_CHANNEL];
+
+    const ota_manifest_release_t *chosen = stable;
+    if (channel->found) {
+        // Una versión que no es semver pierde frente a la otra
+        ota_version_t vc, vs;
+        bool channel_ok = ota_version_parse(channel->version, &vc) == ESP_OK;
+        bool stable_ok = ota_version_parse(stable->version, &vs) == ESP_OK;
+        if (channel_ok && (!stable_ok || ota_version_compare(&vc, &vs) > 0)) {
+            chosen = channel;
+        }
+    }
+
+    if (chosen->invalid || !chosen->version[0] || !chosen->url[0]) return NULL;
+    return chosen;
+}
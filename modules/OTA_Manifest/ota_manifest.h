@@ -0,0 +1,102 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "ota_json.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Lectura del manifest OTA a medida que se descarga.
+ *
+ * Sobre ota_json: guarda solo los campos de las versiones que pueden
+ * tocar a este dispositivo (la de primer nivel y las entradas de
+ * "channels" de su canal y modelo) y se salta el resto, así que el
+ * manifest puede crecer (notas, más canales y modelos) sin más memoria
+ * que ota_manifest_parser_t.
+ */
+
+#define OTA_MANIFEST_VERSION_LEN 32
+#define OTA_MANIFEST_URL_LEN 256            // Con el '\0': URLs de hasta 255 caracteres
+#define OTA_MANIFEST_SHA256_HEX_LEN 65
+#define OTA_MANIFEST_KEY_LEN 48             // "<canal>@<modelo>" más largo
+
+/**
+ * @brief Una versión del manifest (primer nivel o entrada de "channels")
+ */
+typedef struct {
+    bool found;                             // Hay un objeto para esta entrada
+    bool invalid;                           // Algún campo conocido no cabe o no tiene el tipo esperado
+    char version[OTA_MANIFEST_VERSION_LEN];
+    char min_version[OTA_MANIFEST_VERSION_LEN];    // "" sin mínimo
+    uint16_t rollout;                       // Centésimas de %, OTA_ROLLOUT_FULL sin campo "rollout"
+    bool downgrade;
+    char url[OTA_MANIFEST_URL_LEN];
+    char sha256[OTA_MANIFEST_SHA256_HEX_LEN];      // "" si no viene
+    uint32_t size;                          // 0 si no viene
+    bool deflate;                           // "compression": "deflate"
+    char delta_from[OTA_MANIFEST_VERSION_LEN];     // Objeto "delta": "" si no viene
+    char delta_url[OTA_MANIFEST_URL_LEN];
+    bool delta_deflate;
+} ota_manifest_release_t;
+
+// Entradas que se guardan
+typedef enum {
+    OTA_MANIFEST_ROOT = 0,                  // Primer nivel: estable para todos los modelos
+    OTA_MANIFEST_STABLE_MODEL,              // channels["stable@<modelo>"]
+    OTA_MANIFEST_CHANNEL_MODEL,             // channels["<canal>@<modelo>"]
+    OTA_MANIFEST_CHANNEL,                   // channels["<canal>"]
+    OTA_MANIFEST_SLOTS,
+} ota_manifest_slot_t;
+
+/**
+ * @brief Estado de la lectura (unos 3.4 KB: mejor en el heap que en la pila de la tarea)
+ */
+typedef struct {
+    ota_json_t json;
+    ota_manifest_release_t slots[OTA_MANIFEST_SLOTS];
+    char slot_keys[OTA_MANIFEST_SLOTS][OTA_MANIFEST_KEY_LEN];
+    char key[OTA_MANIFEST_KEY_LEN];         // Última clave ("" si era más larga)
+    uint8_t context[OTA_JSON_MAX_DEPTH + 1];    // Qué es cada nivel abierto
+    size_t received;
+    esp_err_t err;
+} ota_manifest_parser_t;
+
+/**
+ * @brief Empezar la lectura
+ * @param channel Canal del dispositivo ("stable", "beta"...)
+ * @param model Modelo de hardware para las entradas "<canal>@<modelo>"
+ */
+void ota_manifest_parser_init(ota_manifest_parser_t *p, const char *channel, const char *model);
+
+/**
+ * @brief Procesar un trozo del manifest (p. ej. lo leído con esp_http_client_read)
+ * @return ESP_OK, ESP_ERR_INVALID_RESPONSE si no es JSON válido (también en
+ *         las llamadas siguientes)
+ */
+esp_err_t ota_manifest_parser_feed(ota_manifest_parser_t *p, const char *data, size_t len);
+
+/**
+ * @brief Fin del manifest
+ * @return ESP_OK si el documento está completo y es un objeto
+ */
+esp_err_t ota_manifest_parser_finish(ota_manifest_parser_t *p);
+
+/**
+ * @brief Versión para el dispositivo, tras ota_manifest_parser_finish
+ *
+ * La estable es stable@<modelo> o, si no hay, la de primer nivel. En otro
+ * canal se usa su entrada (<canal>@<modelo> antes que <canal>) si es
+ * posterior a la estable.
+ *
+ * @return NULL si la elegida no tiene version y url, o algún campo no es válido
+ */
+const ota_manifest_release_t *ota_manifest_select(const ota_manifest_parser_t *p);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,71 @@
+#include <stddef.h>
+#include "ota_version.h"
+#include "ota_release.h"
+
+#define FNV_OFFSET 2166136261u
+#define FNV_PRIME 16777619u
+
+static uint32_t fnv1a(uint32_t h, const char *s)
+{
+    for (; *s; s++) {
+        h ^= (uint8_t)*s;
+        h *= FNV_PRIME;
+    }
+    return h;
+}
+
+uint16_t ota_rollout_bucket(const char *device_id, const char *version)
+{
+    uint32_t h = fnv1a(FNV_OFFSET, device_id);
+    h = fnv1a(h, ":");
+    h = fnv1a(h, version);
+
+    // Mezcla final (fmix32 de MurmurHash3): los bits bajos, los que usa
+    // el módulo, dependen de todos los de la entrada
+    h ^= h >> 16;
+    h *= 0x85ebca6bu;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35u;
+    h ^= h >> 16;
+
+    return h % OTA_ROLLOUT_FULL;
+}
+
+bool ota_rollout_includes(const char *device_id, const char *version, uint16_t rollout)
+{
+    if (rollout >= OTA_ROLLOUT_FULL) return true;
+    return ota_rollout_bucket(device_id, version) < rollout;
+}
+
+ota_release_decision_t ota_release_decide(const ota_release_t *rel, const char *local_version,
+                                          const char *device_id)
+{
+    ota_version_t remote, local, min;
+    if (ota_version_parse(rel->version, &remote) != ESP_OK) return OTA_RELEASE_INVALID;
+    if (rel->min_version && ota_version_parse(rel->min_version, &min) != ESP_OK) return OTA_RELEASE_INVALID;
+
+    // Versión local desconocida ("0.0.0" por defecto o texto libre): cualquiera es posterior
+    if (ota_version_parse(local_version, &local) != ESP_OK) {
+        ota_version_parse("0.0.0", &local);
+    }
+
+    int cmp = ota_version_compare(&remote, &local);
+    if (cmp == 0) return OTA_RELEASE_UP_TO_DATE;
+    if (cmp < 0 && !rel->downgrade) return OTA_RELEASE_OLDER;
+    if (rel->min_version && ota_version_compare(&local, &min) < 0) return OTA_RELEASE_BELOW_MIN;
+    if (!ota_rollout_includes(device_id, rel->version, rel->rollout)) return OTA_RELEASE_NOT_IN_ROLLOUT;
+    return OTA_RELEASE_UPDATE;
+}
+
+const char *ota_release_decision_name(ota_release_decision_t decision)
+{
+    switch (decision) {
+    case OTA_RELEASE_UPDATE:            return "actualizar";
+    case OTA_RELEASE_UP_TO_DATE:        return "misma versión";
+    case OTA_RELEASE_OLDER:             return "versión anterior";
+    case OTA_RELEASE_BELOW_MIN:         return "por debajo de min_version";
+    case OTA_RELEASE_NOT_IN_ROLLOUT:    return "fuera del despliegue";
+    case OTA_RELEASE_INVALID:           return "versión no válida";
+    }
+    return "?";
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Decisión de actualizar a una versión anunciada en el manifest.
+ *
+ * Con la versión local, la del manifest y sus campos opcionales
+ * (min_version, rollout, downgrade) decide en el dispositivo si merece la
+ * pena descargar: una versión igual o anterior a la local, una que exige
+ * una versión intermedia o un despliegue gradual que aún no llega a este
+ * dispositivo no se descargan.
+ */
+
+// rollout en centésimas de porcentaje: 10000 = todos los dispositivos
+#define OTA_ROLLOUT_FULL 10000
+
+/**
+ * @brief Campos de una versión del manifest que intervienen en la decisión
+ */
+typedef struct {
+    const char *version;            // Versión anunciada
+    const char *min_version;        // Versión local mínima para instalarla (NULL: cualquiera)
+    uint16_t rollout;               // Parte de los dispositivos que la reciben (0..OTA_ROLLOUT_FULL)
+    bool downgrade;                 // Instalar aunque la local sea posterior (retirar una versión)
+} ota_release_t;
+
+typedef enum {
+    OTA_RELEASE_UPDATE = 0,         // Descargar e instalar
+    OTA_RELEASE_UP_TO_DATE,         // Misma versión que la local
+    OTA_RELEASE_OLDER,              // Anterior a la local y sin downgrade
+    OTA_RELEASE_BELOW_MIN,          // La local es anterior a min_version
+    OTA_RELEASE_NOT_IN_ROLLOUT,     // Este dispositivo aún no entra en el despliegue
+    OTA_RELEASE_INVALID,            // version o min_version no son semver
+} ota_release_decision_t;
+
+/**
+ * @brief Cubeta del dispositivo en el despliegue de una versión (0..OTA_ROLLOUT_FULL - 1)
+ *
+ * Hash de device_id y version: estable para el mismo par (subir el
+ * porcentaje solo añade dispositivos) y distinto en cada versión (los
+ * primeros en recibir una no son siempre los mismos).
+ */
+uint16_t ota_rollout_bucket(const char *device_id, const char *version);
+
+/**
+ * @brief El dispositivo entra en un despliegue al rollout indicado
+ */
+bool ota_rollout_includes(const char *device_id, const char *version, uint16_t rollout);
+
+/**
+ * @brief Decidir si instalar rel
+ * @param local_version Versión instalada; si no es semver cuenta como 0.0.0
+ * @param device_id Identificador estable del dispositivo (p. ej. la MAC en hex)
+ */
+ota_release_decision_t ota_release_decide(const ota_release_t *rel, const char *local_version,
+                                          const char *device_id);
+
+/**
+ * @brief Nombre de la decisión para los logs
+ */
+const char *ota_release_decision_name(ota_release_decision_t decision);
+
+#ifdef __cplusplus
+}
+#endif
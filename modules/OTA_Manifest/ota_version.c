@@ -0,0 +1,140 @@
+#include <string.h>
+#include <ctype.h>
+#include "ota_version.h"
+
+/**
+ * @brief Número sin ceros a la izquierda ni desbordamiento
+ * @return Puntero tras el número, NULL si no hay uno válido
+ */
+static const char *parse_number(const char *p, uint32_t *out)
+{
+    if (!isdigit((unsigned char)*p)) return NULL;
+    if (p[0] == '0' && isdigit((unsigned char)p[1])) return NULL;
+
+    uint32_t value = 0;
+    for (; isdigit((unsigned char)*p); p++) {
+        uint32_t digit = *p - '0';
+        if (value > (UINT32_MAX - digit) / 10) return NULL;
+        value = value * 10 + digit;
+    }
+    *out = value;
+    return p;
+}
+
+static bool is_ident_char(char c)
+{
+    return isalnum((unsigned char)c) || c == '-';
+}
+
+/**
+ * @brief Identificadores separados por '.' hasta end_chars o el final
+ *
+ * Ninguno vacío; si numeric_rules, los numéricos sin ceros a la izquierda.
+ * @return Longitud recorrida, -1 si no son válidos
+ */
+static int scan_identifiers(const char *p, bool numeric_rules)
+{
+    const char *start = p;
+    for (;;) {
+        const char *id = p;
+        bool numeric = true;
+        while (is_ident_char(*p)) {
+            if (!isdigit((unsigned char)*p)) numeric = false;
+            p++;
+        }
+        if (p == id) return -1;
+        if (numeric_rules && numeric && id[0] == '0' && p - id > 1) return -1;
+        if (*p != '.') break;
+        p++;
+    }
+    return p - start;
+}
+
+esp_err_t ota_version_parse(const char *str, ota_version_t *out)
+{
+    if (!str || !out) return ESP_ERR_INVALID_ARG;
+
+    memset(out, 0, sizeof(*out));
+    const char *p = str;
+    if (*p == 'v' || *p == 'V') p++;
+
+    // MINOR y PATCH opcionales: "0.1" es 0.1.0
+    uint32_t *parts[3] = { &out->major, &out->minor, &out->patch };
+    for (int i = 0; i < 3; i++) {
+        p = parse_number(p, parts[i]);
+        if (!p) return ESP_ERR_INVALID_ARG;
+        if (*p != '.' || i == 2) break;
+        p++;
+    }
+
+    if (*p == '-') {
+        p++;
+        int len = scan_identifiers(p, true);
+        if (len < 0) return ESP_ERR_INVALID_ARG;
+        if (len >= OTA_VERSION_PRE_LEN) return ESP_ERR_INVALID_SIZE;
+        memcpy(out->pre, p, len);
+        out->pre[len] = '\0';
+        p += len;
+    }
+
+    if (*p == '+') {
+        p++;
+        int len = scan_identifiers(p, false);
+        if (len < 0) return ESP_ERR_INVALID_ARG;
+        p += len;
+    }
+
+    return *p == '\0' ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+/**
+ * @brief Precedencia de dos prereleases no vacíos (semver 2.0, punto 11)
+ */
+static int compare_pre(const char *a, const char *b)
+{
+    while (*a && *b) {
+        size_t la = strcspn(a, ".");
+        size_t lb = strcspn(b, ".");
+        bool na = strspn(a, "0123456789") == la;
+        bool nb = strspn(b, "0123456789") == lb;
+
+        int cmp;
+        if (na && nb) {
+            // Sin ceros a la izquierda: más dígitos es mayor
+            cmp = la != lb ? (la < lb ? -1 : 1) : strncmp(a, b, la);
+        } else if (na != nb) {
+            cmp = na ? -1 : 1;          // Los numéricos van antes
+        } else {
+            cmp = strncmp(a, b, la < lb ? la : lb);
+            if (cmp == 0 && la != lb) cmp = la < lb ? -1 : 1;
+        }
+        if (cmp != 0) return cmp < 0 ? -1 : 1;
+
+        a += la;
+        b += lb;
+        if (*a == '.') a++;
+        if (*b == '.') b++;
+    }
+    // Iguales hasta aquí: el que tiene más identificadores es mayor
+    return (*a != '\0') - (*b != '\0');
+}
+
+int ota_version_compare(const ota_version_t *a, const ota_version_t *b)
+{
+    if (a->major != b->major) return a->major < b->major ? -1 : 1;
+    if (a->minor != b->minor) return a->minor < b->minor ? -1 : 1;
+    if (a->patch != b->patch) return a->patch < b->patch ? -1 : 1;
+
+    // Una versión final es posterior a cualquiera de sus prereleases
+    if (!a->pre[0] || !b->pre[0]) return (a->pre[0] == '\0') - (b->pre[0] == '\0');
+    return compare_pre(a->pre, b->pre);
+}
+
+esp_err_t ota_version_compare_str(const char *a, const char *b, int *result)
+{
+    ota_version_t va, vb;
+    esp_err_t err = ota_version_parse(a, &va);
+    if (err == ESP_OK) err = ota_version_parse(b, &vb);
+    if (err == ESP_OK) *result = ota_version_compare(&va, &vb);
+    return err;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Versiones semánticas (semver 2.0) de las imágenes OTA.
+ *
+ * "MAJOR[.MINOR[.PATCH]][-prerelease][+build]", con "v" inicial opcional:
+ * "0.1" equivale a "0.1.0", como las versiones de Versions/. Orden de
+ * semver: 1.0.0-alpha < 1.0.0-alpha.1 < 1.0.0-beta < 1.0.0-rc.1 < 1.0.0;
+ * la parte +build no cuenta.
+ */
+
+// Prerelease más largo que se admite ("beta.12", "rc.1"...)
+#define OTA_VERSION_PRE_LEN 24
+
+typedef struct {
+    uint32_t major;
+    uint32_t minor;
+    uint32_t patch;
+    char pre[OTA_VERSION_PRE_LEN];      // Identificadores tras '-' ("" en una versión final)
+} ota_version_t;
+
+/**
+ * @brief Interpretar una versión
+ * @return ESP_OK, ESP_ERR_INVALID_ARG si no es semver (o un número no cabe en 32 bits),
+ *         ESP_ERR_INVALID_SIZE si el prerelease es demasiado largo
+ */
+esp_err_t ota_version_parse(const char *str, ota_version_t *out);
+
+/**
+ * @brief Comparar dos versiones según la precedencia de semver
+ * @return < 0 si a es anterior, 0 si son equivalentes, > 0 si a es posterior
+ */
+int ota_version_compare(const ota_version_t *a, const ota_version_t *b);
+
+/**
+ * @brief Comparar dos cadenas de versión
+ * @param result Como ota_version_compare
+ * @return ESP_OK, o el error de ota_version_parse de la primera que no es válida
+ */
+esp_err_t ota_version_compare_str(const char *a, const char *b, int *result);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,659 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sched.h>
+#include <pthread.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_system.h"
+#include "esp_rom_crc.h"
+#include "esp_partition.h"
+#include "esp_ota_ops.h"
+#include "esp_app_desc.h"
+#include "nvs.h"
+#include "mbedtls/sha256.h"
+#include "esp32/rom/miniz.h"
+#include "host_port.h"
+
+#define FLASH_SECTOR_SIZE 4096
+#define IMAGE_MAGIC 0xE9            // Primer byte de una imagen de app ESP32
+#define NVS_MAX_ENTRIES 8
+#define NVS_MAX_HANDLES 4
+#define NVS_KEY_LEN 32
+#define NVS_VALUE_LEN 128
+
+esp_log_level_t host_log_level = ESP_LOG_INFO;
+jmp_buf *host_restart_jmp = NULL;
+
+// ============================================================================
+// ESP-IDF base: errores, tiempo, reinicio
+// ============================================================================
+
+const char *esp_err_to_name(esp_err_t code)
+{
+    switch (code) {
+    case ESP_OK: return "ESP_OK";
+    case ESP_FAIL: return "ESP_FAIL";
+    case ESP_ERR_NO_MEM: return "ESP_ERR_NO_MEM";
+    case ESP_ERR_INVALID_ARG: return "ESP_ERR_INVALID_ARG";
+    case ESP_ERR_INVALID_STATE: return "ESP_ERR_INVALID_STATE";
+    case ESP_ERR_INVALID_SIZE: return "ESP_ERR_INVALID_SIZE";
+    case ESP_ERR_NOT_FOUND: return "ESP_ERR_NOT_FOUND";
+    case ESP_ERR_NOT_SUPPORTED: return "ESP_ERR_NOT_SUPPORTED";
+    case ESP_ERR_TIMEOUT: return "ESP_ERR_TIMEOUT";
+    case ESP_ERR_INVALID_RESPONSE: return "ESP_ERR_INVALID_RESPONSE";
+    case ESP_ERR_INVALID_CRC: return "ESP_ERR_INVALID_CRC";
+    case ESP_ERR_INVALID_VERSION: return "ESP_ERR_INVALID_VERSION";
+    case ESP_ERR_NVS_NOT_FOUND: return "ESP_ERR_NVS_NOT_FOUND";
+    case ESP_ERR_NVS_INVALID_LENGTH: return "ESP_ERR_NVS_INVALID_LENGTH";
+    case ESP_ERR_OTA_VALIDATE_FAILED: return "ESP_ERR_OTA_VALIDATE_FAILED";
+    default: return "UNKNOWN ERROR";
+    }
+}
+
+void host_error_check_failed(esp_err_t err, const char *expr)
+{
+    fprintf(stderr, "ESP_ERROR_CHECK falló: %s = %s\n", expr, esp_err_to_name(err));
+    abort();
+}
+
+int64_t esp_timer_get_time(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+void esp_restart(void)
+{
+    if (host_restart_jmp) {
+        longjmp(*host_restart_jmp, 1);
+    }
+    exit(0);
+}
+
+// Heap fijo: el del proceso no se parece al del ESP32
+#define HOST_FREE_HEAP (160 * 1024)
+
+uint32_t esp_get_free_heap_size(void)
+{
+    return HOST_FREE_HEAP;
+}
+
+uint32_t esp_get_minimum_free_heap_size(void)
+{
+    return HOST_FREE_HEAP;
+}
+
+// App "en ejecución": mismo proyecto que Versions/0.1/OTA.bin
+static const esp_app_desc_t s_running_app = {
+    .magic_word = ESP_APP_DESC_MAGIC_WORD,
+    .secure_version = 0,
+    .version = "1",
+    .project_name = HOST_PROJECT_NAME,
+    .idf_ver = "v5.3.4",
+};
+
+const esp_app_desc_t *esp_app_get_description(void)
+{
+    return &s_running_app;
+}
+
+// ============================================================================
+// FreeRTOS sobre pthreads
+// ============================================================================
+
+struct host_task {
+    pthread_t thread;
+    TaskFunction_t fn;
+    void *arg;
+};
+
+struct host_queue {
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    uint8_t *storage;
+    UBaseType_t length;
+    UBaseType_t item_size;
+    UBaseType_t head;
+    UBaseType_t count;
+};
+
+/**
+ * @brief Esperar en `cond` con timeout en ticks (false si expira)
+ */
+static bool host_cond_wait(pthread_cond_t *cond, pthread_mutex_t *lock, TickType_t wait)
+{
+    if (wait == 0) return false;
+    if (wait == portMAX_DELAY) {
+        pthread_cond_wait(cond, lock);
+        return true;
+    }
+
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    uint64_t ns = ts.tv_nsec + (uint64_t)wait * portTICK_PERIOD_MS * 1000000;
+    ts.tv_sec += ns / 1000000000;
+    ts.tv_nsec = ns % 1000000000;
+    return pthread_cond_timedwait(cond, lock, &ts) == 0;
+}
+
+static void *host_task_entry(void *arg)
+{
+    struct host_task *task = arg;
+    task->fn(task->arg);
+    return NULL;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t fn, const char *name, uint32_t stack_depth,
+                       void *arg, UBaseType_t prio, TaskHandle_t *handle)
+{
+    (void)name;
+    (void)stack_depth;
+    (void)prio;
+
+    struct host_task *task = calloc(1, sizeof(*task));
+    if (!task) return pdFAIL;
+    task->fn = fn;
+    task->arg = arg;
+
+    if (pthread_create(&task->thread, NULL, host_task_entry, task) != 0) {
+        free(task);
+        return pdFAIL;
+    }
+    pthread_detach(task->thread);
+
+    if (handle) *handle = task;
+    return pdPASS;
+}
+
+void vTaskDelete(TaskHandle_t task)
+{
+    // Solo se admite que una task se borre a sí misma
+    if (task == NULL) {
+        pthread_exit(NULL);
+    }
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    // Sin dormir: los retardos del protocolo (reinicio tras END_OTA) no
+    // deben contar en el benchmark
+    (void)ticks;
+    sched_yield();
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+    return (TickType_t)(esp_timer_get_time() / 1000 / portTICK_PERIOD_MS);
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size)
+{
+    struct host_queue *q = calloc(1, sizeof(*q));
+    if (!q) return NULL;
+
+    q->storage = calloc(length, item_size);
+    if (!q->storage) {
+        free(q);
+        return NULL;
+    }
+    q->length = length;
+    q->item_size = item_size;
+    pthread_mutex_init(&q->lock, NULL);
+    pthread_cond_init(&q->changed, NULL);
+    return q;
+}
+
+void vQueueDelete(QueueHandle_t q)
+{
+    if (!q) return;
+    pthread_mutex_destroy(&q->lock);
+    pthread_cond_destroy(&q->changed);
+    free(q->storage);
+    free(q);
+}
+
+BaseType_t xQueueSend(QueueHandle_t q, const void *item, TickType_t wait)
+{
+    pthread_mutex_lock(&q->lock);
+    while (q->count == q->length) {
+        if (!host_cond_wait(&q->changed, &q->lock, wait)) {
+            pthread_mutex_unlock(&q->lock);
+            return pdFALSE;
+        }
+    }
+
+    UBaseType_t slot = (q->head + q->count) % q->length;
+    memcpy(q->storage + slot * q->item_size, item, q->item_size);
+    q->count++;
+    pthread_cond_broadcast(&q->changed);
+    pthread_mutex_unlock(&q->lock);
+    return pdTRUE;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t q, void *item, TickType_t wait)
+{
+    pthread_mutex_lock(&q->lock);
+    while (q->count == 0) {
+        if (!host_cond_wait(&q->changed, &q->lock, wait)) {
+            pthread_mutex_unlock(&q->lock);
+            return pdFALSE;
+        }
+    }
+
+    memcpy(item, q->storage + q->head * q->item_size, q->item_size);
+    q->head = (q->head + 1) % q->length;
+    q->count--;
+    pthread_cond_broadcast(&q->changed);
+    pthread_mutex_unlock(&q->lock);
+    return pdTRUE;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t q)
+{
+    pthread_mutex_lock(&q->lock);
+    UBaseType_t count = q->count;
+    pthread_mutex_unlock(&q->lock);
+    return count;
+}
+
+// ============================================================================
+// Flash: dos particiones OTA en RAM con semántica NOR (escribir solo baja bits)
+// ============================================================================
+
+static const esp_partition_t s_partitions[2] = {
+    { .address = 0x10000, .size = HOST_PARTITION_SIZE, .erase_size = FLASH_SECTOR_SIZE, .label = "ota_0" },
+    { .address = 0x110000, .size = HOST_PARTITION_SIZE, .erase_size = FLASH_SECTOR_SIZE, .label = "ota_1" },
+};
+static uint8_t s_flash[2][HOST_PARTITION_SIZE];
+static const esp_partition_t *s_boot_partition = NULL;
+
+// Única sesión esp_ota_* abierta
+static struct {
+    esp_ota_handle_t handle;
+    const esp_partition_t *part;
+    size_t written;
+    size_t erased_end;
+    bool sequential;
+} s_ota;
+static esp_ota_handle_t s_ota_last_handle = 0;
+
+uint8_t *host_partition_data(const esp_partition_t *part)
+{
+    return s_flash[part - s_partitions];
+}
+
+const esp_partition_t *host_boot_partition(void)
+{
+    return s_boot_partition;
+}
+
+esp_err_t esp_partition_read(const esp_partition_t *part, size_t offset, void *dst, size_t len)
+{
+    if (offset > part->size || len > part->size - offset) return ESP_ERR_INVALID_SIZE;
+    memcpy(dst, host_partition_data(part) + offset, len);
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_write(const esp_partition_t *part, size_t offset, const void *src, size_t len)
+{
+    if (offset > part->size || len > part->size - offset) return ESP_ERR_INVALID_SIZE;
+
+    uint8_t *dst = host_partition_data(part) + offset;
+    const uint8_t *in = src;
+    for (size_t i = 0; i < len; i++) {
+        dst[i] &= in[i];
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_erase_range(const esp_partition_t *part, size_t offset, size_t len)
+{
+    if (offset % FLASH_SECTOR_SIZE || len % FLASH_SECTOR_SIZE) return ESP_ERR_INVALID_ARG;
+    if (offset > part->size || len > part->size - offset) return ESP_ERR_INVALID_SIZE;
+    memset(host_partition_data(part) + offset, 0xFF, len);
+    return ESP_OK;
+}
+
+const esp_partition_t *esp_ota_get_running_partition(void)
+{
+    return &s_partitions[0];
+}
+
+const esp_partition_t *esp_ota_get_next_update_partition(const esp_partition_t *start_from)
+{
+    (void)start_from;
+    return &s_partitions[1];
+}
+
+esp_err_t esp_ota_begin(const esp_partition_t *part, size_t image_size, esp_ota_handle_t *out_handle)
+{
+    if (part != &s_partitions[1]) return ESP_ERR_INVALID_ARG;
+
+    s_ota.part = part;
+    s_ota.written = 0;
+    s_ota.erased_end = 0;
+    s_ota.sequential = (image_size == OTA_WITH_SEQUENTIAL_WRITES);
+
+    if (!s_ota.sequential) {
+        size_t len = (image_size == OTA_SIZE_UNKNOWN) ? part->size : image_size;
+        len = (len + FLASH_SECTOR_SIZE - 1) & ~(FLASH_SECTOR_SIZE - 1);
+        esp_err_t err = esp_partition_erase_range(part, 0, len);
+        if (err != ESP_OK) return err;
+        s_ota.erased_end = len;
+    }
+
+    s_ota.handle = ++s_ota_last_handle;
+    *out_handle = s_ota.handle;
+    return ESP_OK;
+}
+
+esp_err_t esp_ota_write(esp_ota_handle_t handle, const void *data, size_t size)
+{
+    if (handle == 0 || handle != s_ota.handle) return ESP_ERR_INVALID_ARG;
+    if (s_ota.written == 0 && size > 0 && ((const uint8_t *)data)[0] != IMAGE_MAGIC) {
+        return ESP_ERR_OTA_VALIDATE_FAILED;
+    }
+
+    size_t end = s_ota.written + size;
+    if (end > s_ota.part->size) return ESP_ERR_INVALID_SIZE;
+
+    if (s_ota.sequential && end > s_ota.erased_end) {
+        size_t erase_end = (end + FLASH_SECTOR_SIZE - 1) & ~(FLASH_SECTOR_SIZE - 1);
+        esp_partition_erase_range(s_ota.part, s_ota.erased_end, erase_end - s_ota.erased_end);
+        s_ota.erased_end = erase_end;
+    }
+
+    esp_err_t err = esp_partition_write(s_ota.part, s_ota.written, data, size);
+    if (err == ESP_OK) {
+        s_ota.written = end;
+    }
+    return err;
+}
+
+esp_err_t esp_ota_end(esp_ota_handle_t handle)
+{
+    if (handle == 0 || handle != s_ota.handle) return ESP_ERR_NOT_FOUND;
+    s_ota.handle = 0;
+    return s_ota.written ? ESP_OK : ESP_ERR_OTA_VALIDATE_FAILED;
+}
+
+esp_err_t esp_ota_abort(esp_ota_handle_t handle)
+{
+    if (handle == 0 || handle != s_ota.handle) return ESP_ERR_NOT_FOUND;
+    s_ota.handle = 0;
+    return ESP_OK;
+}
+
+esp_err_t esp_ota_set_boot_partition(const esp_partition_t *part)
+{
+    if (host_partition_data(part)[0] != IMAGE_MAGIC) return ESP_ERR_OTA_VALIDATE_FAILED;
+    s_boot_partition = part;
+    return ESP_OK;
+}
+
+// ============================================================================
+// NVS en memoria
+// ============================================================================
+
+typedef struct {
+    char key[NVS_KEY_LEN];         // "namespace/clave"
+    uint8_t value[NVS_VALUE_LEN];
+    size_t len;
+    bool used;
+} host_nvs_entry_t;
+
+static host_nvs_entry_t s_nvs[NVS_MAX_ENTRIES];
+static char s_nvs_ns[NVS_MAX_HANDLES][16];
+static nvs_open_mode_t s_nvs_mode[NVS_MAX_HANDLES];
+
+static host_nvs_entry_t *host_nvs_find(nvs_handle_t handle, const char *key, bool create)
+{
+    char full[NVS_KEY_LEN];
+    snprintf(full, sizeof(full), "%s/%s", s_nvs_ns[handle - 1], key);
+
+    host_nvs_entry_t *free_entry = NULL;
+    for (int i = 0; i < NVS_MAX_ENTRIES; i++) {
+        if (s_nvs[i].used && strcmp(s_nvs[i].key, full) == 0) return &s_nvs[i];
+        if (!s_nvs[i].used && !free_entry) free_entry = &s_nvs[i];
+    }
+
+    if (create && free_entry) {
+        memset(free_entry, 0, sizeof(*free_entry));
+        strcpy(free_entry->key, full);
+        return free_entry;
+    }
+    return NULL;
+}
+
+void host_reset(void)
+{
+    memset(s_nvs, 0, sizeof(s_nvs));
+    s_boot_partition = NULL;
+}
+
+esp_err_t nvs_open(const char *name, nvs_open_mode_t mode, nvs_handle_t *out)
+{
+    for (int i = 0; i < NVS_MAX_HANDLES; i++) {
+        if (s_nvs_ns[i][0] == '\0') {
+            snprintf(s_nvs_ns[i], sizeof(s_nvs_ns[i]), "%s", name);
+            s_nvs_mode[i] = mode;
+            *out = i + 1;
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_NO_MEM;
+}
+
+void nvs_close(nvs_handle_t handle)
+{
+    s_nvs_ns[handle - 1][0] = '\0';
+}
+
+esp_err_t nvs_commit(nvs_handle_t handle)
+{
+    (void)handle;
+    return ESP_OK;
+}
+
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char *key, void *out, size_t *len)
+{
+    host_nvs_entry_t *e = host_nvs_find(handle, key, false);
+    if (!e) return ESP_ERR_NVS_NOT_FOUND;
+
+    if (out == NULL) {
+        *len = e->len;
+        return ESP_OK;
+    }
+    if (*len < e->len) return ESP_ERR_NVS_INVALID_LENGTH;
+
+    memcpy(out, e->value, e->len);
+    *len = e->len;
+    return ESP_OK;
+}
+
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char *key, const void *value, size_t len)
+{
+    if (s_nvs_mode[handle - 1] != NVS_READWRITE) return ESP_ERR_INVALID_STATE;
+    if (len > NVS_VALUE_LEN) return ESP_ERR_INVALID_SIZE;
+
+    host_nvs_entry_t *e = host_nvs_find(handle, key, true);
+    if (!e) return ESP_ERR_NO_MEM;
+
+    memcpy(e->value, value, len);
+    e->len = len;
+    e->used = true;
+    return ESP_OK;
+}
+
+esp_err_t nvs_erase_key(nvs_handle_t handle, const char *key)
+{
+    if (s_nvs_mode[handle - 1] != NVS_READWRITE) return ESP_ERR_INVALID_STATE;
+
+    host_nvs_entry_t *e = host_nvs_find(handle, key, false);
+    if (!e) return ESP_ERR_NVS_NOT_FOUND;
+    e->used = false;
+    return ESP_OK;
+}
+
+// ============================================================================
+// ROM: CRC32 y tinfl
+// ============================================================================
+
+uint32_t esp_rom_crc32_le(uint32_t crc, uint8_t const *buf, uint32_t len)
+{
+    static uint32_t table[256];
+    static bool ready = false;
+
+    if (!ready) {
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++) {
+                c = (c & 1) ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+            }
+            table[i] = c;
+        }
+        ready = true;
+    }
+
+    crc = ~crc;
+    while (len--) {
+        crc = table[(crc ^ *buf++) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+tinfl_status tinfl_decompress(tinfl_decompressor *r, const mz_uint8 *in_next, size_t *in_size,
+                              mz_uint8 *out_start, mz_uint8 *out_next, size_t *out_size,
+                              const mz_uint32 flags)
+{
+    (void)r; (void)in_next; (void)out_start; (void)out_next; (void)flags;
+    *in_size = 0;
+    *out_size = 0;
+    return TINFL_STATUS_FAILED;
+}
+
+// ============================================================================
+// mbedtls: SHA-256 (FIPS 180-4)
+// ============================================================================
+
+static const uint32_t s_sha256_k[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+#define ROR32(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+static void sha256_block(mbedtls_sha256_context *ctx, const uint8_t *p)
+{
+    uint32_t w[64];
+    for (int i = 0; i < 16; i++) {
+        w[i] = ((uint32_t)p[4 * i] << 24) | ((uint32_t)p[4 * i + 1] << 16) |
+               ((uint32_t)p[4 * i + 2] << 8) | p[4 * i + 3];
+    }
+    for (int i = 16; i < 64; i++) {
+        uint32_t s0 = ROR32(w[i - 15], 7) ^ ROR32(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        uint32_t s1 = ROR32(w[i - 2], 17) ^ ROR32(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+
+    uint32_t a = ctx->state[0], b = ctx->state[1], c = ctx->state[2], d = ctx->state[3];
+    uint32_t e = ctx->state[4], f = ctx->state[5], g = ctx->state[6], h = ctx->state[7];
+    for (int i = 0; i < 64; i++) {
+        uint32_t t1 = h + (ROR32(e, 6) ^ ROR32(e, 11) ^ ROR32(e, 25)) + ((e & f) ^ (~e & g)) +
+                      s_sha256_k[i] + w[i];
+        uint32_t t2 = (ROR32(a, 2) ^ ROR32(a, 13) ^ ROR32(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+        h = g; g = f; f = e; e = d + t1;
+        d = c; c = b; b = a; a = t1 + t2;
+    }
+
+    ctx->state[0] += a; ctx->state[1] += b; ctx->state[2] += c; ctx->state[3] += d;
+    ctx->state[4] += e; ctx->state[5] += f; ctx->state[6] += g; ctx->state[7] += h;
+}
+
+void mbedtls_sha256_init(mbedtls_sha256_context *ctx)
+{
+    memset(ctx, 0, sizeof(*ctx));
+}
+
+void mbedtls_sha256_free(mbedtls_sha256_context *ctx)
+{
+    memset(ctx, 0, sizeof(*ctx));
+}
+
+int mbedtls_sha256_starts(mbedtls_sha256_context *ctx, int is224)
+{
+    static const uint32_t iv[8] = {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+    };
+    if (is224) return -1;   // SHA-224 no se usa en el módulo
+
+    memcpy(ctx->state, iv, sizeof(iv));
+    ctx->total = 0;
+    ctx->used = 0;
+    return 0;
+}
+
+int mbedtls_sha256_update(mbedtls_sha256_context *ctx, const unsigned char *input, size_t len)
+{
+    ctx->total += len;
+
+    if (ctx->used) {
+        size_t take = 64 - ctx->used;
+        if (take > len) take = len;
+        memcpy(ctx->block + ctx->used, input, take);
+        ctx->used += take;
+        input += take;
+        len -= take;
+        if (ctx->used < 64) return 0;
+        sha256_block(ctx, ctx->block);
+        ctx->used = 0;
+    }
+
+    while (len >= 64) {
+        sha256_block(ctx, input);
+        input += 64;
+        len -= 64;
+    }
+
+    memcpy(ctx->block, input, len);
+    ctx->used = len;
+    return 0;
+}
+
+int mbedtls_sha256_finish(mbedtls_sha256_context *ctx, unsigned char output[32])
+{
+    uint64_t bits = ctx->total * 8;
+
+    ctx->block[ctx->used++] = 0x80;
+    if (ctx->used > 56) {
+        memset(ctx->block + ctx->used, 0, 64 - ctx->used);
+        sha256_block(ctx, ctx->block);
+        ctx->used = 0;
+    }
+    memset(ctx->block + ctx->used, 0, 56 - ctx->used);
+    for (int i = 0; i < 8; i++) {
+        ctx->block[56 + i] = bits >> (56 - 8 * i);
+    }
+    sha256_block(ctx, ctx->block);
+
+    for (int i = 0; i < 8; i++) {
+        output[4 * i] = ctx->state[i] >> 24;
+        output[4 * i + 1] = ctx->state[i] >> 16;
+        output[4 * i + 2] = ctx->state[i] >> 8;
+        output[4 * i + 3] = ctx->state[i];
+    }
+    return 0;
+}
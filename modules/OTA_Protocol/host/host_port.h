@@ -0,0 +1,31 @@
+#pragma once
+
+// Control del entorno simulado: particiones en RAM, NVS y reinicio
+
+#include <stddef.h>
+#include <stdint.h>
+#include <setjmp.h>
+#include "esp_partition.h"
+
+#define HOST_PARTITION_SIZE (1024 * 1024)   // Como partitions_two_ota.csv
+#define HOST_PROJECT_NAME "OTA"             // project_name de esp_app_get_description()
+
+/**
+ * @brief Si no es NULL, esp_restart() hace longjmp aquí en vez de salir
+ */
+extern jmp_buf *host_restart_jmp;
+
+/**
+ * @brief Contenido en RAM de una partición OTA (0 = en ejecución, 1 = destino)
+ */
+uint8_t *host_partition_data(const esp_partition_t *part);
+
+/**
+ * @brief Partición marcada con esp_ota_set_boot_partition (NULL si ninguna)
+ */
+const esp_partition_t *host_boot_partition(void);
+
+/**
+ * @brief Vaciar el NVS simulado y olvidar la partición de arranque
+ */
+void host_reset(void);
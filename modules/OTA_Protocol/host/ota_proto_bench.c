@@ -0,0 +1,1014 @@
+/*
+ * Benchmark en el host del motor de protocolo OTA.
+ *
+ * Compila ota_proto.c tal cual contra los stubs de host/stubs y le entrega
+ * flujos generados como lo haría un transporte: cada fragmento entra por
+ * ota_proto_push() y se procesa con ota_proto_process() (lo que hacen el
+ * callback SPP y ota_bt_task), con la task escritora en su propio hilo.
+ * Antes de los escenarios somete el anillo RX a un productor y un consumidor
+ * en hilos distintos (lo que hacen Bluedroid y ota_bt_task en el ESP32).
+ *
+ * Uso: ota_proto_bench [-s KB] [-n repeticiones] [-v] [imagen.bin]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stddef.h>
+#include "esp_system.h"
+#include "mbedtls/sha256.h"
+#include "host_port.h"
+#include "../ota_proto.c"
+
+#define BENCH_WINDOW 8
+#define BENCH_DEFAULT_KB 768
+#define BENCH_DEFAULT_REPS 10
+#define BENCH_MAX_FRAGMENT 2048
+#define BENCH_SPP_MTU 990            // Payload típico de un paquete RFCOMM
+#define BENCH_RING_MB 256            // Volumen de la prueba de estrés del anillo
+#define BENCH_RING_OVERFLOW_MB 16    // Volumen entregado con desbordes (el productor no espera)
+#define BENCH_RING_MAX_READ 4096
+#define BENCH_DEDUPE_EVERY 8         // Escenario dedupe: 1 de cada N sectores cambia respecto al slot en ejecución
+
+#define FRAG_FIXED 0                 // Fragmentos de frag_size bytes
+#define FRAG_RANDOM 1                // Fragmentos de 1..BENCH_MAX_FRAGMENT bytes
+
+typedef struct {
+    const char *name;
+    bool windowed;
+    uint8_t flags;                   // OTA_FLAG_* (solo modo ventana)
+    bool hash;                       // Anunciar TLV_IMAGE_HASH
+    uint16_t chunk;
+    uint8_t frag_mode;
+    uint16_t frag_size;
+    uint8_t garbage_pct;             // % de frames precedidos de bytes basura
+    uint8_t corrupt_pct;             // % de frames con un bit cambiado (y retransmitidos)
+    bool resume;                     // Desconexión a mitad y RESUME_OTA
+    bool threaded;                   // push desde otro hilo (productor/consumidor reales)
+    uint8_t reject;                  // Imagen de otro proyecto: código PROTO_ERR_* esperado
+    bool dedupe;                     // SECTOR_HASH y COPY_SEQ de los sectores iguales al slot en ejecución
+} scenario_t;
+
+static const scenario_t s_scenarios[] = {
+    { "clasico 1021 / 990",         false, 0,            false, 1021, FRAG_FIXED,  BENCH_SPP_MTU, 0,  0, false, false },
+    { "clasico 128 / 990",          false, 0,            false, 128,  FRAG_FIXED,  BENCH_SPP_MTU, 0,  0, false, false },
+    { "ventana 1021 / 990",         true,  0,            false, 1021, FRAG_FIXED,  BENCH_SPP_MTU, 0,  0, false, false },
+    { "ventana 512 / aleatorio",    true,  0,            false, 512,  FRAG_RANDOM, 0,             0,  0, false, false },
+    { "ventana+crc 1021 / 990",     true,  OTA_FLAG_CRC, false, 1021, FRAG_FIXED,  BENCH_SPP_MTU, 0,  0, false, false },
+    { "ventana+crc 1021 / 1 byte",  true,  OTA_FLAG_CRC, false, 1021, FRAG_FIXED,  1,             0,  0, false, false },
+    { "ventana+crc 2048 / 990",     true,  OTA_FLAG_CRC, false, 2048, FRAG_FIXED,  BENCH_SPP_MTU, 0,  0, false, false },
+    { "ventana+crc 4096 / 990",     true,  OTA_FLAG_CRC, false, 4096, FRAG_FIXED,  BENCH_SPP_MTU, 0,  0, false, false },
+    { "ventana+crc+sha 1021 / 990", true,  OTA_FLAG_CRC, true,  1021, FRAG_FIXED,  BENCH_SPP_MTU, 0,  0, false, false },
+    { "ventana+crc basura 10%",     true,  OTA_FLAG_CRC, false, 1021, FRAG_RANDOM, 0,             10, 0, false, false },
+    { "ventana+crc errores 1%",     true,  OTA_FLAG_CRC, false, 1021, FRAG_FIXED,  BENCH_SPP_MTU, 0,  1, false, false },
+    { "reanudacion a mitad",        true,  OTA_FLAG_CRC, true,  1021, FRAG_FIXED,  BENCH_SPP_MTU, 0,  0, true,  false },
+    { "ventana+crc 2 hilos",        true,  OTA_FLAG_CRC, false, 1021, FRAG_RANDOM, 0,             0,  0, false, true  },
+    { "ventana+creditos 2 hilos",   true,  OTA_FLAG_CRC | OTA_FLAG_CREDIT, false, 1021, FRAG_RANDOM, 0, 0, 0, false, true },
+    { "creditos 4096 2 hilos",      true,  OTA_FLAG_CRC | OTA_FLAG_CREDIT, false, 4096, FRAG_RANDOM, 0, 0, 0, false, true },
+    { "imagen de otro proyecto",    true,  OTA_FLAG_CRC, false, 1021, FRAG_FIXED,  BENCH_SPP_MTU, 0,  0, false, false,
+      PROTO_ERR_PROJECT },
+    { "dedupe 1 de cada 8 sectores", true, OTA_FLAG_CRC | OTA_FLAG_DEDUPE, true, 1021, FRAG_FIXED, BENCH_SPP_MTU, 0, 0,
+      false, false, 0, true },
+};
+
+typedef struct {
+    uint8_t *data;
+    size_t len;
+    size_t cap;
+} bench_stream_t;
+
+typedef struct {
+    uint32_t acks;
+    uint32_t naks;
+    uint32_t sacks;
+    uint32_t snaks;
+    uint8_t last[STATUS_MAX_LEN];    // Última respuesta (TLV_OFFSET, hashes, STATUS)
+    size_t last_len;
+    uint8_t first_err;               // Código del primer SNAK/NAK con código
+    size_t err_bytes;                // Bytes de imagen recibidos al llegar ese error
+} bench_responses_t;
+
+static bench_responses_t s_resp;
+static int s_sessions;               // Avisos de sesión: inicios - fines (ota_proto_set_session_cb)
+static bool s_sessions_ok;           // Nunca dos inicios ni dos fines seguidos
+static uint8_t s_sector_hashes[HOST_PARTITION_SIZE / FLASH_SECTOR_SIZE][SECTOR_HASH_LEN];
+static _Atomic uint32_t s_credit;    // Último límite de crédito recibido (OTA_FLAG_CREDIT)
+static size_t s_credit_origin;       // Offset del flujo donde empiezan a contar los créditos
+static uint32_t s_rng = 0x2545F491;
+
+static uint32_t bench_rand_r(uint32_t *state)
+{
+    // xorshift32: reproducible entre ejecuciones
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+static uint32_t bench_rand(void)
+{
+    return bench_rand_r(&s_rng);
+}
+
+static double bench_cpu_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static uint32_t bench_be32(const uint8_t *p)
+{
+    return ((uint32_t)p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+/**
+ * @brief Buscar un TLV en la respuesta ACK de START_OTA_EXT / RESUME_OTA
+ * @return Puntero al valor o NULL si no está
+ */
+static const uint8_t *bench_find_tlv(const uint8_t *data, size_t len, uint8_t type, uint8_t vlen)
+{
+    if (len < 2 || data[0] != PROTO_ACK || len != 2u + data[1]) {
+        return NULL;
+    }
+    for (size_t pos = 2; pos + 2 <= len; pos += 2 + data[pos + 1]) {
+        if (data[pos] == type && data[pos + 1] == vlen && pos + 2 + vlen <= len) {
+            return &data[pos + 2];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Crédito de una respuesta: TLV_CREDIT del ACK de START, o credit[4] de SACK/SNAK
+ */
+static void bench_parse_credit(const uint8_t *data, size_t len)
+{
+    if (data[0] == PROTO_SACK && len == 7) {
+        atomic_store_explicit(&s_credit, bench_be32(&data[3]), memory_order_release);
+    } else if (data[0] == PROTO_SNAK && len == 8) {
+        atomic_store_explicit(&s_credit, bench_be32(&data[4]), memory_order_release);
+    } else {
+        const uint8_t *credit = bench_find_tlv(data, len, TLV_CREDIT, 4);
+        if (credit) {
+            atomic_store_explicit(&s_credit, bench_be32(credit), memory_order_release);
+        }
+    }
+}
+
+static esp_err_t bench_send(void *ctx, const uint8_t *data, size_t len)
+{
+    (void)ctx;
+    if (len == 0) return ESP_OK;
+
+    switch (data[0]) {
+    case PROTO_ACK: s_resp.acks++; break;
+    case PROTO_NAK: s_resp.naks++; break;
+    case PROTO_SACK: s_resp.sacks++; break;
+    case PROTO_SNAK: s_resp.snaks++; break;
+    default: break;
+    }
+    bench_parse_credit(data, len);
+
+    if (!s_resp.first_err && ((data[0] == PROTO_SNAK && len >= 4) || (data[0] == PROTO_NAK && len == 2))) {
+        s_resp.first_err = (data[0] == PROTO_SNAK) ? data[3] : data[1];
+        s_resp.err_bytes = ota_state.bytes_received;
+    }
+
+    s_resp.last_len = len < sizeof(s_resp.last) ? len : sizeof(s_resp.last);
+    memcpy(s_resp.last, data, s_resp.last_len);
+    return ESP_OK;
+}
+
+static const ota_proto_transport_t s_bench_transport = {
+    .name = "bench",
+    .send = bench_send,
+};
+
+static void bench_session_cb(bool active, const char *transport)
+{
+    s_sessions += active ? 1 : -1;
+    if (s_sessions < 0 || s_sessions > 1 || strcmp(transport, "bench") != 0) {
+        s_sessions_ok = false;
+    }
+}
+
+// ============================================================================
+// Construcción de flujos (lo que enviaría send_ota_bt.py)
+// ============================================================================
+
+static void stream_put(bench_stream_t *st, const void *data, size_t len)
+{
+    if (st->len + len > st->cap) {
+        st->cap = (st->len + len) * 2;
+        st->data = realloc(st->data, st->cap);
+        if (!st->data) {
+            fprintf(stderr, "Sin memoria para el flujo\n");
+            exit(1);
+        }
+    }
+    memcpy(st->data + st->len, data, len);
+    st->len += len;
+}
+
+static void stream_put_u8(bench_stream_t *st, uint8_t v)
+{
+    stream_put(st, &v, 1);
+}
+
+static void stream_put_be(bench_stream_t *st, uint32_t v, int bytes)
+{
+    while (bytes--) {
+        stream_put_u8(st, v >> (8 * bytes));
+    }
+}
+
+/**
+ * @brief Bytes que no son comandos (el receptor los descarta uno a uno)
+ */
+static void stream_put_garbage(bench_stream_t *st, const scenario_t *sc)
+{
+    if (sc->garbage_pct == 0 || bench_rand() % 100 >= sc->garbage_pct) return;
+
+    int n = 1 + bench_rand() % 8;
+    while (n--) {
+        stream_put_u8(st, 0x10 + bench_rand() % 0x90);
+    }
+}
+
+static void stream_put_start(bench_stream_t *st, uint8_t cmd, const scenario_t *sc,
+                             size_t size, const uint8_t *digest)
+{
+    uint8_t tlv_len = 6 + 3 + 3 + 4 + (sc->hash ? 2 + IMAGE_HASH_LEN : 0);
+
+    stream_put_u8(st, cmd);
+    stream_put_be(st, tlv_len, 2);
+    stream_put_u8(st, TLV_IMAGE_SIZE);
+    stream_put_u8(st, 4);
+    stream_put_be(st, size, 4);
+    stream_put_u8(st, TLV_WINDOW);
+    stream_put_u8(st, 1);
+    stream_put_u8(st, BENCH_WINDOW);
+    stream_put_u8(st, TLV_FLAGS);
+    stream_put_u8(st, 1);
+    stream_put_u8(st, sc->flags);
+    stream_put_u8(st, TLV_CHUNK);
+    stream_put_u8(st, 2);
+    stream_put_be(st, sc->chunk, 2);
+    if (sc->hash) {
+        stream_put_u8(st, TLV_IMAGE_HASH);
+        stream_put_u8(st, IMAGE_HASH_LEN);
+        stream_put(st, digest, IMAGE_HASH_LEN);
+    }
+}
+
+/**
+ * @brief Frames DATA_CHUNK / DATA_SEQ de image[from..to) y, si `end`, END_OTA
+ *
+ * Un frame corrupto va seguido de su retransmisión, como haría el emisor
+ * al recibir el SNAK.
+ */
+static void stream_put_data(bench_stream_t *st, const scenario_t *sc,
+                            const uint8_t *image, size_t from, size_t to, bool end)
+{
+    uint16_t seq = 0;
+
+    for (size_t pos = from; pos < to; pos += sc->chunk) {
+        size_t n = (to - pos < sc->chunk) ? to - pos : sc->chunk;
+        stream_put_garbage(st, sc);
+
+        if (!sc->windowed) {
+            stream_put_u8(st, PROTO_DATA_CHUNK);
+            stream_put_be(st, n, 2);
+            stream_put(st, image + pos, n);
+            continue;
+        }
+
+        bool crc = (sc->flags & OTA_FLAG_CRC) != 0;
+        uint32_t crc32 = crc ? esp_rom_crc32_le(0, image + pos, n) : 0;
+        bool corrupt = crc && sc->corrupt_pct && bench_rand() % 100 < sc->corrupt_pct;
+
+        for (int copy = corrupt ? 0 : 1; copy < 2; copy++) {
+            size_t frame = st->len;
+            stream_put_u8(st, PROTO_DATA_SEQ);
+            stream_put_be(st, seq, 2);
+            stream_put_be(st, n, 2);
+            stream_put(st, image + pos, n);
+            if (crc) {
+                stream_put_be(st, crc32, 4);
+            }
+            if (copy == 0) {
+                st->data[frame + DATA_SEQ_HEADER_LEN + bench_rand() % n] ^= 0x04;
+            }
+        }
+        seq++;
+    }
+
+    if (end) {
+        stream_put_garbage(st, sc);
+        stream_put_u8(st, PROTO_END_OTA);
+    }
+}
+
+static void bench_sector_hash(const uint8_t *data, uint8_t out[SECTOR_HASH_LEN])
+{
+    uint8_t digest[IMAGE_HASH_LEN];
+    mbedtls_sha256_context sha;
+    mbedtls_sha256_init(&sha);
+    mbedtls_sha256_starts(&sha, 0);
+    mbedtls_sha256_update(&sha, data, FLASH_SECTOR_SIZE);
+    mbedtls_sha256_finish(&sha, digest);
+    mbedtls_sha256_free(&sha);
+    memcpy(out, digest, SECTOR_HASH_LEN);
+}
+
+/**
+ * @brief Imagen completa con COPY_SEQ para cada racha de sectores iguales al slot en ejecución
+ *
+ * Los sectores distintos y el último, si es parcial, van en DATA_SEQ. Los
+ * hashes son los que devolvió SECTOR_HASH (s_sector_hashes).
+ */
+static void stream_put_dedupe(bench_stream_t *st, const scenario_t *sc, const uint8_t *image, size_t size)
+{
+    bool crc = (sc->flags & OTA_FLAG_CRC) != 0;
+    uint16_t seq = 0;
+    size_t pos = 0;
+
+    while (pos < size) {
+        size_t sector = pos / FLASH_SECTOR_SIZE;
+        uint8_t count = 0;
+        for (size_t at = pos; count < COPY_MAX_SECTORS && at + FLASH_SECTOR_SIZE <= size;
+             at += FLASH_SECTOR_SIZE, count++) {
+            uint8_t hash[SECTOR_HASH_LEN];
+            bench_sector_hash(image + at, hash);
+            if (memcmp(hash, s_sector_hashes[sector + count], SECTOR_HASH_LEN) != 0) break;
+        }
+
+        if (count > 0) {
+            uint8_t frame[COPY_SEQ_LEN] = { PROTO_COPY_SEQ, seq >> 8, seq & 0xFF,
+                                            sector >> 8, sector & 0xFF, count };
+            stream_put(st, frame, sizeof(frame));
+            if (crc) {
+                stream_put_be(st, esp_rom_crc32_le(0, frame + 1, COPY_SEQ_LEN - 1), 4);
+            }
+            seq++;
+            pos += (size_t)count * FLASH_SECTOR_SIZE;
+            continue;
+        }
+
+        size_t end = (size - pos < FLASH_SECTOR_SIZE) ? size : pos + FLASH_SECTOR_SIZE;
+        for (; pos < end; pos += sc->chunk) {
+            size_t n = (end - pos < sc->chunk) ? end - pos : sc->chunk;
+            stream_put_u8(st, PROTO_DATA_SEQ);
+            stream_put_be(st, seq++, 2);
+            stream_put_be(st, n, 2);
+            stream_put(st, image + pos, n);
+            if (crc) {
+                stream_put_be(st, esp_rom_crc32_le(0, image + pos, n), 4);
+            }
+        }
+        pos = end;
+    }
+
+    stream_put_u8(st, PROTO_END_OTA);
+}
+
+// ============================================================================
+// Entrega al módulo
+// ============================================================================
+
+// Productor en otro hilo (escenarios `threaded`)
+typedef struct {
+    const scenario_t *sc;
+    const uint8_t *data;
+    size_t len;
+    atomic_bool done;
+} bench_producer_t;
+
+static bench_producer_t s_producer;
+static pthread_t s_producer_thread;
+static bool s_producer_running = false;
+
+/**
+ * @brief Sitio libre en el anillo visto por el productor
+ */
+static size_t bench_ring_free(const rx_buffer_t *buf)
+{
+    return RX_BUFFER_SIZE - (atomic_load_explicit(&buf->head, memory_order_relaxed) -
+                             atomic_load_explicit(&buf->tail, memory_order_acquire));
+}
+
+static size_t bench_fragment(const scenario_t *sc, uint32_t *rng)
+{
+    return (sc->frag_mode == FRAG_RANDOM) ? 1 + bench_rand_r(rng) % BENCH_MAX_FRAGMENT : sc->frag_size;
+}
+
+/**
+ * @brief Bytes que el productor puede enviar desde `pos` según el último crédito
+ *
+ * Hasta el final del START no hay crédito que respetar (es lo que lo pide).
+ */
+static size_t bench_credit_allowed(size_t pos)
+{
+    if (pos < s_credit_origin) {
+        return s_credit_origin - pos;
+    }
+    uint32_t sent = pos - s_credit_origin;
+    uint32_t limit = atomic_load_explicit(&s_credit, memory_order_acquire);
+    int32_t allowed = (int32_t)(limit - sent);
+    return allowed > 0 ? (size_t)allowed : 0;
+}
+
+/**
+ * @brief Hilo productor: push en cuanto hay sitio (sin control de flujo) o
+ *        en cuanto hay crédito (OTA_FLAG_CREDIT, como send_ota_bt.py)
+ */
+static void *bench_producer_main(void *arg)
+{
+    bench_producer_t *p = arg;
+    uint32_t rng = 0x9E3779B9;
+    bool credit = (p->sc->flags & OTA_FLAG_CREDIT) != 0;
+    size_t pos = 0;
+
+    while (pos < p->len) {
+        size_t n = bench_fragment(p->sc, &rng);
+        if (n > p->len - pos) n = p->len - pos;
+
+        if (credit) {
+            size_t allowed;
+            while ((allowed = bench_credit_allowed(pos)) == 0) {
+                sched_yield();
+            }
+            if (n > allowed) n = allowed;
+        } else {
+            while (bench_ring_free(&ota_state.rx_buf) < n) {
+                sched_yield();
+            }
+        }
+        ota_proto_push(p->data + pos, n);
+        pos += n;
+    }
+
+    atomic_store_explicit(&p->done, true, memory_order_release);
+    return NULL;
+}
+
+static void bench_producer_join(void)
+{
+    if (s_producer_running) {
+        pthread_join(s_producer_thread, NULL);
+        s_producer_running = false;
+    }
+}
+
+/**
+ * @brief Consumidor en este hilo (puede no volver: esp_restart hace longjmp)
+ */
+static void bench_deliver_threaded(const scenario_t *sc, const uint8_t *data, size_t len)
+{
+    s_producer.sc = sc;
+    s_producer.data = data;
+    s_producer.len = len;
+    atomic_store(&s_producer.done, false);
+    if (pthread_create(&s_producer_thread, NULL, bench_producer_main, &s_producer) != 0) {
+        fprintf(stderr, "No se pudo crear el hilo productor\n");
+        exit(1);
+    }
+    s_producer_running = true;
+
+    for (;;) {
+        bool done = atomic_load_explicit(&s_producer.done, memory_order_acquire);
+        ota_proto_process();
+        if (done) break;   // Última pasada con todo lo que se empujó
+        sched_yield();     // Dejar correr al productor (con un solo núcleo)
+    }
+    bench_producer_join();
+}
+
+static void bench_deliver(const scenario_t *sc, const uint8_t *data, size_t len)
+{
+    size_t pos = 0;
+
+    if (sc->threaded) {
+        bench_deliver_threaded(sc, data, len);
+        return;
+    }
+
+    while (pos < len) {
+        size_t n = (sc->frag_mode == FRAG_RANDOM) ? 1 + bench_rand() % BENCH_MAX_FRAGMENT
+                                                  : sc->frag_size;
+        if (n > len - pos) n = len - pos;
+
+        ota_proto_push(data + pos, n);
+        ota_proto_process();
+        pos += n;
+    }
+}
+
+/**
+ * @brief Pedir con SECTOR_HASH los hashes de los sectores que ocupa la imagen
+ */
+static bool bench_query_hashes(const scenario_t *sc, size_t size)
+{
+    size_t sectors = (size + FLASH_SECTOR_SIZE - 1) / FLASH_SECTOR_SIZE;
+
+    for (size_t first = 0; first < sectors; first += SECTOR_HASH_MAX_COUNT) {
+        size_t count = (sectors - first < SECTOR_HASH_MAX_COUNT) ? sectors - first : SECTOR_HASH_MAX_COUNT;
+        uint8_t req[SECTOR_HASH_REQ_LEN] = { PROTO_SECTOR_HASH, first >> 8, first & 0xFF, count };
+
+        s_resp.last_len = 0;
+        bench_deliver(sc, req, sizeof(req));
+        if (s_resp.last_len != 4 + count * SECTOR_HASH_LEN || s_resp.last[0] != PROTO_ACK) {
+            return false;
+        }
+        memcpy(s_sector_hashes[first], &s_resp.last[4], count * SECTOR_HASH_LEN);
+    }
+    return true;
+}
+
+/**
+ * @brief Transferir la imagen completa; termina con esp_restart() si la OTA se confirma
+ */
+static void bench_transfer(const scenario_t *sc, const uint8_t *image, size_t size,
+                           const uint8_t *digest, bench_stream_t *st)
+{
+    size_t from = 0;
+    size_t to = sc->resume ? size / 2 : size;
+
+    if (sc->dedupe && !bench_query_hashes(sc, size)) {
+        return;
+    }
+
+    st->len = 0;
+    if (sc->windowed) {
+        stream_put_start(st, PROTO_START_OTA_EXT, sc, size, digest);
+    } else {
+        stream_put_u8(st, PROTO_START_OTA);
+        stream_put_be(st, size, 4);
+    }
+    s_credit_origin = st->len;
+    atomic_store(&s_credit, 0);
+
+    if (sc->resume) {
+        // Primera mitad sin END y caída del enlace
+        stream_put_data(st, sc, image, 0, to, false);
+        bench_deliver(sc, st->data, st->len);
+        ota_proto_disconnect(&s_bench_transport);
+        ota_proto_connect(&s_bench_transport);
+
+        st->len = 0;
+        stream_put_start(st, PROTO_RESUME_OTA, sc, size, digest);
+        bench_deliver(sc, st->data, st->len);
+        const uint8_t *offset = bench_find_tlv(s_resp.last, s_resp.last_len, TLV_OFFSET, 4);
+        if (!offset) {
+            return;
+        }
+        from = bench_be32(offset);
+        to = size;
+        st->len = 0;
+    }
+
+    if (sc->dedupe) {
+        stream_put_dedupe(st, sc, image, size);
+    } else {
+        stream_put_data(st, sc, image, from, to, true);
+    }
+    bench_deliver(sc, st->data, st->len);
+}
+
+/**
+ * @brief Slot en ejecución con la imagen salvo 1 de cada BENCH_DEDUPE_EVERY sectores
+ */
+static void bench_prepare_running(const uint8_t *image, size_t size)
+{
+    const esp_partition_t *running = esp_ota_get_running_partition();
+    uint8_t *data = host_partition_data(running);
+
+    memset(data, 0xFF, running->size);
+    memcpy(data, image, size);
+    for (size_t sector = 1; sector * FLASH_SECTOR_SIZE < size; sector += BENCH_DEDUPE_EVERY) {
+        data[sector * FLASH_SECTOR_SIZE] ^= 0xFF;
+    }
+}
+
+static bool bench_run(const scenario_t *sc, const uint8_t *image, size_t size,
+                      const uint8_t *digest, bench_stream_t *st, int reps)
+{
+    const esp_partition_t *part = esp_ota_get_next_update_partition(NULL);
+    double wall_s = 0, cpu_s = 0;
+    bool ok = true;
+
+    memset(&s_resp, 0, sizeof(s_resp));
+    for (int r = 0; r < reps && ok; r++) {
+        uint32_t overflows = atomic_load(&ota_state.rx_buf.overflows);
+        s_resp.first_err = 0;
+        host_reset();
+        s_sessions = 0;
+        s_sessions_ok = true;
+        memset(host_partition_data(part), 0, part->size);   // Sin borrar, una escritura da 0
+        if (sc->dedupe) {
+            bench_prepare_running(image, size);
+        }
+        ota_proto_connect(&s_bench_transport);
+
+        jmp_buf restart;
+        volatile bool restarted = false;
+        host_restart_jmp = &restart;
+
+        int64_t t0 = esp_timer_get_time();
+        double c0 = bench_cpu_seconds();
+        if (setjmp(restart) == 0) {
+            bench_transfer(sc, image, size, digest, st);
+        } else {
+            restarted = true;
+        }
+        wall_s += (esp_timer_get_time() - t0) / 1e6;
+        cpu_s += bench_cpu_seconds() - c0;
+        host_restart_jmp = NULL;
+        bench_producer_join();
+
+        if (sc->reject) {
+            // Rechazo con el primer chunk, sin llegar a escribir la cabecera
+            ok = !restarted && host_boot_partition() == NULL && s_resp.first_err == sc->reject &&
+                 s_resp.err_bytes == 0 && host_partition_data(part)[0] != ESP_IMAGE_HEADER_MAGIC &&
+                 s_sessions_ok && s_sessions == 0;
+        } else {
+            // El aviso de fin no llega tras un END correcto (reinicia)
+            ok = restarted && host_boot_partition() == part && s_sessions_ok && s_sessions == 1 &&
+                 memcmp(host_partition_data(part), image, size) == 0 &&
+                 atomic_load(&ota_state.rx_buf.overflows) == overflows &&
+                 (!sc->dedupe || ota_state.bytes_copied > 0);
+        }
+        ota_proto_disconnect(&s_bench_transport);
+    }
+
+    if (sc->reject) {
+        printf("%-28s %9s %10s %8" PRIu32 " %6" PRIu32 "   %s (código 0x%02X)\n", sc->name, "-", "-",
+               (s_resp.acks + s_resp.sacks) / reps, s_resp.snaks / reps, ok ? "OK" : "FALLO", s_resp.first_err);
+        return ok;
+    }
+
+    double mb = (double)size * reps / (1024.0 * 1024.0);
+    printf("%-28s %9.1f %10.2f %8" PRIu32 " %6" PRIu32 "   %s\n", sc->name,
+           ok ? mb / wall_s : 0.0, ok ? cpu_s * 1000.0 / mb : 0.0,
+           (s_resp.acks + s_resp.sacks) / reps, s_resp.snaks / reps, ok ? "OK" : "FALLO");
+    return ok;
+}
+
+/**
+ * @brief STATUS sin sesión: la respuesta debe describir la última sesión (s_telemetry)
+ *
+ * Llega tras un '\n' suelto, como el de un terminal en la UART: ese byte se
+ * descarta sin respuesta.
+ */
+static bool bench_status(void)
+{
+    static const scenario_t sc = { .frag_mode = FRAG_FIXED, .frag_size = BENCH_SPP_MTU };
+    const uint8_t cmd[] = { '\n', PROTO_STATUS };
+    bool ok = true;
+
+    ota_proto_connect(&s_bench_transport);
+    s_resp.last_len = 0;
+    uint32_t acks = s_resp.acks, naks = s_resp.naks;
+    bench_deliver(&sc, cmd, sizeof(cmd));
+    ota_proto_disconnect(&s_bench_transport);
+    ok = s_resp.acks == acks + 1 && s_resp.naks == naks;
+
+    const uint8_t *r = s_resp.last;
+    size_t len = s_resp.last_len;
+    if (len < 3 || r[0] != PROTO_ACK || (size_t)((r[1] << 8) | r[2]) != len - 3) {
+        printf("STATUS: respuesta inválida (%zu bytes)   FALLO\n", len);
+        return false;
+    }
+
+    // Cada histograma debe llegar igual que en ota_proto_get_telemetry()
+    ota_proto_telemetry_t t;
+    ota_proto_get_telemetry(&t);
+    const ota_proto_hist_t *hists[STATUS_NUM_HIST] = { &t.interarrival, &t.parse, &t.flash_wait, &t.write, &t.ack_delay };
+    int found = 0;
+    for (size_t pos = 3; pos + 2 <= len; pos += 2 + r[pos + 1]) {
+        if (r[pos] != STATUS_TLV_HIST) continue;
+        const uint8_t *v = &r[pos + 2];
+        const ota_proto_hist_t *h = hists[v[0] % STATUS_NUM_HIST];
+        ok = ok && v[0] < STATUS_NUM_HIST && r[pos + 1] == STATUS_HIST_LEN && bench_be32(&v[1]) == h->count &&
+             bench_be32(&v[5]) == h->max_us && bench_be32(&v[17]) == h->bucket[0];
+        found++;
+    }
+    ok = ok && found == STATUS_NUM_HIST && t.parse.count > 0 && t.write.count > 0;
+
+    printf("STATUS: %zu bytes, %" PRIu32 " frames, %" PRIu32 " sectores escritos, buffer RX máx %" PRIu32
+           " bytes   %s\n", len, t.parse.count, t.write.count, t.ring_max, ok ? "OK" : "FALLO");
+    return ok;
+}
+
+/**
+ * @brief Cliente nuevo antes de que el consumidor procese el cierre del anterior
+ *        (SPP en modo callback): su STATUS espera al disconnect y no se pierde
+ */
+static bool bench_reconnect(void)
+{
+    uint8_t cmd = PROTO_STATUS;
+
+    ota_proto_connect(&s_bench_transport);
+    ota_proto_close(&s_bench_transport);
+    ota_proto_connect(&s_bench_transport);
+    s_resp.last_len = 0;
+    ota_proto_push(&cmd, 1);
+    ota_proto_process();
+    bool held = s_resp.last_len == 0;          // Aún no: el cierre sigue pendiente
+
+    ota_proto_disconnect(&s_bench_transport);  // Cierre del cliente anterior
+    bool kept = atomic_load(&s_transport) == &s_bench_transport;
+    ota_proto_process();
+    bool answered = s_resp.last_len > 0 && s_resp.last[0] == PROTO_ACK;
+
+    ota_proto_close(&s_bench_transport);
+    ota_proto_disconnect(&s_bench_transport);
+    bool released = atomic_load(&s_transport) == NULL;
+
+    bool ok = held && kept && answered && released;
+    printf("Reconexión antes del cierre: STATUS %s, transporte %s   %s\n",
+           answered ? "respondido" : "perdido", released ? "liberado" : "retenido", ok ? "OK" : "FALLO");
+    return ok;
+}
+
+// ============================================================================
+// Estrés del anillo SPSC
+// ============================================================================
+
+static rx_buffer_t s_stress_ring;
+
+typedef struct {
+    size_t total;                    // Bytes que deben llegar al consumidor
+    bool overflow;                   // El productor no espera: lo que no cabe se descarta, como Bluedroid
+    uint32_t dropped;                // Bytes descartados según el productor (se publica con done)
+    atomic_bool done;
+} bench_ring_job_t;
+
+/**
+ * @brief Productor: secuencia pseudoaleatoria en fragmentos de 1..BENCH_MAX_FRAGMENT bytes
+ *
+ * Con `overflow` entrega cada fragmento una sola vez y la secuencia sigue
+ * desde el último byte guardado, así el consumidor la sigue comprobando.
+ */
+static void *bench_ring_producer(void *arg)
+{
+    bench_ring_job_t *job = arg;
+    uint32_t data_rng = 1, frag_rng = 7;
+    uint8_t frag[BENCH_MAX_FRAGMENT];
+    size_t sent = 0;
+
+    while (sent < job->total) {
+        size_t n = 1 + bench_rand_r(&frag_rng) % BENCH_MAX_FRAGMENT;
+        if (n > job->total - sent) n = job->total - sent;
+        uint32_t frag_start = data_rng;
+        for (size_t i = 0; i < n; i++) {
+            frag[i] = bench_rand_r(&data_rng);
+        }
+
+        if (job->overflow) {
+            size_t stored = rx_buffer_append(&s_stress_ring, frag, n);
+            job->dropped += n - stored;
+            data_rng = frag_start;
+            for (size_t i = 0; i < stored; i++) {
+                bench_rand_r(&data_rng);
+            }
+            if (stored == 0) sched_yield();
+            sent += stored;
+            continue;
+        }
+
+        size_t pos = 0;
+        while (pos < n) {
+            size_t free_space = bench_ring_free(&s_stress_ring);
+            if (free_space == 0) {
+                sched_yield();
+                continue;
+            }
+            size_t part = (n - pos < free_space) ? n - pos : free_space;
+            pos += rx_buffer_append(&s_stress_ring, frag + pos, part);
+        }
+        sent += n;
+    }
+
+    atomic_store_explicit(&job->done, true, memory_order_release);
+    return NULL;
+}
+
+/**
+ * @brief Un hilo escribe y otro consume (read, peek, span+drop) comprobando cada byte
+ *
+ * Con `overflow` el productor descarta lo que no cabe y el consumidor lee el
+ * contador de desbordes mientras tanto, como send_status.
+ * @return true si el consumidor recibió la secuencia exacta y los desbordes cuadran
+ */
+static bool bench_ring_stress(bool overflow)
+{
+    int mb = overflow ? BENCH_RING_OVERFLOW_MB : BENCH_RING_MB;
+    bench_ring_job_t job = { .total = (size_t)mb * 1024 * 1024, .overflow = overflow };
+    uint32_t data_rng = 1, read_rng = 3, overflows = 0;
+    uint8_t chunk[BENCH_RING_MAX_READ];
+    size_t received = 0, errors = 0;
+    pthread_t producer;
+
+    memset(&s_stress_ring, 0, sizeof(s_stress_ring));
+    atomic_store(&job.done, false);
+    int64_t t0 = esp_timer_get_time();
+    if (pthread_create(&producer, NULL, bench_ring_producer, &job) != 0) {
+        return false;
+    }
+
+    while (received < job.total) {
+        size_t want = 1 + bench_rand_r(&read_rng) % BENCH_RING_MAX_READ;
+        size_t got;
+
+        if (want & 1) {
+            // Copia (rx_buffer_read) o peek + drop, como el parser de comandos
+            got = (want & 2) ? rx_buffer_read(&s_stress_ring, chunk, want)
+                             : rx_buffer_peek_at(&s_stress_ring, 0, chunk, want);
+            if (!(want & 2)) rx_buffer_drop(&s_stress_ring, got);
+            for (size_t i = 0; i < got; i++) {
+                errors += chunk[i] != (uint8_t)bench_rand_r(&data_rng);
+            }
+        } else {
+            // Sin copia, como writer_feed
+            const uint8_t *ptr;
+            got = rx_buffer_span(&s_stress_ring, 0, &ptr);
+            if (got > want) got = want;
+            for (size_t i = 0; i < got; i++) {
+                errors += ptr[i] != (uint8_t)bench_rand_r(&data_rng);
+            }
+            rx_buffer_drop(&s_stress_ring, got);
+        }
+
+        if (got == 0) {
+            // Nunca decrece: solo lo escribe el productor, con release
+            uint32_t now = atomic_load_explicit(&s_stress_ring.overflows, memory_order_acquire);
+            errors += now < overflows;
+            overflows = now;
+            if (atomic_load_explicit(&job.done, memory_order_acquire) && rx_buffer_count(&s_stress_ring) == 0) {
+                break;   // El productor terminó y no queda nada: faltan bytes
+            }
+            sched_yield();
+        }
+        received += got;
+    }
+    pthread_join(producer, NULL);
+
+    double secs = (esp_timer_get_time() - t0) / 1e6;
+    overflows = atomic_load_explicit(&s_stress_ring.overflows, memory_order_acquire);
+    bool ok = received == job.total && errors == 0 &&
+              (overflow ? overflows == job.dropped && overflows > 0 : overflows == 0);
+    if (overflow) {
+        printf("Anillo SPSC con desbordes, 2 hilos, %d MB: %" PRIu32 " bytes descartados, %zu bytes erróneos   %s\n\n",
+               mb, overflows, errors, ok ? "OK" : "FALLO");
+    } else {
+        printf("Anillo SPSC, 2 hilos, %d MB: %.1f MB/s, %zu bytes erróneos   %s\n",
+               mb, mb / secs, errors, ok ? "OK" : "FALLO");
+    }
+    return ok;
+}
+
+// ============================================================================
+// main
+// ============================================================================
+
+/**
+ * @brief Cabecera de imagen y esp_app_desc_t válidos para este "dispositivo"
+ */
+static void bench_put_image_header(uint8_t *image, const char *project)
+{
+    esp_image_header_t hdr = {
+        .magic = ESP_IMAGE_HEADER_MAGIC,
+        .segment_count = 1,
+        .chip_id = CONFIG_IDF_FIRMWARE_CHIP_ID,
+    };
+    esp_app_desc_t desc = {
+        .magic_word = ESP_APP_DESC_MAGIC_WORD,
+        .version = "2",
+    };
+    strncpy(desc.project_name, project, sizeof(desc.project_name) - 1);
+
+    memcpy(image, &hdr, sizeof(hdr));
+    memcpy(image + sizeof(hdr) + sizeof(esp_image_segment_header_t), &desc, sizeof(desc));
+}
+
+/**
+ * @brief Copia de la imagen con otro project_name (p. ej. i2c_oled.bin en el dispositivo OTA)
+ */
+static uint8_t *bench_foreign_image(const uint8_t *image, size_t size)
+{
+    uint8_t *copy = malloc(size);
+    if (!copy) return NULL;
+
+    memcpy(copy, image, size);
+    size_t name = sizeof(esp_image_header_t) + sizeof(esp_image_segment_header_t) +
+                  offsetof(esp_app_desc_t, project_name);
+    memset(copy + name, 0, sizeof(((esp_app_desc_t *)0)->project_name));
+    memcpy(copy + name, "i2c_oled", 8);
+    return copy;
+}
+
+static uint8_t *bench_load_image(const char *path, size_t *size)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f) return NULL;
+
+    fseek(f, 0, SEEK_END);
+    long len = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    uint8_t *data = (len > 0 && len <= HOST_PARTITION_SIZE) ? malloc(len) : NULL;
+    if (data && fread(data, 1, len, f) != (size_t)len) {
+        free(data);
+        data = NULL;
+    }
+    fclose(f);
+
+    *size = len;
+    return data;
+}
+
+int main(int argc, char **argv)
+{
+    size_t size = BENCH_DEFAULT_KB * 1024;
+    int reps = BENCH_DEFAULT_REPS;
+    int opt;
+
+    host_log_level = ESP_LOG_ERROR;
+    while ((opt = getopt(argc, argv, "s:n:v")) != -1) {
+        switch (opt) {
+        case 's': size = (size_t)atoi(optarg) * 1024; break;
+        case 'n': reps = atoi(optarg); break;
+        case 'v': host_log_level = ESP_LOG_INFO; break;
+        default:
+            fprintf(stderr, "Uso: %s [-s KB] [-n repeticiones] [-v] [imagen.bin]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    uint8_t *image;
+    if (optind < argc) {
+        image = bench_load_image(argv[optind], &size);
+        if (!image) {
+            fprintf(stderr, "No se pudo leer %s (máximo %d bytes)\n", argv[optind], HOST_PARTITION_SIZE);
+            return 1;
+        }
+    } else {
+        if (size < OTA_IMAGE_CHECK_LEN || size > HOST_PARTITION_SIZE || reps <= 0) {
+            fprintf(stderr, "Tamaño fuera de rango (1..%d KB)\n", HOST_PARTITION_SIZE / 1024);
+            return 2;
+        }
+        image = malloc(size);
+        for (size_t i = 0; i < size; i++) {
+            image[i] = bench_rand();
+        }
+        bench_put_image_header(image, HOST_PROJECT_NAME);
+    }
+
+    uint8_t digest[IMAGE_HASH_LEN];
+    mbedtls_sha256_context sha;
+    mbedtls_sha256_init(&sha);
+    mbedtls_sha256_starts(&sha, 0);
+    mbedtls_sha256_update(&sha, image, size);
+    mbedtls_sha256_finish(&sha, digest);
+    mbedtls_sha256_free(&sha);
+
+    if (ota_proto_init() != ESP_OK) {
+        fprintf(stderr, "No se pudo iniciar el escritor\n");
+        return 1;
+    }
+    ota_proto_set_session_cb(bench_session_cb);
+
+    int failures = bench_ring_stress(false) ? 0 : 1;
+    if (!bench_ring_stress(true)) {
+        failures++;
+    }
+
+    printf("Imagen: %zu bytes, %d repeticiones por escenario\n\n", size, reps);
+    printf("%-28s %9s %10s %8s %6s\n", "Escenario", "MB/s", "CPU ms/MB", "ACKs", "SNAKs");
+
+    uint8_t *foreign = bench_foreign_image(image, size);
+    bench_stream_t st = {0};
+    for (size_t i = 0; i < sizeof(s_scenarios) / sizeof(s_scenarios[0]); i++) {
+        const scenario_t *sc = &s_scenarios[i];
+        if (!bench_run(sc, sc->reject ? foreign : image, size, digest, &st, reps)) {
+            failures++;
+        }
+    }
+
+    if (!bench_status()) {
+        failures++;
+    }
+    if (!bench_reconnect()) {
+        failures++;
+    }
+
+    free(st.data);
+    free(foreign);
+    free(image);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,226 @@
+/*
+ * Dispositivo OTA simulado en un pseudo-terminal.
+ *
+ * Compila ota_proto.c tal cual contra los stubs de host/stubs y lo conecta
+ * al maestro de un pty: lo que el PC escribe en el esclavo (/dev/pts/N)
+ * entra por ota_proto_receive() y las respuestas salen por el maestro, como
+ * haría ota_uart_task con una UART. send_ota_bt.py abre el esclavo como un
+ * puerto serie, así que se puede probar el emisor (p. ej. --fleet con varios
+ * dispositivos) sin ESP32.
+ *
+ * Uso: ota_proto_pty [-v] [-b] [-l enlace] [-e imagen.bin] [-r en_ejecucion.bin] [-x bytes]
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <termios.h>
+#include <poll.h>
+#include "host_port.h"
+#include "../ota_proto.c"
+
+#define PTY_READ_SIZE 4096
+#define PTY_RESTART_DELAY_S 2        // Como el ESP32 entre el ACK de END_OTA y esp_restart
+#define PTY_DROP_QUIET_MS 1000       // Enlace caído: se descarta lo recibido hasta este silencio
+#define PTY_TX_BATCH 64              // -b: respuestas agrupadas como SPP en modo VFS
+
+static int s_master = -1;
+static uint8_t s_tx[PTY_TX_BATCH];
+static size_t s_tx_len;
+
+static esp_err_t pty_write(const uint8_t *data, size_t len)
+{
+    while (len > 0) {
+        ssize_t n = write(s_master, data, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return ESP_FAIL;
+        }
+        data += n;
+        len -= n;
+    }
+    return ESP_OK;
+}
+
+static esp_err_t pty_send(void *ctx, const uint8_t *data, size_t len)
+{
+    return pty_write(data, len);
+}
+
+static esp_err_t pty_flush(void *ctx)
+{
+    esp_err_t err = pty_write(s_tx, s_tx_len);
+    s_tx_len = 0;
+    return err;
+}
+
+static esp_err_t pty_send_batched(void *ctx, const uint8_t *data, size_t len)
+{
+    if (s_tx_len + len > sizeof(s_tx)) {
+        pty_flush(ctx);
+        if (len > sizeof(s_tx)) {
+            return pty_write(data, len);
+        }
+    }
+    memcpy(&s_tx[s_tx_len], data, len);
+    s_tx_len += len;
+    return ESP_OK;
+}
+
+static ota_proto_transport_t s_pty_transport = {
+    .name = "pty",
+    .send = pty_send,
+};
+
+static uint8_t *pty_load(const char *path, size_t *size)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f) return NULL;
+
+    uint8_t *data = malloc(HOST_PARTITION_SIZE);
+    *size = data ? fread(data, 1, HOST_PARTITION_SIZE, f) : 0;
+    fclose(f);
+    return data;
+}
+
+/**
+ * @brief Abrir el pty: el esclavo queda abierto y en modo raw para que el PC
+ * pueda conectar y desconectar sin que el maestro vea EIO
+ */
+static const char *pty_open(void)
+{
+    s_master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (s_master < 0 || grantpt(s_master) != 0 || unlockpt(s_master) != 0) {
+        return NULL;
+    }
+
+    const char *name = ptsname(s_master);
+    int slave = name ? open(name, O_RDWR | O_NOCTTY) : -1;
+    if (slave < 0) {
+        return NULL;
+    }
+
+    struct termios tio;
+    tcgetattr(slave, &tio);
+    cfmakeraw(&tio);
+    tcsetattr(slave, TCSANOW, &tio);
+    return name;
+}
+
+int main(int argc, char **argv)
+{
+    const char *link_path = NULL;
+    const char *expected_path = NULL;
+    const char *running_path = NULL;
+    size_t drop_after = 0;
+    int opt;
+
+    host_log_level = ESP_LOG_WARN;
+    while ((opt = getopt(argc, argv, "vbl:e:r:x:")) != -1) {
+        switch (opt) {
+        case 'v': host_log_level = ESP_LOG_INFO; break;
+        case 'b':
+            s_pty_transport.send = pty_send_batched;
+            s_pty_transport.flush = pty_flush;
+            break;
+        case 'l': link_path = optarg; break;
+        case 'e': expected_path = optarg; break;
+        case 'r': running_path = optarg; break;
+        case 'x': drop_after = (size_t)atol(optarg); break;
+        default:
+            fprintf(stderr, "Uso: %s [-v] [-b] [-l enlace] [-e imagen.bin] [-r en_ejecucion.bin] [-x bytes]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    if (running_path) {
+        const esp_partition_t *running = esp_ota_get_running_partition();
+        size_t len;
+        uint8_t *data = pty_load(running_path, &len);
+        if (!data) {
+            fprintf(stderr, "No se pudo leer %s\n", running_path);
+            return 1;
+        }
+        memset(host_partition_data(running), 0xFF, running->size);
+        memcpy(host_partition_data(running), data, len);
+        free(data);
+    }
+
+    const char *slave = pty_open();
+    if (!slave) {
+        perror("pty");
+        return 1;
+    }
+    if (link_path) {
+        unlink(link_path);
+        if (symlink(slave, link_path) != 0) {
+            perror(link_path);
+            return 1;
+        }
+    }
+    printf("PTY: %s%s%s\n", slave, link_path ? " -> " : "", link_path ? link_path : "");
+    fflush(stdout);
+
+    if (ota_proto_init() != ESP_OK || ota_proto_connect(&s_pty_transport) != ESP_OK) {
+        fprintf(stderr, "No se pudo iniciar el protocolo\n");
+        return 1;
+    }
+
+    jmp_buf restart;
+    host_restart_jmp = &restart;
+    if (setjmp(restart) == 0) {
+        static uint8_t buf[PTY_READ_SIZE];
+        size_t received = 0;
+
+        for (;;) {
+            ssize_t n = read(s_master, buf, sizeof(buf));
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) {
+                perror("read");
+                return 1;
+            }
+
+            // -x: el enlace "se cae" una vez; la sesión queda suspendida como al cerrarse SPP.
+            // Lo que el PC siga enviando se pierde hasta que deja de escribir (reconexión)
+            if (drop_after && received < drop_after && received + n >= drop_after) {
+                printf("ENLACE: caída simulada tras %zu bytes\n", drop_after);
+                fflush(stdout);
+                ota_proto_disconnect(&s_pty_transport);
+
+                struct pollfd pfd = { .fd = s_master, .events = POLLIN };
+                while (poll(&pfd, 1, PTY_DROP_QUIET_MS) > 0 && read(s_master, buf, sizeof(buf)) > 0) {
+                }
+                tcflush(s_master, TCIOFLUSH);
+                ota_proto_connect(&s_pty_transport);
+                printf("ENLACE: reconectado\n");
+                fflush(stdout);
+                received += n;
+                continue;
+            }
+            received += n;
+            ota_proto_receive(buf, n);
+        }
+    }
+
+    // esp_restart(): el ACK de END_OTA ya está en el pty; dejar que el PC lo lea
+    sleep(PTY_RESTART_DELAY_S);
+
+    const esp_partition_t *boot = host_boot_partition();
+    int status = boot ? 0 : 1;
+    if (boot && expected_path) {
+        size_t len;
+        uint8_t *expected = pty_load(expected_path, &len);
+        status = (expected && memcmp(host_partition_data(boot), expected, len) == 0) ? 0 : 1;
+        free(expected);
+    }
+    printf("REINICIO: arranque %s%s\n", boot ? boot->label : "sin cambiar",
+           expected_path ? (status == 0 ? ", imagen OK" : ", imagen DISTINTA") : "");
+
+    if (link_path) {
+        unlink(link_path);
+    }
+    return status;
+}
@@ -0,0 +1,5 @@
+#pragma once
+
+// Sin menuconfig: cada módulo usa sus valores por defecto (#ifndef CONFIG_...)
+
+#define CONFIG_IDF_FIRMWARE_CHIP_ID 0x0000   // ESP32
@@ -0,0 +1,2055 @@
+#include <string.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "esp_log.h"
+#include "esp_ota_ops.h"
+#include "esp_partition.h"
+#include "esp_timer.h"
+#include "esp_system.h"
+#include "esp_rom_crc.h"
+#include "nvs.h"
+#include "ota_stream.h"
+#include "ota_image_check.h"
+#include "ota_proto.h"
+
+#define TAG "ota_proto"
+
+// Protocolo
+#define PROTO_START_OTA 0x01
+#define PROTO_DATA_CHUNK 0x02
+#define PROTO_END_OTA 0x03
+#define PROTO_START_OTA_EXT 0x04   // START con negociación (TLV)
+#define PROTO_DATA_SEQ 0x05        // DATA_CHUNK con número de secuencia
+#define PROTO_ABORT_OTA 0x06
+#define PROTO_RESUME_OTA 0x07      // Reanudar sesión guardada (mismo formato que START_OTA_EXT)
+#define PROTO_SECTOR_HASH 0x08     // Hashes de sectores de la app en ejecución: 0x08 | first[2] | count[1]
+#define PROTO_COPY_SEQ 0x09        // Copiar sectores de la app en ejecución: 0x09 | seq[2] | sector[2] | count[1]
+#define PROTO_STATUS 0xC1          // Telemetría de la sesión actual o última: 0xAA | len[2] | TLV...
+                                   // Fuera de ASCII y nunca válido en UTF-8: no lo dispara un '\n' suelto
+#define PROTO_ACK 0xAA
+#define PROTO_SACK 0xAB            // ACK acumulativo: 0xAB | next_seq[2]
+#define PROTO_SNAK 0xAC            // NAK selectivo: 0xAC | next_seq[2] | código
+#define PROTO_NAK 0xFF
+
+// TLVs de START_OTA_EXT (type[1] | len[1] | value)
+#define TLV_IMAGE_SIZE 0x01        // uint32_t big-endian
+#define TLV_WINDOW 0x02            // uint8_t, chunks en vuelo
+#define TLV_FLAGS 0x03             // uint8_t, OTA_FLAG_*
+#define TLV_IMAGE_HASH 0x04        // SHA-256 de la imagen (32 bytes), identifica la sesión
+#define TLV_OFFSET 0x05            // uint32_t big-endian, bytes ya escritos (respuesta a RESUME)
+#define TLV_CREDIT 0x06            // uint32_t big-endian, crédito inicial en bytes (respuesta, OTA_FLAG_CREDIT)
+#define TLV_CHUNK 0x07             // uint16_t big-endian, payload máximo por DATA_SEQ (pedido / aceptado)
+#define TLV_RX_BUFFER 0x08         // uint32_t big-endian, tamaño del buffer RX (respuesta)
+
+// Flags de START_OTA_EXT
+#define OTA_FLAG_DEFLATE (1 << 0)  // Payload deflate raw (ventana OTA_INFLATE_WINDOW_SIZE)
+#define OTA_FLAG_DELTA (1 << 1)    // Payload es un parche contra la imagen en ejecución
+#define OTA_FLAG_CRC (1 << 2)      // Cada DATA_SEQ lleva crc32[4] tras los datos
+#define OTA_FLAG_CREDIT (1 << 3)   // Control de flujo por créditos: SACK/SNAK llevan credit[4]
+#define OTA_FLAG_DEDUPE (1 << 4)   // COPY_SEQ: los sectores iguales se copian del slot en ejecución
+#define OTA_FLAGS_TRANSFORM (OTA_FLAG_DEFLATE | OTA_FLAG_DELTA)
+#define OTA_FLAGS_RESUMABLE (OTA_FLAG_CRC | OTA_FLAG_CREDIT | OTA_FLAG_DEDUPE)
+#define OTA_FLAGS_SUPPORTED (OTA_FLAGS_TRANSFORM | OTA_FLAGS_RESUMABLE)
+
+// Códigos de error (modo ventana: 0xFF | código)
+#define PROTO_ERR_STATE 0x01
+#define PROTO_ERR_PARTITION 0x02
+#define PROTO_ERR_BEGIN 0x03
+#define PROTO_ERR_LENGTH 0x04
+#define PROTO_ERR_SEQ 0x05
+#define PROTO_ERR_WRITE 0x06
+#define PROTO_ERR_END 0x07
+#define PROTO_ERR_BOOT 0x08
+#define PROTO_ERR_PARAM 0x09
+#define PROTO_ERR_BASE 0x0A        // El parche delta no corresponde a la imagen en ejecución
+#define PROTO_ERR_RESUME 0x0B      // No hay sesión guardada para esa imagen
+#define PROTO_ERR_CRC 0x0C         // CRC32 de un DATA_SEQ incorrecto (retransmitir)
+#define PROTO_ERR_DIGEST 0x0D      // SHA-256 de la imagen no coincide con TLV_IMAGE_HASH
+#define PROTO_ERR_IMAGE 0x0E       // Los primeros bytes no son una imagen de app
+#define PROTO_ERR_CHIP 0x0F        // Imagen compilada para otro chip
+#define PROTO_ERR_PROJECT 0x10     // Imagen de otro proyecto
+#define PROTO_ERR_SECURE_VERSION 0x11  // secure_version menor que la de la app en ejecución
+
+// Estados OTA
+#define OTA_STATE_IDLE 0
+#define OTA_STATE_STARTED 1
+#define OTA_STATE_RECEIVING 2
+#define OTA_STATE_ENDING 3
+
+// Buffer de recepción (debe caber la ventana completa; potencia de 2)
+#ifdef CONFIG_OTA_PROTO_RX_BUFFER_SIZE
+#define RX_BUFFER_SIZE CONFIG_OTA_PROTO_RX_BUFFER_SIZE
+#else
+#define RX_BUFFER_SIZE 16384
+#endif
+#define RX_INDEX_ALIGN 64          // head y tail en líneas de caché distintas (sin false sharing)
+#define RX_LINK_CLOSED   (1 << 0)  // ota_proto_close: conexión cerrada, falta ota_proto_disconnect
+#define RX_LINK_REOPENED (1 << 1)  // El mismo transporte volvió a conectar antes de ota_proto_disconnect
+#define MAX_CHUNK_PAYLOAD 1021    // DATA_CHUNK y sesiones que no negocian TLV_CHUNK
+
+// Modo ventana
+#define START_EXT_MAX_LEN 64
+#define DATA_SEQ_HEADER_LEN 5      // 0x05 | seq[2] | len[2]
+#define DATA_SEQ_CRC_LEN 4         // crc32[4] big-endian (con OTA_FLAG_CRC)
+#define DATA_SEQ_OVERHEAD (DATA_SEQ_HEADER_LEN + DATA_SEQ_CRC_LEN)
+#define COPY_SEQ_LEN 6             // 0x09 | seq[2] | sector[2] | count[1] (+ crc32[4] con OTA_FLAG_CRC)
+#define COPY_MAX_SECTORS 16        // Por COPY_SEQ: acota lo que la copia bloquea la task de protocolo
+#define SECTOR_HASH_REQ_LEN 4      // 0x08 | first[2] | count[1]
+#define SECTOR_HASH_LEN 16         // Primeros 16 bytes del SHA-256 del sector
+#define SECTOR_HASH_MAX_COUNT 32   // Hashes por respuesta
+#define MAX_WINDOW_CREDIT 255      // Con créditos el límite real son los bytes libres, no los chunks
+
+// Payload máximo negociable con TLV_CHUNK: caben al menos dos frames en el buffer RX
+#ifdef CONFIG_OTA_PROTO_MAX_CHUNK
+#define MAX_CHUNK_CONFIG CONFIG_OTA_PROTO_MAX_CHUNK
+#else
+#define MAX_CHUNK_CONFIG 4096
+#endif
+#define MAX_CHUNK_NEGOTIATED ((MAX_CHUNK_CONFIG) < RX_BUFFER_SIZE / 2 - DATA_SEQ_OVERHEAD ? \
+                              (MAX_CHUNK_CONFIG) : RX_BUFFER_SIZE / 2 - DATA_SEQ_OVERHEAD)
+
+// Borrado de la partición OTA al recibir START_OTA
+#define OTA_ERASE_FULL 0           // Todo el slot antes del ACK (comportamiento original)
+#define OTA_ERASE_IMAGE_SIZE 1     // Solo los sectores del tamaño anunciado, antes del ACK
+#define OTA_ERASE_SEQUENTIAL 2     // Sector a sector dentro de esp_ota_write (task escritora)
+#define OTA_ERASE_MODE OTA_ERASE_SEQUENTIAL
+
+// Escritor de flash: buffers alineados a sector, doble buffer
+#define FLASH_SECTOR_SIZE 4096
+#define WRITER_NUM_BUFFERS 2
+#define WRITER_TASK_STACK 4096
+#define WRITER_TASK_PRIO 5
+
+// Reanudación: identidad de la imagen y offset escrito en NVS
+#define RESUME_NVS_NAMESPACE "ota_bt"    // Nombre heredado del módulo SPP: conserva sesiones guardadas
+#define RESUME_NVS_KEY "session"
+#define RESUME_SAVE_INTERVAL (64 * 1024)  // Bytes de imagen entre guardados
+#define IMAGE_HASH_LEN 32
+
+// TLV de la respuesta a STATUS (valores big-endian)
+#define STATUS_TLV_SESSION 0x01    // estado[1] | recibidos[4] | imagen[4] | esperados[4] | ms[4]
+#define STATUS_TLV_COUNTERS 0x02   // naks[4] | crc[4] | huecos[4] | duplicados[4] | overflows[4] | esperas[4]
+#define STATUS_TLV_MEMORY 0x03     // buffer RX máx[4] | tamaño[4] | heap mín sesión[4] | heap mín arranque[4]
+#define STATUS_TLV_HIST 0x04       // id[1] | count[4] | max_us[4] | sum_us[8] | bucket[4] × OTA_PROTO_HIST_BUCKETS
+#define STATUS_HIST_LEN (1 + 4 + 4 + 8 + 4 * OTA_PROTO_HIST_BUCKETS)
+#define STATUS_NUM_HIST 5
+#define STATUS_MAX_LEN (3 + (2 + 17) + (2 + 24) + (2 + 16) + STATUS_NUM_HIST * (2 + STATUS_HIST_LEN))
+
+typedef struct {
+    size_t size;             // Tamaño final de la imagen (descomprimida)
+    uint8_t window;
+    uint8_t flags;
+    uint16_t chunk;          // Payload máximo pedido (0: no negociado, MAX_CHUNK_PAYLOAD)
+    bool has_hash;
+    uint8_t hash[IMAGE_HASH_LEN];
+} ota_start_params_t;
+
+// Registro persistente de una sesión reanudable
+typedef struct {
+    uint32_t part_addr;      // Partición destino
+    uint32_t size;           // Tamaño de la imagen
+    uint32_t offset;         // Bytes escritos en flash (alineado a sector)
+    uint8_t hash[IMAGE_HASH_LEN];
+} ota_resume_record_t;
+
+_Static_assert((RX_BUFFER_SIZE & (RX_BUFFER_SIZE - 1)) == 0, "RX_BUFFER_SIZE debe ser potencia de 2");
+
+/*
+ * Anillo SPSC sin locks entre el transporte (productor: callback SPP o task
+ * de lectura) y la task que procesa (consumidor).
+ *
+ * head y tail son contadores libres (la posición es índice & (RX_BUFFER_SIZE - 1))
+ * y cada uno tiene un único escritor:
+ *   - head: solo el productor. Escribe los bytes y después publica head con
+ *     release; el consumidor lo lee con acquire y ve los bytes completos.
+ *   - tail: solo el consumidor. Termina de leer los bytes y después publica
+ *     tail con release; el productor lo lee con acquire antes de reutilizarlos.
+ * El productor nunca toca tail: si no hay sitio descarta lo que no cabe
+ * (overflows) y el emisor lo recupera por CRC/secuencia/timeout.
+ * Para vaciar el anillo al conectar, el productor publica flush_head y el
+ * consumidor descarta hasta ahí en su siguiente pasada (rx_buffer_apply_flush).
+ * Si la conexión se cierra en el productor (ota_proto_close), este publica
+ * close_head y RX_LINK_CLOSED: el consumidor no pasa de close_head hasta
+ * ota_proto_disconnect, porque lo que llega después es de la conexión siguiente.
+ */
+typedef struct {
+    _Alignas(RX_INDEX_ALIGN) atomic_size_t head;   // Próximo byte a escribir (productor)
+    atomic_size_t flush_head;                      // head al pedir el vaciado (productor)
+    atomic_bool flush;                             // Vaciado pendiente (productor → consumidor)
+    atomic_size_t close_head;                      // head al cerrarse la conexión (productor)
+    atomic_uint link;                              // RX_LINK_*: cierre pendiente de ota_proto_disconnect
+    atomic_uint_least32_t overflows;               // Bytes descartados por falta de sitio (productor)
+    atomic_size_t max_append;                      // Mayor entrega del transporte (≈ MTU del enlace)
+    _Alignas(RX_INDEX_ALIGN) atomic_size_t tail;   // Próximo byte a leer (consumidor)
+    _Alignas(RX_INDEX_ALIGN) uint8_t buffer[RX_BUFFER_SIZE];
+} rx_buffer_t;
+
+typedef struct {
+    uint8_t ota_state;
+    esp_ota_handle_t ota_handle;
+    const esp_partition_t *update_partition;
+    size_t bytes_received;   // Bytes de payload recibidos (comprimidos si aplica)
+    size_t expected_size;    // Tamaño final de la imagen
+    uint32_t start_time;
+    uint32_t chunk_count;
+    bool windowed;           // Sesión iniciada con START_OTA_EXT
+    uint8_t window;          // Ventana negociada (chunks)
+    uint16_t max_chunk;      // Payload máximo por DATA_SEQ negociado
+    uint16_t next_seq;       // Próxima secuencia esperada
+    uint16_t acked_seq;      // Última secuencia confirmada con SACK
+    bool gap_reported;       // Ya se envió SNAK para el hueco actual
+    bool crc;                // DATA_SEQ con CRC32 (OTA_FLAG_CRC)
+    bool credit;             // Control de flujo por créditos (OTA_FLAG_CREDIT)
+    bool dedupe;             // COPY_SEQ permitido (OTA_FLAG_DEDUPE)
+    size_t bytes_copied;     // Bytes de imagen copiados del slot en ejecución
+    size_t credit_base;      // tail del buffer RX tras el START: origen de los créditos
+    uint32_t credit_sent;    // Último límite anunciado al emisor
+    rx_buffer_t rx_buf;      // Anillo SPSC: ver rx_buffer_t
+} ota_proto_state_t;
+
+static ota_proto_state_t ota_state = {
+    .ota_state = OTA_STATE_IDLE,
+    .bytes_received = 0,
+    .expected_size = 0,
+    .chunk_count = 0,
+};
+
+// Transporte que tiene el protocolo (uno a la vez); NULL sin conexión. Se
+// toma con compare-exchange: connect puede llegar desde varias tasks a la vez
+static _Atomic(const ota_proto_transport_t *) s_transport = NULL;
+
+// Aviso de inicio/fin de sesión y si ya se avisó del inicio
+static ota_proto_session_cb_t s_session_cb = NULL;
+static bool s_session_notified = false;
+
+typedef struct {
+    uint8_t data[FLASH_SECTOR_SIZE];
+    size_t len;
+} sector_buf_t;
+
+// Escritor de flash: la task de protocolo llena `s_fill` y lo pasa por
+// `s_write_q`; la task escritora lo devuelve por `s_free_q` tras escribirlo.
+static sector_buf_t s_sector_bufs[WRITER_NUM_BUFFERS];
+static sector_buf_t *s_fill = NULL;
+static QueueHandle_t s_free_q = NULL;
+static QueueHandle_t s_write_q = NULL;
+static TaskHandle_t s_writer_task_handle = NULL;
+static volatile esp_err_t s_writer_err = ESP_OK;
+static ota_proto_writer_stats_t s_writer_stats;
+static size_t s_image_bytes = 0;           // Bytes de imagen entregados a esp_ota_write
+static ota_stream_t *s_stream = NULL;      // Solo en sesiones con OTA_FLAG_DEFLATE/DELTA
+
+// Validación de la cabecera de imagen: la task de protocolo la hace sobre el
+// payload según llega; en sesiones transformadas la imagen solo existe a la
+// salida del pipeline, así que la hace la task escritora en writer_flash_sink.
+static ota_image_check_t s_image_check;
+static bool s_check_in_writer = false;
+
+// Telemetría: todo lo escribe la task de protocolo salvo `write`, que es de
+// la task escritora (se lee tras writer_sync)
+static ota_proto_telemetry_t s_telemetry;
+static int64_t s_last_frame_us = 0;        // Último frame de datos completo (0: ninguno)
+static int64_t s_unacked_us = 0;           // Primer frame sin confirmar (0: todo confirmado)
+static int64_t s_frame_wait_us = 0;        // Esperas por flash dentro del frame en curso
+static uint32_t s_overflows_base = 0;      // rx_buf.overflows al empezar la sesión
+
+// Reanudación: solo sesiones sin transformación (flags 0) que anuncian hash.
+// Una sesión reanudada no tiene handle de esp_ota: escribe con esp_partition_*
+// y la imagen se valida en esp_ota_set_boot_partition.
+static ota_resume_record_t s_resume;
+static bool s_resumable = false;
+static bool s_resumed = false;
+static size_t s_resume_saved = 0;          // Último offset guardado en NVS
+static size_t s_erased_end = 0;            // Fin de la zona ya borrada (sesión reanudada)
+
+/**
+ * @brief Añadir una muestra en µs a un histograma log2
+ */
+static void hist_add(ota_proto_hist_t *h, int64_t us)
+{
+    uint32_t v = (us < 0) ? 0 : (us > UINT32_MAX) ? UINT32_MAX : (uint32_t)us;
+    int b = 0;
+    while (b < OTA_PROTO_HIST_BUCKETS - 1 && (v >> (b + 1)) != 0) {
+        b++;
+    }
+
+    h->bucket[b]++;
+    h->count++;
+    h->sum_us += v;
+    if (v > h->max_us) {
+        h->max_us = v;
+    }
+}
+
+/**
+ * @brief Bytes disponibles para el consumidor
+ */
+static size_t rx_buffer_count(const rx_buffer_t *buf)
+{
+    size_t head = atomic_load_explicit(&buf->head, memory_order_acquire);
+    // Con un cierre pendiente, lo posterior a close_head es de la conexión siguiente
+    if (atomic_load_explicit(&buf->link, memory_order_acquire) & RX_LINK_CLOSED) {
+        head = atomic_load_explicit(&buf->close_head, memory_order_relaxed);
+    }
+    return head - atomic_load_explicit(&buf->tail, memory_order_relaxed);
+}
+
+/**
+ * @brief Región contigua legible a partir de `offset` bytes desde tail (consumidor)
+ * @return Longitud contigua disponible (0 si offset >= count)
+ */
+static size_t rx_buffer_span(const rx_buffer_t *buf, size_t offset, const uint8_t **ptr)
+{
+    size_t count = rx_buffer_count(buf);
+    if (offset >= count) {
+        *ptr = NULL;
+        return 0;
+    }
+
+    size_t pos = (atomic_load_explicit(&buf->tail, memory_order_relaxed) + offset) & (RX_BUFFER_SIZE - 1);
+    size_t avail = count - offset;
+    size_t to_end = RX_BUFFER_SIZE - pos;
+
+    *ptr = &buf->buffer[pos];
+    return (avail < to_end) ? avail : to_end;
+}
+
+/**
+ * @brief Descartar bytes del buffer sin copiarlos (consumidor)
+ */
+static void rx_buffer_drop(rx_buffer_t *buf, size_t len)
+{
+    size_t count = rx_buffer_count(buf);
+    size_t tail = atomic_load_explicit(&buf->tail, memory_order_relaxed);
+    atomic_store_explicit(&buf->tail, tail + ((len < count) ? len : count), memory_order_release);
+}
+
+/**
+ * @brief Descartar todo lo recibido hasta ahora (consumidor)
+ */
+static void rx_buffer_reset(rx_buffer_t *buf)
+{
+    atomic_store_explicit(&buf->flush, false, memory_order_relaxed);
+    rx_buffer_drop(buf, RX_BUFFER_SIZE);
+}
+
+/**
+ * @brief Pedir al consumidor que descarte lo recibido hasta ahora (productor)
+ */
+static void rx_buffer_request_flush(rx_buffer_t *buf)
+{
+    atomic_store_explicit(&buf->flush_head, atomic_load_explicit(&buf->head, memory_order_relaxed),
+                          memory_order_release);
+    atomic_store_explicit(&buf->flush, true, memory_order_release);
+}
+
+/**
+ * @brief Aplicar un vaciado pedido por el productor (consumidor)
+ */
+static void rx_buffer_apply_flush(rx_buffer_t *buf)
+{
+    if (!atomic_exchange_explicit(&buf->flush, false, memory_order_acquire)) {
+        return;
+    }
+
+    // Si ya se consumió más allá de flush_head la resta da la vuelta y no se descarta nada
+    // Otro vaciado pedido mientras tanto solo puede adelantar flush_head
+    size_t pending = atomic_load_explicit(&buf->flush_head, memory_order_acquire) -
+                     atomic_load_explicit(&buf->tail, memory_order_relaxed);
+    if (pending <= RX_BUFFER_SIZE) {
+        rx_buffer_drop(buf, pending);
+    }
+}
+
+/**
+ * @brief Agregar bytes al buffer circular de recepción, máximo dos memcpy (productor)
+ * @return Bytes copiados; el resto se descarta si el buffer está lleno
+ */
+static size_t rx_buffer_append(rx_buffer_t *buf, const uint8_t *data, size_t len)
+{
+    size_t head = atomic_load_explicit(&buf->head, memory_order_relaxed);
+    size_t free_space = RX_BUFFER_SIZE - (head - atomic_load_explicit(&buf->tail, memory_order_acquire));
+
+    if (len > free_space) {
+        // Buffer lleno: se pierde lo nuevo (el productor no puede mover tail)
+        // Solo escribe el productor: basta load + store, sin RMW atómico
+        uint32_t dropped = atomic_load_explicit(&buf->overflows, memory_order_relaxed) + (len - free_space);
+        atomic_store_explicit(&buf->overflows, dropped, memory_order_release);
+        ESP_LOGW(TAG, "RX buffer overflow! (%zu bytes descartados)", len - free_space);
+        len = free_space;
+    }
+
+    if (len > atomic_load_explicit(&buf->max_append, memory_order_relaxed)) {
+        atomic_store_explicit(&buf->max_append, len, memory_order_relaxed);
+    }
+
+    size_t pos = head & (RX_BUFFER_SIZE - 1);
+    size_t first = RX_BUFFER_SIZE - pos;
+    if (first > len) first = len;
+
+    memcpy(&buf->buffer[pos], data, first);
+    memcpy(buf->buffer, data + first, len - first);
+
+    atomic_store_explicit(&buf->head, head + len, memory_order_release);
+    return len;
+}
+
+/**
+ * @brief Peek desde `offset` bytes tras tail sin consumir (máximo dos memcpy)
+ */
+static size_t rx_buffer_peek_at(const rx_buffer_t *buf, size_t offset, uint8_t *out, size_t len)
+{
+    size_t done = 0;
+
+    while (done < len) {
+        const uint8_t *ptr;
+        size_t span = rx_buffer_span(buf, offset + done, &ptr);
+        if (span == 0) break;
+        if (span > len - done) span = len - done;
+
+        memcpy(out + done, ptr, span);
+        done += span;
+    }
+
+    return done;
+}
+
+/**
+ * @brief Peek (leer sin consumir) del buffer
+ */
+static size_t rx_buffer_peek(rx_buffer_t *buf, uint8_t *out, size_t len)
+{
+    return rx_buffer_peek_at(buf, 0, out, len);
+}
+
+/**
+ * @brief CRC32 (IEEE, el mismo que zlib.crc32) de `len` bytes desde `offset`
+ */
+static uint32_t rx_buffer_crc32(const rx_buffer_t *buf, size_t offset, size_t len)
+{
+    uint32_t crc = 0;
+
+    while (len > 0) {
+        const uint8_t *ptr;
+        size_t span = rx_buffer_span(buf, offset, &ptr);
+        if (span == 0) break;
+        if (span > len) span = len;
+
+        crc = esp_rom_crc32_le(crc, ptr, span);
+        offset += span;
+        len -= span;
+    }
+
+    return crc;
+}
+
+/**
+ * @brief Leer bytes del buffer circular
+ */
+static size_t rx_buffer_read(rx_buffer_t *buf, uint8_t *out, size_t len)
+{
+    size_t to_read = rx_buffer_peek(buf, out, len);
+    rx_buffer_drop(buf, to_read);
+    return to_read;
+}
+
+/**
+ * @brief Guardar en NVS la sesión en curso con el offset indicado
+ */
+static void resume_store(size_t offset)
+{
+    nvs_handle_t nvs;
+    if (nvs_open(RESUME_NVS_NAMESPACE, NVS_READWRITE, &nvs) != ESP_OK) {
+        ESP_LOGW(TAG, "No se pudo abrir NVS para reanudación");
+        return;
+    }
+
+    // Solo offsets alineados: al reanudar se borra desde el offset
+    s_resume.offset = offset - (offset % FLASH_SECTOR_SIZE);
+    if (nvs_set_blob(nvs, RESUME_NVS_KEY, &s_resume, sizeof(s_resume)) == ESP_OK) {
+        nvs_commit(nvs);
+        s_resume_saved = offset;
+    }
+    nvs_close(nvs);
+}
+
+static esp_err_t resume_load(ota_resume_record_t *rec)
+{
+    nvs_handle_t nvs;
+    esp_err_t err = nvs_open(RESUME_NVS_NAMESPACE, NVS_READONLY, &nvs);
+    if (err != ESP_OK) return err;
+
+    size_t len = sizeof(*rec);
+    err = nvs_get_blob(nvs, RESUME_NVS_KEY, rec, &len);
+    nvs_close(nvs);
+
+    if (err == ESP_OK && len != sizeof(*rec)) {
+        err = ESP_ERR_INVALID_SIZE;
+    }
+    return err;
+}
+
+static void resume_clear(void)
+{
+    nvs_handle_t nvs;
+    if (nvs_open(RESUME_NVS_NAMESPACE, NVS_READWRITE, &nvs) != ESP_OK) return;
+
+    if (nvs_erase_key(nvs, RESUME_NVS_KEY) == ESP_OK) {
+        nvs_commit(nvs);
+    }
+    nvs_close(nvs);
+}
+
+/**
+ * @brief Escritura de una sesión reanudada: borra sector a sector por delante
+ */
+static esp_err_t resumed_partition_write(const uint8_t *data, size_t len)
+{
+    const esp_partition_t *part = ota_state.update_partition;
+    size_t end = s_image_bytes + len;
+
+    if (end > part->size) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    if (end > s_erased_end) {
+        size_t erase_end = (end + FLASH_SECTOR_SIZE - 1) & ~(FLASH_SECTOR_SIZE - 1);
+        esp_err_t err = esp_partition_erase_range(part, s_erased_end, erase_end - s_erased_end);
+        if (err != ESP_OK) return err;
+        s_erased_end = erase_end;
+    }
+
+    return esp_partition_write(part, s_image_bytes, data, len);
+}
+
+/**
+ * @brief Sink final de la task escritora: bytes de imagen a la partición
+ */
+static esp_err_t writer_flash_sink(void *ctx, const uint8_t *data, size_t len)
+{
+    if (s_check_in_writer && OTA_IMAGE_REJECTED(ota_image_check_feed(&s_image_check, data, len))) {
+        return ESP_ERR_OTA_VALIDATE_FAILED;
+    }
+
+    esp_err_t err = s_resumed ? resumed_partition_write(data, len)
+                              : esp_ota_write(ota_state.ota_handle, data, len);
+    if (err == ESP_OK) {
+        s_image_bytes += len;
+    }
+    return err;
+}
+
+/**
+ * @brief Task escritora: vuelca a flash los sectores llenos
+ *
+ * Recibe punteros a sector_buf_t por s_write_q. Un puntero NULL detiene la task.
+ * En sesiones comprimidas los sectores se inflan aquí, fuera de la task de
+ * protocolo, antes de llegar a esp_ota_write.
+ * Tras un error de escritura descarta los sectores siguientes hasta que la
+ * task de protocolo aborte la sesión (writer_reset).
+ */
+static void ota_writer_task(void *arg)
+{
+    sector_buf_t *sb;
+
+    for (;;) {
+        if (xQueueReceive(s_write_q, &sb, portMAX_DELAY) != pdTRUE) continue;
+        if (sb == NULL) break;
+
+        if (s_writer_err == ESP_OK) {
+            int64_t t0 = esp_timer_get_time();
+            esp_err_t err = s_stream ? ota_stream_feed(s_stream, sb->data, sb->len)
+                                     : writer_flash_sink(NULL, sb->data, sb->len);
+            int64_t dt = esp_timer_get_time() - t0;
+            s_writer_stats.write_us += dt;
+            hist_add(&s_telemetry.write, dt);
+
+            if (err != ESP_OK) {
+                ESP_LOGE(TAG, "Escritura de imagen falló: %s", esp_err_to_name(err));
+                s_writer_err = err;
+            } else {
+                s_writer_stats.sectors_written++;
+                if (s_resumable && s_image_bytes - s_resume_saved >= RESUME_SAVE_INTERVAL) {
+                    resume_store(s_image_bytes);
+                }
+            }
+        }
+
+        sb->len = 0;
+        xQueueSend(s_free_q, &sb, portMAX_DELAY);
+    }
+
+    s_writer_task_handle = NULL;
+    vTaskDelete(NULL);
+}
+
+/**
+ * @brief Vaciar las respuestas acumuladas por el transporte (si las agrupa)
+ *
+ * Antes de cualquier espera larga (flash, reinicio) y al terminar cada
+ * pasada, para que el emisor no espere un ACK retenido.
+ */
+static void proto_flush(void)
+{
+    const ota_proto_transport_t *transport = atomic_load(&s_transport);
+    if (transport && transport->flush) {
+        transport->flush(transport->ctx);
+    }
+}
+
+/**
+ * @brief Entregar el sector en curso a la task escritora y tomar uno libre
+ */
+static void writer_submit_fill(void)
+{
+    xQueueSend(s_write_q, &s_fill, portMAX_DELAY);
+
+    UBaseType_t depth = uxQueueMessagesWaiting(s_write_q);
+    if (depth > s_writer_stats.queue_depth_max) {
+        s_writer_stats.queue_depth_max = depth;
+    }
+
+    if (uxQueueMessagesWaiting(s_free_q) == 0) {
+        proto_flush();
+    }
+    int64_t t0 = esp_timer_get_time();
+    xQueueReceive(s_free_q, &s_fill, portMAX_DELAY);
+    int64_t waited = esp_timer_get_time() - t0;
+    s_frame_wait_us += waited;
+    hist_add(&s_telemetry.flash_wait, waited);
+
+    // Más de 1 ms esperando buffer libre: la flash va por detrás del enlace
+    if (waited > 1000) {
+        s_writer_stats.stall_count++;
+        s_writer_stats.stall_us += waited;
+    }
+}
+
+/**
+ * @brief Copiar `len` bytes del anillo al sector en curso y consumirlos
+ * @return Error de la task escritora si ya falló una escritura anterior
+ */
+static esp_err_t writer_feed(rx_buffer_t *buf, size_t len)
+{
+    while (len > 0) {
+        const uint8_t *ptr;
+        size_t span = rx_buffer_span(buf, 0, &ptr);
+        if (span == 0) return ESP_ERR_INVALID_SIZE;
+        if (span > len) span = len;
+
+        // Cabecera de imagen: se decide antes de que llegue a la flash
+        if (!s_check_in_writer && s_image_check.verdict == OTA_IMAGE_PENDING &&
+            OTA_IMAGE_REJECTED(ota_image_check_feed(&s_image_check, ptr, span))) {
+            rx_buffer_drop(buf, len);
+            return ESP_ERR_OTA_VALIDATE_FAILED;
+        }
+
+        size_t room = FLASH_SECTOR_SIZE - s_fill->len;
+        if (span > room) span = room;
+
+        memcpy(&s_fill->data[s_fill->len], ptr, span);
+        s_fill->len += span;
+        rx_buffer_drop(buf, span);
+        len -= span;
+
+        if (s_fill->len == FLASH_SECTOR_SIZE) {
+            writer_submit_fill();
+        }
+    }
+
+    return s_writer_err;
+}
+
+/**
+ * @brief Añadir a la imagen `len` bytes del slot en ejecución desde `offset`
+ *
+ * Se leen directamente sobre el sector en curso, así que el destino no
+ * necesita estar alineado a sector.
+ * @return Error de lectura, o de la task escritora si ya falló una escritura
+ */
+static esp_err_t writer_copy(const esp_partition_t *src, size_t offset, size_t len)
+{
+    while (len > 0) {
+        size_t n = FLASH_SECTOR_SIZE - s_fill->len;
+        if (n > len) n = len;
+
+        uint8_t *dst = &s_fill->data[s_fill->len];
+        esp_err_t err = esp_partition_read(src, offset, dst, n);
+        if (err != ESP_OK) return err;
+
+        if (!s_check_in_writer && s_image_check.verdict == OTA_IMAGE_PENDING &&
+            OTA_IMAGE_REJECTED(ota_image_check_feed(&s_image_check, dst, n))) {
+            return ESP_ERR_OTA_VALIDATE_FAILED;
+        }
+
+        s_fill->len += n;
+        offset += n;
+        len -= n;
+
+        if (s_fill->len == FLASH_SECTOR_SIZE) {
+            writer_submit_fill();
+        }
+    }
+
+    return s_writer_err;
+}
+
+/**
+ * @brief Esperar a que la task escritora termine los sectores ya enviados
+ *
+ * Recupera todos los buffers de la cola libre (barrera) y los devuelve; el
+ * sector en curso no se toca.
+ */
+static void writer_sync(void)
+{
+    sector_buf_t *held[WRITER_NUM_BUFFERS - 1];
+    for (int i = 0; i < WRITER_NUM_BUFFERS - 1; i++) {
+        xQueueReceive(s_free_q, &held[i], portMAX_DELAY);
+    }
+    for (int i = 0; i < WRITER_NUM_BUFFERS - 1; i++) {
+        xQueueSend(s_free_q, &held[i], portMAX_DELAY);
+    }
+}
+
+/**
+ * @brief Enviar el sector parcial y esperar a que la flash esté al día
+ * @return Primer error de escritura de la sesión, o ESP_OK
+ */
+static esp_err_t writer_flush(void)
+{
+    if (s_fill->len > 0) {
+        writer_submit_fill();
+    }
+    writer_sync();
+
+    return s_writer_err;
+}
+
+/**
+ * @brief Preparar el escritor para una sesión nueva
+ */
+static void writer_reset(void)
+{
+    s_fill->len = 0;
+    s_writer_err = ESP_OK;
+    s_image_bytes = 0;
+    memset(&s_writer_stats, 0, sizeof(s_writer_stats));
+}
+
+/**
+ * @brief Liberar recursos de sesión (escritor ya drenado)
+ */
+static void ota_session_release(void)
+{
+    if (s_stream) {
+        ota_stream_destroy(s_stream);
+        s_stream = NULL;
+    }
+}
+
+/**
+ * @brief Avisar a la aplicación de que la sesión empieza o termina (una vez por cambio)
+ */
+static void session_notify(bool active)
+{
+    if (active == s_session_notified) {
+        return;
+    }
+
+    s_session_notified = active;
+    if (s_session_cb) {
+        const ota_proto_transport_t *transport = atomic_load(&s_transport);
+        s_session_cb(active, transport ? transport->name : "");
+    }
+}
+
+/**
+ * @brief Cerrar la sesión (escritor ya drenado) sin tocar el registro NVS
+ */
+static void ota_session_close(void)
+{
+    if (!s_resumed) {
+        esp_ota_abort(ota_state.ota_handle);
+    }
+    ota_session_release();
+    s_resumable = false;
+    s_resumed = false;
+    ota_state.ota_state = OTA_STATE_IDLE;
+    session_notify(false);
+}
+
+/**
+ * @brief Abortar la sesión OTA en curso una vez drenado el escritor
+ */
+static void ota_session_abort(void)
+{
+    writer_flush();
+    if (s_resumable) {
+        resume_clear();
+    }
+    ota_session_close();
+}
+
+/**
+ * @brief Conexión perdida: guardar el progreso si la sesión es reanudable
+ *
+ * La partición conserva lo escrito; RESUME_OTA continúa desde el último
+ * sector completo.
+ */
+static void ota_session_suspend(void)
+{
+    if (writer_flush() != ESP_OK || !s_resumable) {
+        ota_session_abort();
+        return;
+    }
+
+    resume_store(s_image_bytes);
+    ESP_LOGW(TAG, "Sesión OTA suspendida en %" PRIu32 "/%zu bytes",
+             s_resume.offset, ota_state.expected_size);
+    ota_session_close();
+}
+
+/**
+ * @brief Enviar una respuesta por el transporte conectado
+ */
+static void proto_send(const uint8_t *data, size_t len)
+{
+    if (data[0] == PROTO_NAK || data[0] == PROTO_SNAK) {
+        s_telemetry.naks++;
+    }
+    const ota_proto_transport_t *transport = atomic_load(&s_transport);
+    if (transport) {
+        transport->send(transport->ctx, data, len);
+    }
+}
+
+static void send_nak_code(uint8_t code)
+{
+    uint8_t frame[2] = { PROTO_NAK, code };
+    proto_send(frame, sizeof(frame));
+}
+
+/**
+ * @brief NAK de END_OTA: con código en modo ventana, un solo byte en el clásico
+ */
+static void send_end_nak(uint8_t code)
+{
+    if (ota_state.windowed) {
+        send_nak_code(code);
+    } else {
+        uint8_t response = PROTO_NAK;
+        proto_send(&response, 1);
+    }
+}
+
+/**
+ * @brief Límite de crédito: bytes (desde el START) que el emisor puede haber enviado
+ *
+ * Lo consumido del buffer RX más su tamaño: si el emisor no lo supera el
+ * buffer nunca se desborda.
+ */
+static uint32_t credit_limit(void)
+{
+    size_t tail = atomic_load_explicit(&ota_state.rx_buf.tail, memory_order_relaxed);
+    return (uint32_t)(tail - ota_state.credit_base) + RX_BUFFER_SIZE;
+}
+
+/**
+ * @brief Añadir credit[4] a una respuesta si la sesión usa créditos
+ * @return Bytes añadidos
+ */
+static size_t put_credit(uint8_t *out)
+{
+    if (!ota_state.credit) return 0;
+
+    uint32_t limit = credit_limit();
+    out[0] = limit >> 24;
+    out[1] = limit >> 16;
+    out[2] = limit >> 8;
+    out[3] = limit;
+    ota_state.credit_sent = limit;
+    return 4;
+}
+
+/**
+ * @brief Escribir un TLV con valor entero big-endian
+ * @return Bytes escritos
+ */
+static size_t put_tlv_be(uint8_t *out, uint8_t type, uint32_t value, uint8_t len)
+{
+    out[0] = type;
+    out[1] = len;
+    for (uint8_t i = 0; i < len; i++) {
+        out[2 + i] = value >> (8 * (len - 1 - i));
+    }
+    return 2 + len;
+}
+
+static void send_sack(uint16_t next_seq)
+{
+    uint8_t frame[7] = { PROTO_SACK, next_seq >> 8, next_seq & 0xFF };
+    proto_send(frame, 3 + put_credit(&frame[3]));
+    ota_state.acked_seq = next_seq;
+
+    if (s_unacked_us) {
+        hist_add(&s_telemetry.ack_delay, esp_timer_get_time() - s_unacked_us);
+        s_unacked_us = 0;
+    }
+    uint32_t heap = esp_get_free_heap_size();
+    if (heap < s_telemetry.heap_min) {
+        s_telemetry.heap_min = heap;
+    }
+}
+
+static void send_snak(uint16_t next_seq, uint8_t code)
+{
+    uint8_t frame[8] = { PROTO_SNAK, next_seq >> 8, next_seq & 0xFF, code };
+    proto_send(frame, 4 + put_credit(&frame[4]));
+}
+
+/**
+ * @brief Parsear los TLV de START_OTA_EXT
+ * @return true si el bloque es válido y contiene el tamaño de imagen
+ */
+static bool parse_start_tlv(const uint8_t *tlv, size_t len, ota_start_params_t *params)
+{
+    bool has_size = false;
+    size_t pos = 0;
+
+    params->window = 1;
+    params->flags = 0;
+    params->chunk = 0;
+    params->has_hash = false;
+    while (pos + 2 <= len) {
+        uint8_t type = tlv[pos];
+        uint8_t vlen = tlv[pos + 1];
+        const uint8_t *val = &tlv[pos + 2];
+        if (pos + 2 + vlen > len) return false;
+
+        if (type == TLV_IMAGE_SIZE && vlen == 4) {
+            params->size = (val[0] << 24) | (val[1] << 16) | (val[2] << 8) | val[3];
+            has_size = true;
+        } else if (type == TLV_WINDOW && vlen == 1) {
+            params->window = val[0];
+        } else if (type == TLV_FLAGS && vlen == 1) {
+            params->flags = val[0];
+        } else if (type == TLV_CHUNK && vlen == 2) {
+            params->chunk = (val[0] << 8) | val[1];
+        } else if (type == TLV_IMAGE_HASH && vlen == IMAGE_HASH_LEN) {
+            memcpy(params->hash, val, IMAGE_HASH_LEN);
+            params->has_hash = true;
+        }
+        // TLV desconocido: se ignora para mantener compatibilidad
+        pos += 2 + vlen;
+    }
+
+    return has_size && pos == len;
+}
+
+/**
+ * @brief Poner a cero el estado de una sesión que empieza a recibir
+ */
+static void ota_session_reset(size_t size)
+{
+    session_notify(true);
+    ota_state.ota_state = OTA_STATE_RECEIVING;
+    ota_state.bytes_received = 0;
+    ota_state.expected_size = size;
+    ota_state.chunk_count = 0;
+    ota_state.windowed = false;
+    ota_state.window = 1;
+    ota_state.max_chunk = MAX_CHUNK_PAYLOAD;
+    ota_state.next_seq = 0;
+    ota_state.acked_seq = 0;
+    ota_state.gap_reported = false;
+    ota_state.crc = false;
+    ota_state.credit = false;
+    ota_state.dedupe = false;
+    ota_state.bytes_copied = 0;
+    ota_state.start_time = xTaskGetTickCount();
+    ota_image_check_init(&s_image_check);
+    writer_reset();
+
+    memset(&s_telemetry, 0, sizeof(s_telemetry));
+    s_telemetry.heap_min = esp_get_free_heap_size();
+    s_last_frame_us = 0;
+    s_unacked_us = 0;
+    s_overflows_base = atomic_load_explicit(&ota_state.rx_buf.overflows, memory_order_acquire);
+}
+
+/**
+ * @brief Iniciar sesión OTA (común a START_OTA y START_OTA_EXT)
+ * @return 0 si OK, código PROTO_ERR_* en caso de error
+ */
+static uint8_t ota_session_begin(const ota_start_params_t *params)
+{
+    size_t size = params->size;
+    uint8_t flags = params->flags;
+
+    if (ota_state.ota_state != OTA_STATE_IDLE) {
+        ESP_LOGW(TAG, "START_OTA rechazado (estado: %d)", ota_state.ota_state);
+        return PROTO_ERR_STATE;
+    }
+
+    ESP_LOGI(TAG, "START_OTA: %zu bytes (flags 0x%02X)", size, flags);
+
+    if (flags & ~OTA_FLAGS_SUPPORTED) {
+        ESP_LOGE(TAG, "Flags no soportados: 0x%02X", flags);
+        return PROTO_ERR_PARAM;
+    }
+
+    // Los sectores copiados solo se comprueban con el SHA-256 final
+    if ((flags & OTA_FLAG_DEDUPE) && (!params->has_hash || (flags & OTA_FLAGS_TRANSFORM))) {
+        ESP_LOGE(TAG, "OTA_FLAG_DEDUPE requiere hash y sesión sin transformación");
+        return PROTO_ERR_PARAM;
+    }
+
+    ota_state.update_partition = esp_ota_get_next_update_partition(NULL);
+    if (ota_state.update_partition == NULL) {
+        ESP_LOGE(TAG, "Partición OTA no disponible");
+        return PROTO_ERR_PARTITION;
+    }
+
+    if (size == 0 || size > ota_state.update_partition->size) {
+        ESP_LOGE(TAG, "Tamaño de imagen inválido: %zu (partición %" PRIu32 ")",
+                 size, ota_state.update_partition->size);
+        return PROTO_ERR_PARAM;
+    }
+
+#if OTA_ERASE_MODE == OTA_ERASE_FULL
+    size_t erase_size = OTA_SIZE_UNKNOWN;
+#elif OTA_ERASE_MODE == OTA_ERASE_IMAGE_SIZE
+    size_t erase_size = size;
+#else
+    size_t erase_size = OTA_WITH_SEQUENTIAL_WRITES;
+#endif
+
+    uint32_t stream_flags = 0;
+    if (flags & OTA_FLAG_DEFLATE) stream_flags |= OTA_STREAM_DEFLATE;
+    if (flags & OTA_FLAG_DELTA) stream_flags |= OTA_STREAM_DELTA;
+
+    // Con hash anunciado el pipeline se usa también sin transformación, para
+    // calcular el SHA-256 de la imagen a medida que se escribe
+    if (stream_flags || params->has_hash) {
+        s_stream = ota_stream_create(stream_flags, writer_flash_sink, NULL);
+        if (!s_stream) {
+            return PROTO_ERR_BEGIN;
+        }
+        if (params->has_hash) {
+            ota_stream_expect_sha256(s_stream, params->hash);
+        }
+    }
+
+    int64_t t0 = esp_timer_get_time();
+    esp_err_t err = esp_ota_begin(ota_state.update_partition, erase_size, &ota_state.ota_handle);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "esp_ota_begin falló: %s", esp_err_to_name(err));
+        ota_session_release();
+        return PROTO_ERR_BEGIN;
+    }
+    ESP_LOGI(TAG, "esp_ota_begin (modo borrado %d): %" PRId64 " ms",
+             OTA_ERASE_MODE, (esp_timer_get_time() - t0) / 1000);
+
+    ota_session_reset(size);
+    s_check_in_writer = (flags & OTA_FLAGS_TRANSFORM) != 0;
+
+    // La sesión nueva sustituye a cualquier sesión guardada en la partición
+    s_resumed = false;
+    s_resumable = params->has_hash && !(flags & OTA_FLAGS_TRANSFORM);
+    if (s_resumable) {
+        s_resume.part_addr = ota_state.update_partition->address;
+        s_resume.size = size;
+        memcpy(s_resume.hash, params->hash, IMAGE_HASH_LEN);
+        resume_store(0);
+    } else {
+        resume_clear();
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Reanudar una sesión guardada en NVS para la misma imagen
+ * @param offset Bytes de imagen ya escritos, desde donde debe seguir el emisor
+ * @return 0 si OK, código PROTO_ERR_* en caso de error
+ */
+static uint8_t ota_session_resume(const ota_start_params_t *params, size_t *offset)
+{
+    if (ota_state.ota_state != OTA_STATE_IDLE) {
+        ESP_LOGW(TAG, "RESUME_OTA rechazado (estado: %d)", ota_state.ota_state);
+        return PROTO_ERR_STATE;
+    }
+
+    if (!params->has_hash || (params->flags & ~OTA_FLAGS_RESUMABLE)) {
+        ESP_LOGE(TAG, "RESUME_OTA requiere hash y sesión sin transformación");
+        return PROTO_ERR_PARAM;
+    }
+
+    ota_state.update_partition = esp_ota_get_next_update_partition(NULL);
+    if (ota_state.update_partition == NULL) {
+        ESP_LOGE(TAG, "Partición OTA no disponible");
+        return PROTO_ERR_PARTITION;
+    }
+
+    ota_resume_record_t rec;
+    if (resume_load(&rec) != ESP_OK ||
+        rec.part_addr != ota_state.update_partition->address ||
+        rec.size != params->size ||
+        memcmp(rec.hash, params->hash, IMAGE_HASH_LEN) != 0 ||
+        rec.offset == 0 || rec.offset > rec.size) {
+        ESP_LOGW(TAG, "RESUME_OTA: no hay sesión guardada para esta imagen");
+        return PROTO_ERR_RESUME;
+    }
+
+    ota_session_reset(params->size);
+    s_image_check.verdict = OTA_IMAGE_VALID;   // Comprobada al empezar la sesión
+    s_check_in_writer = false;
+
+    s_resume = rec;
+    s_resumable = true;
+    s_resumed = true;
+    s_image_bytes = rec.offset;
+    s_resume_saved = rec.offset;
+    s_erased_end = rec.offset;      // El sector del offset se vuelve a borrar
+
+    ESP_LOGI(TAG, "OTA reanudada en %" PRIu32 "/%zu bytes", rec.offset, params->size);
+    *offset = rec.offset;
+    return 0;
+}
+
+/**
+ * @brief Comprobar el SHA-256 de una sesión reanudada leyendo la partición
+ *
+ * Parte de la imagen se escribió antes de la desconexión, así que el hash no
+ * se puede calcular en streaming como en una sesión normal.
+ */
+static bool resumed_image_matches(void)
+{
+    uint8_t digest[IMAGE_HASH_LEN];
+    int64_t t0 = esp_timer_get_time();
+
+    esp_err_t err = ota_partition_sha256(ota_state.update_partition, ota_state.expected_size, digest);
+    if (err != ESP_OK || memcmp(digest, s_resume.hash, IMAGE_HASH_LEN) != 0) {
+        ESP_LOGE(TAG, "SHA-256 de la imagen reanudada no coincide");
+        return false;
+    }
+
+    ESP_LOGI(TAG, "SHA-256 verificado sobre la partición en %" PRId64 " ms",
+             (esp_timer_get_time() - t0) / 1000);
+    return true;
+}
+
+/**
+ * @brief Código de NAK para un error del camino de datos (escritor ya drenado)
+ */
+static uint8_t data_error_code(esp_err_t err)
+{
+    if (err == ESP_ERR_INVALID_VERSION) {
+        return PROTO_ERR_BASE;
+    }
+    if (err != ESP_ERR_OTA_VALIDATE_FAILED) {
+        return PROTO_ERR_WRITE;
+    }
+
+    ESP_LOGE(TAG, "Imagen rechazada tras %zu bytes (%" PRIu32 " ms): %s", ota_state.bytes_received,
+             (uint32_t)((xTaskGetTickCount() - ota_state.start_time) * portTICK_PERIOD_MS),
+             ota_image_verdict_str(s_image_check.verdict));
+    switch (s_image_check.verdict) {
+    case OTA_IMAGE_BAD_CHIP: return PROTO_ERR_CHIP;
+    case OTA_IMAGE_BAD_PROJECT: return PROTO_ERR_PROJECT;
+    case OTA_IMAGE_OLD_SECURE_VERSION: return PROTO_ERR_SECURE_VERSION;
+    default: return PROTO_ERR_IMAGE;
+    }
+}
+
+/**
+ * @brief Responder a SECTOR_HASH: 0xAA | first[2] | count[1] | hash[16] × count
+ *
+ * count se recorta al final de la partición en ejecución (0 si first ya está
+ * fuera). Con los hashes el emisor decide qué sectores envía y cuáles copia.
+ * @return 0 si OK, código PROTO_ERR_* en caso de error
+ */
+static uint8_t send_sector_hashes(uint16_t first, uint8_t count)
+{
+    static uint8_t reply[4 + SECTOR_HASH_MAX_COUNT * SECTOR_HASH_LEN];
+    const esp_partition_t *running = esp_ota_get_running_partition();
+
+    if (running == NULL) {
+        return PROTO_ERR_PARTITION;
+    }
+
+    size_t sectors = running->size / FLASH_SECTOR_SIZE;
+    if (first >= sectors) {
+        count = 0;
+    } else if (count > sectors - first) {
+        count = sectors - first;
+    }
+
+    for (uint8_t i = 0; i < count; i++) {
+        uint8_t digest[IMAGE_HASH_LEN];
+        esp_err_t err = ota_partition_range_sha256(running, (size_t)(first + i) * FLASH_SECTOR_SIZE,
+                                                   FLASH_SECTOR_SIZE, digest);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "No se pudo leer el sector %u: %s", first + i, esp_err_to_name(err));
+            return PROTO_ERR_PARTITION;
+        }
+        memcpy(&reply[4 + i * SECTOR_HASH_LEN], digest, SECTOR_HASH_LEN);
+    }
+
+    reply[0] = PROTO_ACK;
+    reply[1] = first >> 8;
+    reply[2] = first & 0xFF;
+    reply[3] = count;
+    proto_send(reply, 4 + count * SECTOR_HASH_LEN);
+    return 0;
+}
+
+/**
+ * @brief Frame de datos completo en el buffer: muestra de intervalo entre frames
+ * @return Marca de tiempo para telemetry_frame_done
+ */
+static int64_t telemetry_frame_start(void)
+{
+    int64_t now = esp_timer_get_time();
+    if (s_last_frame_us) {
+        hist_add(&s_telemetry.interarrival, now - s_last_frame_us);
+    }
+    s_last_frame_us = now;
+    s_frame_wait_us = 0;
+    return now;
+}
+
+/**
+ * @brief Frame de datos escrito: tiempo de procesado sin las esperas por flash
+ */
+static void telemetry_frame_done(int64_t t0)
+{
+    hist_add(&s_telemetry.parse, esp_timer_get_time() - t0 - s_frame_wait_us);
+}
+
+static size_t put_be(uint8_t *out, uint64_t value, uint8_t len)
+{
+    for (uint8_t i = 0; i < len; i++) {
+        out[i] = value >> (8 * (len - 1 - i));
+    }
+    return len;
+}
+
+static size_t put_status_hist(uint8_t *out, uint8_t id, const ota_proto_hist_t *h)
+{
+    size_t len = 0;
+    out[len++] = STATUS_TLV_HIST;
+    out[len++] = STATUS_HIST_LEN;
+    out[len++] = id;
+    len += put_be(&out[len], h->count, 4);
+    len += put_be(&out[len], h->max_us, 4);
+    len += put_be(&out[len], h->sum_us, 8);
+    for (int i = 0; i < OTA_PROTO_HIST_BUCKETS; i++) {
+        len += put_be(&out[len], h->bucket[i], 4);
+    }
+    return len;
+}
+
+/**
+ * @brief Responder a STATUS con la telemetría de la sesión actual o la última
+ *
+ * Formato: 0xAA | len[2] | TLV (STATUS_TLV_*). Los histogramas van en el
+ * orden de ota_proto_telemetry_t (id 0 = interarrival ... 4 = ack_delay).
+ */
+static void send_status(void)
+{
+    static uint8_t reply[STATUS_MAX_LEN];
+    size_t len = 3;
+
+    // El histograma de escritura es de la task escritora: esperar a que
+    // termine los sectores pendientes para leerlo completo
+    if (ota_state.ota_state != OTA_STATE_IDLE) {
+        writer_sync();
+    }
+
+    uint32_t elapsed_ms = (xTaskGetTickCount() - ota_state.start_time) * portTICK_PERIOD_MS;
+    uint32_t overflows = atomic_load_explicit(&ota_state.rx_buf.overflows, memory_order_acquire);
+    reply[len++] = STATUS_TLV_SESSION;
+    reply[len++] = 17;
+    reply[len++] = ota_state.ota_state;
+    len += put_be(&reply[len], ota_state.bytes_received, 4);
+    len += put_be(&reply[len], s_image_bytes, 4);
+    len += put_be(&reply[len], ota_state.expected_size, 4);
+    len += put_be(&reply[len], elapsed_ms, 4);
+
+    reply[len++] = STATUS_TLV_COUNTERS;
+    reply[len++] = 24;
+    len += put_be(&reply[len], s_telemetry.naks, 4);
+    len += put_be(&reply[len], s_telemetry.crc_errors, 4);
+    len += put_be(&reply[len], s_telemetry.seq_gaps, 4);
+    len += put_be(&reply[len], s_telemetry.duplicates, 4);
+    len += put_be(&reply[len], overflows - s_overflows_base, 4);
+    len += put_be(&reply[len], s_writer_stats.stall_count, 4);
+
+    reply[len++] = STATUS_TLV_MEMORY;
+    reply[len++] = 16;
+    len += put_be(&reply[len], s_telemetry.ring_max, 4);
+    len += put_be(&reply[len], RX_BUFFER_SIZE, 4);
+    len += put_be(&reply[len], s_telemetry.heap_min, 4);
+    len += put_be(&reply[len], esp_get_minimum_free_heap_size(), 4);
+
+    const ota_proto_hist_t *hists[STATUS_NUM_HIST] = {
+        &s_telemetry.interarrival, &s_telemetry.parse, &s_telemetry.flash_wait,
+        &s_telemetry.write, &s_telemetry.ack_delay,
+    };
+    for (int i = 0; i < STATUS_NUM_HIST; i++) {
+        len += put_status_hist(&reply[len], i, hists[i]);
+    }
+
+    reply[0] = PROTO_ACK;
+    reply[1] = (len - 3) >> 8;
+    reply[2] = (len - 3) & 0xFF;
+    proto_send(reply, len);
+}
+
+/**
+ * @brief Comprobar la secuencia de un DATA_SEQ/COPY_SEQ completo en el buffer
+ *
+ * Si no es la esperada descarta el frame y responde: SACK para una
+ * retransmisión de algo ya escrito, SNAK una sola vez por hueco.
+ * @return true si es el siguiente frame esperado
+ */
+static bool seq_in_order(rx_buffer_t *buf, uint16_t seq, size_t frame_len)
+{
+    if (seq == ota_state.next_seq) {
+        return true;
+    }
+
+    rx_buffer_drop(buf, frame_len);
+    if ((int16_t)(seq - ota_state.next_seq) < 0) {
+        // Retransmisión de algo ya escrito: reconfirmar
+        s_telemetry.duplicates++;
+        send_sack(ota_state.next_seq);
+    } else if (!ota_state.gap_reported) {
+        // Hueco: pedir retransmisión una sola vez por hueco
+        ESP_LOGW(TAG, "Secuencia %u fuera de orden (esperada %u)", seq, ota_state.next_seq);
+        s_telemetry.seq_gaps++;
+        send_snak(ota_state.next_seq, PROTO_ERR_SEQ);
+        ota_state.gap_reported = true;
+    }
+    return false;
+}
+
+/**
+ * @brief Comprobar el crc32[4] que sigue a `len` bytes desde `offset` (con OTA_FLAG_CRC)
+ *
+ * Si no coincide descarta el frame antes de escribir nada y pide
+ * retransmisión desde next_seq.
+ * @return true si el frame es válido o la sesión no usa CRC
+ */
+static bool seq_crc_ok(rx_buffer_t *buf, uint16_t seq, size_t offset, size_t len, size_t frame_len)
+{
+    if (!ota_state.crc) {
+        return true;
+    }
+
+    uint8_t trailer[DATA_SEQ_CRC_LEN];
+    rx_buffer_peek_at(buf, offset + len, trailer, sizeof(trailer));
+    uint32_t expected = ((uint32_t)trailer[0] << 24) | (trailer[1] << 16) | (trailer[2] << 8) | trailer[3];
+
+    if (rx_buffer_crc32(buf, offset, len) == expected) {
+        return true;
+    }
+
+    ESP_LOGW(TAG, "CRC incorrecto en secuencia %u", seq);
+    s_telemetry.crc_errors++;
+    rx_buffer_drop(buf, frame_len);
+    if (!ota_state.gap_reported) {
+        send_snak(ota_state.next_seq, PROTO_ERR_CRC);
+        ota_state.gap_reported = true;
+    }
+    return false;
+}
+
+/**
+ * @brief Frame en secuencia escrito: avanzar y confirmar cada media ventana
+ */
+static void seq_advance(void)
+{
+    if (!s_unacked_us) {
+        s_unacked_us = s_last_frame_us;
+    }
+    ota_state.next_seq++;
+    ota_state.gap_reported = false;
+
+    // ACK acumulativo cada media ventana; el resto al vaciar el buffer
+    uint16_t pending = ota_state.next_seq - ota_state.acked_seq;
+    if (pending >= (ota_state.window + 1) / 2) {
+        send_sack(ota_state.next_seq);
+    }
+}
+
+/**
+ * @brief Procesar paquetes del buffer
+ */
+static void process_rx_buffer(void)
+{
+    uint8_t response;
+    rx_buffer_t *buf = &ota_state.rx_buf;
+
+    rx_buffer_apply_flush(buf);
+    size_t pending_bytes = rx_buffer_count(buf);
+    if (pending_bytes > s_telemetry.ring_max) {
+        s_telemetry.ring_max = pending_bytes;
+    }
+
+    while (rx_buffer_count(buf) > 0) {
+        // Peek al primer byte (comando)
+        uint8_t cmd;
+        if (rx_buffer_peek(buf, &cmd, 1) < 1) break;
+        
+        // ========== START_OTA ==========
+        if (cmd == PROTO_START_OTA) {
+            if (rx_buffer_count(buf) < 5) {
+                break;  // Esperar más datos
+            }
+            
+            uint8_t header[5];
+            rx_buffer_read(buf, header, 5);
+            
+            ota_start_params_t params = {
+                .size = (header[1] << 24) | (header[2] << 16) | (header[3] << 8) | header[4],
+            };
+            size_t size = params.size;
+            uint8_t code = ota_session_begin(&params);
+            response = code ? PROTO_NAK : PROTO_ACK;
+            proto_send(&response, 1);
+            if (code == 0) {
+                ESP_LOGI(TAG, "OTA iniciada. Esperando %zu bytes", size);
+            }
+        }
+        // ========== START_OTA_EXT / RESUME_OTA ==========
+        else if (cmd == PROTO_START_OTA_EXT || cmd == PROTO_RESUME_OTA) {
+            if (rx_buffer_count(buf) < 3) {
+                break;  // Esperar más datos
+            }
+
+            uint8_t frame[3 + START_EXT_MAX_LEN];
+            rx_buffer_peek(buf, frame, 3);
+
+            uint16_t tlv_len = (frame[1] << 8) | frame[2];
+            if (tlv_len > START_EXT_MAX_LEN) {
+                ESP_LOGE(TAG, "START_OTA_EXT demasiado largo: %u", tlv_len);
+                rx_buffer_read(buf, frame, 3);  // Descartar
+                send_nak_code(PROTO_ERR_LENGTH);
+                continue;
+            }
+
+            if (rx_buffer_count(buf) < (size_t)(3 + tlv_len)) {
+                break;  // Esperar más datos
+            }
+
+            rx_buffer_read(buf, frame, 3 + tlv_len);
+
+            ota_start_params_t params = {0};
+            if (!parse_start_tlv(&frame[3], tlv_len, &params) || params.window == 0) {
+                ESP_LOGE(TAG, "START_OTA_EXT con parámetros inválidos");
+                send_nak_code(PROTO_ERR_PARAM);
+                continue;
+            }
+
+            size_t offset = 0;
+            uint8_t code = (cmd == PROTO_RESUME_OTA) ? ota_session_resume(&params, &offset)
+                                                     : ota_session_begin(&params);
+            if (code) {
+                send_nak_code(code);
+                continue;
+            }
+
+            // Chunk: lo pedido hasta MAX_CHUNK_NEGOTIATED. Sin créditos la
+            // ventana completa de chunks de ese tamaño debe caber en el buffer
+            ota_state.max_chunk = MAX_CHUNK_PAYLOAD;
+            if (params.chunk) {
+                ota_state.max_chunk = (params.chunk < MAX_CHUNK_NEGOTIATED) ? params.chunk : MAX_CHUNK_NEGOTIATED;
+            }
+            size_t max_window = RX_BUFFER_SIZE / (ota_state.max_chunk + DATA_SEQ_OVERHEAD);
+            if ((params.flags & OTA_FLAG_CREDIT) || max_window > MAX_WINDOW_CREDIT) {
+                max_window = MAX_WINDOW_CREDIT;
+            }
+
+            // Los créditos cuentan desde el byte que sigue a este frame
+            ota_state.windowed = true;
+            ota_state.window = (params.window > max_window) ? max_window : params.window;
+            ota_state.crc = (params.flags & OTA_FLAG_CRC) != 0;
+            ota_state.credit = (params.flags & OTA_FLAG_CREDIT) != 0;
+            ota_state.dedupe = (params.flags & OTA_FLAG_DEDUPE) != 0;
+            ota_state.credit_base = atomic_load_explicit(&buf->tail, memory_order_relaxed);
+
+            // Respuesta: ventana [, offset] [, crédito] y capacidades (chunk, buffer RX)
+            uint8_t reply[32] = { PROTO_ACK };
+            size_t reply_len = 2;
+            reply_len += put_tlv_be(&reply[reply_len], TLV_WINDOW, ota_state.window, 1);
+            if (cmd == PROTO_RESUME_OTA) {
+                reply_len += put_tlv_be(&reply[reply_len], TLV_OFFSET, offset, 4);
+            }
+            if (ota_state.credit) {
+                reply[reply_len++] = TLV_CREDIT;
+                reply[reply_len++] = 4;
+                reply_len += put_credit(&reply[reply_len]);
+            }
+            reply_len += put_tlv_be(&reply[reply_len], TLV_CHUNK, ota_state.max_chunk, 2);
+            reply_len += put_tlv_be(&reply[reply_len], TLV_RX_BUFFER, RX_BUFFER_SIZE, 4);
+            reply[1] = reply_len - 2;
+            proto_send(reply, reply_len);
+            ESP_LOGI(TAG, "OTA iniciada (ventana %u, chunk %u%s). Esperando %zu bytes", ota_state.window,
+                     ota_state.max_chunk, ota_state.credit ? ", créditos" : "", params.size - offset);
+        }
+        // ========== DATA_CHUNK ==========
+        else if (cmd == PROTO_DATA_CHUNK) {
+            if (rx_buffer_count(buf) < 3) {
+                break;  // Esperar más datos
+            }
+            
+            uint8_t header[3];
+            rx_buffer_peek(buf, header, 3);
+            
+            uint16_t chunk_len = (header[1] << 8) | header[2];
+            
+            if (chunk_len > MAX_CHUNK_PAYLOAD) {
+                ESP_LOGE(TAG, "Longitud inválida: %u", chunk_len);
+                rx_buffer_read(buf, header, 3);  // Descartar
+                response = PROTO_NAK;
+                proto_send(&response, 1);
+                continue;
+            }
+            
+            if (rx_buffer_count(buf) < (3 + chunk_len)) {
+                break;  // Esperar más datos
+            }
+            
+            if (ota_state.ota_state != OTA_STATE_RECEIVING) {
+                ESP_LOGW(TAG, "DATA_CHUNK rechazado (estado: %d)", ota_state.ota_state);
+                rx_buffer_drop(buf, 3 + chunk_len);  // Descartar
+                response = PROTO_NAK;
+                proto_send(&response, 1);
+                continue;
+            }
+            
+            int64_t t0 = telemetry_frame_start();
+            rx_buffer_drop(buf, 3);
+            
+            esp_err_t err = writer_feed(buf, chunk_len);
+            if (err != ESP_OK) {
+                ota_session_abort();
+                data_error_code(err);   // Solo log: el NAK clásico no lleva código
+                response = PROTO_NAK;
+                proto_send(&response, 1);
+                continue;
+            }
+            
+            ota_state.bytes_received += chunk_len;
+            ota_state.chunk_count++;
+            telemetry_frame_done(t0);
+            response = PROTO_ACK;
+            proto_send(&response, 1);
+            hist_add(&s_telemetry.ack_delay, esp_timer_get_time() - t0);
+        }
+        // ========== DATA_SEQ ==========
+        else if (cmd == PROTO_DATA_SEQ) {
+            if (rx_buffer_count(buf) < DATA_SEQ_HEADER_LEN) {
+                break;  // Esperar más datos
+            }
+
+            uint8_t header[DATA_SEQ_HEADER_LEN];
+            rx_buffer_peek(buf, header, DATA_SEQ_HEADER_LEN);
+
+            uint16_t seq = (header[1] << 8) | header[2];
+            uint16_t chunk_len = (header[3] << 8) | header[4];
+
+            if (chunk_len > ota_state.max_chunk) {
+                ESP_LOGE(TAG, "Longitud inválida: %u", chunk_len);
+                rx_buffer_read(buf, header, DATA_SEQ_HEADER_LEN);  // Descartar
+                send_snak(ota_state.next_seq, PROTO_ERR_LENGTH);
+                continue;
+            }
+
+            size_t frame_len = DATA_SEQ_HEADER_LEN + chunk_len + (ota_state.crc ? DATA_SEQ_CRC_LEN : 0);
+            if (rx_buffer_count(buf) < frame_len) {
+                break;  // Esperar más datos
+            }
+
+            if (ota_state.ota_state != OTA_STATE_RECEIVING || !ota_state.windowed) {
+                ESP_LOGW(TAG, "DATA_SEQ rechazado (estado: %d)", ota_state.ota_state);
+                rx_buffer_drop(buf, frame_len);
+                send_nak_code(PROTO_ERR_STATE);
+                continue;
+            }
+
+            int64_t t0 = telemetry_frame_start();
+            if (!seq_in_order(buf, seq, frame_len) ||
+                !seq_crc_ok(buf, seq, DATA_SEQ_HEADER_LEN, chunk_len, frame_len)) {
+                continue;
+            }
+
+            rx_buffer_drop(buf, DATA_SEQ_HEADER_LEN);
+
+            esp_err_t err = writer_feed(buf, chunk_len);
+            if (ota_state.crc) {
+                rx_buffer_drop(buf, DATA_SEQ_CRC_LEN);
+            }
+            if (err != ESP_OK) {
+                ota_session_abort();
+                send_snak(ota_state.next_seq, data_error_code(err));
+                continue;
+            }
+
+            ota_state.bytes_received += chunk_len;
+            ota_state.chunk_count++;
+            telemetry_frame_done(t0);
+            seq_advance();
+        }
+        // ========== COPY_SEQ ==========
+        else if (cmd == PROTO_COPY_SEQ) {
+            size_t frame_len = COPY_SEQ_LEN + (ota_state.crc ? DATA_SEQ_CRC_LEN : 0);
+            if (rx_buffer_count(buf) < frame_len) {
+                break;  // Esperar más datos
+            }
+
+            uint8_t frame[COPY_SEQ_LEN];
+            rx_buffer_peek(buf, frame, COPY_SEQ_LEN);
+
+            uint16_t seq = (frame[1] << 8) | frame[2];
+            uint16_t sector = (frame[3] << 8) | frame[4];
+            uint8_t count = frame[5];
+
+            if (ota_state.ota_state != OTA_STATE_RECEIVING || !ota_state.dedupe) {
+                ESP_LOGW(TAG, "COPY_SEQ rechazado (estado: %d)", ota_state.ota_state);
+                rx_buffer_drop(buf, frame_len);
+                send_nak_code(PROTO_ERR_STATE);
+                continue;
+            }
+
+            // El CRC cubre seq, sector y count: un sector equivocado no se detectaría hasta el END
+            int64_t t0 = telemetry_frame_start();
+            if (!seq_in_order(buf, seq, frame_len) ||
+                !seq_crc_ok(buf, seq, 1, COPY_SEQ_LEN - 1, frame_len)) {
+                continue;
+            }
+            rx_buffer_drop(buf, frame_len);
+
+            const esp_partition_t *running = esp_ota_get_running_partition();
+            size_t offset = (size_t)sector * FLASH_SECTOR_SIZE;
+            size_t len = (size_t)count * FLASH_SECTOR_SIZE;
+            if (count == 0 || count > COPY_MAX_SECTORS || offset + len > running->size) {
+                // Reenviarlo daría lo mismo: sin abortar, el emisor repetiría este frame sin fin
+                ESP_LOGE(TAG, "COPY_SEQ fuera de rango: sector %u, %u sectores", sector, count);
+                ota_session_abort();
+                send_snak(ota_state.next_seq, PROTO_ERR_PARAM);
+                continue;
+            }
+
+            esp_err_t err = writer_copy(running, offset, len);
+            if (err != ESP_OK) {
+                ota_session_abort();
+                send_snak(ota_state.next_seq, data_error_code(err));
+                continue;
+            }
+
+            ota_state.bytes_copied += len;
+            telemetry_frame_done(t0);
+            seq_advance();
+        }
+        // ========== SECTOR_HASH ==========
+        else if (cmd == PROTO_SECTOR_HASH) {
+            if (rx_buffer_count(buf) < SECTOR_HASH_REQ_LEN) {
+                break;  // Esperar más datos
+            }
+
+            uint8_t req[SECTOR_HASH_REQ_LEN];
+            rx_buffer_read(buf, req, SECTOR_HASH_REQ_LEN);
+
+            // Solo entre sesiones: leer la partición frenaría la recepción
+            if (ota_state.ota_state != OTA_STATE_IDLE) {
+                ESP_LOGW(TAG, "SECTOR_HASH rechazado (estado: %d)", ota_state.ota_state);
+                send_nak_code(PROTO_ERR_STATE);
+                continue;
+            }
+            if (req[3] > SECTOR_HASH_MAX_COUNT) {
+                send_nak_code(PROTO_ERR_PARAM);
+                continue;
+            }
+
+            uint8_t code = send_sector_hashes((req[1] << 8) | req[2], req[3]);
+            if (code) {
+                send_nak_code(code);
+            }
+        }
+        // ========== STATUS ==========
+        else if (cmd == PROTO_STATUS) {
+            rx_buffer_drop(buf, 1);
+            send_status();
+        }
+        // ========== ABORT_OTA ==========
+        else if (cmd == PROTO_ABORT_OTA) {
+            rx_buffer_drop(buf, 1);
+
+            if (ota_state.ota_state == OTA_STATE_IDLE) {
+                response = PROTO_NAK;
+                proto_send(&response, 1);
+                continue;
+            }
+
+            ESP_LOGW(TAG, "ABORT_OTA recibido tras %zu bytes", ota_state.bytes_received);
+            ota_session_abort();
+            response = PROTO_ACK;
+            proto_send(&response, 1);
+        }
+        // ========== END_OTA ==========
+        else if (cmd == PROTO_END_OTA) {
+            if (rx_buffer_count(buf) < 1) {
+                break;
+            }
+            
+            uint8_t end_byte;
+            rx_buffer_read(buf, &end_byte, 1);
+            
+            if (ota_state.ota_state != OTA_STATE_RECEIVING) {
+                ESP_LOGW(TAG, "END_OTA rechazado (estado: %d)", ota_state.ota_state);
+                response = PROTO_NAK;
+                proto_send(&response, 1);
+                continue;
+            }
+            
+            ESP_LOGI(TAG, "END_OTA recibido");
+            ota_state.ota_state = OTA_STATE_ENDING;
+            if (ota_state.windowed && ota_state.acked_seq != ota_state.next_seq) {
+                send_sack(ota_state.next_seq);
+            }
+            proto_flush();
+            
+            // La imagen se rechaza antes de esp_ota_end si no está completa
+            // o no coincide con el hash anunciado
+            uint8_t code = 0;
+            esp_err_t err = writer_flush();
+            if (err != ESP_OK) {
+                code = PROTO_ERR_WRITE;
+            } else if (s_stream && (err = ota_stream_finish(s_stream)) != ESP_OK) {
+                ESP_LOGE(TAG, "Imagen rechazada (%zu bytes): %s", s_image_bytes, esp_err_to_name(err));
+                code = (err == ESP_ERR_INVALID_CRC) ? PROTO_ERR_DIGEST : PROTO_ERR_LENGTH;
+            } else if (s_image_bytes != ota_state.expected_size) {
+                ESP_LOGE(TAG, "Tamaño incorrecto: %zu escritos vs %zu esperados",
+                    s_image_bytes, ota_state.expected_size);
+                code = PROTO_ERR_LENGTH;
+            } else if (s_resumed && !resumed_image_matches()) {
+                code = PROTO_ERR_DIGEST;
+            }
+
+            if (code) {
+                ota_session_abort();
+                send_end_nak(code);
+                continue;
+            }
+            
+            uint32_t elapsed_ms = (xTaskGetTickCount() - ota_state.start_time) * portTICK_PERIOD_MS;
+            float elapsed_s = elapsed_ms / 1000.0;
+            float speed_mbps = (ota_state.bytes_received / (float)(elapsed_ms ? elapsed_ms : 1)) * 1000.0f / (1024.0f * 1024.0f);
+            
+            ESP_LOGI(TAG, "OTA finalizada:");
+            ESP_LOGI(TAG, "   - Bytes: %zu (imagen %zu)", ota_state.bytes_received, s_image_bytes);
+            if (ota_state.dedupe) {
+                ESP_LOGI(TAG, "   - Copiados del slot en ejecución: %zu bytes", ota_state.bytes_copied);
+            }
+            ESP_LOGI(TAG, "   - Chunks: %" PRIu32 " (máx %u bytes)", ota_state.chunk_count,
+                     ota_state.windowed ? ota_state.max_chunk : MAX_CHUNK_PAYLOAD);
+            ESP_LOGI(TAG, "   - Mayor entrega del transporte: %zu bytes",
+                     atomic_load_explicit(&buf->max_append, memory_order_relaxed));
+            ESP_LOGI(TAG, "   - Tiempo: %.2f s", elapsed_s);
+            ESP_LOGI(TAG, "   - Velocidad: %.2f MB/s", speed_mbps);
+            ESP_LOGI(TAG, "   - Flash: %" PRIu32 " sectores, %.2f s escribiendo",
+                     s_writer_stats.sectors_written, s_writer_stats.write_us / 1e6);
+            ESP_LOGI(TAG, "   - Esperas por flash: %" PRIu32 " (%.2f s), cola máx %" PRIu32,
+                     s_writer_stats.stall_count, s_writer_stats.stall_us / 1e6,
+                     s_writer_stats.queue_depth_max);
+            ESP_LOGI(TAG, "   - Buffer RX máx: %" PRIu32 "/%d bytes, heap mínimo %" PRIu32 " bytes",
+                     s_telemetry.ring_max, RX_BUFFER_SIZE, s_telemetry.heap_min);
+            
+            ota_session_release();
+            if (s_resumable) {
+                resume_clear();
+            }
+
+            // Una sesión reanudada no tiene handle: la validación de la imagen
+            // la hace esp_ota_set_boot_partition
+            err = s_resumed ? ESP_OK : esp_ota_end(ota_state.ota_handle);
+            s_resumable = false;
+            s_resumed = false;
+            if (err != ESP_OK) {
+                ESP_LOGE(TAG, "esp_ota_end falló: %s", esp_err_to_name(err));
+                ota_state.ota_state = OTA_STATE_IDLE;
+                session_notify(false);
+                send_end_nak(PROTO_ERR_END);
+                continue;
+            }
+            
+            err = esp_ota_set_boot_partition(ota_state.update_partition);
+            if (err != ESP_OK) {
+                ESP_LOGE(TAG, "esp_ota_set_boot_partition falló: %s", esp_err_to_name(err));
+                ota_state.ota_state = OTA_STATE_IDLE;
+                session_notify(false);
+                send_end_nak(PROTO_ERR_BOOT);
+                continue;
+            }
+            
+            response = PROTO_ACK;
+            proto_send(&response, 1);
+            ESP_LOGI(TAG, "OTA confirmada. Reiniciando en 2s...");
+            ota_state.ota_state = OTA_STATE_IDLE;
+            s_session_notified = false;     // Sin aviso: reinicia con la aplicación aún en pausa
+            proto_flush();
+            
+            vTaskDelay(pdMS_TO_TICKS(2000));
+            esp_restart();
+        }
+        else {
+            uint8_t bad_byte;
+            rx_buffer_read(buf, &bad_byte, 1);
+            ESP_LOGW(TAG, "Byte desconocido descartado: 0x%02X", bad_byte);
+        }
+    }
+
+    // Buffer vacío o frame incompleto: confirmar lo pendiente de la ventana.
+    // Con créditos, también si se liberó medio buffer desde el último anuncio
+    // (frames descartados tras un SNAK no avanzan next_seq y el emisor
+    // podría quedarse sin crédito esperando).
+    if (ota_state.ota_state == OTA_STATE_RECEIVING && ota_state.windowed &&
+        (ota_state.acked_seq != ota_state.next_seq ||
+         (ota_state.credit && credit_limit() - ota_state.credit_sent >= RX_BUFFER_SIZE / 2))) {
+        send_sack(ota_state.next_seq);
+    }
+    proto_flush();
+}
+
+/**
+ * @brief Crear las colas y la task escritora (idempotente)
+ */
+static esp_err_t ota_writer_init(void)
+{
+    if (!s_free_q) {
+        s_free_q = xQueueCreate(WRITER_NUM_BUFFERS, sizeof(sector_buf_t *));
+        s_write_q = xQueueCreate(WRITER_NUM_BUFFERS + 1, sizeof(sector_buf_t *));  // +1: NULL de parada
+        if (!s_free_q || !s_write_q) {
+            ESP_LOGE(TAG, "No se pudieron crear colas del escritor");
+            return ESP_FAIL;
+        }
+
+        // Un buffer queda en s_fill; el resto empieza libre
+        s_fill = &s_sector_bufs[0];
+        s_fill->len = 0;
+        for (int i = 1; i < WRITER_NUM_BUFFERS; i++) {
+            sector_buf_t *sb = &s_sector_bufs[i];
+            sb->len = 0;
+            xQueueSend(s_free_q, &sb, 0);
+        }
+    }
+
+    if (!s_writer_task_handle) {
+        BaseType_t res = xTaskCreate(
+            ota_writer_task,
+            "ota_writer_task",
+            WRITER_TASK_STACK,
+            NULL,
+            WRITER_TASK_PRIO,
+            &s_writer_task_handle
+        );
+        if (res != pdPASS) {
+            ESP_LOGE(TAG, "No se pudo crear task escritora");
+            return ESP_FAIL;
+        }
+    }
+
+    return ESP_OK;
+}
+
+// ============================================================================
+// PUBLIC API
+// ============================================================================
+
+esp_err_t ota_proto_init(void)
+{
+    if (ota_writer_init() != ESP_OK) {
+        return ESP_FAIL;
+    }
+
+    ESP_LOGI(TAG, "RX Buffer: %d bytes (chunk máx %d, negociable hasta %d)", RX_BUFFER_SIZE,
+             MAX_CHUNK_PAYLOAD, MAX_CHUNK_NEGOTIATED);
+    return ESP_OK;
+}
+
+esp_err_t ota_proto_deinit(void)
+{
+    if (atomic_load(&s_transport)) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    // Parar la task escritora (sin sesión no tiene sectores pendientes)
+    if (s_write_q && s_writer_task_handle) {
+        sector_buf_t *stop = NULL;
+        xQueueSend(s_write_q, &stop, portMAX_DELAY);
+        while (s_writer_task_handle) {
+            vTaskDelay(pdMS_TO_TICKS(10));
+        }
+    }
+
+    if (s_free_q) {
+        vQueueDelete(s_free_q);
+        vQueueDelete(s_write_q);
+        s_free_q = NULL;
+        s_write_q = NULL;
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t ota_proto_connect(const ota_proto_transport_t *transport)
+{
+    if (!transport || !transport->send) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    const ota_proto_transport_t *owner = NULL;
+    if (!atomic_compare_exchange_strong(&s_transport, &owner, transport) && owner != transport) {
+        ESP_LOGW(TAG, "%s rechazado: el protocolo está en uso por %s", transport->name, owner->name);
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    // Conexión nueva antes de que el consumidor procese el cierre de la
+    // anterior: ota_proto_disconnect la deja conectada
+    rx_buffer_t *buf = &ota_state.rx_buf;
+    unsigned link = atomic_load_explicit(&buf->link, memory_order_relaxed);
+    while ((link & RX_LINK_CLOSED) && !(link & RX_LINK_REOPENED) &&
+           !atomic_compare_exchange_weak_explicit(&buf->link, &link, link | RX_LINK_REOPENED,
+                                                  memory_order_release, memory_order_relaxed)) {
+    }
+
+    atomic_store_explicit(&buf->max_append, 0, memory_order_relaxed);
+    rx_buffer_request_flush(buf);
+    ESP_LOGI(TAG, "Transporte %s conectado", transport->name);
+    return ESP_OK;
+}
+
+void ota_proto_close(const ota_proto_transport_t *transport)
+{
+    if (!transport || atomic_load(&s_transport) != transport) {
+        return;
+    }
+
+    // Con varios cierres seguidos vale el primero: lo posterior lo vacía la
+    // siguiente ota_proto_connect
+    rx_buffer_t *buf = &ota_state.rx_buf;
+    unsigned link = atomic_load_explicit(&buf->link, memory_order_relaxed);
+    do {
+        if (!(link & RX_LINK_CLOSED)) {
+            atomic_store_explicit(&buf->close_head, atomic_load_explicit(&buf->head, memory_order_relaxed),
+                                  memory_order_relaxed);
+        }
+    } while (!atomic_compare_exchange_weak_explicit(&buf->link, &link, RX_LINK_CLOSED,
+                                                    memory_order_release, memory_order_relaxed));
+}
+
+void ota_proto_disconnect(const ota_proto_transport_t *transport)
+{
+    if (!transport || atomic_load(&s_transport) != transport) {
+        return;
+    }
+
+    if (ota_state.ota_state != OTA_STATE_IDLE) {
+        ESP_LOGW(TAG, "Conexión %s cerrada con OTA en curso", transport->name);
+        ota_session_suspend();
+    }
+
+    rx_buffer_t *buf = &ota_state.rx_buf;
+    unsigned link = atomic_load_explicit(&buf->link, memory_order_acquire);
+    if (!(link & RX_LINK_CLOSED)) {
+        // Cierre visto por el propio consumidor (UART, TCP, SPP VFS): no hay nada más detrás
+        rx_buffer_reset(buf);
+        atomic_store(&s_transport, NULL);
+        ESP_LOGI(TAG, "Transporte %s desconectado", transport->name);
+        return;
+    }
+
+    // Solo hasta close_head (rx_buffer_count no pasa de ahí) y sin tocar el
+    // vaciado que haya pedido una conexión nueva
+    rx_buffer_drop(buf, RX_BUFFER_SIZE);
+
+    for (;;) {
+        if (link & RX_LINK_REOPENED) {
+            if (atomic_compare_exchange_strong_explicit(&buf->link, &link, 0,
+                                                        memory_order_acq_rel, memory_order_acquire)) {
+                ESP_LOGI(TAG, "Transporte %s: conexión anterior cerrada, sigue la nueva", transport->name);
+                return;
+            }
+            continue;
+        }
+
+        // Se suelta antes de borrar el cierre: una ota_proto_connect entre
+        // medias marca RX_LINK_REOPENED y el compare-exchange de abajo falla
+        const ota_proto_transport_t *owner = transport;
+        atomic_compare_exchange_strong(&s_transport, &owner, NULL);
+        if (atomic_compare_exchange_strong_explicit(&buf->link, &link, 0,
+                                                    memory_order_acq_rel, memory_order_acquire)) {
+            ESP_LOGI(TAG, "Transporte %s desconectado", transport->name);
+            return;
+        }
+    }
+}
+
+void ota_proto_push(const uint8_t *data, size_t len)
+{
+    if (len == 0) return;
+
+    size_t stored = rx_buffer_append(&ota_state.rx_buf, data, len);
+    ESP_LOGD(TAG, "RX: %zu/%zu bytes", stored, len);
+}
+
+void ota_proto_process(void)
+{
+    if (atomic_load(&s_transport)) {
+        process_rx_buffer();
+    }
+}
+
+void ota_proto_receive(const uint8_t *data, size_t len)
+{
+    ota_proto_push(data, len);
+    ota_proto_process();
+}
+
+void ota_proto_set_session_cb(ota_proto_session_cb_t cb)
+{
+    s_session_cb = cb;
+}
+
+bool ota_proto_session_active(void)
+{
+    return ota_state.ota_state != OTA_STATE_IDLE;
+}
+
+esp_err_t ota_proto_get_telemetry(ota_proto_telemetry_t *out)
+{
+    if (!out) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    *out = s_telemetry;
+    return ESP_OK;
+}
+
+esp_err_t ota_proto_get_writer_stats(ota_proto_writer_stats_t *out)
+{
+    if (!out) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    *out = s_writer_stats;
+    out->queue_depth = s_write_q ? uxQueueMessagesWaiting(s_write_q) : 0;
+    return ESP_OK;
+}
@@ -0,0 +1,184 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Máximo de bytes por llamada a ota_proto_push/ota_proto_receive
+ *
+ * El buffer RX (16 KB) conserva como mucho un frame incompleto entre
+ * llamadas, así que lecturas de este tamaño nunca lo desbordan.
+ */
+#define OTA_PROTO_MAX_PUSH 4096
+
+/**
+ * @brief Canal de respuesta de un transporte (SPP, UART, TCP...)
+ */
+typedef struct {
+    const char *name;                                               // Para logs
+    esp_err_t (*send)(void *ctx, const uint8_t *data, size_t len);  // Respuestas al emisor
+    esp_err_t (*flush)(void *ctx);  // Opcional: si send acumula, enviar lo pendiente (antes de esperar)
+    void *ctx;
+} ota_proto_transport_t;
+
+/**
+ * @brief Aviso de inicio/fin de sesión OTA (ver ota_proto_set_session_cb)
+ * @param active true al empezar a recibir (START/RESUME), false al cerrarse sin reiniciar
+ * @param transport Nombre del transporte ("SPP", "UART", "TCP"...)
+ */
+typedef void (*ota_proto_session_cb_t)(bool active, const char *transport);
+
+/**
+ * @brief Estadísticas del escritor de flash (sesión OTA actual o última)
+ */
+typedef struct {
+    uint32_t sectors_written;   // Sectores de 4 KB volcados con esp_ota_write
+    uint32_t queue_depth;       // Sectores pendientes de escribir ahora mismo
+    uint32_t queue_depth_max;   // Máximo de sectores pendientes en la sesión
+    uint32_t stall_count;       // Veces que la recepción esperó un buffer libre
+    int64_t stall_us;           // Tiempo total esperando a la flash
+    int64_t write_us;           // Tiempo total en la etapa escritora (inflado + esp_ota_write)
+} ota_proto_writer_stats_t;
+
+#define OTA_PROTO_HIST_BUCKETS 20
+
+/**
+ * @brief Histograma de latencias en escala log2
+ *
+ * bucket[i] cuenta los valores en [2^i, 2^(i+1)) µs; bucket[0] incluye el 0
+ * y el último todo lo que pasa de 2^19 µs (~0.5 s).
+ */
+typedef struct {
+    uint32_t count;
+    uint32_t max_us;
+    uint64_t sum_us;
+    uint32_t bucket[OTA_PROTO_HIST_BUCKETS];
+} ota_proto_hist_t;
+
+/**
+ * @brief Telemetría de la sesión OTA actual o última (se pone a cero en cada START/RESUME)
+ *
+ * Para saber si el límite es el enlace (interarrival grande, parse pequeño),
+ * la CPU (parse ≈ interarrival) o la flash (flash_wait).
+ */
+typedef struct {
+    ota_proto_hist_t interarrival;  // Entre frames de datos consecutivos completos en el buffer RX
+    ota_proto_hist_t parse;         // Procesado de un frame de datos, sin las esperas por flash
+    ota_proto_hist_t flash_wait;    // Espera por un buffer de sector libre (flash por detrás)
+    ota_proto_hist_t write;         // Task escritora por sector (inflado + esp_ota_write)
+    ota_proto_hist_t ack_delay;     // Primer frame sin confirmar hasta su ACK/SACK
+    uint32_t naks;                  // NAK y SNAK enviados
+    uint32_t crc_errors;            // DATA_SEQ/COPY_SEQ descartados por CRC
+    uint32_t seq_gaps;              // Huecos de secuencia detectados
+    uint32_t duplicates;            // Retransmisiones de frames ya escritos
+    uint32_t ring_max;              // Máxima ocupación del buffer RX (bytes)
+    uint32_t heap_min;              // Mínimo de heap libre observado durante la sesión
+} ota_proto_telemetry_t;
+
+/**
+ * @brief Crear la task escritora y sus colas (idempotente)
+ * @return ESP_OK on success, ESP_FAIL if the task or queues cannot be created
+ */
+esp_err_t ota_proto_init(void);
+
+/**
+ * @brief Parar la task escritora y liberar sus colas
+ * @return ESP_OK on success, ESP_ERR_INVALID_STATE if a transport is still connected
+ */
+esp_err_t ota_proto_deinit(void);
+
+/**
+ * @brief Asignar el protocolo a un transporte recién conectado (vacía el buffer RX)
+ *
+ * Llamar desde el mismo contexto que ota_proto_push (el vaciado lo aplica
+ * ota_proto_process en su siguiente pasada). Varios transportes pueden
+ * llamarla a la vez desde sus tasks: solo uno se queda el protocolo.
+ * @param transport Canal de respuesta; debe seguir válido hasta ota_proto_disconnect
+ * @return ESP_OK on success, ESP_ERR_INVALID_STATE if another transport owns the protocol
+ */
+esp_err_t ota_proto_connect(const ota_proto_transport_t *transport);
+
+/**
+ * @brief Avisar del cierre de la conexión desde el contexto de ota_proto_push
+ *
+ * Para transportes que conectan y hacen push en un callback pero
+ * desconectan en la task de proceso (SPP). Lo recibido después es de la
+ * conexión siguiente: ota_proto_process no lo procesa y ota_proto_disconnect
+ * no lo descarta. Si el mismo transporte vuelve a conectar antes de
+ * ota_proto_disconnect, esta cierra la sesión anterior y deja la nueva conectada.
+ * @param transport Transporte cuya conexión se cerró (se ignora si no es el conectado)
+ */
+void ota_proto_close(const ota_proto_transport_t *transport);
+
+/**
+ * @brief Liberar el protocolo; una OTA en curso se suspende (o aborta) tras drenar el escritor
+ *
+ * Llamar desde la misma task que llama a ota_proto_process.
+ * @param transport Transporte que se desconecta (se ignora si no es el conectado)
+ */
+void ota_proto_disconnect(const ota_proto_transport_t *transport);
+
+/**
+ * @brief Añadir bytes recibidos al buffer RX sin procesarlos
+ *
+ * Para transportes que reciben en un callback (SPP): el callback hace push y
+ * una task propia llama a ota_proto_process. El buffer es un anillo
+ * productor/consumidor sin locks: un único contexto hace push y otro (o el
+ * mismo) procesa. Si no hay sitio se descarta lo que no cabe.
+ */
+void ota_proto_push(const uint8_t *data, size_t len);
+
+/**
+ * @brief Procesar los frames completos del buffer RX y responder por el transporte
+ *
+ * Puede bloquear esperando a la flash y no vuelve si la OTA se confirma (esp_restart).
+ */
+void ota_proto_process(void);
+
+/**
+ * @brief ota_proto_push + ota_proto_process, para transportes con task de lectura propia
+ */
+void ota_proto_receive(const uint8_t *data, size_t len);
+
+/**
+ * @brief Hay una sesión OTA abierta
+ */
+bool ota_proto_session_active(void);
+
+/**
+ * @brief Registrar el aviso de inicio/fin de sesión (NULL para quitarlo)
+ *
+ * Se llama desde la task de protocolo: al aceptar START_OTA, START_OTA_EXT o
+ * RESUME_OTA, y al cerrarse la sesión por ABORT, error, END rechazado o
+ * desconexión. Tras un END correcto no se avisa: el dispositivo reinicia.
+ * Sirve para pausar el resto de la aplicación mientras dura la OTA
+ * (modules/OTA_Quiesce).
+ */
+void ota_proto_set_session_cb(ota_proto_session_cb_t cb);
+
+/**
+ * @brief Get flash writer statistics (stall time > 0 means flash is the bottleneck)
+ * @param out Destination structure
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG if out is NULL
+ */
+esp_err_t ota_proto_get_writer_stats(ota_proto_writer_stats_t *out);
+
+/**
+ * @brief Get OTA telemetry (latency histograms, error counters, RX ring and heap usage)
+ *
+ * Durante una sesión el histograma `write` lo actualiza la task escritora:
+ * puede ir un sector por detrás.
+ * @param out Destination structure
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG if out is NULL
+ */
+esp_err_t ota_proto_get_telemetry(ota_proto_telemetry_t *out);
+
+#ifdef __cplusplus
+}
+#endif
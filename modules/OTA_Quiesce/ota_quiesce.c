@@ -0,0 +1,143 @@
+#include <string.h>
+#include <inttypes.h>
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_wifi.h"
+#include "esp_pm.h"
+#include "ota_quiesce.h"
+
+#define TAG "ota_quiesce"
+
+typedef struct {
+    const char *name;
+    ota_quiesce_fn_t fn;
+    void *ctx;
+} quiesce_hook_t;
+
+static ota_quiesce_config_t s_cfg;
+static SemaphoreHandle_t s_lock = NULL;
+static quiesce_hook_t s_hooks[OTA_QUIESCE_MAX_HOOKS];
+static size_t s_num_hooks;
+static int s_depth;                 // begin sin su end
+static bool s_wifi_stopped;         // Lo paró ota_quiesce_begin: hay que arrancarlo al salir
+static int64_t s_start_us;
+static esp_pm_lock_handle_t s_cpu_lock = NULL;
+static esp_pm_lock_handle_t s_sleep_lock = NULL;
+
+esp_err_t ota_quiesce_init(const ota_quiesce_config_t *cfg)
+{
+    if (s_lock) return ESP_OK;
+
+    ota_quiesce_config_t def = OTA_QUIESCE_CONFIG_DEFAULT();
+    s_cfg = cfg ? *cfg : def;
+
+    s_lock = xSemaphoreCreateMutex();
+    if (!s_lock) return ESP_ERR_NO_MEM;
+
+#ifdef CONFIG_PM_ENABLE
+    if (s_cfg.cpu_max && esp_pm_lock_create(ESP_PM_CPU_FREQ_MAX, 0, "ota_cpu", &s_cpu_lock) != ESP_OK) {
+        ESP_LOGW(TAG, "No se pudo crear el lock de CPU");
+    }
+    if (s_cfg.no_light_sleep && esp_pm_lock_create(ESP_PM_NO_LIGHT_SLEEP, 0, "ota_sleep", &s_sleep_lock) != ESP_OK) {
+        ESP_LOGW(TAG, "No se pudo crear el lock de light sleep");
+    }
+#else
+    // Sin gestión de energía la CPU ya va fija a CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ y no hay light sleep
+    ESP_LOGI(TAG, "CONFIG_PM_ENABLE desactivado: sin locks de energía");
+#endif
+    return ESP_OK;
+}
+
+esp_err_t ota_quiesce_register(const char *name, ota_quiesce_fn_t fn, void *ctx)
+{
+    if (!s_lock || !fn) return ESP_ERR_INVALID_ARG;
+
+    esp_err_t err = ESP_OK;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    if (s_num_hooks < OTA_QUIESCE_MAX_HOOKS) {
+        s_hooks[s_num_hooks++] = (quiesce_hook_t){ name, fn, ctx };
+        if (s_depth > 0) {
+            fn(ctx, true);   // Registrada con una OTA en curso
+        }
+    } else {
+        err = ESP_ERR_NO_MEM;
+    }
+    xSemaphoreGive(s_lock);
+    return err;
+}
+
+esp_err_t ota_quiesce_begin(bool wifi_in_use)
+{
+    if (!s_lock) return ESP_ERR_INVALID_STATE;
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    if (s_depth++ > 0) {
+        xSemaphoreGive(s_lock);
+        return ESP_OK;
+    }
+
+    s_start_us = esp_timer_get_time();
+    if (s_cpu_lock) esp_pm_lock_acquire(s_cpu_lock);
+    if (s_sleep_lock) esp_pm_lock_acquire(s_sleep_lock);
+
+    for (size_t i = 0; i < s_num_hooks; i++) {
+        s_hooks[i].fn(s_hooks[i].ctx, true);
+    }
+
+    // Sin Wi-Fi la radio queda entera para Bluetooth (sin coexistencia)
+    wifi_mode_t mode;
+    s_wifi_stopped = s_cfg.suspend_wifi && !wifi_in_use &&
+                     esp_wifi_get_mode(&mode) == ESP_OK && esp_wifi_stop() == ESP_OK;
+
+    ESP_LOGI(TAG, "Modo OTA: %u tareas en pausa%s", (unsigned)s_num_hooks,
+             s_wifi_stopped ? ", Wi-Fi parado" : "");
+    xSemaphoreGive(s_lock);
+    return ESP_OK;
+}
+
+void ota_quiesce_end(void)
+{
+    if (!s_lock) return;
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    if (s_depth == 0 || --s_depth > 0) {
+        xSemaphoreGive(s_lock);
+        return;
+    }
+
+    if (s_wifi_stopped) {
+        // La app vuelve a conectar en WIFI_EVENT_STA_START como al arrancar
+        esp_err_t err = esp_wifi_start();
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG, "esp_wifi_start falló: %s", esp_err_to_name(err));
+        }
+        s_wifi_stopped = false;
+    }
+
+    for (size_t i = s_num_hooks; i > 0; i--) {
+        s_hooks[i - 1].fn(s_hooks[i - 1].ctx, false);
+    }
+
+    if (s_sleep_lock) esp_pm_lock_release(s_sleep_lock);
+    if (s_cpu_lock) esp_pm_lock_release(s_cpu_lock);
+
+    ESP_LOGI(TAG, "Fin del modo OTA tras %" PRId64 " ms", (esp_timer_get_time() - s_start_us) / 1000);
+    xSemaphoreGive(s_lock);
+}
+
+bool ota_quiesce_active(void)
+{
+    return s_depth > 0;
+}
+
+void ota_quiesce_proto_session(bool active, const char *transport)
+{
+    if (active) {
+        ota_quiesce_begin(transport && strcmp(transport, "TCP") == 0);
+    } else {
+        ota_quiesce_end();
+    }
+}
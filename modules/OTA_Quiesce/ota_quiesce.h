@@ -0,0 +1,90 @@
+#pragma once
+
+#include <stdbool.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Modo "actualización en curso".
+ *
+ * Mientras dura una OTA (Bluetooth, UART, TCP o HTTPS) el resto de la
+ * aplicación compite con ella por la CPU, el bus I2C, la radio y el log.
+ * ota_quiesce_begin() pausa las tareas de fondo registradas, toma los locks
+ * de gestión de energía (CPU al máximo, sin light sleep) y, si la OTA no
+ * llega por Wi-Fi, para el Wi-Fi; ota_quiesce_end() lo deshace todo.
+ */
+
+// Tareas de fondo que se pueden registrar
+#ifndef OTA_QUIESCE_MAX_HOOKS
+#define OTA_QUIESCE_MAX_HOOKS 8
+#endif
+
+/**
+ * @brief Pausar (pause = true) o reanudar una tarea de fondo
+ *
+ * Debe volver enseguida: la tarea deja de trabajar en su siguiente vuelta
+ * (p. ej. sensoramb_pause, ccs811_pause).
+ */
+typedef void (*ota_quiesce_fn_t)(void *ctx, bool pause);
+
+/**
+ * @brief Configuración del modo OTA
+ */
+typedef struct {
+    bool cpu_max;           // Lock ESP_PM_CPU_FREQ_MAX (solo con CONFIG_PM_ENABLE)
+    bool no_light_sleep;    // Lock ESP_PM_NO_LIGHT_SLEEP (solo con CONFIG_PM_ENABLE)
+    bool suspend_wifi;      // esp_wifi_stop() si la OTA no llega por Wi-Fi (SPP, UART)
+} ota_quiesce_config_t;
+
+#define OTA_QUIESCE_CONFIG_DEFAULT() {  \
+    .cpu_max = true,                    \
+    .no_light_sleep = true,             \
+    .suspend_wifi = false,              \
+}
+
+/**
+ * @brief Crear los locks de energía (llamar una vez al arrancar)
+ * @param cfg Configuración; NULL para OTA_QUIESCE_CONFIG_DEFAULT()
+ * @return ESP_OK on success
+ */
+esp_err_t ota_quiesce_init(const ota_quiesce_config_t *cfg);
+
+/**
+ * @brief Registrar una tarea de fondo que se pausa durante la OTA
+ * @param name Para los logs
+ * @return ESP_OK, ESP_ERR_NO_MEM si ya hay OTA_QUIESCE_MAX_HOOKS
+ */
+esp_err_t ota_quiesce_register(const char *name, ota_quiesce_fn_t fn, void *ctx);
+
+/**
+ * @brief Entrar en modo OTA (anidable: solo la primera llamada pausa)
+ * @param wifi_in_use La OTA llega por Wi-Fi (TCP, HTTPS): no parar el Wi-Fi
+ * @return ESP_OK, ESP_ERR_INVALID_STATE sin ota_quiesce_init
+ */
+esp_err_t ota_quiesce_begin(bool wifi_in_use);
+
+/**
+ * @brief Salir del modo OTA: la última llamada reanuda todo
+ */
+void ota_quiesce_end(void);
+
+/**
+ * @brief Hay una OTA en curso (entre begin y end)
+ */
+bool ota_quiesce_active(void);
+
+/**
+ * @brief Aviso de sesión del protocolo OTA: begin/end según el transporte
+ *
+ * Con la firma de ota_proto_session_cb_t, para
+ * ota_proto_set_session_cb(ota_quiesce_proto_session). Solo el transporte
+ * "TCP" cuenta como Wi-Fi en uso.
+ */
+void ota_quiesce_proto_session(bool active, const char *transport);
+
+#ifdef __cplusplus
+}
+#endif
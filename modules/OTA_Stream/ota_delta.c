@@ -0,0 +1,219 @@
+#include <stdlib.h>
+#include <inttypes.h>
+#include <string.h>
+#include "esp_log.h"
+#include "esp_ota_ops.h"
+#include "esp_partition.h"
+#include "ota_delta.h"
+
+#define TAG "ota_delta"
+
+// Tamaño del buffer de rebote para COPY (lectura de la partición base)
+#define DELTA_COPY_BUF_SIZE 1024
+
+typedef enum {
+    DELTA_ST_HEADER,    // Acumulando cabecera
+    DELTA_ST_OP,        // Esperando código de operación
+    DELTA_ST_ARGS,      // Acumulando argumentos de la operación
+    DELTA_ST_INSERT,    // Pasando datos literales al sink
+    DELTA_ST_DONE,
+} delta_state_t;
+
+struct ota_delta {
+    delta_state_t state;
+    uint8_t hdr[OTA_DELTA_HEADER_LEN];  // Cabecera o argumentos en curso
+    size_t hdr_len;
+    size_t hdr_need;
+    uint8_t op;
+    uint32_t remaining;                 // Bytes pendientes de INSERT
+    uint32_t base_size;
+    uint32_t target_size;
+    uint32_t written;
+    const esp_partition_t *base;
+    ota_stream_sink_t sink;
+    void *ctx;
+    uint8_t copy_buf[DELTA_COPY_BUF_SIZE];
+};
+
+static uint32_t be32(const uint8_t *p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static esp_err_t delta_emit(ota_delta_t *d, const uint8_t *data, size_t len)
+{
+    if (d->written + len > d->target_size) {
+        ESP_LOGE(TAG, "El parche excede el tamaño destino (%" PRIu32 ")", d->target_size);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    esp_err_t err = d->sink(d->ctx, data, len);
+    if (err == ESP_OK) {
+        d->written += len;
+    }
+    return err;
+}
+
+/**
+ * @brief Validar cabecera y comprobar que la base es la imagen en ejecución
+ */
+static esp_err_t delta_check_header(ota_delta_t *d)
+{
+    if (memcmp(d->hdr, OTA_DELTA_MAGIC, 4) != 0 || d->hdr[4] != OTA_DELTA_VERSION) {
+        ESP_LOGE(TAG, "Cabecera de parche inválida");
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    d->base_size = be32(&d->hdr[8]);
+    d->target_size = be32(&d->hdr[12]);
+
+    if (d->base_size > d->base->size) {
+        ESP_LOGE(TAG, "Base de %" PRIu32 " bytes no cabe en la partición", d->base_size);
+        return ESP_ERR_INVALID_VERSION;
+    }
+
+    uint8_t digest[OTA_STREAM_SHA256_LEN];
+    esp_err_t err = ota_partition_sha256(d->base, d->base_size, digest);
+    if (err != ESP_OK) return err;
+
+    if (memcmp(digest, &d->hdr[16], sizeof(digest)) != 0) {
+        ESP_LOGE(TAG, "El parche no corresponde a la imagen en ejecución");
+        return ESP_ERR_INVALID_VERSION;
+    }
+
+    ESP_LOGI(TAG, "Parche: base %" PRIu32 " bytes -> destino %" PRIu32 " bytes",
+             d->base_size, d->target_size);
+    return ESP_OK;
+}
+
+/**
+ * @brief Ejecutar COPY leyendo de la partición base en bloques
+ */
+static esp_err_t delta_copy(ota_delta_t *d, uint32_t src_off, uint32_t len)
+{
+    if (src_off > d->base_size || len > d->base_size - src_off) {
+        ESP_LOGE(TAG, "COPY fuera de la base: %" PRIu32 "+%" PRIu32, src_off, len);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    while (len > 0) {
+        size_t n = (len > DELTA_COPY_BUF_SIZE) ? DELTA_COPY_BUF_SIZE : len;
+        esp_err_t err = esp_partition_read(d->base, src_off, d->copy_buf, n);
+        if (err != ESP_OK) return err;
+
+        err = delta_emit(d, d->copy_buf, n);
+        if (err != ESP_OK) return err;
+
+        src_off += n;
+        len -= n;
+    }
+
+    return ESP_OK;
+}
+
+ota_delta_t *ota_delta_create(ota_stream_sink_t sink, void *ctx)
+{
+    if (!sink) return NULL;
+
+    const esp_partition_t *base = esp_ota_get_running_partition();
+    if (!base) return NULL;
+
+    ota_delta_t *d = calloc(1, sizeof(*d));
+    if (!d) return NULL;
+
+    d->state = DELTA_ST_HEADER;
+    d->hdr_need = OTA_DELTA_HEADER_LEN;
+    d->base = base;
+    d->sink = sink;
+    d->ctx = ctx;
+    return d;
+}
+
+esp_err_t ota_delta_feed(ota_delta_t *d, const uint8_t *data, size_t len)
+{
+    esp_err_t err = ESP_OK;
+
+    while (len > 0) {
+        switch (d->state) {
+        case DELTA_ST_HEADER:
+        case DELTA_ST_ARGS: {
+            size_t n = d->hdr_need - d->hdr_len;
+            if (n > len) n = len;
+            memcpy(&d->hdr[d->hdr_len], data, n);
+            d->hdr_len += n;
+            data += n;
+            len -= n;
+            if (d->hdr_len < d->hdr_need) break;
+
+            if (d->state == DELTA_ST_HEADER) {
+                err = delta_check_header(d);
+                d->state = DELTA_ST_OP;
+            } else if (d->op == OTA_DELTA_OP_COPY) {
+                err = delta_copy(d, be32(&d->hdr[0]), be32(&d->hdr[4]));
+                d->state = DELTA_ST_OP;
+            } else {
+                d->remaining = be32(&d->hdr[0]);
+                d->state = d->remaining ? DELTA_ST_INSERT : DELTA_ST_OP;
+            }
+            if (err != ESP_OK) return err;
+            break;
+        }
+
+        case DELTA_ST_OP:
+            d->op = *data++;
+            len--;
+            d->hdr_len = 0;
+            if (d->op == OTA_DELTA_OP_COPY) {
+                d->hdr_need = 8;
+                d->state = DELTA_ST_ARGS;
+            } else if (d->op == OTA_DELTA_OP_INSERT) {
+                d->hdr_need = 4;
+                d->state = DELTA_ST_ARGS;
+            } else if (d->op == OTA_DELTA_OP_END) {
+                if (d->written != d->target_size) {
+                    ESP_LOGE(TAG, "Parche incompleto: %" PRIu32 "/%" PRIu32 " bytes",
+                             d->written, d->target_size);
+                    return ESP_ERR_INVALID_SIZE;
+                }
+                d->state = DELTA_ST_DONE;
+            } else {
+                ESP_LOGE(TAG, "Operación desconocida: 0x%02X", d->op);
+                return ESP_ERR_INVALID_ARG;
+            }
+            break;
+
+        case DELTA_ST_INSERT: {
+            // Los literales van directos del buffer de entrada al sink
+            size_t n = (len < d->remaining) ? len : d->remaining;
+            err = delta_emit(d, data, n);
+            if (err != ESP_OK) return err;
+            data += n;
+            len -= n;
+            d->remaining -= n;
+            if (d->remaining == 0) d->state = DELTA_ST_OP;
+            break;
+        }
+
+        case DELTA_ST_DONE:
+            ESP_LOGE(TAG, "Datos tras el final del parche");
+            return ESP_ERR_INVALID_SIZE;
+        }
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t ota_delta_sink(void *d, const uint8_t *data, size_t len)
+{
+    return ota_delta_feed((ota_delta_t *)d, data, len);
+}
+
+bool ota_delta_done(const ota_delta_t *d)
+{
+    return d->state == DELTA_ST_DONE;
+}
+
+void ota_delta_destroy(ota_delta_t *d)
+{
+    free(d);
+}
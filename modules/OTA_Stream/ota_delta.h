@@ -0,0 +1,70 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "ota_stream.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Formato de parche (generado con `pack_ota.py delta`), todo big-endian:
+ *
+ *   Cabecera (48 bytes):
+ *     "OTAD" | version[1] | reservado[3] | base_size[4] | target_size[4] | sha256(base)[32]
+ *
+ *   Operaciones, hasta OTA_DELTA_OP_END:
+ *     0x01 | src_off[4] | len[4]    COPY: len bytes de la imagen base desde src_off
+ *     0x02 | len[4] | datos[len]    INSERT: len bytes literales
+ *     0x00                          END
+ *
+ * La base es la partición en ejecución; su SHA-256 (primeros base_size bytes)
+ * debe coincidir con el de la cabecera o el parche se rechaza.
+ */
+#define OTA_DELTA_MAGIC "OTAD"
+#define OTA_DELTA_VERSION 1
+#define OTA_DELTA_HEADER_LEN 48
+
+#define OTA_DELTA_OP_END 0x00
+#define OTA_DELTA_OP_COPY 0x01
+#define OTA_DELTA_OP_INSERT 0x02
+
+typedef struct ota_delta ota_delta_t;
+
+/**
+ * @brief Crear un aplicador de parches contra la partición en ejecución
+ * @param sink Destino de la imagen reconstruida (normalmente esp_ota_write)
+ * @return Aplicador o NULL si no hay memoria
+ */
+ota_delta_t *ota_delta_create(ota_stream_sink_t sink, void *ctx);
+
+/**
+ * @brief Alimentar bytes del parche (cualquier tamaño y fragmentación)
+ * @return ESP_OK, ESP_ERR_INVALID_VERSION si la base no coincide,
+ *         ESP_ERR_INVALID_ARG si el parche está mal formado
+ *         o el error devuelto por el sink
+ */
+esp_err_t ota_delta_feed(ota_delta_t *d, const uint8_t *data, size_t len);
+
+/**
+ * @brief Igual que ota_delta_feed, con firma de sink para encadenar etapas
+ * @param d ota_delta_t* creado con ota_delta_create
+ */
+esp_err_t ota_delta_sink(void *d, const uint8_t *data, size_t len);
+
+/**
+ * @brief Indica si se ha procesado OTA_DELTA_OP_END con el tamaño esperado
+ */
+bool ota_delta_done(const ota_delta_t *d);
+
+/**
+ * @brief Liberar el aplicador
+ */
+void ota_delta_destroy(ota_delta_t *d);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,94 @@
+#include <string.h>
+#include <inttypes.h>
+#include "sdkconfig.h"
+#include "esp_log.h"
+#include "ota_image_check.h"
+
+#define TAG "ota_image_check"
+
+void ota_image_check_init(ota_image_check_t *chk)
+{
+    chk->len = 0;
+    chk->verdict = OTA_IMAGE_PENDING;
+}
+
+ota_image_verdict_t ota_image_check_desc(const esp_app_desc_t *desc)
+{
+    const esp_app_desc_t *running = esp_app_get_description();
+
+    if (desc->magic_word != ESP_APP_DESC_MAGIC_WORD) {
+        ESP_LOGE(TAG, "Descripción de app inválida (magic 0x%08" PRIX32 ")", desc->magic_word);
+        return OTA_IMAGE_BAD_MAGIC;
+    }
+
+    ESP_LOGI(TAG, "Imagen recibida: %.32s %.32s (secure_version %" PRIu32 ", IDF %.32s)",
+             desc->project_name, desc->version, desc->secure_version, desc->idf_ver);
+
+    if (OTA_IMAGE_CHECK_PROJECT &&
+        strncmp(desc->project_name, running->project_name, sizeof(desc->project_name)) != 0) {
+        ESP_LOGE(TAG, "Proyecto %.32s, se esperaba %.32s", desc->project_name, running->project_name);
+        return OTA_IMAGE_BAD_PROJECT;
+    }
+
+    if (desc->secure_version < running->secure_version) {
+        ESP_LOGE(TAG, "secure_version %" PRIu32 " menor que la actual (%" PRIu32 ")",
+                 desc->secure_version, running->secure_version);
+        return OTA_IMAGE_OLD_SECURE_VERSION;
+    }
+
+    return OTA_IMAGE_VALID;
+}
+
+/**
+ * @brief Decidir con la cabecera completa (chk->head lleno)
+ */
+static ota_image_verdict_t image_check_head(const ota_image_check_t *chk)
+{
+    esp_image_header_t hdr;
+    esp_app_desc_t desc;
+
+    memcpy(&hdr, chk->head, sizeof(hdr));
+    memcpy(&desc, &chk->head[sizeof(hdr) + sizeof(esp_image_segment_header_t)], sizeof(desc));
+
+    if (hdr.magic != ESP_IMAGE_HEADER_MAGIC) {
+        ESP_LOGE(TAG, "No es una imagen de app (magic 0x%02X)", hdr.magic);
+        return OTA_IMAGE_BAD_MAGIC;
+    }
+
+    if (hdr.chip_id != CONFIG_IDF_FIRMWARE_CHIP_ID) {
+        ESP_LOGE(TAG, "Imagen para chip_id %d, este chip es %d", hdr.chip_id, CONFIG_IDF_FIRMWARE_CHIP_ID);
+        return OTA_IMAGE_BAD_CHIP;
+    }
+
+    return ota_image_check_desc(&desc);
+}
+
+ota_image_verdict_t ota_image_check_feed(ota_image_check_t *chk, const uint8_t *data, size_t len)
+{
+    if (chk->verdict != OTA_IMAGE_PENDING) {
+        return chk->verdict;
+    }
+
+    size_t take = OTA_IMAGE_CHECK_LEN - chk->len;
+    if (take > len) take = len;
+    memcpy(&chk->head[chk->len], data, take);
+    chk->len += take;
+
+    if (chk->len == OTA_IMAGE_CHECK_LEN) {
+        chk->verdict = image_check_head(chk);
+    }
+    return chk->verdict;
+}
+
+const char *ota_image_verdict_str(ota_image_verdict_t verdict)
+{
+    switch (verdict) {
+    case OTA_IMAGE_PENDING: return "pendiente";
+    case OTA_IMAGE_VALID: return "válida";
+    case OTA_IMAGE_BAD_MAGIC: return "no es una imagen de app";
+    case OTA_IMAGE_BAD_CHIP: return "otro chip";
+    case OTA_IMAGE_BAD_PROJECT: return "otro proyecto";
+    case OTA_IMAGE_OLD_SECURE_VERSION: return "secure_version menor";
+    }
+    return "?";
+}
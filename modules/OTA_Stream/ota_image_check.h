@@ -0,0 +1,75 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "esp_app_format.h"
+#include "esp_app_desc.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Validación temprana de la imagen: con los primeros bytes (cabecera de
+ * imagen, primer segmento y esp_app_desc_t) se decide si la imagen sirve
+ * para este dispositivo, sin esperar a esp_ota_end ni al arranque.
+ *
+ * Comprueba, contra la app en ejecución:
+ *   - magic de imagen (0xE9) y de esp_app_desc_t
+ *   - chip_id de la cabecera (CONFIG_IDF_FIRMWARE_CHIP_ID)
+ *   - project_name (si OTA_IMAGE_CHECK_PROJECT)
+ *   - secure_version, que no puede ser menor (anti-rollback)
+ */
+#define OTA_IMAGE_CHECK_LEN (sizeof(esp_image_header_t) + sizeof(esp_image_segment_header_t) + \
+                             sizeof(esp_app_desc_t))
+
+// true: rechazar imágenes de otro proyecto (p. ej. i2c_oled.bin en el dispositivo OTA)
+#ifndef OTA_IMAGE_CHECK_PROJECT
+#define OTA_IMAGE_CHECK_PROJECT true
+#endif
+
+typedef enum {
+    OTA_IMAGE_PENDING = 0,          // Aún no han llegado OTA_IMAGE_CHECK_LEN bytes
+    OTA_IMAGE_VALID,
+    OTA_IMAGE_BAD_MAGIC,            // No es una imagen de app de ESP-IDF
+    OTA_IMAGE_BAD_CHIP,             // Compilada para otro chip
+    OTA_IMAGE_BAD_PROJECT,          // Otro proyecto
+    OTA_IMAGE_OLD_SECURE_VERSION,   // secure_version menor que la de la app en ejecución
+} ota_image_verdict_t;
+
+#define OTA_IMAGE_REJECTED(v) ((v) > OTA_IMAGE_VALID)
+
+typedef struct {
+    uint8_t head[OTA_IMAGE_CHECK_LEN];
+    size_t len;
+    ota_image_verdict_t verdict;
+} ota_image_check_t;
+
+/**
+ * @brief Preparar la comprobación de una imagen nueva
+ */
+void ota_image_check_init(ota_image_check_t *chk);
+
+/**
+ * @brief Alimentar bytes de imagen desde el offset 0 (cualquier fragmentación)
+ *
+ * Acumula hasta OTA_IMAGE_CHECK_LEN bytes y entonces decide; después ignora
+ * los datos y devuelve siempre el mismo veredicto.
+ */
+ota_image_verdict_t ota_image_check_feed(ota_image_check_t *chk, const uint8_t *data, size_t len);
+
+/**
+ * @brief Comprobar solo la descripción de la app (p. ej. la de esp_https_ota_get_img_desc)
+ */
+ota_image_verdict_t ota_image_check_desc(const esp_app_desc_t *desc);
+
+/**
+ * @brief Texto del veredicto para los logs
+ */
+const char *ota_image_verdict_str(ota_image_verdict_t verdict);
+
+#ifdef __cplusplus
+}
+#endif
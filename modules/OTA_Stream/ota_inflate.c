@@ -0,0 +1,98 @@
+#include <stdlib.h>
+#include <string.h>
+#include "esp_log.h"
+#include "esp32/rom/miniz.h"
+#include "ota_inflate.h"
+
+#define TAG "ota_inflate"
+
+struct ota_inflate {
+    tinfl_decompressor decomp;              // Estado de tinfl (en ROM)
+    uint8_t dict[OTA_INFLATE_WINDOW_SIZE];  // Salida circular = ventana deflate
+    size_t dict_ofs;
+    size_t total_out;
+    bool done;
+    ota_stream_sink_t sink;
+    void *ctx;
+};
+
+ota_inflate_t *ota_inflate_create(ota_stream_sink_t sink, void *ctx)
+{
+    if (!sink) return NULL;
+
+    ota_inflate_t *inf = malloc(sizeof(*inf));
+    if (!inf) {
+        ESP_LOGE(TAG, "No hay memoria para el descompresor (%u bytes)", (unsigned)sizeof(*inf));
+        return NULL;
+    }
+
+    tinfl_init(&inf->decomp);
+    inf->dict_ofs = 0;
+    inf->total_out = 0;
+    inf->done = false;
+    inf->sink = sink;
+    inf->ctx = ctx;
+    return inf;
+}
+
+esp_err_t ota_inflate_feed(ota_inflate_t *inf, const uint8_t *data, size_t len)
+{
+    size_t in_pos = 0;
+
+    if (inf->done) {
+        return len ? ESP_ERR_INVALID_SIZE : ESP_OK;
+    }
+
+    for (;;) {
+        size_t in_bytes = len - in_pos;
+        size_t out_bytes = OTA_INFLATE_WINDOW_SIZE - inf->dict_ofs;
+
+        tinfl_status status = tinfl_decompress(&inf->decomp, data + in_pos, &in_bytes,
+                                               inf->dict, inf->dict + inf->dict_ofs, &out_bytes,
+                                               TINFL_FLAG_HAS_MORE_INPUT);
+        in_pos += in_bytes;
+
+        if (out_bytes > 0) {
+            esp_err_t err = inf->sink(inf->ctx, inf->dict + inf->dict_ofs, out_bytes);
+            if (err != ESP_OK) return err;
+            inf->total_out += out_bytes;
+            inf->dict_ofs = (inf->dict_ofs + out_bytes) & (OTA_INFLATE_WINDOW_SIZE - 1);
+        }
+
+        if (status == TINFL_STATUS_DONE) {
+            inf->done = true;
+            return (in_pos == len) ? ESP_OK : ESP_ERR_INVALID_SIZE;
+        }
+
+        if (status < 0) {
+            ESP_LOGE(TAG, "Stream deflate corrupto (status %d) tras %zu bytes", status, inf->total_out);
+            return ESP_ERR_INVALID_CRC;
+        }
+
+        // Sin más entrada: esperar al siguiente bloque
+        if (status == TINFL_STATUS_NEEDS_MORE_INPUT) {
+            return ESP_OK;
+        }
+        // TINFL_STATUS_HAS_MORE_OUTPUT: el diccionario se llenó, seguir
+    }
+}
+
+esp_err_t ota_inflate_sink(void *inf, const uint8_t *data, size_t len)
+{
+    return ota_inflate_feed((ota_inflate_t *)inf, data, len);
+}
+
+bool ota_inflate_done(const ota_inflate_t *inf)
+{
+    return inf->done;
+}
+
+size_t ota_inflate_total_out(const ota_inflate_t *inf)
+{
+    return inf->total_out;
+}
+
+void ota_inflate_destroy(ota_inflate_t *inf)
+{
+    free(inf);
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "ota_stream.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Ventana de deflate usada por el empaquetador (pack_ota.py, wbits = -12).
+ * El descompresor reserva exactamente este tamaño como diccionario circular,
+ * así que una imagen comprimida con una ventana mayor no se puede inflar.
+ */
+#define OTA_INFLATE_WINDOW_BITS 12
+#define OTA_INFLATE_WINDOW_SIZE (1 << OTA_INFLATE_WINDOW_BITS)
+
+typedef struct ota_inflate ota_inflate_t;
+
+/**
+ * @brief Crear un descompresor deflate (raw, sin cabecera zlib)
+ * @param sink Callback que recibe bloques de hasta OTA_INFLATE_WINDOW_SIZE bytes
+ * @param ctx Contexto pasado al sink
+ * @return Descompresor o NULL si no hay memoria
+ */
+ota_inflate_t *ota_inflate_create(ota_stream_sink_t sink, void *ctx);
+
+/**
+ * @brief Alimentar bytes comprimidos (cualquier tamaño y fragmentación)
+ * @return ESP_OK, ESP_ERR_INVALID_CRC si el stream está corrupto,
+ *         ESP_ERR_INVALID_SIZE si llegan datos tras el final del stream
+ *         o el error devuelto por el sink
+ */
+esp_err_t ota_inflate_feed(ota_inflate_t *inf, const uint8_t *data, size_t len);
+
+/**
+ * @brief Igual que ota_inflate_feed, con firma de sink para encadenar etapas
+ * @param inf ota_inflate_t* creado con ota_inflate_create
+ */
+esp_err_t ota_inflate_sink(void *inf, const uint8_t *data, size_t len);
+
+/**
+ * @brief Indica si se ha decodificado el último bloque del stream
+ */
+bool ota_inflate_done(const ota_inflate_t *inf);
+
+/**
+ * @brief Bytes descomprimidos entregados al sink hasta ahora
+ */
+size_t ota_inflate_total_out(const ota_inflate_t *inf);
+
+/**
+ * @brief Liberar el descompresor
+ */
+void ota_inflate_destroy(ota_inflate_t *inf);
+
+#ifdef __cplusplus
+}
+#endif
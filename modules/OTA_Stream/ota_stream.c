@@ -0,0 +1,162 @@
+#include <stdlib.h>
+#include <string.h>
+#include "esp_log.h"
+#include "mbedtls/sha256.h"
+#include "ota_inflate.h"
+#include "ota_delta.h"
+#include "ota_stream.h"
+
+#define TAG "ota_stream"
+
+// Buffer de lectura para ota_partition_sha256
+#define PARTITION_READ_CHUNK 1024
+
+struct ota_stream {
+    ota_inflate_t *inflate;
+    ota_delta_t *delta;
+    ota_stream_sink_t entry;    // Primera etapa del pipeline
+    void *entry_ctx;
+    ota_stream_sink_t sink;     // Destino final (imagen)
+    void *sink_ctx;
+    size_t total_out;
+    bool verify;
+    uint8_t expected[OTA_STREAM_SHA256_LEN];
+    mbedtls_sha256_context sha;
+};
+
+/**
+ * @brief Última etapa: cuenta y, si procede, hashea la imagen antes del sink
+ */
+static esp_err_t stream_output(void *ctx, const uint8_t *data, size_t len)
+{
+    ota_stream_t *st = (ota_stream_t *)ctx;
+
+    esp_err_t err = st->sink(st->sink_ctx, data, len);
+    if (err != ESP_OK) return err;
+
+    if (st->verify) {
+        mbedtls_sha256_update(&st->sha, data, len);
+    }
+    st->total_out += len;
+    return ESP_OK;
+}
+
+ota_stream_t *ota_stream_create(uint32_t flags, ota_stream_sink_t sink, void *ctx)
+{
+    ota_stream_t *st = calloc(1, sizeof(*st));
+    if (!st) return NULL;
+
+    st->sink = sink;
+    st->sink_ctx = ctx;
+    st->entry = stream_output;
+    st->entry_ctx = st;
+    mbedtls_sha256_init(&st->sha);
+
+    // Se construye de atrás hacia delante: cada etapa escribe en la siguiente
+    if (flags & OTA_STREAM_DELTA) {
+        st->delta = ota_delta_create(st->entry, st->entry_ctx);
+        if (!st->delta) goto fail;
+        st->entry = ota_delta_sink;
+        st->entry_ctx = st->delta;
+    }
+
+    if (flags & OTA_STREAM_DEFLATE) {
+        st->inflate = ota_inflate_create(st->entry, st->entry_ctx);
+        if (!st->inflate) goto fail;
+        st->entry = ota_inflate_sink;
+        st->entry_ctx = st->inflate;
+    }
+
+    return st;
+
+fail:
+    ESP_LOGE(TAG, "No hay memoria para el pipeline (flags 0x%02X)", (unsigned)flags);
+    ota_stream_destroy(st);
+    return NULL;
+}
+
+esp_err_t ota_stream_feed(ota_stream_t *st, const uint8_t *data, size_t len)
+{
+    return st->entry(st->entry_ctx, data, len);
+}
+
+void ota_stream_expect_sha256(ota_stream_t *st, const uint8_t digest[OTA_STREAM_SHA256_LEN])
+{
+    memcpy(st->expected, digest, OTA_STREAM_SHA256_LEN);
+    mbedtls_sha256_starts(&st->sha, 0);
+    st->verify = true;
+}
+
+esp_err_t ota_stream_finish(ota_stream_t *st)
+{
+    if (st->inflate && !ota_inflate_done(st->inflate)) {
+        ESP_LOGE(TAG, "Stream deflate truncado");
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    if (st->delta && !ota_delta_done(st->delta)) {
+        ESP_LOGE(TAG, "Parche delta truncado");
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    if (st->verify) {
+        uint8_t digest[OTA_STREAM_SHA256_LEN];
+        mbedtls_sha256_finish(&st->sha, digest);
+        st->verify = false;
+        if (memcmp(digest, st->expected, sizeof(digest)) != 0) {
+            ESP_LOGE(TAG, "SHA-256 de la imagen no coincide (%zu bytes)", st->total_out);
+            return ESP_ERR_INVALID_CRC;
+        }
+    }
+
+    return ESP_OK;
+}
+
+size_t ota_stream_total_out(const ota_stream_t *st)
+{
+    return st->total_out;
+}
+
+void ota_stream_destroy(ota_stream_t *st)
+{
+    if (!st) return;
+    if (st->inflate) ota_inflate_destroy(st->inflate);
+    if (st->delta) ota_delta_destroy(st->delta);
+    mbedtls_sha256_free(&st->sha);
+    free(st);
+}
+
+esp_err_t ota_partition_sha256(const esp_partition_t *part, size_t len,
+                               uint8_t digest[OTA_STREAM_SHA256_LEN])
+{
+    return ota_partition_range_sha256(part, 0, len, digest);
+}
+
+esp_err_t ota_partition_range_sha256(const esp_partition_t *part, size_t offset, size_t len,
+                                     uint8_t digest[OTA_STREAM_SHA256_LEN])
+{
+    if (offset > part->size || len > part->size - offset) return ESP_ERR_INVALID_SIZE;
+
+    uint8_t *buf = malloc(PARTITION_READ_CHUNK);
+    if (!buf) return ESP_ERR_NO_MEM;
+
+    mbedtls_sha256_context sha;
+    mbedtls_sha256_init(&sha);
+    mbedtls_sha256_starts(&sha, 0);
+
+    esp_err_t err = ESP_OK;
+    for (size_t off = 0; off < len && err == ESP_OK; off += PARTITION_READ_CHUNK) {
+        size_t n = (len - off > PARTITION_READ_CHUNK) ? PARTITION_READ_CHUNK : len - off;
+        err = esp_partition_read(part, offset + off, buf, n);
+        if (err == ESP_OK) {
+            mbedtls_sha256_update(&sha, buf, n);
+        }
+    }
+
+    if (err == ESP_OK) {
+        mbedtls_sha256_finish(&sha, digest);
+    }
+    mbedtls_sha256_free(&sha);
+    free(buf);
+    return err;
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "esp_partition.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Destino de una etapa del pipeline (la siguiente etapa o esp_ota_write)
+ * @return ESP_OK para continuar, cualquier otro valor aborta el stream
+ */
+typedef esp_err_t (*ota_stream_sink_t)(void *ctx, const uint8_t *data, size_t len);
+
+// Formato del payload recibido
+#define OTA_STREAM_DEFLATE (1 << 0)   // Comprimido con deflate raw (ota_inflate)
+#define OTA_STREAM_DELTA   (1 << 1)   // Parche contra la partición en ejecución (ota_delta)
+
+#define OTA_STREAM_SHA256_LEN 32
+
+typedef struct ota_stream ota_stream_t;
+
+/**
+ * @brief Crear el pipeline payload -> [inflate] -> [delta] -> sink
+ * @param flags Combinación de OTA_STREAM_*
+ * @param sink Destino de los bytes de imagen (normalmente esp_ota_write)
+ * @return Pipeline o NULL si no hay memoria
+ */
+ota_stream_t *ota_stream_create(uint32_t flags, ota_stream_sink_t sink, void *ctx);
+
+/**
+ * @brief Alimentar bytes de payload tal como llegan del transporte
+ */
+esp_err_t ota_stream_feed(ota_stream_t *st, const uint8_t *data, size_t len);
+
+/**
+ * @brief Verificar el SHA-256 de la imagen reconstruida en ota_stream_finish
+ *
+ * El hash se calcula sobre los bytes que salen hacia el sink, a medida que se
+ * escriben. Llamar antes del primer ota_stream_feed.
+ */
+void ota_stream_expect_sha256(ota_stream_t *st, const uint8_t digest[OTA_STREAM_SHA256_LEN]);
+
+/**
+ * @brief Comprobar que todas las etapas han visto el final de su stream
+ * @return ESP_OK, ESP_ERR_INVALID_SIZE si el payload está truncado o
+ *         ESP_ERR_INVALID_CRC si el SHA-256 no coincide con el esperado
+ */
+esp_err_t ota_stream_finish(ota_stream_t *st);
+
+/**
+ * @brief Bytes entregados al sink (tamaño de la imagen reconstruida)
+ */
+size_t ota_stream_total_out(const ota_stream_t *st);
+
+/**
+ * @brief Liberar el pipeline
+ */
+void ota_stream_destroy(ota_stream_t *st);
+
+/**
+ * @brief SHA-256 de los primeros `len` bytes de una partición
+ */
+esp_err_t ota_partition_sha256(const esp_partition_t *part, size_t len,
+                               uint8_t digest[OTA_STREAM_SHA256_LEN]);
+
+/**
+ * @brief SHA-256 de `len` bytes de una partición a partir de `offset` (p. ej. un sector)
+ */
+esp_err_t ota_partition_range_sha256(const esp_partition_t *part, size_t offset, size_t len,
+                                     uint8_t digest[OTA_STREAM_SHA256_LEN]);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,232 @@
+#!/usr/bin/env python3
+
+"""
+Empaquetador de imágenes OTA
+
+Genera los artefactos que entienden ota_inflate.c (y los módulos OTA que lo usan):
+- compress: deflate raw (sin cabecera zlib) con ventana de 4 KB (wbits = -12)
+- delta: parche COPY/INSERT contra la imagen en ejecución (ota_delta.c)
+
+Uso:
+python3 pack_ota.py compress build/app.bin build/app.bin.z
+python3 pack_ota.py delta v1.bin v2.bin v1_v2.patch [--compress]
+"""
+
+import sys
+import os
+import zlib
+import struct
+import hashlib
+import argparse
+
+# Debe coincidir con OTA_INFLATE_WINDOW_BITS en ota_inflate.h
+OTA_INFLATE_WINDOW_BITS = 12
+
+# Formato de parche, ver ota_delta.h
+DELTA_MAGIC = b"OTAD"
+DELTA_VERSION = 1
+DELTA_OP_END = 0x00
+DELTA_OP_COPY = 0x01
+DELTA_OP_INSERT = 0x02
+
+# Tamaño de bloque indexado y coincidencia mínima para emitir un COPY
+DELTA_BLOCK = 16
+DELTA_MIN_MATCH = 24
+
+
+def compress_image(data, level=9):
+    """
+    Comprime una imagen con la ventana que puede inflar el ESP32
+    """
+    comp = zlib.compressobj(level, zlib.DEFLATED, -OTA_INFLATE_WINDOW_BITS, 9)
+    return comp.compress(data) + comp.flush()
+
+
+def make_delta(base, target):
+    """
+    Genera un parche COPY/INSERT por coincidencia voraz de bloques
+
+    Indexa la base en bloques alineados de DELTA_BLOCK bytes y recorre el
+    destino byte a byte buscando el bloque; cada coincidencia se extiende
+    hacia delante y hacia atrás sobre los literales pendientes.
+    """
+    index = {}
+    for off in range(0, len(base) - DELTA_BLOCK + 1, DELTA_BLOCK):
+        index.setdefault(base[off:off + DELTA_BLOCK], off)
+
+    ops = []
+    literal_start = 0
+    pos = 0
+    n = len(target)
+
+    while pos + DELTA_BLOCK <= n:
+        src = index.get(target[pos:pos + DELTA_BLOCK])
+        if src is None:
+            pos += 1
+            continue
+
+        # Extender hacia delante
+        length = DELTA_BLOCK
+        while pos + length < n and src + length < len(base) and target[pos + length] == base[src + length]:
+            length += 1
+
+        # Extender hacia atrás sobre los literales aún no emitidos
+        back = 0
+        while pos - back > literal_start and src - back > 0 and target[pos - back - 1] == base[src - back - 1]:
+            back += 1
+        pos -= back
+        src -= back
+        length += back
+
+        if length < DELTA_MIN_MATCH:
+            pos += back + 1
+            continue
+
+        if pos > literal_start:
+            ops.append((DELTA_OP_INSERT, target[literal_start:pos]))
+        ops.append((DELTA_OP_COPY, src, length))
+        pos += length
+        literal_start = pos
+
+    if literal_start < n:
+        ops.append((DELTA_OP_INSERT, target[literal_start:]))
+
+    out = bytearray()
+    out += DELTA_MAGIC + bytes([DELTA_VERSION, 0, 0, 0])
+    out += struct.pack(">II", len(base), len(target))
+    out += hashlib.sha256(base).digest()
+    for op in ops:
+        if op[0] == DELTA_OP_COPY:
+            out += struct.pack(">BII", DELTA_OP_COPY, op[1], op[2])
+        else:
+            out += struct.pack(">BI", DELTA_OP_INSERT, len(op[1])) + op[1]
+    out.append(DELTA_OP_END)
+    return bytes(out), ops
+
+
+def apply_delta(base, patch):
+    """
+    Aplica un parche igual que ota_delta.c (para verificación)
+    """
+    if patch[:4] != DELTA_MAGIC or patch[4] != DELTA_VERSION:
+        raise ValueError("cabecera inválida")
+    base_size, target_size = struct.unpack(">II", patch[8:16])
+    if base_size != len(base) or patch[16:48] != hashlib.sha256(base).digest():
+        raise ValueError("la base no coincide")
+
+    out = bytearray()
+    pos = 48
+    while True:
+        op = patch[pos]
+        pos += 1
+        if op == DELTA_OP_END:
+            break
+        if op == DELTA_OP_COPY:
+            src, length = struct.unpack(">II", patch[pos:pos + 8])
+            pos += 8
+            out += base[src:src + length]
+        elif op == DELTA_OP_INSERT:
+            (length,) = struct.unpack(">I", patch[pos:pos + 4])
+            pos += 4
+            out += patch[pos:pos + length]
+            pos += length
+        else:
+            raise ValueError(f"operación desconocida 0x{op:02X}")
+
+    if len(out) != target_size:
+        raise ValueError("tamaño destino incorrecto")
+    return bytes(out)
+
+
+def cmd_compress(args):
+    if not os.path.isfile(args.input):
+        print(f"❌ Archivo no existe: {args.input}")
+        return False
+
+    with open(args.input, 'rb') as f:
+        data = f.read()
+
+    packed = compress_image(data, args.level)
+
+    # Verificación: el stream debe inflar a la imagen original
+    if zlib.decompress(packed, -OTA_INFLATE_WINDOW_BITS) != data:
+        print("❌ La verificación de la imagen comprimida falló")
+        return False
+
+    with open(args.output, 'wb') as f:
+        f.write(packed)
+
+    ratio = len(packed) / len(data) if data else 0
+    print(f"📦 {args.input}: {len(data)} bytes")
+    print(f"🗜️  {args.output}: {len(packed)} bytes ({ratio * 100:.1f}%)")
+    print(f"   Manifest: \"compression\": \"deflate\", \"size\": {len(data)}, "
+          f"\"sha256\": \"{hashlib.sha256(data).hexdigest()}\"")
+    return True
+
+
+def cmd_delta(args):
+    for path in (args.base, args.target):
+        if not os.path.isfile(path):
+            print(f"❌ Archivo no existe: {path}")
+            return False
+
+    with open(args.base, 'rb') as f:
+        base = f.read()
+    with open(args.target, 'rb') as f:
+        target = f.read()
+
+    patch, ops = make_delta(base, target)
+
+    # Verificación: el parche debe reconstruir exactamente el destino
+    if apply_delta(base, patch) != target:
+        print("❌ La verificación del parche falló")
+        return False
+
+    copied = sum(op[2] for op in ops if op[0] == DELTA_OP_COPY)
+    inserted = sum(len(op[1]) for op in ops if op[0] == DELTA_OP_INSERT)
+
+    out = patch
+    if args.compress:
+        out = compress_image(patch, args.level)
+        if zlib.decompress(out, -OTA_INFLATE_WINDOW_BITS) != patch:
+            print("❌ La verificación del parche comprimido falló")
+            return False
+
+    with open(args.output, 'wb') as f:
+        f.write(out)
+
+    ratio = len(out) / len(target) if target else 0
+    print(f"📦 Base:    {args.base}: {len(base)} bytes")
+    print(f"📦 Destino: {args.target}: {len(target)} bytes")
+    print(f"🧩 COPY {copied} bytes, INSERT {inserted} bytes ({len(ops)} operaciones)")
+    print(f"🩹 {args.output}: {len(out)} bytes ({ratio * 100:.1f}% del destino)")
+    compression = ", \"compression\": \"deflate\"" if args.compress else ""
+    print(f"   Manifest: \"delta\": {{\"from\": \"<versión base>\", \"url\": \"...\"{compression}}}, "
+          f"\"size\": {len(target)}, \"sha256\": \"{hashlib.sha256(target).hexdigest()}\"")
+    return True
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Empaquetador de imágenes OTA")
+    sub = parser.add_subparsers(dest="cmd", required=True)
+
+    p = sub.add_parser("compress", help="Comprimir imagen (deflate, ventana 4 KB)")
+    p.add_argument("input", help="Imagen .bin original")
+    p.add_argument("output", help="Imagen comprimida de salida")
+    p.add_argument("--level", type=int, default=9, help="Nivel de compresión (1-9)")
+    p.set_defaults(func=cmd_compress)
+
+    p = sub.add_parser("delta", help="Generar parche binario contra la imagen base")
+    p.add_argument("base", help="Imagen .bin en ejecución en el dispositivo")
+    p.add_argument("target", help="Imagen .bin nueva")
+    p.add_argument("output", help="Parche de salida")
+    p.add_argument("--compress", action="store_true", help="Comprimir el parche (deflate)")
+    p.add_argument("--level", type=int, default=9, help="Nivel de compresión (1-9)")
+    p.set_defaults(func=cmd_delta)
+
+    args = parser.parse_args()
+    sys.exit(0 if args.func(args) else 1)
+
+
+if __name__ == "__main__":
+    main()
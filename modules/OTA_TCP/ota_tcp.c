@@ -0,0 +1,192 @@
+#include <string.h>
+#include <stdbool.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "lwip/sockets.h"
+#include "ota_proto.h"
+#include "ota_tcp.h"
+
+#define TAG "ota_tcp"
+
+#define TCP_READ_SIZE 2048             // Máximo por ota_proto_receive (<= OTA_PROTO_MAX_PUSH)
+#define TCP_KEEPALIVE_IDLE_S 5         // Detectar un cliente muerto para suspender la OTA
+#define TCP_KEEPALIVE_INTERVAL_S 2
+#define TCP_KEEPALIVE_COUNT 3
+#define TCP_ACCEPT_TIMEOUT_S 1          // accept vuelve periódicamente para ver s_stop
+#define TCP_TASK_STACK 4096
+#define TCP_TASK_PRIO 5
+
+static uint16_t s_port;
+static TaskHandle_t s_task_handle = NULL;
+static volatile bool s_stop = false;
+static volatile int s_client_sock = -1;
+static uint8_t s_rx[TCP_READ_SIZE];
+
+static esp_err_t tcp_send(void *ctx, const uint8_t *data, size_t len)
+{
+    while (len > 0) {
+        int n = send(s_client_sock, data, len, 0);
+        if (n < 0) {
+            ESP_LOGW(TAG, "send falló: errno %d", errno);
+            return ESP_FAIL;
+        }
+        data += n;
+        len -= n;
+    }
+    return ESP_OK;
+}
+
+static const ota_proto_transport_t s_tcp_transport = {
+    .name = "TCP",
+    .send = tcp_send,
+};
+
+/**
+ * @brief Opciones del socket de un cliente: sin Nagle (ACKs pequeños) y keepalive
+ */
+static void tcp_configure_client(int sock)
+{
+    int one = 1;
+    int idle = TCP_KEEPALIVE_IDLE_S;
+    int interval = TCP_KEEPALIVE_INTERVAL_S;
+    int count = TCP_KEEPALIVE_COUNT;
+
+    setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    setsockopt(sock, SOL_SOCKET, SO_KEEPALIVE, &one, sizeof(one));
+    setsockopt(sock, IPPROTO_TCP, TCP_KEEPIDLE, &idle, sizeof(idle));
+    setsockopt(sock, IPPROTO_TCP, TCP_KEEPINTVL, &interval, sizeof(interval));
+    setsockopt(sock, IPPROTO_TCP, TCP_KEEPCNT, &count, sizeof(count));
+}
+
+/**
+ * @brief Atender un cliente hasta que cierre: recv → ota_proto_receive
+ */
+static void tcp_serve_client(int sock)
+{
+    if (ota_proto_connect(&s_tcp_transport) != ESP_OK) {
+        return;   // Otro transporte tiene el protocolo
+    }
+
+    s_client_sock = sock;
+    for (;;) {
+        int n = recv(sock, s_rx, sizeof(s_rx), 0);
+        if (n <= 0) {
+            if (n < 0 && !s_stop) {
+                ESP_LOGW(TAG, "recv falló: errno %d", errno);
+            }
+            break;
+        }
+        ota_proto_receive(s_rx, n);
+    }
+
+    ota_proto_disconnect(&s_tcp_transport);
+    s_client_sock = -1;
+}
+
+static void ota_tcp_task(void *arg)
+{
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(s_port),
+        .sin_addr.s_addr = htonl(INADDR_ANY),
+    };
+    struct timeval accept_timeout = { .tv_sec = TCP_ACCEPT_TIMEOUT_S };
+    int one = 1;
+
+    int listen_sock = socket(AF_INET, SOCK_STREAM, IPPROTO_IP);
+    if (listen_sock < 0) {
+        ESP_LOGE(TAG, "socket falló: errno %d", errno);
+        goto out;
+    }
+    setsockopt(listen_sock, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    setsockopt(listen_sock, SOL_SOCKET, SO_RCVTIMEO, &accept_timeout, sizeof(accept_timeout));
+
+    if (bind(listen_sock, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(listen_sock, 1) != 0) {
+        ESP_LOGE(TAG, "bind/listen en el puerto %u falló: errno %d", s_port, errno);
+        close(listen_sock);
+        goto out;
+    }
+    ESP_LOGI(TAG, "Escuchando en el puerto %u", s_port);
+
+    while (!s_stop) {
+        struct sockaddr_in client;
+        socklen_t client_len = sizeof(client);
+        int sock = accept(listen_sock, (struct sockaddr *)&client, &client_len);
+        if (sock < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && !s_stop) {
+                ESP_LOGW(TAG, "accept falló: errno %d", errno);
+                vTaskDelay(pdMS_TO_TICKS(100));
+            }
+            continue;
+        }
+
+        char ip[16];
+        inet_ntoa_r(client.sin_addr, ip, sizeof(ip));
+        ESP_LOGI(TAG, "Cliente conectado: %s", ip);
+
+        tcp_configure_client(sock);
+        tcp_serve_client(sock);
+        close(sock);
+        ESP_LOGI(TAG, "Cliente desconectado: %s", ip);
+    }
+
+    close(listen_sock);
+
+out:
+    ESP_LOGI(TAG, "OTA TCP task detenida");
+    s_task_handle = NULL;
+    vTaskDelete(NULL);
+}
+
+// ============================================================================
+// PUBLIC API
+// ============================================================================
+
+esp_err_t ota_tcp_init(uint16_t port)
+{
+    if (s_task_handle) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    if (ota_proto_init() != ESP_OK) {
+        return ESP_FAIL;
+    }
+
+    s_port = port;
+    s_stop = false;
+    BaseType_t res = xTaskCreate(
+        ota_tcp_task,
+        "ota_tcp_task",
+        TCP_TASK_STACK,
+        NULL,
+        TCP_TASK_PRIO,
+        &s_task_handle
+    );
+    if (res != pdPASS) {
+        ESP_LOGE(TAG, "No se pudo crear task OTA TCP");
+        return ESP_FAIL;
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t ota_tcp_stop(void)
+{
+    if (!s_task_handle) {
+        return ESP_OK;
+    }
+
+    // shutdown desbloquea el recv del cliente; accept vuelve por timeout
+    s_stop = true;
+    int sock = s_client_sock;
+    if (sock >= 0) {
+        shutdown(sock, SHUT_RDWR);
+    }
+    while (s_task_handle) {
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+
+    ESP_LOGI(TAG, "TCP OTA detenido");
+    return ESP_OK;
+}
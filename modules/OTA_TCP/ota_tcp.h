@@ -0,0 +1,29 @@
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define OTA_TCP_DEFAULT_PORT 3333
+
+/**
+ * @brief Abrir un servidor TCP que alimenta el protocolo OTA (un cliente a la vez)
+ *
+ * Requiere la red ya levantada (Wi-Fi STA/AP con IP).
+ * @param port Puerto de escucha (OTA_TCP_DEFAULT_PORT)
+ * @return ESP_OK on success, error code otherwise
+ */
+esp_err_t ota_tcp_init(uint16_t port);
+
+/**
+ * @brief Cerrar el servidor y la conexión en curso (suspende la OTA)
+ * @return ESP_OK on success
+ */
+esp_err_t ota_tcp_stop(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,146 @@
+#include <stdbool.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "driver/uart.h"
+#include "ota_proto.h"
+#include "ota_uart.h"
+
+#define TAG "ota_uart"
+
+#define UART_RX_BUFFER_SIZE 8192       // Buffer del driver (ISR → task)
+#define UART_READ_SIZE 1024            // Máximo por ota_proto_receive (<= OTA_PROTO_MAX_PUSH)
+#define UART_READ_TIMEOUT_MS 50
+#define UART_IDLE_RELEASE_MS 10000     // Silencio tras el que se libera el protocolo
+#define UART_TASK_STACK 4096
+#define UART_TASK_PRIO 5
+
+static uart_port_t s_port;
+static TaskHandle_t s_task_handle = NULL;
+static volatile bool s_stop = false;
+static uint8_t s_rx[UART_READ_SIZE];
+
+static esp_err_t uart_send(void *ctx, const uint8_t *data, size_t len)
+{
+    return uart_write_bytes(s_port, data, len) == (int)len ? ESP_OK : ESP_FAIL;
+}
+
+static const ota_proto_transport_t s_uart_transport = {
+    .name = "UART",
+    .send = uart_send,
+};
+
+/**
+ * @brief Task de lectura: pasa lo recibido al protocolo en su propio contexto
+ *
+ * UART no tiene conexión: el protocolo se toma con el primer byte y se libera
+ * tras UART_IDLE_RELEASE_MS sin datos, para que SPP o TCP puedan usarlo.
+ */
+static void ota_uart_task(void *arg)
+{
+    bool proto = false;
+    TickType_t last_rx = 0;
+
+    ESP_LOGI(TAG, "OTA UART task iniciada");
+    while (!s_stop) {
+        // Leer lo que ya haya en el buffer sin esperar; si no hay nada, esperar un byte
+        size_t avail = 0;
+        uart_get_buffered_data_len(s_port, &avail);
+        size_t want = avail ? (avail < UART_READ_SIZE ? avail : UART_READ_SIZE) : 1;
+        int n = uart_read_bytes(s_port, s_rx, want, avail ? 0 : pdMS_TO_TICKS(UART_READ_TIMEOUT_MS));
+
+        if (n > 0) {
+            if (!proto) {
+                proto = (ota_proto_connect(&s_uart_transport) == ESP_OK);
+                if (!proto) continue;   // Otro transporte tiene el protocolo: se descarta
+            }
+            last_rx = xTaskGetTickCount();
+            ota_proto_receive(s_rx, n);
+        } else if (proto && xTaskGetTickCount() - last_rx > pdMS_TO_TICKS(UART_IDLE_RELEASE_MS)) {
+            ota_proto_disconnect(&s_uart_transport);
+            proto = false;
+        }
+    }
+
+    if (proto) {
+        ota_proto_disconnect(&s_uart_transport);
+    }
+
+    ESP_LOGI(TAG, "OTA UART task detenida");
+    s_task_handle = NULL;
+    vTaskDelete(NULL);
+}
+
+// ============================================================================
+// PUBLIC API
+// ============================================================================
+
+esp_err_t ota_uart_init(const ota_uart_config_t *cfg)
+{
+    if (!cfg) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (s_task_handle) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    bool flow = cfg->rts_pin != UART_PIN_NO_CHANGE && cfg->cts_pin != UART_PIN_NO_CHANGE;
+    uart_config_t uart_cfg = {
+        .baud_rate = cfg->baud_rate,
+        .data_bits = UART_DATA_8_BITS,
+        .parity = UART_PARITY_DISABLE,
+        .stop_bits = UART_STOP_BITS_1,
+        .flow_ctrl = flow ? UART_HW_FLOWCTRL_CTS_RTS : UART_HW_FLOWCTRL_DISABLE,
+        .rx_flow_ctrl_thresh = 100,
+        .source_clk = UART_SCLK_DEFAULT,
+    };
+
+    esp_err_t err = uart_driver_install(cfg->port, UART_RX_BUFFER_SIZE, 0, 0, NULL, 0);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "uart_driver_install falló: %s", esp_err_to_name(err));
+        return err;
+    }
+    ESP_ERROR_CHECK(uart_param_config(cfg->port, &uart_cfg));
+    ESP_ERROR_CHECK(uart_set_pin(cfg->port, cfg->tx_pin, cfg->rx_pin, cfg->rts_pin, cfg->cts_pin));
+    s_port = cfg->port;
+
+    if (ota_proto_init() != ESP_OK) {
+        uart_driver_delete(cfg->port);
+        return ESP_FAIL;
+    }
+
+    s_stop = false;
+    BaseType_t res = xTaskCreate(
+        ota_uart_task,
+        "ota_uart_task",
+        UART_TASK_STACK,
+        NULL,
+        UART_TASK_PRIO,
+        &s_task_handle
+    );
+    if (res != pdPASS) {
+        ESP_LOGE(TAG, "No se pudo crear task OTA UART");
+        uart_driver_delete(cfg->port);
+        return ESP_FAIL;
+    }
+
+    ESP_LOGI(TAG, "UART OTA inicializado - UART%d a %d baud%s", cfg->port, cfg->baud_rate,
+             flow ? " (RTS/CTS)" : "");
+    return ESP_OK;
+}
+
+esp_err_t ota_uart_stop(void)
+{
+    if (!s_task_handle) {
+        return ESP_OK;
+    }
+
+    s_stop = true;
+    while (s_task_handle) {
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+
+    uart_driver_delete(s_port);
+    ESP_LOGI(TAG, "UART OTA detenido");
+    return ESP_OK;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "esp_err.h"
+#include "driver/uart.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Configuración del enlace UART para OTA
+ */
+typedef struct {
+    uart_port_t port;       // UART_NUM_1 o UART_NUM_2 (UART0 lleva la consola)
+    int baud_rate;          // Hasta 5 Mbaud en ESP32; 921600-2000000 típicos con adaptador USB
+    int tx_pin;
+    int rx_pin;
+    int rts_pin;            // UART_PIN_NO_CHANGE: sin control de flujo hardware
+    int cts_pin;
+} ota_uart_config_t;
+
+#define OTA_UART_CONFIG_DEFAULT() {         \
+    .port = UART_NUM_1,                     \
+    .baud_rate = 921600,                    \
+    .tx_pin = 17,                           \
+    .rx_pin = 16,                           \
+    .rts_pin = UART_PIN_NO_CHANGE,          \
+    .cts_pin = UART_PIN_NO_CHANGE,          \
+}
+
+/**
+ * @brief Instalar el driver UART y arrancar la task que alimenta el protocolo OTA
+ * @param cfg Puerto, velocidad y pines
+ * @return ESP_OK on success, error code otherwise
+ */
+esp_err_t ota_uart_init(const ota_uart_config_t *cfg);
+
+/**
+ * @brief Parar la task (suspende la OTA en curso) y desinstalar el driver UART
+ * @return ESP_OK on success
+ */
+esp_err_t ota_uart_stop(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -93,6 +93,7 @@ typedef struct {
     SemaphoreHandle_t lock;               // mutex para proteger shared_data
     TaskHandle_t task;                    // handle de la task creada
     volatile bool stop_requested;         // señal para parar la task
+    volatile bool paused;                 // sin lecturas mientras dura una OTA
 } sensor_ctx_t;
 
 /* Contexto global del módulo. Permite implementar sensoramb_read/stop. */
@@ -113,6 +114,10 @@ static void sensor_task(void *arg)
 
     while (1) {
         if (ctx->stop_requested) break;
+        if (ctx->paused) {
+            vTaskDelay(pdMS_TO_TICKS(100));
+            continue;
+        }
         rslt = bme68x_set_op_mode(BME68X_FORCED_MODE, ctx->dev);
         if (rslt != BME68X_OK) {
             ESP_LOGW(TAG, "bme68x_set_op_mode error: %d", rslt);
@@ -205,6 +210,7 @@ int sensoramb_start(struct bme68x_data *shared_data)
         return -5;
     }
     ctx->stop_requested = false;
+    ctx->paused = false;
     ctx->task = NULL;
 
     /* Guardar referencia global para sensoramb_read/stop */
@@ -235,6 +241,18 @@ int sensoramb_read(struct bme68x_data *out, TickType_t timeout_ms)
     return 0;
 }
 
+// Pausa (true) o reanuda (false) las lecturas sin parar la tarea. La tarea
+// termina la lectura en curso y no vuelve a usar el bus I2C hasta reanudar.
+// Devuelve 0 en éxito, <0 si el sensor no está iniciado.
+int sensoramb_pause(bool pause)
+{
+    if (!global_ctx) return -1;
+
+    global_ctx->paused = pause;
+    ESP_LOGI(TAG, "Lecturas %s", pause ? "en pausa" : "reanudadas");
+    return 0;
+}
+
 // Para la tarea del sensor y libera recursos. Devuelve 0 en éxito.
 int sensoramb_stop(void)
 {
@@ -1,6 +1,7 @@
 #ifndef SENSORAMB_H
 #define SENSORAMB_H
 
+#include <stdbool.h>
 #include "bme68x.h"
 #include "freertos/FreeRTOS.h"
 
@@ -13,6 +14,10 @@ int sensoramb_start(struct bme68x_data *shared_data);
 // para adquirir el mutex interno.
 int sensoramb_read(struct bme68x_data *out, TickType_t timeout_ms);
 
+// Pausa (true) o reanuda (false) las lecturas periódicas, p. ej. durante una
+// OTA. Las últimas lecturas siguen disponibles con sensoramb_read.
+int sensoramb_pause(bool pause);
+
 // Para la tarea del sensor y libera los recursos asociados.
 int sensoramb_stop(void);
 
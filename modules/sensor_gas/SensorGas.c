@@ -21,6 +21,7 @@ typedef struct {
     SemaphoreHandle_t lock;       // mutex para proteger shared_data
     TaskHandle_t task;            // handle de la task creada
     volatile bool stop_requested; // señal para parar la task
+    volatile bool paused;         // sin lecturas mientras dura una OTA
 } ccs811_ctx_t;
 
 static ccs811_ctx_t *global_ctx = NULL;
@@ -132,6 +133,10 @@ static void ccs811_task(void *arg)
         if (ctx->stop_requested) {
             break;
         }
+        if (ctx->paused) {
+            vTaskDelay(pdMS_TO_TICKS(100));
+            continue;
+        }
 
         ccs811_data_t sample = ccs811_read_measurement();
 
@@ -171,6 +176,7 @@ int ccs811_start(ccs811_data_t *shared_data)
         return -4;
     }
     ctx->stop_requested = false;
+    ctx->paused = false;
     ctx->task = NULL;
 
     global_ctx = ctx;
@@ -205,6 +211,15 @@ int ccs811_read_safe(ccs811_data_t *out, TickType_t timeout_ms)
     return 0;
 }
 
+int ccs811_pause(bool pause)
+{
+    if (!global_ctx) return -1;
+
+    global_ctx->paused = pause;
+    ESP_LOGI(TAG, "Lecturas %s", pause ? "en pausa" : "reanudadas");
+    return 0;
+}
+
 int ccs811_stop(void)
 {
     if (!global_ctx) return -1;
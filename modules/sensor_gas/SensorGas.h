@@ -1,5 +1,6 @@
 #pragma once
 #include <stdint.h>
+#include <stdbool.h>
 #include "freertos/FreeRTOS.h"
 
 #define CCS811_ADDR 0x5B   // Dirección del Pmod AQS
@@ -27,6 +28,17 @@ int ccs811_start(ccs811_data_t *shared_data);
  */
 int ccs811_read_safe(ccs811_data_t *out, TickType_t timeout_ms);
 
+/**
+ * @brief Pausa o reanuda las lecturas periódicas (p. ej. durante una OTA).
+ * 
+ * La tarea termina la lectura en curso y no vuelve a usar el bus I2C hasta
+ * reanudar. La última lectura sigue disponible con ccs811_read_safe.
+ * 
+ * @param pause true para pausar, false para reanudar.
+ * @return 0 en éxito, <0 si el sensor no está iniciado.
+ */
+int ccs811_pause(bool pause);
+
 /**
  * @brief Detiene la tarea del CCS811 y libera recursos.
  * 
@@ -1,4 +1,7 @@
+#include <stdio.h>
 #include <string.h>
+#include <strings.h>
+#include <inttypes.h>
 #include <time.h>
 #include <sys/time.h>
 #include <stdlib.h>
@@ -6,12 +9,12 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 
+#include "sdkconfig.h"
 #include "esp_log.h"
 #include "esp_system.h"
 #include "esp_err.h"
+#include "esp_timer.h"
 
-#include "esp_https_ota.h"
-#include "esp_http_client.h"
 #include "esp_ota_ops.h"
 #include "esp_crt_bundle.h"
 
@@ -19,83 +22,355 @@
 #include "nvs_flash.h"
 
 #include "esp_app_desc.h"
+#include "esp_mac.h"
 
 #include "ota_update.h"
-#include "cJSON.h"
+#include "ota_stream.h"
+#include "ota_image_check.h"
+#include "ota_health.h"
+#include "ota_quiesce.h"
+#include "ota_http_session.h"
+#include "ota_http_dl.h"
+#include "ota_version.h"
+#include "ota_release.h"
+#include "ota_manifest.h"
 
 #define TAG "ota_update"
 #define MANIFEST_URL "https://raw.githubusercontent.com/David-lopruiz/SBCG06-WORKFLOW/main/Versions/latest.json"
+#define MANIFEST_CACHE_KEY "manifest"    // NVS "ota_info": validadores y versión del último manifest
+#define CHANNEL_KEY "channel"               // NVS "ota_info": canal elegido con ota_set_channel()
 
-esp_err_t https_ota(const char *url)
+// Canal sin ota_set_channel(): las versiones de primer nivel del manifest
+#define OTA_DEFAULT_CHANNEL "stable"
+
+// Modelo de hardware para las entradas "<canal>@<modelo>" del manifest
+#ifndef OTA_HW_MODEL
+#define OTA_HW_MODEL CONFIG_IDF_TARGET
+#endif
+
+// false: esp_ota_begin con OTA_WITH_SEQUENTIAL_WRITES, cada sector se borra
+// justo antes de escribirlo. true: se borra toda la partición al empezar.
+#define OTA_HTTPS_BULK_ERASE false
+
+#define OTA_HTTP_BUF_SIZE 4096
+
+// El manifest se lee a trozos de MANIFEST_CHUNK en la pila y se procesa
+// sin guardarlo; uno mayor que MANIFEST_MAX_SIZE se rechaza
+#define MANIFEST_CHUNK 256
+#define MANIFEST_MAX_SIZE (64 * 1024)
+
+/**
+ * Campo "sha256" del manifest (64 caracteres hex) a binario
+ */
+static bool parse_sha256_hex(const char *hex, uint8_t out[OTA_STREAM_SHA256_LEN])
 {
-    ESP_LOGI(TAG, "Iniciando OTA segura desde: %s", url);
+    if (strlen(hex) != 2 * OTA_STREAM_SHA256_LEN) return false;
 
-    esp_http_client_config_t client_cfg = {
-        .url = url,
-        .crt_bundle_attach = esp_crt_bundle_attach,
-        .timeout_ms = 15000,
-    };
+    for (int i = 0; i < OTA_STREAM_SHA256_LEN; i++) {
+        char byte[3] = { hex[2 * i], hex[2 * i + 1], '\0' };
+        char *end;
+        out[i] = (uint8_t)strtoul(byte, &end, 16);
+        if (*end != '\0') return false;
+    }
+    return true;
+}
 
-    esp_https_ota_config_t ota_cfg = {
-        .http_config = &client_cfg,
-    };
+/**
+ * OTA de imagen completa con la descarga reanudable de ota_http_dl: un corte
+ * de Wi-Fi o un timeout no vuelve a empezar desde el byte 0, ni en los
+ * reintentos ni tras un reinicio (el offset y el ETag quedan en NVS).
+ * La cabecera de la imagen se valida con el primer sector, antes de
+ * descargar el resto, y el SHA-256 (si se indica) leyendo la partición.
+ */
+static esp_err_t https_ota_image(ota_http_session_t *session, const char *url, size_t image_size,
+                                 const uint8_t *expected_sha256)
+{
+    ESP_LOGI(TAG, "Iniciando OTA segura desde: %s", url);
+
+    ota_http_dl_config_t cfg = OTA_HTTP_DL_CONFIG_DEFAULT();
+    cfg.url = url;
+    cfg.expected_sha256 = expected_sha256;
+    cfg.image_size = image_size;
+    cfg.session = session;
+    cfg.crt_bundle_attach = esp_crt_bundle_attach;
 
-    esp_err_t ret = esp_https_ota(&ota_cfg);
+    ota_http_dl_stats_t stats;
+    esp_err_t ret = ota_http_download(&cfg, &stats);
     if (ret == ESP_OK) {
-        ESP_LOGI(TAG, "OTA completada correctamente");
+        ESP_LOGI(TAG, "OTA completada correctamente (%" PRIu32 " bytes descargados, reanudada en %" PRIu32 ")",
+                 stats.downloaded, stats.resumed_from);
     } else {
         ESP_LOGE(TAG, "Error en OTA: %s", esp_err_to_name(ret));
     }
-
     return ret;
 }
 
-static esp_err_t http_get(const char *url, char *buffer, size_t max_len)
+esp_err_t https_ota(const char *url)
 {
-    esp_http_client_config_t cfg = {
-        .url = url,
-        .crt_bundle_attach = esp_crt_bundle_attach,
-        .timeout_ms = 15000,
-    };
+    return https_ota_image(NULL, url, 0, NULL);
+}
+
+typedef struct {
+    esp_ota_handle_t handle;
+    size_t written;
+    ota_image_check_t check;    // Cabecera de la imagen reconstruida
+} ota_flash_sink_ctx_t;
+
+static esp_err_t ota_flash_sink(void *ctx, const uint8_t *data, size_t len)
+{
+    ota_flash_sink_ctx_t *sink = (ota_flash_sink_ctx_t *)ctx;
+
+    // Se decide con los primeros bytes que salen del pipeline, antes de escribirlos
+    if (OTA_IMAGE_REJECTED(ota_image_check_feed(&sink->check, data, len))) {
+        return ESP_ERR_OTA_VALIDATE_FAILED;
+    }
 
-    esp_http_client_handle_t client = esp_http_client_init(&cfg);
-    if (!client) {
-        ESP_LOGE(TAG, "Fallo al inicializar cliente HTTP");
+    esp_err_t err = esp_ota_write(sink->handle, data, len);
+    if (err == ESP_OK) {
+        sink->written += len;
+    }
+    return err;
+}
+
+/**
+ * OTA desde un artefacto de pack_ota.py (imagen comprimida y/o parche delta).
+ * Se descarga en bloques y pasa en streaming por ota_stream hasta esp_ota_write.
+ * flags: OTA_STREAM_*; image_size es el tamaño final de la imagen (0 = no comprobar).
+ * expected_sha256: SHA-256 de la imagen final, calculado mientras se escribe (NULL = no comprobar).
+ */
+static esp_err_t https_ota_stream(ota_http_session_t *session, const char *url, uint32_t flags,
+                                  size_t image_size, const uint8_t *expected_sha256)
+{
+    ESP_LOGI(TAG, "Iniciando OTA (%s%s) desde: %s",
+             (flags & OTA_STREAM_DELTA) ? "delta" : "completa",
+             (flags & OTA_STREAM_DEFLATE) ? ", deflate" : "", url);
+
+    const esp_partition_t *partition = esp_ota_get_next_update_partition(NULL);
+    if (!partition) {
+        ESP_LOGE(TAG, "Partición OTA no disponible");
         return ESP_FAIL;
     }
 
-    esp_err_t err = esp_http_client_open(client, 0);
+    char *buf = NULL;
+    ota_stream_t *stream = NULL;
+    ota_flash_sink_ctx_t sink = {0};
+    bool ota_started = false;
+    int64_t t0 = esp_timer_get_time();
+
+    int status = 0;
+    int64_t content_length;
+    esp_err_t err = ota_http_session_open(session, url, NULL, NULL, &status, &content_length);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Error abriendo conexión HTTP: %s", esp_err_to_name(err));
+        goto cleanup;
+    }
+
+    if (status != 200) {
+        ESP_LOGE(TAG, "Respuesta HTTP inválida (%d)", status);
+        err = ESP_FAIL;
+        goto cleanup;
+    }
+
+    buf = malloc(OTA_HTTP_BUF_SIZE);
+    ota_image_check_init(&sink.check);
+    stream = ota_stream_create(flags, ota_flash_sink, &sink);
+    if (!buf || !stream) {
+        err = ESP_ERR_NO_MEM;
+        goto cleanup;
+    }
+    if (expected_sha256) {
+        ota_stream_expect_sha256(stream, expected_sha256);
+    }
+
+    err = esp_ota_begin(partition, OTA_HTTPS_BULK_ERASE ? OTA_SIZE_UNKNOWN : OTA_WITH_SEQUENTIAL_WRITES,
+                        &sink.handle);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "esp_ota_begin falló: %s", esp_err_to_name(err));
+        goto cleanup;
+    }
+    ota_started = true;
+
+    size_t downloaded = 0;
+    int read_len;
+    while ((read_len = ota_http_session_read(session, buf, OTA_HTTP_BUF_SIZE)) > 0) {
+        err = ota_stream_feed(stream, (const uint8_t *)buf, read_len);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Error procesando imagen: %s", esp_err_to_name(err));
+            goto cleanup;
+        }
+        downloaded += read_len;
+    }
+
+    if (read_len < 0) {
+        ESP_LOGE(TAG, "Descarga incompleta (%zu bytes recibidos)", downloaded);
+        err = ESP_FAIL;
+        goto cleanup;
+    }
+
+    err = ota_stream_finish(stream);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Imagen rechazada (%zu bytes recibidos): %s", downloaded, esp_err_to_name(err));
+        goto cleanup;
+    }
+
+    if (image_size && sink.written != image_size) {
+        ESP_LOGE(TAG, "Tamaño inesperado: %zu vs %zu", sink.written, image_size);
+        err = ESP_ERR_INVALID_SIZE;
+        goto cleanup;
+    }
+
+    ota_started = false;
+    err = esp_ota_end(sink.handle);
+    if (err == ESP_OK) {
+        err = esp_ota_set_boot_partition(partition);
+    }
+
+    if (err == ESP_OK) {
+        ESP_LOGI(TAG, "OTA completada correctamente: %zu -> %zu bytes (%" PRId64 " ms)",
+                 downloaded, sink.written, (esp_timer_get_time() - t0) / 1000);
+    } else {
+        ESP_LOGE(TAG, "Error finalizando OTA: %s", esp_err_to_name(err));
+    }
+
+cleanup:
+    if (ota_started) {
+        esp_ota_abort(sink.handle);
+    }
+    ota_stream_destroy(stream);
+    free(buf);
+    ota_http_session_end(session);
+    return err;
+}
+
+// Validadores HTTP del último manifest descargado y la versión elegida en
+// él; es la local si el manifest no pedía actualizar (misma versión, fuera
+// del despliegue...)
+typedef struct {
+    char etag[64];
+    char last_modified[32];     // "Wed, 21 Oct 2015 07:28:00 GMT"
+    char version[32];
+} manifest_cache_t;
+
+static esp_err_t manifest_cache_load(manifest_cache_t *cache)
+{
+    nvs_handle_t nvs;
+    esp_err_t err = nvs_open("ota_info", NVS_READONLY, &nvs);
+    if (err != ESP_OK) return err;
+
+    size_t len = sizeof(*cache);
+    err = nvs_get_blob(nvs, MANIFEST_CACHE_KEY, cache, &len);
+    nvs_close(nvs);
+
+    if (err == ESP_OK && len != sizeof(*cache)) {
+        err = ESP_ERR_INVALID_SIZE;
+    }
+    return err;
+}
+
+static void manifest_cache_store(const manifest_cache_t *cache)
+{
+    nvs_handle_t nvs;
+    if (nvs_open("ota_info", NVS_READWRITE, &nvs) != ESP_OK) return;
+
+    // Sin validadores no hay petición condicional posible
+    if (cache->etag[0] || cache->last_modified[0]) {
+        nvs_set_blob(nvs, MANIFEST_CACHE_KEY, cache, sizeof(*cache));
+    } else {
+        nvs_erase_key(nvs, MANIFEST_CACHE_KEY);
+    }
+    nvs_commit(nvs);
+    nvs_close(nvs);
+}
+
+static void manifest_on_header(void *ctx, const char *key, const char *value)
+{
+    manifest_cache_t *validators = (manifest_cache_t *)ctx;
+
+    if (!key) {
+        // Otra respuesta tras una redirección
+        validators->etag[0] = validators->last_modified[0] = '\0';
+        return;
+    }
+
+    // Uno que no cabe no se guarda: la siguiente petición no será condicional
+    if (strcasecmp(key, "ETag") == 0 && strlen(value) < sizeof(validators->etag)) {
+        strcpy(validators->etag, value);
+    } else if (strcasecmp(key, "Last-Modified") == 0 && strlen(value) < sizeof(validators->last_modified)) {
+        strcpy(validators->last_modified, value);
+    }
+}
+
+/**
+ * GET del manifest, procesado a medida que llega con parser.
+ * cond: validadores de la copia anterior para If-None-Match / If-Modified-Since
+ * (NULL = petición normal). validators recibe los de la respuesta (NULL = no
+ * guardar). *status es 200 o 304; con 304 parser no recibe nada.
+ * La conexión de la sesión queda abierta para la descarga de la imagen.
+ */
+static esp_err_t manifest_get(ota_http_session_t *session, const char *url, const manifest_cache_t *cond,
+                              manifest_cache_t *validators, ota_manifest_parser_t *parser, int *status)
+{
+    if (cond && cond->etag[0]) {
+        ota_http_session_set_header(session, "If-None-Match", cond->etag);
+    }
+    if (cond && cond->last_modified[0]) {
+        ota_http_session_set_header(session, "If-Modified-Since", cond->last_modified);
+    }
+
+    int64_t content_length;
+    esp_err_t err = ota_http_session_open(session, url, validators ? manifest_on_header : NULL, validators,
+                                          status, &content_length);
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "Error abriendo conexión HTTP: %s", esp_err_to_name(err));
-        esp_http_client_cleanup(client);
+        ota_http_session_end(session);
         return err;
     }
 
-    int content_length = esp_http_client_fetch_headers(client);
-    if (content_length < 0) {
-        ESP_LOGE(TAG, "Error obteniendo cabeceras HTTP");
-        esp_http_client_close(client);
-        esp_http_client_cleanup(client);
+    if (*status != 200 && *status != 304) {
+        ESP_LOGE(TAG, "Respuesta HTTP inválida (%d)", *status);
+        ota_http_session_end(session);
         return ESP_FAIL;
     }
 
-    int total_read = 0;
-    int read_len = 0;
+    if (*status == 304) {
+        ota_http_session_end(session);
+        return ESP_OK;
+    }
 
-    do {
-        read_len = esp_http_client_read(client, buffer + total_read, max_len - total_read - 1);
-        if (read_len > 0) {
-            total_read += read_len;
-        }
-    } while (read_len > 0 && total_read < max_len - 1);
+    if (content_length > MANIFEST_MAX_SIZE) {
+        ESP_LOGE(TAG, "Manifest demasiado grande (%" PRId64 " bytes)", content_length);
+        ota_http_session_end(session);
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    char chunk[MANIFEST_CHUNK];
+    size_t total_read = 0;
+    int read_len;
 
-    buffer[total_read] = '\0';
-    ESP_LOGI(TAG, "HTTP GET completado (%d bytes)", total_read);
+    while ((read_len = ota_http_session_read(session, chunk, sizeof(chunk))) > 0) {
+        total_read += read_len;
+        if (total_read > MANIFEST_MAX_SIZE) {
+            err = ESP_ERR_INVALID_SIZE;
+            break;
+        }
+        err = ota_manifest_parser_feed(parser, chunk, read_len);
+        if (err != ESP_OK) break;
+    }
 
-    esp_http_client_close(client);
-    esp_http_client_cleanup(client);
+    if (err == ESP_OK && (read_len < 0 || !ota_http_session_complete(session))) {
+        err = ESP_FAIL;
+    }
+    if (err == ESP_OK) {
+        err = ota_manifest_parser_finish(parser);
+    }
+    ota_http_session_end(session);
 
-    return (total_read > 0) ? ESP_OK : ESP_FAIL;
+    if (err == ESP_OK) {
+        ESP_LOGI(TAG, "HTTP GET completado (%zu bytes)", total_read);
+    } else {
+        ESP_LOGE(TAG, "Manifest no válido tras %zu bytes: %s", total_read, esp_err_to_name(err));
+    }
+    return err;
 }
 
 esp_err_t ota_get_stored_version(char *out, size_t len)
@@ -110,75 +385,190 @@ esp_err_t ota_get_stored_version(char *out, size_t len)
     return err;
 }
 
-esp_err_t ota_check_for_update(void)
+esp_err_t ota_get_channel(char *out, size_t len)
+{
+    nvs_handle_t nvs;
+    esp_err_t err = nvs_open("ota_info", NVS_READONLY, &nvs);
+    if (err == ESP_OK) {
+        size_t required = len;
+        err = nvs_get_str(nvs, CHANNEL_KEY, out, &required);
+        nvs_close(nvs);
+    }
+    if (err != ESP_OK) {
+        strncpy(out, OTA_DEFAULT_CHANNEL, len - 1);
+        out[len - 1] = '\0';
+    }
+    return ESP_OK;
+}
+
+esp_err_t ota_set_channel(const char *channel)
 {
-    time_t now = time(NULL);
-    int random_val = esp_random();
-    char manifest_url[256];
+    if (!channel || !channel[0] || strlen(channel) >= OTA_CHANNEL_LEN || strchr(channel, '@')) {
+        return ESP_ERR_INVALID_ARG;
+    }
 
-    snprintf(manifest_url, sizeof(manifest_url),
-             "%s?ts=%ld&r=%d", MANIFEST_URL, (long)now, random_val);
+    nvs_handle_t nvs;
+    esp_err_t err = nvs_open("ota_info", NVS_READWRITE, &nvs);
+    if (err != ESP_OK) return err;
 
-    ESP_LOGI(TAG, "Comprobando manifest remoto...");
+    err = nvs_set_str(nvs, CHANNEL_KEY, channel);
+    // Otro canal puede elegir otra versión del mismo manifest: sin 304
+    nvs_erase_key(nvs, MANIFEST_CACHE_KEY);
+    if (err == ESP_OK) err = nvs_commit(nvs);
+    nvs_close(nvs);
 
-    char json[1024];
-    if (http_get(manifest_url, json, sizeof(json)) != ESP_OK) {
-        ESP_LOGE(TAG, "No se pudo descargar el manifest");
-        return ESP_FAIL;
+    ESP_LOGI(TAG, "Canal OTA: %s", channel);
+    return err;
+}
+
+/**
+ * Identificador para el despliegue gradual: MAC Wi-Fi en hex (12 caracteres)
+ */
+static void device_id_get(char out[13])
+{
+    uint8_t mac[6] = {0};
+    esp_read_mac(mac, ESP_MAC_WIFI_STA);
+    snprintf(out, 13, "%02x%02x%02x%02x%02x%02x", mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+}
+
+/**
+ * Manifest, imagen y reintentos por la misma sesión: un solo handshake TLS
+ * mientras el servidor mantenga la conexión y el host no cambie.
+ */
+static esp_err_t check_for_update(ota_http_session_t *session)
+{
+    char local_version[32] = {0};
+    if (ota_get_stored_version(local_version, sizeof(local_version)) != ESP_OK) {
+        strcpy(local_version, "0.0.0");
     }
 
-    cJSON *root = cJSON_Parse(json);
-    if (!root) {
-        ESP_LOGE(TAG, "Error al parsear JSON");
+    // Petición condicional solo si el manifest guardado no pedía actualizar:
+    // con 304 no hay cuerpo, y para reintentar una OTA hacen falta url y sha256
+    manifest_cache_t cache;
+    bool conditional = manifest_cache_load(&cache) == ESP_OK &&
+                       strcmp(cache.version, local_version) == 0;
+
+    ESP_LOGI(TAG, "Comprobando manifest remoto%s...", conditional ? " (condicional)" : "");
+
+    char channel[OTA_CHANNEL_LEN];
+    ota_get_channel(channel, sizeof(channel));
+
+    // Solo mientras llega el manifest: unos 3.4 KB, demasiado para la pila
+    ota_manifest_parser_t *parser = malloc(sizeof(*parser));
+    if (!parser) {
+        return ESP_ERR_NO_MEM;
+    }
+    ota_manifest_parser_init(parser, channel, OTA_HW_MODEL);
+
+    manifest_cache_t validators = {0};
+    int status = 0;
+    esp_err_t err = manifest_get(session, MANIFEST_URL, conditional ? &cache : NULL, &validators, parser, &status);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "No se pudo descargar el manifest");
+        free(parser);
         return ESP_FAIL;
     }
 
-    const cJSON *ver = cJSON_GetObjectItem(root, "version");
-    const cJSON *url = cJSON_GetObjectItem(root, "url");
+    if (status == 304) {
+        ESP_LOGI(TAG, "Manifest sin cambios (304): versión %s. No se requiere OTA.", cache.version);
+        free(parser);
+        return ESP_OK;
+    }
 
-    if (!cJSON_IsString(ver) || !cJSON_IsString(url)) {
-        ESP_LOGE(TAG, "Campos faltantes en manifest");
-        cJSON_Delete(root);
+    ota_manifest_release_t rel;
+    const ota_manifest_release_t *selected = ota_manifest_select(parser);
+    if (selected) {
+        rel = *selected;
+    }
+    free(parser);
+    if (!selected) {
+        ESP_LOGE(TAG, "Campos faltantes o no válidos en manifest");
         return ESP_FAIL;
     }
 
-    char new_version[32] = {0};
-    strncpy(new_version, ver->valuestring, sizeof(new_version) - 1);
+    char device_id[13];
+    device_id_get(device_id);
 
-    char bin_url[256] = {0};
-    strncpy(bin_url, url->valuestring, sizeof(bin_url) - 1);
+    ota_release_t policy = {
+        .version = rel.version,
+        .min_version = rel.min_version[0] ? rel.min_version : NULL,
+        .rollout = rel.rollout,
+        .downgrade = rel.downgrade,
+    };
+    ota_release_decision_t decision = ota_release_decide(&policy, local_version, device_id);
 
-    char local_version[32] = {0};
-    if (ota_get_stored_version(local_version, sizeof(local_version)) != ESP_OK) {
-        strcpy(local_version, "0.0.0");
-    }
+    ESP_LOGI(TAG, "Versión local: %s | Versión remota: %s (canal %s, %s) | %s", local_version, rel.version,
+             channel, OTA_HW_MODEL, ota_release_decision_name(decision));
 
-    ESP_LOGI(TAG, "Versión local: %s | Versión remota: %s", local_version, new_version);
+    // Con el mismo manifest la decisión es la misma: la siguiente petición
+    // puede ser condicional salvo que haya que reintentar una OTA
+    strcpy(validators.version, decision == OTA_RELEASE_UPDATE ? rel.version : local_version);
+    manifest_cache_store(&validators);
 
-    if (strcmp(new_version, local_version) == 0) {
-        ESP_LOGI(TAG, "Firmware actualizado. No se requiere OTA.");
-        cJSON_Delete(root);
+    if (decision == OTA_RELEASE_NOT_IN_ROLLOUT) {
+        ESP_LOGI(TAG, "Despliegue gradual al %u.%02u%%: este dispositivo aún no entra",
+                 rel.rollout / 100, rel.rollout % 100);
+    }
+    if (decision == OTA_RELEASE_INVALID) {
+        ESP_LOGE(TAG, "Versión del manifest no válida: %s", rel.version);
+        return ESP_FAIL;
+    }
+    if (decision != OTA_RELEASE_UPDATE) {
+        ESP_LOGI(TAG, "No se requiere OTA.");
         return ESP_OK;
     }
 
-    ESP_LOGW(TAG, "Nueva versión detectada: %s", new_version);
+    // Parche opcional: solo aplicable si la versión local es la base del parche
+    int cmp = 1;
+    bool delta = rel.delta_url[0] && rel.size &&
+                 ota_version_compare_str(rel.delta_from, local_version, &cmp) == ESP_OK && cmp == 0;
+    uint32_t delta_flags = OTA_STREAM_DELTA | (rel.delta_deflate ? OTA_STREAM_DEFLATE : 0);
+
+    uint8_t image_sha256[OTA_STREAM_SHA256_LEN];
+    const uint8_t *expected_sha256 = NULL;
+    if (rel.sha256[0]) {
+        if (!parse_sha256_hex(rel.sha256, image_sha256)) {
+            ESP_LOGE(TAG, "Campo sha256 inválido en manifest");
+            return ESP_FAIL;
+        }
+        expected_sha256 = image_sha256;
+    }
+
+    ESP_LOGW(TAG, "Nueva versión detectada: %s", rel.version);
 
     nvs_handle_t nvs;
     esp_err_t nvs_err = nvs_open("ota_info", NVS_READWRITE, &nvs);
     if (nvs_err == ESP_OK) {
-        nvs_set_str(nvs, "pending_version", new_version);
+        nvs_set_str(nvs, "pending_version", rel.version);
         nvs_commit(nvs);
         nvs_close(nvs);
-        ESP_LOGI(TAG, "pending_version guardada: %s", new_version);
+        ESP_LOGI(TAG, "pending_version guardada: %s", rel.version);
     }
 
-    cJSON_Delete(root);
+    // Tareas de fondo en pausa y CPU al máximo durante la descarga (sin
+    // efecto si la app no llamó a ota_quiesce_init); el Wi-Fi sigue en uso
+    ota_quiesce_begin(true);
+
+    esp_err_t res = ESP_FAIL;
+    if (delta) {
+        res = https_ota_stream(session, rel.delta_url, delta_flags, rel.size, expected_sha256);
+        if (res != ESP_OK) {
+            ESP_LOGW(TAG, "OTA delta falló (%s), descargando imagen completa", esp_err_to_name(res));
+        }
+    }
 
-    esp_err_t res = https_ota(bin_url);
+    if (res != ESP_OK) {
+        res = rel.deflate ? https_ota_stream(session, rel.url, OTA_STREAM_DEFLATE, rel.size, expected_sha256)
+                          : https_ota_image(session, rel.url, rel.size, expected_sha256);
+    }
+    ota_quiesce_end();
 
     if (res == ESP_OK) {
         ESP_LOGI(TAG, "OTA completada. Reinicie el dispositivo para aplicar.");
     } else {
+        // Sin imagen escrita no hay nada pendiente: ota_apply_pending_now
+        // reiniciaría en la versión actual. El siguiente check la vuelve a
+        // guardar; la imagen completa sigue desde el offset de ota_http_dl
         nvs_err = nvs_open("ota_info", NVS_READWRITE, &nvs);
         if (nvs_err == ESP_OK) {
             nvs_erase_key(nvs, "pending_version");
@@ -191,6 +581,21 @@ esp_err_t ota_check_for_update(void)
     return res;
 }
 
+esp_err_t ota_check_for_update(void)
+{
+    ota_http_session_config_t cfg = OTA_HTTP_SESSION_CONFIG_DEFAULT();
+    cfg.crt_bundle_attach = esp_crt_bundle_attach;
+
+    ota_http_session_t *session = ota_http_session_create(&cfg);
+    if (!session) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    esp_err_t res = check_for_update(session);
+    ota_http_session_destroy(session);
+    return res;
+}
+
 typedef struct {
     int hour;
     int minute;
@@ -277,4 +682,46 @@ esp_err_t ota_apply_pending_now(void)
     }
 
     return ESP_ERR_NOT_FOUND;
+}
+
+esp_err_t ota_confirm_boot(const ota_health_config_t *cfg)
+{
+    esp_err_t err = ota_health_run(cfg);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    nvs_handle_t nvs;
+    if (nvs_open("ota_info", NVS_READWRITE, &nvs) != ESP_OK) {
+        return ESP_OK;
+    }
+
+    char pending[32] = {0};
+    size_t len = sizeof(pending);
+    if (nvs_get_str(nvs, "pending_version", pending, &len) == ESP_OK) {
+        // El registro de salud puede ser de un arranque anterior: se compara
+        // con la versión que corre, no con el registro
+        const esp_app_desc_t *desc = esp_app_get_description();
+        ota_health_result_t last;
+        bool have_last = ota_health_get_last(&last) == ESP_OK;
+
+        if (strncmp(desc->version, pending, sizeof(desc->version)) == 0) {
+            nvs_set_str(nvs, "last_version", pending);
+            nvs_erase_key(nvs, "pending_version");
+            ESP_LOGI(TAG, "Versión %s confirmada", pending);
+        } else if (have_last && last.rolled_back &&
+                   strncmp(last.version, pending, sizeof(last.version)) == 0) {
+            nvs_erase_key(nvs, "pending_version");
+            ESP_LOGW(TAG, "La versión %s no pasó la prueba de salud (%s): se mantiene la anterior",
+                     pending, ota_health_status_str(last.status));
+        } else {
+            // Reinicio a mitad de la descarga (un fallo sin reinicio ya la
+            // borró en check_for_update): se deja. El siguiente check la vuelve
+            // a guardar; la imagen completa sigue desde el offset de ota_http_dl
+            ESP_LOGI(TAG, "Versión %s aún no instalada (corre %s)", pending, desc->version);
+        }
+        nvs_commit(nvs);
+    }
+    nvs_close(nvs);
+    return ESP_OK;
 }
\ No newline at end of file
@@ -3,16 +3,21 @@
 
 #include <stddef.h>
 #include "esp_err.h"
+#include "ota_health.h"
 
 /**
  * Lanza una OTA directa desde una URL dada.
  * Normalmente se usa internamente desde ota_check_for_update().
+ * La descarga es reanudable: si se corta, la siguiente llamada con la
+ * misma URL sigue donde se quedó (ver modules/OTA_HTTP).
  */
 esp_err_t https_ota(const char *url);
 
 /**
- * Comprueba el manifest remoto, decide si hay nueva versión y,
- * si la hay, guarda pending_version en NVS y ejecuta la OTA.
+ * Comprueba el manifest remoto, elige la versión del canal y modelo del
+ * dispositivo y decide si instalarla (semver, min_version y despliegue
+ * gradual, ver modules/OTA_Manifest). Si procede, guarda pending_version
+ * en NVS y ejecuta la OTA.
  */
 esp_err_t ota_check_for_update(void);
 
@@ -27,10 +32,36 @@ esp_err_t ota_schedule_daily(int hour, int minute);
  */
 esp_err_t ota_get_stored_version(char *out, size_t len);
 
+// Nombre de canal más largo (con el '\0')
+#define OTA_CHANNEL_LEN 16
+
+/**
+ * Elige el canal de actualizaciones ("stable", "beta"...), guardado en NVS
+ * (clave "channel"). Las versiones del canal están en "channels" del
+ * manifest; un canal sin entrada recibe las estables.
+ */
+esp_err_t ota_set_channel(const char *channel);
+
+/**
+ * Devuelve el canal elegido, o "stable" si no se ha elegido ninguno.
+ */
+esp_err_t ota_get_channel(char *out, size_t len);
+
 /**
  * Si existe pending_version en NVS, aplica la actualización ahora (llama a esp_restart).
  * Devuelve ESP_OK si encontró pending_version (nota: esp_restart no retorna).
  * Devuelve ESP_ERR_NOT_FOUND si no hay pending_version.
  */
 esp_err_t ota_apply_pending_now(void);
+
+/**
+ * Llamar al arrancar (tras nvs_flash_init y con Wi-Fi ya iniciado): pasa la
+ * prueba de salud de ota_health con cfg. Si la imagen que corre es
+ * pending_version y es válida, pasa a last_version; si el arranque anterior
+ * volvió a la imagen previa desde pending_version, se descarta. Si no (reinicio
+ * a mitad de la descarga) se mantiene. Una descarga que falla sin reinicio ya
+ * la borró ota_check_for_update. Si la prueba falla no retorna: reinicia en la
+ * imagen anterior.
+ */
+esp_err_t ota_confirm_boot(const ota_health_config_t *cfg);
 #endif // OTA_UPDATE_H
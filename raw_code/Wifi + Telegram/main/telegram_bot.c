@@ -8,6 +8,7 @@
 
 #include <string.h>
 #include <stdlib.h>
+#include <stdbool.h>
 #include "cJSON.h"
 
 static const char *TAG = "TELEGRAM_BOT";
@@ -20,6 +21,7 @@ static const char *TAG = "TELEGRAM_BOT";
 
 /* --- VARIABLES GLOBALES --- */
 static long last_update_id = 0;
+static volatile bool paused = false;   // Sin consultas mientras dura una OTA
 
 /* --- PROTOTIPO --- */
 static void telegram_bot_task(void *pvParameters);
@@ -146,11 +148,20 @@ static void telegram_get_updates(void)
 static void telegram_bot_task(void *pvParameters)
 {
     while (1) {
-        telegram_get_updates();
+        if (!paused) {
+            telegram_get_updates();
+        }
         vTaskDelay(pdMS_TO_TICKS(POLL_INTERVAL_MS));
     }
 }
 
+// Pausa o reanuda la consulta periódica a Telegram (p. ej. con ota_quiesce_register)
+void telegram_bot_pause(bool pause)
+{
+    paused = pause;
+    ESP_LOGI(TAG, "Consultas %s", pause ? "en pausa" : "reanudadas");
+}
+
 void telegram_bot_start(void)
 {
     esp_log_level_set("esp-x509-crt-bundle", ESP_LOG_NONE);